@@ -0,0 +1,186 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory_resource>
+#include <new>
+#include "hash_map.hpp"
+
+namespace fefu
+{
+    /**
+     *  @brief  A bump-pointer memory resource.
+     *
+     *  Memory is carved from blocks obtained from an upstream resource;
+     *  every block is twice as large as the previous one.  Deallocation is
+     *  a no-op: memory is reclaimed all at once by reset(), which keeps the
+     *  blocks for reuse, or by release(), which returns them upstream.
+     *
+     *  Meant for many short-lived containers that die together, e.g. the
+     *  per-request maps of a server: building them costs a pointer bump per
+     *  allocation and tearing them down costs a single reset().
+     *
+     *  Not thread-safe.
+     */
+    class monotonic_arena : public std::pmr::memory_resource {
+    public:
+        /**
+         *  @brief  Creates an arena without allocating.
+         *  @param  initial_size  Size of the first block in bytes.
+         *  @param  upstream      Resource the blocks are obtained from.
+         */
+        explicit monotonic_arena(std::size_t initial_size = 4096,
+            std::pmr::memory_resource* upstream = std::pmr::new_delete_resource())
+            : upstream_(upstream), head_(nullptr), current_(nullptr),
+            next_size_(std::max<std::size_t>(initial_size, 2 * sizeof(block))),
+            first_size_(next_size_), ptr_(nullptr), end_(nullptr), allocated_(0) {}
+
+        monotonic_arena(const monotonic_arena&) = delete;
+        monotonic_arena& operator=(const monotonic_arena&) = delete;
+
+        /// Returns every block upstream.
+        ~monotonic_arena() override {
+            release();
+        }
+
+        /**
+         *  @brief  Makes all memory available again, keeping the blocks.
+         *
+         *  Everything allocated from the arena is invalidated; objects
+         *  living in it must have been destroyed (or be trivially
+         *  destructible) before the call.
+         */
+        void reset() noexcept {
+            current_ = head_;
+            allocated_ = 0;
+
+            if (current_ != nullptr) {
+                ptr_ = current_->data();
+                end_ = current_->end();
+            }
+        }
+
+        /// Returns every block to the upstream resource.
+        void release() noexcept {
+            while (head_ != nullptr) {
+                block* next = head_->next;
+                upstream_->deallocate(head_, head_->size, alignof(std::max_align_t));
+                head_ = next;
+            }
+
+            current_ = nullptr;
+            ptr_ = end_ = nullptr;
+            next_size_ = first_size_;
+            allocated_ = 0;
+        }
+
+        /// Returns the bytes handed out since the last reset.
+        std::size_t bytes_allocated() const noexcept {
+            return allocated_;
+        }
+
+        /// Returns the bytes held in blocks, used or not.
+        std::size_t bytes_reserved() const noexcept {
+            std::size_t total = 0;
+            for (block* b = head_; b != nullptr; b = b->next) {
+                total += b->size;
+            }
+            return total;
+        }
+
+        /// Returns the resource the blocks come from.
+        std::pmr::memory_resource* upstream_resource() const noexcept {
+            return upstream_;
+        }
+
+    protected:
+        void* do_allocate(std::size_t bytes, std::size_t alignment) override {
+            while (true) {
+                if (ptr_ != nullptr) {
+                    std::uintptr_t p = reinterpret_cast<std::uintptr_t>(ptr_);
+                    std::uintptr_t aligned = (p + alignment - 1) & ~(static_cast<std::uintptr_t>(alignment) - 1);
+
+                    if (aligned + bytes <= reinterpret_cast<std::uintptr_t>(end_)) {
+                        ptr_ = reinterpret_cast<char*>(aligned + bytes);
+                        allocated_ += bytes;
+                        return reinterpret_cast<void*>(aligned);
+                    }
+                }
+
+                next_block(bytes + alignment);
+            }
+        }
+
+        void do_deallocate(void*, std::size_t, std::size_t) override {}
+
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+            return this == &other;
+        }
+
+    private:
+        struct alignas(std::max_align_t) block {
+            block* next;
+            std::size_t size;
+
+            char* data() noexcept {
+                return reinterpret_cast<char*>(this + 1);
+            }
+
+            char* end() noexcept {
+                return reinterpret_cast<char*>(this) + size;
+            }
+        };
+
+        std::pmr::memory_resource* upstream_;
+        block* head_;
+        block* current_;
+        std::size_t next_size_;
+        std::size_t first_size_;
+        char* ptr_;
+        char* end_;
+        std::size_t allocated_;
+
+        // Moves to the next kept block or chains a new one of at least @a bytes.
+        void next_block(std::size_t bytes) {
+            if (current_ != nullptr && current_->next != nullptr &&
+                current_->next->size - sizeof(block) >= bytes) {
+                current_ = current_->next;
+            }
+            else {
+                std::size_t size = next_size_;
+                while (size - sizeof(block) < bytes) {
+                    size *= 2;
+                }
+                next_size_ = size * 2;
+
+                block* b = static_cast<block*>(upstream_->allocate(size, alignof(std::max_align_t)));
+                b->size = size;
+
+                if (current_ == nullptr) {
+                    b->next = head_;
+                    head_ = b;
+                }
+                else {
+                    b->next = current_->next;
+                    current_->next = b;
+                }
+                current_ = b;
+            }
+
+            ptr_ = current_->data();
+            end_ = current_->end();
+        }
+    };
+
+    namespace pmr
+    {
+        /// A %hash_map whose buckets come from a std::pmr::memory_resource.
+        template<typename K, typename T,
+            typename Hash = std::hash<K>,
+            typename Pred = std::equal_to<K>>
+            using hash_map = fefu::hash_map<K, T, Hash, Pred,
+            std::pmr::polymorphic_allocator<std::pair<const K, T>>>;
+    } // namespace pmr
+
+} // namespace fefu
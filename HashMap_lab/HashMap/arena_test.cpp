@@ -0,0 +1,100 @@
+#include <string>
+#include <vector>
+#include "arena.hpp"
+#include "../catch.hpp"
+
+TEST_CASE("monotonic_arena bump allocation", "[arena]") {
+    fefu::monotonic_arena arena(256);
+
+    void* a = arena.allocate(10, 1);
+    void* b = arena.allocate(8, 8);
+    REQUIRE(reinterpret_cast<std::uintptr_t>(b) % 8 == 0);
+    REQUIRE(static_cast<char*>(b) >= static_cast<char*>(a) + 10);
+    REQUIRE(arena.bytes_allocated() == 18);
+
+    SECTION("large requests get their own block") {
+        void* big = arena.allocate(10000, 64);
+        REQUIRE(reinterpret_cast<std::uintptr_t>(big) % 64 == 0);
+        REQUIRE(arena.bytes_reserved() >= 10000 + 256);
+    }
+    SECTION("reset reuses the blocks") {
+        std::size_t reserved = arena.bytes_reserved();
+        arena.reset();
+        REQUIRE(arena.bytes_allocated() == 0);
+        REQUIRE(arena.allocate(10, 1) == a);
+        REQUIRE(arena.bytes_reserved() == reserved);
+    }
+    SECTION("release returns the blocks") {
+        arena.release();
+        REQUIRE(arena.bytes_reserved() == 0);
+        REQUIRE(arena.allocate(4, 4) != nullptr);
+    }
+}
+
+TEST_CASE("pmr hash_map allocates from the arena", "[arena]") {
+    fefu::monotonic_arena arena;
+    std::pmr::polymorphic_allocator<std::pair<const int, int>> alloc(&arena);
+
+    {
+        fefu::pmr::hash_map<int, int> map(alloc);
+        for (int i = 0; i < 1000; i++) {
+            map[i] = i * i;
+        }
+
+        REQUIRE(map.get_allocator().resource() == &arena);
+        REQUIRE(arena.bytes_allocated() > 1000 * sizeof(std::pair<const int, int>));
+        REQUIRE(map.at(999) == 999 * 999);
+
+        fefu::pmr::hash_map<int, int> copy(map);
+        REQUIRE(copy.get_allocator().resource() == std::pmr::get_default_resource());
+        REQUIRE(copy.at(31) == 31 * 31);
+
+        fefu::pmr::hash_map<int, int> moved(std::move(copy), alloc);
+        REQUIRE(moved.get_allocator().resource() == &arena);
+        REQUIRE(moved.size() == 1000);
+        REQUIRE(moved.at(31) == 31 * 31);
+
+        moved = map;
+        REQUIRE(moved.get_allocator().resource() == &arena);
+        REQUIRE(moved.size() == 1000);
+    }
+
+    arena.reset();
+    REQUIRE(arena.bytes_allocated() == 0);
+}
+
+TEST_CASE("Small short-lived maps with and without an arena", "[arena][!benchmark]") {
+    const int maps = 10000;
+    const int elements = 16;
+
+    BENCHMARK("default allocator") {
+        std::size_t total = 0;
+        for (int m = 0; m < maps; m++) {
+            fefu::hash_map<int, int> map;
+            for (int i = 0; i < elements; i++) {
+                map[m + i] = i;
+            }
+            total += map.size();
+        }
+        return total;
+    };
+
+    BENCHMARK("monotonic_arena, reset per batch of 100 maps") {
+        fefu::monotonic_arena arena(1 << 16);
+        std::pmr::polymorphic_allocator<std::pair<const int, int>> alloc(&arena);
+        std::size_t total = 0;
+        for (int m = 0; m < maps; m++) {
+            {
+                fefu::pmr::hash_map<int, int> map(alloc);
+                for (int i = 0; i < elements; i++) {
+                    map[m + i] = i;
+                }
+                total += map.size();
+            }
+            if (m % 100 == 99) {
+                arena.reset();
+            }
+        }
+        return total;
+    };
+}
@@ -0,0 +1,146 @@
+#pragma once
+#include <functional>
+#include <mutex>
+#include <utility>
+#include "hash_map.hpp"
+
+namespace fefu
+{
+    /**
+     *  @brief  A shared %hash_map fed through per-thread write-combining
+     *          buffers.
+     *
+     *  Each writer thread owns a %buffer, a small private %hash_map that
+     *  combines updates to the same key locally.  A buffer is flushed into
+     *  the shared map under a single lock acquisition when it holds
+     *  flush_threshold distinct keys, when flush() is called, or when it is
+     *  destroyed.  Hot keys therefore touch the shared map once per flush
+     *  rather than once per update.
+     *
+     *  Updates are combined with Merge, called as merge(old, update) and
+     *  returning the new value.  It must be associative and commutative
+     *  for the result not to depend on flush order.  std::plus<T> gives
+     *  counting and summing.
+     */
+    template<typename K, typename T,
+        typename Merge = std::plus<T>,
+        typename Hash = std::hash<K>,
+        typename Pred = std::equal_to<K>>
+        class combining_hash_map
+    {
+    public:
+        using map_type = hash_map<K, T, Hash, Pred>;
+        using key_type = K;
+        using mapped_type = T;
+        using size_type = std::size_t;
+
+        /// Thread-private front end; must not be shared between threads.
+        class buffer {
+        public:
+            explicit buffer(combining_hash_map& owner) : owner_(&owner), local_(owner.flush_threshold_ * 2) {}
+
+            buffer(const buffer&) = delete;
+            buffer& operator=(const buffer&) = delete;
+
+            buffer(buffer&& other) noexcept : owner_(other.owner_), local_(std::move(other.local_)) {
+                other.owner_ = nullptr;
+            }
+
+            /// Flushes pending updates.
+            ~buffer() {
+                if (owner_ != nullptr) {
+                    flush();
+                }
+            }
+
+            /**
+             *  @brief  Combines @a value into the pending update of @a k.
+             *
+             *  Flushes the buffer once it holds flush_threshold keys.
+             */
+            template<typename V>
+            void update(const key_type& k, V&& value) {
+                auto inserted = local_.try_emplace(k, std::forward<V>(value));
+
+                if (!inserted.second) {
+                    inserted.first->second = owner_->merge_(std::move(inserted.first->second), std::forward<V>(value));
+                }
+                else if (local_.size() >= owner_->flush_threshold_) {
+                    flush();
+                }
+            }
+
+            /// Publishes all pending updates to the shared map.
+            void flush() {
+                if (!local_.empty()) {
+                    owner_->merge_from(local_);
+                    local_.clear();
+                }
+            }
+
+            /// Returns the number of keys waiting to be flushed.
+            size_type pending() const noexcept {
+                return local_.size();
+            }
+
+        private:
+            combining_hash_map* owner_;
+            map_type local_;
+        };
+
+        /**
+         *  @brief  Creates an empty shared map.
+         *  @param  flush_threshold  Distinct keys a buffer holds before it
+         *                           flushes itself.
+         *  @param  merge  The combining functor.
+         */
+        explicit combining_hash_map(size_type flush_threshold = 256, const Merge& merge = Merge())
+            : flush_threshold_(flush_threshold == 0 ? 1 : flush_threshold), merge_(merge) {}
+
+        combining_hash_map(const combining_hash_map&) = delete;
+        combining_hash_map& operator=(const combining_hash_map&) = delete;
+
+        /// Creates a write buffer for the calling thread.
+        buffer make_buffer() {
+            return buffer(*this);
+        }
+
+        /// Calls @a f with the shared map while holding its lock.
+        template<typename F>
+        void visit(F&& f) const {
+            std::lock_guard<std::mutex> lock(mutex_);
+            std::forward<F>(f)(static_cast<const map_type&>(shared_));
+        }
+
+        /// Copies the flushed contents of the shared map.
+        map_type snapshot() const {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return shared_;
+        }
+
+        /// Returns the number of distinct keys flushed so far.
+        size_type size() const {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return shared_.size();
+        }
+
+    private:
+        size_type flush_threshold_;
+        Merge merge_;
+        mutable std::mutex mutex_;
+        map_type shared_;
+
+        void merge_from(map_type& local) {
+            std::lock_guard<std::mutex> lock(mutex_);
+
+            for (auto& element : local) {
+                auto inserted = shared_.try_emplace(element.first, std::move(element.second));
+
+                if (!inserted.second) {
+                    inserted.first->second = merge_(std::move(inserted.first->second), std::move(element.second));
+                }
+            }
+        }
+    };
+
+} // namespace fefu
@@ -0,0 +1,140 @@
+#include <algorithm>
+#include <cmath>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include "combining_hash_map.hpp"
+#include "../catch.hpp"
+
+namespace
+{
+    // Samples ranks 0..n-1 with probability proportional to 1 / (rank + 1)^s.
+    class zipf_distribution {
+    public:
+        zipf_distribution(unsigned n, double s) : cdf_(n) {
+            double sum = 0;
+            for (unsigned i = 0; i < n; i++) {
+                sum += 1.0 / std::pow(i + 1.0, s);
+                cdf_[i] = sum;
+            }
+            for (auto& p : cdf_) {
+                p /= sum;
+            }
+        }
+
+        template<typename Generator>
+        unsigned operator()(Generator& generator) {
+            double u = std::uniform_real_distribution<double>(0, 1)(generator);
+            return static_cast<unsigned>(std::lower_bound(cdf_.begin(), cdf_.end(), u) - cdf_.begin());
+        }
+
+    private:
+        std::vector<double> cdf_;
+    };
+}
+
+TEST_CASE("combining_hash_map flush semantics", "[combining_hash_map]") {
+    fefu::combining_hash_map<int, int> shared(3);
+
+    {
+        auto buffer = shared.make_buffer();
+        buffer.update(1, 5);
+        buffer.update(1, 5);
+        buffer.update(2, 1);
+
+        REQUIRE(buffer.pending() == 2);
+        REQUIRE(shared.size() == 0);
+
+        SECTION("threshold flush") {
+            buffer.update(3, 1);
+            REQUIRE(buffer.pending() == 0);
+            REQUIRE(shared.snapshot().at(1) == 10);
+        }
+        SECTION("explicit flush") {
+            buffer.flush();
+            REQUIRE(buffer.pending() == 0);
+            REQUIRE(shared.snapshot().at(2) == 1);
+        }
+    }
+
+    auto result = shared.snapshot();
+    REQUIRE(result.at(1) == 10);
+    REQUIRE(result.at(2) == 1);
+}
+
+TEST_CASE("combining_hash_map custom merge from many threads", "[combining_hash_map]") {
+    auto max = [](int a, int b) { return std::max(a, b); };
+    fefu::combining_hash_map<int, int, decltype(max)> shared(16, max);
+    std::vector<std::thread> threads;
+
+    for (int t = 0; t < 4; t++) {
+        threads.emplace_back([&shared, t] {
+            auto buffer = shared.make_buffer();
+            for (int i = 0; i < 1000; i++) {
+                buffer.update(i % 100, i * 4 + t);
+            }
+        });
+    }
+
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    shared.visit([](const fefu::hash_map<int, int>& map) {
+        REQUIRE(map.size() == 100);
+        REQUIRE(map.at(0) == 900 * 4 + 3);
+        REQUIRE(map.at(99) == 999 * 4 + 3);
+    });
+}
+
+TEST_CASE("combining_hash_map contention on Zipfian keys", "[combining_hash_map][!benchmark]") {
+    const unsigned threads_count = std::max(2u, std::thread::hardware_concurrency());
+    const unsigned keys = 1 << 16;
+    const int updates_per_thread = 1 << 18;
+
+    for (double skew : { 0.8, 0.99, 1.2 }) {
+        zipf_distribution zipf(keys, skew);
+        std::vector<std::vector<unsigned>> streams(threads_count);
+        for (unsigned t = 0; t < threads_count; t++) {
+            std::mt19937 generator(t);
+            for (int i = 0; i < updates_per_thread; i++) {
+                streams[t].push_back(zipf(generator));
+            }
+        }
+
+        auto run = [&](auto body) {
+            std::vector<std::thread> threads;
+            for (unsigned t = 0; t < threads_count; t++) {
+                threads.emplace_back(body, std::cref(streams[t]));
+            }
+            for (auto& thread : threads) {
+                thread.join();
+            }
+        };
+
+        BENCHMARK("combining buffers, skew " + std::to_string(skew)) {
+            fefu::combining_hash_map<unsigned, long long> shared(1024);
+            run([&](const std::vector<unsigned>& stream) {
+                auto buffer = shared.make_buffer();
+                for (unsigned key : stream) {
+                    buffer.update(key, 1);
+                }
+            });
+            return shared.size();
+        };
+
+        BENCHMARK("mutex-guarded updates, skew " + std::to_string(skew)) {
+            fefu::hash_map<unsigned, long long> shared;
+            std::mutex mutex;
+            run([&](const std::vector<unsigned>& stream) {
+                for (unsigned key : stream) {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    shared[key] += 1;
+                }
+            });
+            return shared.size();
+        };
+    }
+}
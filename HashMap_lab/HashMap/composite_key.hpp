@@ -0,0 +1,261 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+namespace fefu
+{
+    template<typename... Ts>
+    class packed_key;
+
+    namespace detail
+    {
+        template<typename Key, typename Indices>
+        struct packed_prefix;
+
+        template<typename... Ts, std::size_t... I>
+        struct packed_prefix<packed_key<Ts...>, std::index_sequence<I...>> {
+            using type = packed_key<typename std::tuple_element<I, std::tuple<Ts...>>::type...>;
+        };
+
+        template<typename Word>
+        Word load(const unsigned char* bytes) noexcept {
+            Word word;
+            std::memcpy(&word, bytes, sizeof(Word));
+            return word;
+        }
+
+        /**
+         *  Reads the last N % 8 bytes of an N-byte run as one word, with
+         *  whole loads that may overlap bytes already hashed.  Assembling
+         *  the tail from byte copies into a zeroed word would go through
+         *  the stack and stall the load that follows.
+         */
+        template<std::size_t N>
+        std::uint64_t load_tail(const unsigned char* bytes) noexcept {
+            if constexpr (N >= 8) {
+                return load<std::uint64_t>(bytes + N - 8);
+            }
+            else if constexpr (N >= 4) {
+                return load<std::uint32_t>(bytes) | std::uint64_t(load<std::uint32_t>(bytes + N - 4)) << 32;
+            }
+            else if constexpr (N >= 2) {
+                return load<std::uint16_t>(bytes) | std::uint64_t(load<std::uint16_t>(bytes + N - 2)) << 16;
+            }
+            else {
+                return bytes[0];
+            }
+        }
+
+        /**
+         *  Hashes N bytes a 64-bit word at a time.  N is known at compile
+         *  time, so the loop is unrolled into one multiply per word,
+         *  followed by a single finalizer.
+         */
+        template<std::size_t N>
+        std::uint64_t hash_words(const unsigned char* bytes) noexcept {
+            std::uint64_t h = 0x9E3779B97F4A7C15ULL ^ N;
+
+            for (std::size_t i = 0; i + 8 <= N; i += 8) {
+                h = (h ^ load<std::uint64_t>(bytes + i)) * 0xff51afd7ed558ccdULL;
+                h ^= h >> 32;
+            }
+            if constexpr (N % 8 != 0) {
+                h = (h ^ load_tail<N>(bytes)) * 0xff51afd7ed558ccdULL;
+                h ^= h >> 32;
+            }
+
+            h ^= h >> 33;
+            h *= 0xc4ceb9fe1a85ec53ULL;
+            h ^= h >> 33;
+            return h;
+        }
+    }
+
+    /**
+     *  @brief  A composite key whose members are stored back to back.
+     *
+     *  A std::tuple<std::uint32_t, std::uint64_t, std::uint16_t> takes 24
+     *  bytes, 10 of them padding; packed_key of the same members takes 14.
+     *  Members are read and written with memcpy, so the key has alignment
+     *  1 and can be compared and hashed as a single run of bytes.  This
+     *  needs members whose value is their bytes: integers, enums, and
+     *  structs of those without padding.
+     *
+     *  std::hash is specialized with packed_key_hash, so a packed_key can
+     *  key a %hash_map directly.  Members are read with get<I>() or
+     *  structured bindings.
+     */
+    template<typename... Ts>
+    class packed_key {
+        static_assert(sizeof...(Ts) > 0, "packed_key needs at least one member");
+        static_assert((std::has_unique_object_representations<Ts>::value && ...),
+            "packed_key compares its members bytewise, so each member needs a unique object representation");
+
+    public:
+        /// Bytes taken by the members.
+        static constexpr std::size_t size = (sizeof(Ts) + ...);
+
+        template<std::size_t I>
+        using element_type = typename std::tuple_element<I, std::tuple<Ts...>>::type;
+
+        /// The packed_key of the first @a N members.
+        template<std::size_t N>
+        using prefix_type = typename detail::packed_prefix<packed_key, std::make_index_sequence<N>>::type;
+
+        /// All members zero.
+        packed_key() noexcept : bytes_() {}
+
+        packed_key(const Ts&... members) noexcept {
+            std::size_t offset = 0;
+            ((std::memcpy(bytes_ + offset, &members, sizeof(Ts)), offset += sizeof(Ts)), ...);
+        }
+
+        explicit packed_key(const std::tuple<Ts...>& members) noexcept
+            : packed_key(std::make_from_tuple<packed_key>(members)) {}
+
+        /// Returns member @a I.
+        template<std::size_t I>
+        element_type<I> get() const noexcept {
+            element_type<I> member;
+            std::memcpy(&member, bytes_ + offset_of(I), sizeof(member));
+            return member;
+        }
+
+        /// Overwrites member @a I.
+        template<std::size_t I>
+        void set(const element_type<I>& member) noexcept {
+            std::memcpy(bytes_ + offset_of(I), &member, sizeof(member));
+        }
+
+        std::tuple<Ts...> unpack() const noexcept {
+            return unpack(std::index_sequence_for<Ts...>());
+        }
+
+        /// Returns the key made of the first @a N members.
+        template<std::size_t N>
+        prefix_type<N> prefix() const noexcept {
+            static_assert(N > 0 && N <= sizeof...(Ts), "prefix length out of range");
+            prefix_type<N> result;
+            std::memcpy(result.bytes_, bytes_, prefix_type<N>::size);
+            return result;
+        }
+
+        /// Returns true if the first members of this key equal @a p.
+        template<typename... Ps>
+        bool starts_with(const packed_key<Ps...>& p) const noexcept {
+            static_assert(sizeof...(Ps) <= sizeof...(Ts) && std::is_same<packed_key<Ps...>, prefix_type<sizeof...(Ps)>>::value,
+                "the members of the prefix must be the leading members of the key");
+            return std::memcmp(bytes_, p.bytes_, p.size) == 0;
+        }
+
+        /// The packed members, size bytes.
+        const unsigned char* data() const noexcept {
+            return bytes_;
+        }
+
+        friend bool operator==(const packed_key& lhs, const packed_key& rhs) noexcept {
+            return std::memcmp(lhs.bytes_, rhs.bytes_, size) == 0;
+        }
+
+        friend bool operator!=(const packed_key& lhs, const packed_key& rhs) noexcept {
+            return !(lhs == rhs);
+        }
+
+    private:
+        template<typename...>
+        friend class packed_key;
+
+        unsigned char bytes_[size];
+
+        static constexpr std::size_t offset_of(std::size_t i) noexcept {
+            constexpr std::size_t sizes[] = { sizeof(Ts)... };
+            std::size_t offset = 0;
+            for (std::size_t j = 0; j != i; j++) {
+                offset += sizes[j];
+            }
+            return offset;
+        }
+
+        template<std::size_t... I>
+        std::tuple<Ts...> unpack(std::index_sequence<I...>) const noexcept {
+            return std::tuple<Ts...>(get<I>()...);
+        }
+    };
+
+    template<typename... Ts>
+    packed_key<typename std::decay<Ts>::type...> make_packed_key(Ts&&... members) noexcept {
+        return packed_key<typename std::decay<Ts>::type...>(members...);
+    }
+
+    template<std::size_t I, typename... Ts>
+    typename packed_key<Ts...>::template element_type<I> get(const packed_key<Ts...>& key) noexcept {
+        return key.template get<I>();
+    }
+
+    /**
+     *  @brief  Hashes all members of a packed_key in one pass.
+     *
+     *  The packed bytes are hashed as 64-bit words, with no per-member
+     *  hash and no hash_combine between members.
+     */
+    template<typename... Ts>
+    struct packed_key_hash {
+        std::size_t operator()(const packed_key<Ts...>& key) const noexcept {
+            return static_cast<std::size_t>(detail::hash_words<packed_key<Ts...>::size>(key.data()));
+        }
+    };
+
+    //@{
+    /**
+     *  @brief  Visits the elements of @a map whose key starts with @a prefix.
+     *
+     *  The hash covers the whole key, so elements sharing a prefix are
+     *  spread over the table: both helpers scan every element, comparing
+     *  the leading bytes of each key.
+     */
+    template<typename Map, typename... Ps, typename F>
+    void for_each_prefix(Map& map, const packed_key<Ps...>& prefix, F f) {
+        for (auto& element : map) {
+            if (element.first.starts_with(prefix)) {
+                f(element);
+            }
+        }
+    }
+
+    /// Erases the elements of @a map whose key starts with @a prefix; returns the number erased.
+    template<typename Map, typename... Ps>
+    std::size_t erase_prefix(Map& map, const packed_key<Ps...>& prefix) {
+        std::size_t erased = 0;
+        for (auto it = map.begin(); it != map.end();) {
+            if (it->first.starts_with(prefix)) {
+                it = map.erase(it);
+                erased++;
+            }
+            else {
+                ++it;
+            }
+        }
+        return erased;
+    }
+    //@}
+
+} // namespace fefu
+
+namespace std
+{
+    template<typename... Ts>
+    struct hash<fefu::packed_key<Ts...>> : fefu::packed_key_hash<Ts...> {};
+
+    template<typename... Ts>
+    struct tuple_size<fefu::packed_key<Ts...>> : std::integral_constant<std::size_t, sizeof...(Ts)> {};
+
+    template<std::size_t I, typename... Ts>
+    struct tuple_element<I, fefu::packed_key<Ts...>> {
+        using type = typename fefu::packed_key<Ts...>::template element_type<I>;
+    };
+}
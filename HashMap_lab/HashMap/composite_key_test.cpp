@@ -0,0 +1,140 @@
+#include <cstdint>
+#include <functional>
+#include <random>
+#include <tuple>
+#include <unordered_set>
+#include <vector>
+#include "composite_key.hpp"
+#include "hash_map.hpp"
+#include "../catch.hpp"
+
+namespace
+{
+    using tuple_key = std::tuple<std::uint32_t, std::uint64_t, std::uint16_t>;
+    using tenant_user_day = fefu::packed_key<std::uint32_t, std::uint64_t, std::uint16_t>;
+
+    // What the maps keyed by tuples used to carry.
+    struct tuple_key_hash {
+        std::size_t operator()(const tuple_key& key) const noexcept {
+            std::size_t seed = std::hash<std::uint32_t>()(std::get<0>(key));
+            seed ^= std::hash<std::uint64_t>()(std::get<1>(key)) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+            seed ^= std::hash<std::uint16_t>()(std::get<2>(key)) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+            return seed;
+        }
+    };
+}
+
+TEST_CASE("packed_key stores members without padding", "[composite_key]") {
+    static_assert(sizeof(tenant_user_day) == 14, "no padding");
+    static_assert(alignof(tenant_user_day) == 1, "byte aligned");
+
+    tenant_user_day key(7, 123456789012ULL, 300);
+    REQUIRE(key.get<0>() == 7);
+    REQUIRE(key.get<1>() == 123456789012ULL);
+    REQUIRE(fefu::get<2>(key) == 300);
+    REQUIRE(key.unpack() == tuple_key(7, 123456789012ULL, 300));
+    REQUIRE(tenant_user_day(key.unpack()) == key);
+
+    auto [tenant, user, day] = key;
+    REQUIRE(tenant == 7);
+    REQUIRE(user == 123456789012ULL);
+    REQUIRE(day == 300);
+
+    tenant_user_day other = key;
+    other.set<2>(301);
+    REQUIRE(other != key);
+    REQUIRE(other.starts_with(key.prefix<2>()));
+    REQUIRE(other.starts_with(fefu::make_packed_key(std::uint32_t(7))));
+    REQUIRE_FALSE(other.starts_with(fefu::make_packed_key(std::uint32_t(8))));
+    REQUIRE(std::hash<tenant_user_day>()(other) != std::hash<tenant_user_day>()(key));
+}
+
+TEST_CASE("hash_map keyed by packed_key", "[composite_key]") {
+    fefu::hash_map<tenant_user_day, int> map;
+    for (std::uint32_t tenant = 0; tenant < 10; tenant++) {
+        for (std::uint64_t user = 0; user < 100; user++) {
+            for (std::uint16_t day = 0; day < 10; day++) {
+                map[tenant_user_day(tenant, user, day)] = static_cast<int>(tenant * 10000 + user * 10 + day);
+            }
+        }
+    }
+    REQUIRE(map.size() == 10000);
+    REQUIRE(map.at(tenant_user_day(3, 42, 5)) == 30425);
+    REQUIRE_FALSE(map.contains(tenant_user_day(3, 42, 10)));
+
+    std::size_t visited = 0;
+    fefu::for_each_prefix(map, fefu::make_packed_key(std::uint32_t(3), std::uint64_t(42)), [&](auto& element) {
+        REQUIRE(element.second / 10 == 3042);
+        visited++;
+    });
+    REQUIRE(visited == 10);
+
+    REQUIRE(fefu::erase_prefix(map, fefu::make_packed_key(std::uint32_t(4))) == 1000);
+    REQUIRE(map.size() == 9000);
+    REQUIRE_FALSE(map.contains(tenant_user_day(4, 0, 0)));
+    REQUIRE(map.contains(tenant_user_day(5, 0, 0)));
+
+    // Keys differing in a single member still spread over the table.
+    std::unordered_set<std::size_t> buckets;
+    for (std::uint16_t day = 0; day < 1000; day++) {
+        buckets.insert(std::hash<tenant_user_day>()(tenant_user_day(1, 1, day)) % 1009);
+    }
+    REQUIRE(buckets.size() > 550);
+}
+
+TEST_CASE("Composite keys: std::tuple with a combining hash versus packed_key", "[composite_key][!benchmark]") {
+    const std::size_t elements = 1 << 21;
+
+    std::mt19937_64 generator(16);
+    std::vector<tuple_key> tuples(elements);
+    std::vector<tenant_user_day> packed(elements);
+    for (std::size_t i = 0; i < elements; i++) {
+        tuples[i] = tuple_key(static_cast<std::uint32_t>(generator() % 1000), generator(), static_cast<std::uint16_t>(generator() % 365));
+        packed[i] = tenant_user_day(tuples[i]);
+    }
+
+    std::vector<std::size_t> probes(elements);
+    for (auto& probe : probes) {
+        probe = generator() % elements;
+    }
+
+    fefu::hash_map<tuple_key, std::uint32_t, tuple_key_hash> tuple_map;
+    fefu::hash_map<tenant_user_day, std::uint32_t> packed_map;
+
+    BENCHMARK("std::tuple build") {
+        tuple_map = fefu::hash_map<tuple_key, std::uint32_t, tuple_key_hash>();
+        for (std::size_t i = 0; i < elements; i++) {
+            tuple_map[tuples[i]] = static_cast<std::uint32_t>(i);
+        }
+        return tuple_map.size();
+    };
+
+    BENCHMARK("packed_key build") {
+        packed_map = fefu::hash_map<tenant_user_day, std::uint32_t>();
+        for (std::size_t i = 0; i < elements; i++) {
+            packed_map[packed[i]] = static_cast<std::uint32_t>(i);
+        }
+        return packed_map.size();
+    };
+
+    WARN("bytes per element: std::tuple " << sizeof(std::pair<const tuple_key, std::uint32_t>)
+        << ", packed_key " << sizeof(std::pair<const tenant_user_day, std::uint32_t>)
+        << "; tables: " << tuple_map.memory_usage().total() / (1 << 20) << " MiB versus "
+        << packed_map.memory_usage().total() / (1 << 20) << " MiB");
+
+    BENCHMARK("std::tuple find") {
+        std::uint64_t sum = 0;
+        for (std::size_t i : probes) {
+            sum += tuple_map.find(tuples[i])->second;
+        }
+        return sum;
+    };
+
+    BENCHMARK("packed_key find") {
+        std::uint64_t sum = 0;
+        for (std::size_t i : probes) {
+            sum += packed_map.find(packed[i])->second;
+        }
+        return sum;
+    };
+}
@@ -0,0 +1,140 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <type_traits>
+#include "hash_map.hpp"
+
+namespace fefu
+{
+    /// Allocation counters shared by the copies of a %counting_allocator.
+    class allocation_stats {
+    public:
+        allocation_stats() noexcept : live_(0), peak_(0), allocations_(0), deallocations_(0) {}
+
+        allocation_stats(const allocation_stats&) = delete;
+        allocation_stats& operator=(const allocation_stats&) = delete;
+
+        /// Bytes allocated and not yet freed.
+        std::size_t live_bytes() const noexcept {
+            return live_.load(std::memory_order_relaxed);
+        }
+
+        /// Highest value live_bytes() has reached.
+        std::size_t peak_bytes() const noexcept {
+            return peak_.load(std::memory_order_relaxed);
+        }
+
+        /// Number of allocate() calls.
+        std::size_t allocations() const noexcept {
+            return allocations_.load(std::memory_order_relaxed);
+        }
+
+        /// Number of deallocate() calls.
+        std::size_t deallocations() const noexcept {
+            return deallocations_.load(std::memory_order_relaxed);
+        }
+
+        void on_allocate(std::size_t bytes) noexcept {
+            allocations_.fetch_add(1, std::memory_order_relaxed);
+            std::size_t live = live_.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+            std::size_t peak = peak_.load(std::memory_order_relaxed);
+
+            while (live > peak && !peak_.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {
+            }
+        }
+
+        void on_deallocate(std::size_t bytes) noexcept {
+            deallocations_.fetch_add(1, std::memory_order_relaxed);
+            live_.fetch_sub(bytes, std::memory_order_relaxed);
+        }
+
+    private:
+        std::atomic<std::size_t> live_;
+        std::atomic<std::size_t> peak_;
+        std::atomic<std::size_t> allocations_;
+        std::atomic<std::size_t> deallocations_;
+    };
+
+    /**
+     *  @brief  An allocator adaptor recording what a container allocates.
+     *
+     *  A default-constructed %counting_allocator owns fresh counters, and
+     *  so does the allocator of a container copy, so every container
+     *  instance reports its own usage.  Rebound copies, such as the one a
+     *  %hash_map uses for its bitmaps, share the counters of the original.
+     *  Counters outlive the container: keep the pointer from stats_ptr()
+     *  to export them.
+     */
+    template<typename T, typename Alloc = allocator<T>>
+    class counting_allocator {
+    public:
+        using size_type = std::size_t;
+        using difference_type = std::ptrdiff_t;
+        using pointer = T*;
+        using const_pointer = const T*;
+        using value_type = T;
+        using propagate_on_container_copy_assignment = std::false_type;
+        using propagate_on_container_move_assignment = std::true_type;
+        using propagate_on_container_swap = std::true_type;
+        using is_always_equal = std::false_type;
+
+        template<typename U>
+        struct rebind {
+            using other = counting_allocator<U, typename std::allocator_traits<Alloc>::template rebind_alloc<U>>;
+        };
+
+        counting_allocator() : stats_(std::make_shared<allocation_stats>()), upstream_() {}
+
+        explicit counting_allocator(const Alloc& upstream)
+            : stats_(std::make_shared<allocation_stats>()), upstream_(upstream) {}
+
+        counting_allocator(const counting_allocator&) noexcept = default;
+
+        template<typename U, typename A>
+        counting_allocator(const counting_allocator<U, A>& other) noexcept
+            : stats_(other.stats_), upstream_(other.upstream_) {}
+
+        pointer allocate(size_type n = 1) {
+            pointer p = std::allocator_traits<Alloc>::allocate(upstream_, n);
+            stats_->on_allocate(n * sizeof(T));
+            return p;
+        }
+
+        void deallocate(pointer p, size_type n) noexcept {
+            std::allocator_traits<Alloc>::deallocate(upstream_, p, n);
+            stats_->on_deallocate(n * sizeof(T));
+        }
+
+        /// A container copy gets its own counters.
+        counting_allocator select_on_container_copy_construction() const {
+            return counting_allocator(std::allocator_traits<Alloc>::select_on_container_copy_construction(upstream_));
+        }
+
+        const allocation_stats& stats() const noexcept {
+            return *stats_;
+        }
+
+        std::shared_ptr<const allocation_stats> stats_ptr() const noexcept {
+            return stats_;
+        }
+
+        template<typename U, typename A>
+        bool operator==(const counting_allocator<U, A>& other) const noexcept {
+            return stats_ == other.stats_ && upstream_ == other.upstream_;
+        }
+
+        template<typename U, typename A>
+        bool operator!=(const counting_allocator<U, A>& other) const noexcept {
+            return !(*this == other);
+        }
+
+    private:
+        template<typename, typename>
+        friend class counting_allocator;
+
+        std::shared_ptr<allocation_stats> stats_;
+        Alloc upstream_;
+    };
+
+} // namespace fefu
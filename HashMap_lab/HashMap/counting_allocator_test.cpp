@@ -0,0 +1,62 @@
+#include <string>
+#include "counting_allocator.hpp"
+#include "hash_map.hpp"
+#include "../catch.hpp"
+
+namespace
+{
+    template<typename K, typename T>
+    using counted_map = fefu::hash_map<K, T, std::hash<K>, std::equal_to<K>,
+        fefu::counting_allocator<std::pair<const K, T>>>;
+}
+
+TEST_CASE("hash_map memory_usage", "[memory]") {
+    fefu::hash_map<int, std::string> map(100);
+
+    fefu::memory_footprint empty = map.memory_usage();
+    REQUIRE(empty.object == sizeof(map));
+    REQUIRE(empty.slots == map.bucket_count() * sizeof(std::pair<const int, std::string>));
+    REQUIRE(empty.metadata >= 2 * map.bucket_count() / 8);
+    REQUIRE(empty.heap == 0);
+
+    map[1] = "short";
+    map[2] = std::string(1000, 'x');
+
+    auto heap = [](const std::pair<const int, std::string>& element) {
+        const char* data = element.second.data();
+        const char* object = reinterpret_cast<const char*>(&element.second);
+        bool inline_buffer = data >= object && data < object + sizeof(std::string);
+        return inline_buffer ? std::size_t(0) : element.second.capacity() + 1;
+    };
+
+    fefu::memory_footprint full = map.memory_usage(heap);
+    REQUIRE(full.slots == empty.slots);
+    REQUIRE(full.heap >= 1001);
+    REQUIRE(full.total() == full.object + full.slots + full.metadata + full.heap);
+}
+
+TEST_CASE("counting_allocator tracks each container", "[memory]") {
+    counted_map<int, int> map;
+    const fefu::allocation_stats& stats = map.get_allocator().stats();
+
+    for (int i = 0; i < 1000; i++) {
+        map[i] = i;
+    }
+
+    REQUIRE(stats.allocations() > 0);
+    REQUIRE(stats.live_bytes() >= map.memory_usage().slots);
+    REQUIRE(stats.peak_bytes() > stats.live_bytes());
+    REQUIRE(stats.allocations() - stats.deallocations() == 3);
+
+    SECTION("copies count separately") {
+        counted_map<int, int> copy(map);
+        REQUIRE(&copy.get_allocator().stats() != &stats);
+        REQUIRE(copy.get_allocator().stats().live_bytes() > 0);
+    }
+    SECTION("counters outlive the container") {
+        auto exported = map.get_allocator().stats_ptr();
+        map = counted_map<int, int>();
+        REQUIRE(exported->live_bytes() == 0);
+        REQUIRE(exported->allocations() == exported->deallocations());
+    }
+}
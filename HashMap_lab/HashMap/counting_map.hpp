@@ -0,0 +1,328 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <new>
+#include <thread>
+#include <utility>
+#include "hash_map.hpp"
+
+namespace fefu
+{
+    /**
+     *  @brief  A concurrent map from keys to 64-bit counters.
+     *
+     *  increment() finds or inserts the key and adds to its counter with a
+     *  single atomic fetch_add.  Inserting a new key claims a slot with a
+     *  compare and swap, then constructs the key in it.  Lookups and
+     *  increments take no lock, but one that probes a slot whose key is
+     *  still being constructed yields until that insert finishes.
+     *
+     *  Storage is a chain of open-addressed tables, each twice the size of
+     *  the previous one.  A table that reaches its load threshold is sealed,
+     *  and new keys go to the next table.  Keys are never moved, so a
+     *  counter stays in the same slot for the life of the map.
+     *
+     *  snapshot() and drain() are exact for every key: drain() exchanges
+     *  each counter with zero, so no increment is lost or counted twice.
+     *  Increments that run concurrently with them land either in the result
+     *  or in the map.
+     */
+    template<typename K,
+        typename Hash = std::hash<K>,
+        typename Pred = std::equal_to<K>>
+        class counting_map
+    {
+    public:
+        using key_type = K;
+        using mapped_type = std::uint64_t;
+        using hasher = Hash;
+        using key_equal = Pred;
+        using size_type = std::size_t;
+        using map_type = hash_map<K, std::uint64_t, Hash, Pred>;
+
+        static constexpr size_type max_tables = 40;
+
+        /**
+         *  @brief  Creates an empty map.
+         *  @param  n  Number of keys the first table holds before a second
+         *             one is chained.
+         */
+        explicit counting_map(size_type n = 1024) : tables_() {
+            size_type capacity = 16;
+
+            while (capacity < 2 * n) {
+                capacity *= 2;
+            }
+
+            tables_[0].store(new table(capacity), std::memory_order_release);
+        }
+
+        counting_map(const counting_map&) = delete;
+        counting_map& operator=(const counting_map&) = delete;
+
+        ~counting_map() {
+            for (auto& t : tables_) {
+                delete t.load(std::memory_order_relaxed);
+            }
+        }
+
+        /**
+         *  @brief  Adds @a delta to the counter of @a k, inserting it with
+         *          zero first if needed.
+         *  @return  The counter value after the addition.
+         */
+        mapped_type increment(const key_type& k, mapped_type delta = 1) {
+            size_t hash = mix(hash_(k));
+            slot* s = find_slot(k, hash);
+
+            if (s == nullptr) {
+                s = insert_slot(k, hash);
+            }
+
+            return s->value.fetch_add(delta, std::memory_order_relaxed) + delta;
+        }
+
+        /// Returns the counter of @a k, or zero if it was never incremented.
+        mapped_type get(const key_type& k) const {
+            const slot* s = find_slot(k, mix(hash_(k)));
+
+            return s == nullptr ? 0 : s->value.load(std::memory_order_relaxed);
+        }
+
+        /// Returns the number of distinct keys.
+        size_type size() const noexcept {
+            size_type result = 0;
+
+            for (auto& t : tables_) {
+                const table* current = t.load(std::memory_order_acquire);
+
+                if (current == nullptr) {
+                    break;
+                }
+
+                result += current->size.load(std::memory_order_relaxed);
+            }
+
+            return result;
+        }
+
+        /// Copies every key and its current counter into a %hash_map.
+        map_type snapshot() const {
+            map_type result;
+            result.reserve(size());
+
+            for_each_slot([&result](slot& s, const key_type& key) {
+                result.insert(std::make_pair(key, s.value.load(std::memory_order_relaxed)));
+            });
+
+            return result;
+        }
+
+        /**
+         *  @brief  Moves all counters out of the map.
+         *  @return  Every key with a non-zero counter and that counter.
+         *
+         *  Keys stay in the map with a zero counter, so draining repeatedly
+         *  does not cost new insertions.
+         */
+        map_type drain() {
+            map_type result;
+            result.reserve(size());
+
+            for_each_slot([&result](slot& s, const key_type& key) {
+                mapped_type value = s.value.exchange(0, std::memory_order_relaxed);
+
+                if (value != 0) {
+                    result.insert(std::make_pair(key, value));
+                }
+            });
+
+            return result;
+        }
+
+    private:
+        enum slot_state : unsigned char { empty, busy, ready };
+
+        struct slot {
+            std::atomic<unsigned char> state{ empty };
+            std::atomic<mapped_type> value{ 0 };
+            alignas(key_type) unsigned char key[sizeof(key_type)];
+
+            const key_type& get_key() const noexcept {
+                return *reinterpret_cast<const key_type*>(key);
+            }
+        };
+
+        struct table {
+            size_type capacity;
+            size_type threshold;
+            std::atomic<size_type> size{ 0 };
+            std::atomic<size_type> reserved{ 0 };
+            std::atomic<size_type> pending{ 0 };
+            std::atomic<bool> sealed{ false };
+            slot* slots;
+
+            explicit table(size_type n) : capacity(n), threshold(n / 2), slots(new slot[n]) {}
+
+            ~table() {
+                for (size_type i = 0; i != capacity; i++) {
+                    if (slots[i].state.load(std::memory_order_relaxed) == ready) {
+                        slots[i].get_key().~key_type();
+                    }
+                }
+
+                delete[] slots;
+            }
+        };
+
+        std::atomic<table*> tables_[max_tables];
+        Hash hash_;
+        key_equal equal_;
+
+        static size_t mix(size_t hash) noexcept {
+            return static_cast<size_t>(detail::mix(hash));
+        }
+
+        static unsigned char wait_ready(const slot& s) noexcept {
+            unsigned char state = s.state.load(std::memory_order_acquire);
+
+            while (state == busy) {
+                std::this_thread::yield();
+                state = s.state.load(std::memory_order_acquire);
+            }
+
+            return state;
+        }
+
+        slot* find_in(const table& t, const key_type& k, size_t hash) const {
+            size_type mask = t.capacity - 1;
+
+            for (size_type i = 0, pos = hash & mask; i != t.capacity; i++, pos = (pos + 1) & mask) {
+                slot& s = t.slots[pos];
+
+                if (wait_ready(s) == empty) {
+                    return nullptr;
+                }
+
+                if (equal_(s.get_key(), k)) {
+                    return &s;
+                }
+            }
+
+            return nullptr;
+        }
+
+        // Returns the slot of k in t, claiming an empty one if k is absent.
+        slot* emplace_in(table& t, const key_type& k, size_t hash) {
+            size_type mask = t.capacity - 1;
+
+            for (size_type pos = hash & mask;; pos = (pos + 1) & mask) {
+                slot& s = t.slots[pos];
+                unsigned char state = empty;
+
+                if (s.state.compare_exchange_strong(state, busy, std::memory_order_acq_rel)) {
+                    new (s.key) key_type(k);
+                    s.state.store(ready, std::memory_order_release);
+                    t.size.fetch_add(1, std::memory_order_relaxed);
+
+                    return &s;
+                }
+
+                if (wait_ready(s) == ready && equal_(s.get_key(), k)) {
+                    return &s;
+                }
+            }
+        }
+
+        slot* find_slot(const key_type& k, size_t hash) const {
+            for (auto& t : tables_) {
+                const table* current = t.load(std::memory_order_acquire);
+
+                if (current == nullptr) {
+                    break;
+                }
+
+                if (slot* s = find_in(*current, k, hash)) {
+                    return s;
+                }
+            }
+
+            return nullptr;
+        }
+
+        table* table_at(size_type i) {
+            table* current = tables_[i].load(std::memory_order_acquire);
+
+            if (current == nullptr) {
+                table* previous = tables_[i - 1].load(std::memory_order_acquire);
+                table* created = new table(previous->capacity * 2);
+
+                if (tables_[i].compare_exchange_strong(current, created, std::memory_order_acq_rel)) {
+                    current = created;
+                }
+                else {
+                    delete created;
+                }
+            }
+
+            return current;
+        }
+
+        /*
+         *  A key may only be inserted into table i + 1 after table i is sealed:
+         *  full, with no insertion into it still in flight, and checked not
+         *  to contain the key.  This keeps each key in exactly one table.
+         */
+        slot* insert_slot(const key_type& k, size_t hash) {
+            for (size_type i = 0; i != max_tables; i++) {
+                table& t = *table_at(i);
+
+                if (!t.sealed.load(std::memory_order_acquire)) {
+                    t.pending.fetch_add(1, std::memory_order_seq_cst);
+
+                    if (t.reserved.fetch_add(1, std::memory_order_seq_cst) < t.threshold) {
+                        slot* s = emplace_in(t, k, hash);
+                        t.pending.fetch_sub(1, std::memory_order_seq_cst);
+
+                        return s;
+                    }
+
+                    t.pending.fetch_sub(1, std::memory_order_seq_cst);
+
+                    while (t.pending.load(std::memory_order_seq_cst) != 0) {
+                        std::this_thread::yield();
+                    }
+
+                    t.sealed.store(true, std::memory_order_release);
+                }
+
+                if (slot* s = find_in(t, k, hash)) {
+                    return s;
+                }
+            }
+
+            throw std::length_error("counting_map: too many keys");
+        }
+
+        template<typename F>
+        void for_each_slot(F f) const {
+            for (auto& t : tables_) {
+                table* current = t.load(std::memory_order_acquire);
+
+                if (current == nullptr) {
+                    break;
+                }
+
+                for (size_type i = 0; i != current->capacity; i++) {
+                    slot& s = current->slots[i];
+
+                    if (s.state.load(std::memory_order_acquire) == ready) {
+                        f(s, s.get_key());
+                    }
+                }
+            }
+        }
+    };
+
+} // namespace fefu
@@ -0,0 +1,124 @@
+#include <algorithm>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "counting_map.hpp"
+#include "../catch.hpp"
+
+TEST_CASE("counting_map increments", "[counting_map]") {
+    fefu::counting_map<int> counts(4);
+
+    REQUIRE(counts.increment(7) == 1);
+    REQUIRE(counts.increment(7, 10) == 11);
+    REQUIRE(counts.get(7) == 11);
+    REQUIRE(counts.get(8) == 0);
+
+    SECTION("grows past the first table") {
+        for (int i = 0; i < 1000; i++) {
+            counts.increment(i);
+        }
+
+        REQUIRE(counts.size() == 1000);
+        REQUIRE(counts.get(7) == 12);
+        REQUIRE(counts.get(999) == 1);
+    }
+    SECTION("drain empties the counters") {
+        counts.increment(1, 5);
+        auto drained = counts.drain();
+
+        REQUIRE(drained.size() == 2);
+        REQUIRE(drained.at(7) == 11);
+        REQUIRE(drained.at(1) == 5);
+        REQUIRE(counts.get(7) == 0);
+        REQUIRE(counts.drain().empty());
+    }
+}
+
+TEST_CASE("counting_map concurrent increments", "[counting_map]") {
+    const int threads_count = 8;
+    const int keys = 5000;
+
+    fefu::counting_map<int> counts(16);
+    std::vector<std::thread> threads;
+
+    for (int t = 0; t < threads_count; t++) {
+        threads.emplace_back([&] {
+            for (int i = 0; i < keys; i++) {
+                counts.increment(i);
+            }
+        });
+    }
+
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    auto snapshot = counts.snapshot();
+    REQUIRE(snapshot.size() == keys);
+    REQUIRE(counts.size() == keys);
+
+    for (int i = 0; i < keys; i++) {
+        REQUIRE(snapshot.at(i) == threads_count);
+    }
+}
+
+TEST_CASE("counting_map versus locked and per-thread maps", "[counting_map][!benchmark]") {
+    const unsigned threads_count = std::max(2u, std::thread::hardware_concurrency());
+    const int increments_per_thread = 1 << 20;
+    const unsigned keys = 1 << 14;
+
+    auto run = [&](auto body) {
+        std::vector<std::thread> threads;
+        for (unsigned t = 0; t < threads_count; t++) {
+            threads.emplace_back(body, t);
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+    };
+
+    BENCHMARK("counting_map") {
+        fefu::counting_map<unsigned> counts(keys);
+        run([&](unsigned t) {
+            unsigned key = t;
+            for (int i = 0; i < increments_per_thread; i++) {
+                key = key * 1103515245u + 12345u;
+                counts.increment(key % keys);
+            }
+        });
+        return counts.size();
+    };
+
+    BENCHMARK("per-thread hash_map merged at the end") {
+        fefu::hash_map<unsigned, std::uint64_t> total;
+        std::mutex merge_mutex;
+        run([&](unsigned t) {
+            fefu::hash_map<unsigned, std::uint64_t> local;
+            unsigned key = t;
+            for (int i = 0; i < increments_per_thread; i++) {
+                key = key * 1103515245u + 12345u;
+                local[key % keys]++;
+            }
+            std::lock_guard<std::mutex> lock(merge_mutex);
+            for (auto& element : local) {
+                total[element.first] += element.second;
+            }
+        });
+        return total.size();
+    };
+
+    BENCHMARK("mutex-guarded hash_map") {
+        fefu::hash_map<unsigned, std::uint64_t> total;
+        std::mutex mutex;
+        run([&](unsigned t) {
+            unsigned key = t;
+            for (int i = 0; i < increments_per_thread; i++) {
+                key = key * 1103515245u + 12345u;
+                std::lock_guard<std::mutex> lock(mutex);
+                total[key % keys]++;
+            }
+        });
+        return total.size();
+    };
+}
@@ -0,0 +1,601 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "hash_map.hpp"
+
+namespace fefu
+{
+    /**
+     *  @brief  A %hash_map for integral keys that drops hashing while the
+     *          keys are dense.
+     *
+     *  While the keys fall in a range at most max_gap times the number of
+     *  elements, a %direct_hash_map keeps them in a direct-addressed array
+     *  covering that range, with one occupancy bit per slot: a lookup is
+     *  a subtraction, a bounds check and a bit test.  The range grows by
+     *  doubling toward new keys.  A key that would make the range too
+     *  sparse moves every element into a %hash_map, as does erasing until
+     *  the range is more than 2 * max_gap times the number of elements.
+     *
+     *  In hashed mode the smallest and largest keys inserted are tracked,
+     *  and the elements move back into an array once that range is within
+     *  max_gap / 2 times the number of elements.  erase() does not narrow
+     *  the tracked range.  The gap between the two thresholds keeps a map
+     *  near either of them from switching back and forth.
+     *
+     *  Switching representation, like growing the array, invalidates
+     *  iterators and references.
+     */
+    template<typename K, typename T,
+        typename Hash = std::hash<K>,
+        typename Alloc = allocator<std::pair<const K, T>>>
+        class direct_hash_map
+    {
+        static_assert(std::is_integral<K>::value && !std::is_same<K, bool>::value && sizeof(K) <= sizeof(std::uint64_t),
+            "direct_hash_map needs an integral key of at most 64 bits");
+
+    public:
+        using key_type = K;
+        using mapped_type = T;
+        using hasher = Hash;
+        using key_equal = std::equal_to<K>;
+        using allocator_type = Alloc;
+        using value_type = std::pair<const key_type, mapped_type>;
+        using reference = value_type&;
+        using const_reference = const value_type&;
+        using size_type = std::size_t;
+        using map_type = hash_map<K, T, Hash, std::equal_to<K>, Alloc>;
+
+        /// How the elements are currently stored.
+        enum class storage { direct, hashed };
+
+        /// The array is kept while it spans at most max_gap slots per element.
+        static constexpr size_type max_gap = 4;
+
+        /// Smallest array allocated, so small maps of nearby keys stay direct.
+        static constexpr size_type min_span = 64;
+
+    private:
+        using alloc_traits = std::allocator_traits<Alloc>;
+        using word_vector = std::vector<std::uint64_t, typename alloc_traits::template rebind_alloc<std::uint64_t>>;
+
+        template<bool Const>
+        class basic_iterator {
+            using map_pointer = typename std::conditional<Const, const direct_hash_map*, direct_hash_map*>::type;
+            using map_iterator = typename std::conditional<Const, typename map_type::const_iterator, typename map_type::iterator>::type;
+
+        public:
+            using iterator_category = std::forward_iterator_tag;
+            using value_type = direct_hash_map::value_type;
+            using difference_type = std::ptrdiff_t;
+            using reference = typename std::conditional<Const, const value_type&, value_type&>::type;
+            using pointer = typename std::conditional<Const, const value_type*, value_type*>::type;
+
+            basic_iterator() noexcept : map_(nullptr), index_(0), it_(), hashed_(false) {}
+
+            template<bool C = Const, typename = typename std::enable_if<C>::type>
+            basic_iterator(const basic_iterator<false>& other) noexcept
+                : map_(other.map_), index_(other.index_), it_(other.it_), hashed_(other.hashed_) {}
+
+            reference operator*() const {
+                return hashed_ ? *it_ : map_->slots_[index_];
+            }
+
+            pointer operator->() const {
+                return &**this;
+            }
+
+            basic_iterator& operator++() {
+                if (hashed_) {
+                    ++it_;
+                }
+                else {
+                    index_ = map_->next_direct(index_ + 1);
+                }
+                return *this;
+            }
+
+            basic_iterator operator++(int) {
+                basic_iterator previous(*this);
+                ++(*this);
+                return previous;
+            }
+
+            friend bool operator==(const basic_iterator& lhs, const basic_iterator& rhs) {
+                return lhs.hashed_ ? lhs.it_ == rhs.it_ : lhs.index_ == rhs.index_;
+            }
+
+            friend bool operator!=(const basic_iterator& lhs, const basic_iterator& rhs) {
+                return !(lhs == rhs);
+            }
+
+        private:
+            friend class direct_hash_map;
+            friend class basic_iterator<true>;
+
+            map_pointer map_;
+            size_type index_;
+            map_iterator it_;
+            bool hashed_;
+
+            basic_iterator(map_pointer map, size_type index) noexcept : map_(map), index_(index), it_(), hashed_(false) {}
+            explicit basic_iterator(map_iterator it) noexcept : map_(nullptr), index_(0), it_(it), hashed_(true) {}
+        };
+
+    public:
+        using iterator = basic_iterator<false>;
+        using const_iterator = basic_iterator<true>;
+
+        /// Creates an empty map in direct mode.
+        direct_hash_map() : direct_hash_map(Alloc()) {}
+
+        explicit direct_hash_map(const allocator_type& a)
+            : allocator_(a), slots_(nullptr), occupied_(typename word_vector::allocator_type(a)), base_(0), span_(0),
+            size_(0), low_(0), high_(0), hashed_(false), map_(a) {}
+
+        direct_hash_map(std::initializer_list<value_type> l, const allocator_type& a = allocator_type()) : direct_hash_map(a) {
+            for (const value_type& element : l) {
+                insert(element);
+            }
+        }
+
+        direct_hash_map(const direct_hash_map& other)
+            : direct_hash_map(alloc_traits::select_on_container_copy_construction(other.allocator_)) {
+            if (other.hashed_) {
+                map_ = other.map_;
+                low_ = other.low_;
+                high_ = other.high_;
+                hashed_ = true;
+            }
+            else if (other.span_ != 0) {
+                allocate_direct(other.base_, other.span_);
+                for (size_type i = other.next_direct(0); i != other.span_; i = other.next_direct(i + 1)) {
+                    construct_direct(i, other.slots_[i]);
+                }
+            }
+        }
+
+        direct_hash_map(direct_hash_map&& other) : direct_hash_map(other.allocator_) {
+            swap_all(other);
+        }
+
+        direct_hash_map& operator=(const direct_hash_map& other) {
+            if (this != &other) {
+                direct_hash_map copy(other);
+                swap(copy);
+            }
+            return *this;
+        }
+
+        direct_hash_map& operator=(direct_hash_map&& other) {
+            if (this != &other) {
+                clear();
+                swap(other);
+            }
+            return *this;
+        }
+
+        ~direct_hash_map() {
+            release_direct();
+        }
+
+        allocator_type get_allocator() const noexcept {
+            return allocator_;
+        }
+
+        /// Returns how the elements are currently stored.
+        storage representation() const noexcept {
+            return hashed_ ? storage::hashed : storage::direct;
+        }
+
+        bool empty() const noexcept {
+            return size() == 0;
+        }
+
+        size_type size() const noexcept {
+            return hashed_ ? map_.size() : size_;
+        }
+
+        /// Returns the bytes used by the map; the occupancy bits are metadata.
+        memory_footprint memory_usage() const noexcept {
+            memory_footprint footprint;
+            if (hashed_) {
+                footprint = map_.memory_usage();
+            }
+            footprint.object = sizeof(*this);
+            footprint.slots += span_ * sizeof(value_type);
+            footprint.metadata += occupied_.capacity() * sizeof(std::uint64_t);
+            return footprint;
+        }
+
+        //@{
+        iterator begin() noexcept {
+            return hashed_ ? iterator(map_.begin()) : iterator(this, next_direct(0));
+        }
+
+        const_iterator begin() const noexcept {
+            return hashed_ ? const_iterator(map_.cbegin()) : const_iterator(this, next_direct(0));
+        }
+
+        const_iterator cbegin() const noexcept {
+            return begin();
+        }
+
+        iterator end() noexcept {
+            return hashed_ ? iterator(map_.end()) : iterator(this, span_);
+        }
+
+        const_iterator end() const noexcept {
+            return hashed_ ? const_iterator(map_.cend()) : const_iterator(this, span_);
+        }
+
+        const_iterator cend() const noexcept {
+            return end();
+        }
+        //@}
+
+        //@{
+        /// Returns an iterator to the element with key @a k, or end().
+        iterator find(const key_type& k) {
+            if (hashed_) {
+                return iterator(map_.find(k));
+            }
+            return iterator(this, locate(k));
+        }
+
+        const_iterator find(const key_type& k) const {
+            if (hashed_) {
+                return const_iterator(map_.find(k));
+            }
+            return const_iterator(this, locate(k));
+        }
+        //@}
+
+        bool contains(const key_type& k) const {
+            return hashed_ ? map_.contains(k) : locate(k) != span_;
+        }
+
+        size_type count(const key_type& k) const {
+            return contains(k) ? 1 : 0;
+        }
+
+        //@{
+        /// Returns the value of @a k, or throws std::out_of_range.
+        mapped_type& at(const key_type& k) {
+            iterator it = find(k);
+            if (it == end()) {
+                throw std::out_of_range("direct_hash_map::at");
+            }
+            return it->second;
+        }
+
+        const mapped_type& at(const key_type& k) const {
+            const_iterator it = find(k);
+            if (it == end()) {
+                throw std::out_of_range("direct_hash_map::at");
+            }
+            return it->second;
+        }
+        //@}
+
+        /**
+         *  @brief  Inserts an element with key @a k constructed from
+         *          @a args if @a k is absent.
+         *  @return  A pair of an iterator to the element with key @a k and
+         *           a bool that is true if the element was inserted.
+         *
+         *  May switch the representation either way.
+         */
+        template<typename... Args>
+        std::pair<iterator, bool> try_emplace(const key_type& k, Args&&... args) {
+            if (!hashed_) {
+                std::uint64_t index = ordinal(k) - base_;
+
+                if (index < span_ && test(index)) {
+                    return { iterator(this, index), false };
+                }
+                if (index < span_ || widen(ordinal(k))) {
+                    index = ordinal(k) - base_;
+                    construct_direct(index, std::piecewise_construct, std::forward_as_tuple(k), std::forward_as_tuple(std::forward<Args>(args)...));
+                    return { iterator(this, index), true };
+                }
+
+                to_hashed();
+            }
+
+            auto result = map_.try_emplace(k, std::forward<Args>(args)...);
+            if (!result.second) {
+                return { iterator(result.first), false };
+            }
+
+            low_ = std::min(low_, ordinal(k));
+            high_ = std::max(high_, ordinal(k));
+            if (high_ - low_ < max_gap / 2 * map_.size()) {
+                to_direct();
+                return { iterator(this, ordinal(k) - base_), true };
+            }
+            return { iterator(result.first), true };
+        }
+
+        std::pair<iterator, bool> insert(const value_type& x) {
+            return try_emplace(x.first, x.second);
+        }
+
+        std::pair<iterator, bool> insert(value_type&& x) {
+            return try_emplace(x.first, std::move(x.second));
+        }
+
+        template<typename Obj>
+        std::pair<iterator, bool> insert_or_assign(const key_type& k, Obj&& obj) {
+            auto result = try_emplace(k, std::forward<Obj>(obj));
+            if (!result.second) {
+                result.first->second = std::forward<Obj>(obj);
+            }
+            return result;
+        }
+
+        mapped_type& operator[](const key_type& k) {
+            return try_emplace(k).first->second;
+        }
+
+        /// Erases the element with key @a k; returns the number erased.
+        size_type erase(const key_type& k) {
+            if (hashed_) {
+                return map_.erase(k);
+            }
+
+            size_type index = locate(k);
+            if (index == span_) {
+                return 0;
+            }
+
+            slots_[index].~value_type();
+            occupied_[index / 64] &= ~(std::uint64_t(1) << (index % 64));
+            size_--;
+
+            if (size_ != 0 && span_ > min_span && span_ > 2 * max_gap * size_) {
+                to_hashed();
+            }
+            return 1;
+        }
+
+        /// Erases every element and returns to direct mode, keeping the array.
+        void clear() noexcept {
+            destroy_direct();
+            std::fill(occupied_.begin(), occupied_.end(), 0);
+
+            if (hashed_) {
+                map_ = map_type(allocator_);
+                hashed_ = false;
+            }
+        }
+
+        void swap(direct_hash_map& x) noexcept {
+            if constexpr (alloc_traits::propagate_on_container_swap::value) {
+                using std::swap;
+                swap(allocator_, x.allocator_);
+            }
+            swap_all(x);
+        }
+
+    private:
+        allocator_type allocator_;
+        value_type* slots_;
+        word_vector occupied_;
+        std::uint64_t base_;    ///< Ordinal of the key in slot 0.
+        size_type span_;        ///< Slots in the array.
+        size_type size_;        ///< Elements in the array.
+        std::uint64_t low_;     ///< Smallest ordinal inserted in hashed mode.
+        std::uint64_t high_;    ///< Largest ordinal inserted in hashed mode.
+        bool hashed_;
+        map_type map_;
+
+        /// Maps keys to unsigned integers in the same order.
+        static std::uint64_t ordinal(key_type k) noexcept {
+            if constexpr (std::is_signed<K>::value) {
+                return static_cast<std::uint64_t>(static_cast<std::int64_t>(k)) ^ (std::uint64_t(1) << 63);
+            }
+            else {
+                return static_cast<std::uint64_t>(k);
+            }
+        }
+
+        bool test(size_type index) const noexcept {
+            return (occupied_[index / 64] >> (index % 64)) & 1;
+        }
+
+        /// Slot of @a k in the array, or span_ if it is absent.
+        size_type locate(const key_type& k) const noexcept {
+            std::uint64_t index = ordinal(k) - base_;
+            return index < span_ && test(index) ? index : span_;
+        }
+
+        /// First occupied slot at or after @a index, or span_.
+        size_type next_direct(size_type index) const noexcept {
+            while (index < span_) {
+                std::uint64_t word = occupied_[index / 64] >> (index % 64);
+                if (word != 0) {
+                    return index + detail::lowest_bit(word);
+                }
+                index = (index / 64 + 1) * 64;
+            }
+            return span_;
+        }
+
+        /// Last occupied slot, or span_ if the array is empty.
+        size_type last_direct() const noexcept {
+            for (size_type w = occupied_.size(); w-- != 0;) {
+                if (occupied_[w] != 0) {
+                    return w * 64 + highest_bit(occupied_[w]);
+                }
+            }
+            return span_;
+        }
+
+        static size_type highest_bit(std::uint64_t x) noexcept {
+#if defined(__GNUC__)
+            return static_cast<size_type>(63 - __builtin_clzll(x));
+#else
+            size_type i = 0;
+            while (x >>= 1) {
+                i++;
+            }
+            return i;
+#endif
+        }
+
+        template<typename... Args>
+        void construct_direct(size_type index, Args&&... args) {
+            ::new (static_cast<void*>(slots_ + index)) value_type(std::forward<Args>(args)...);
+            occupied_[index / 64] |= std::uint64_t(1) << (index % 64);
+            size_++;
+        }
+
+        void allocate_direct(std::uint64_t base, size_type span) {
+            slots_ = alloc_traits::allocate(allocator_, span);
+            occupied_.assign((span + 63) / 64, 0);
+            base_ = base;
+            span_ = span;
+        }
+
+        void destroy_direct() noexcept {
+            if constexpr (!std::is_trivially_destructible<value_type>::value) {
+                for (size_type i = next_direct(0); i != span_; i = next_direct(i + 1)) {
+                    slots_[i].~value_type();
+                }
+            }
+            size_ = 0;
+        }
+
+        /// Destroys the array elements and frees the array.
+        void release_direct() noexcept {
+            destroy_direct();
+            if (slots_ != nullptr) {
+                alloc_traits::deallocate(allocator_, slots_, span_);
+            }
+            slots_ = nullptr;
+            occupied_ = word_vector(typename word_vector::allocator_type(allocator_));
+            base_ = 0;
+            span_ = 0;
+        }
+
+        /// Moves the array elements into an array of @a span slots starting at ordinal @a base.
+        void relocate(std::uint64_t base, size_type span) {
+            direct_hash_map next(allocator_);
+            next.allocate_direct(base, span);
+
+            for (size_type i = next_direct(0); i != span_; i = next_direct(i + 1)) {
+                value_type& element = slots_[i];
+                next.construct_direct(ordinal(element.first) - base, element.first, std::move(element.second));
+            }
+
+            release_direct();
+            swap_all(next);
+        }
+
+        /**
+         *  Grows the array to cover ordinal @a key, doubling it toward the
+         *  key, unless the range of the live keys and @a key would exceed
+         *  max_gap slots per element.  Returns whether the array now covers
+         *  @a key.
+         *
+         *  The range is measured over the live keys rather than the array,
+         *  as to_hashed() does, so a refusal is never followed by an
+         *  immediate to_direct().
+         */
+        bool widen(std::uint64_t key) {
+            std::uint64_t low = key;
+            std::uint64_t high = key;
+            if (size_ != 0) {
+                low = std::min(low, base_ + next_direct(0));
+                high = std::max(high, base_ + last_direct());
+            }
+
+            size_type limit = std::max(min_span, max_gap * (size_ + 1));
+            if (high - low >= limit) {
+                return false;
+            }
+
+            size_type span = std::max(static_cast<size_type>(high - low + 1), std::min(std::max(2 * span_, min_span), limit));
+            std::uint64_t base = low;
+            if (size_ != 0 && key == low) {
+                base = high < span - 1 ? 0 : high - (span - 1);
+            }
+            else if (base > std::numeric_limits<std::uint64_t>::max() - (span - 1)) {
+                base = std::numeric_limits<std::uint64_t>::max() - (span - 1);
+            }
+
+            relocate(base, span);
+            return true;
+        }
+
+        /// Moves the array elements into map_.
+        void to_hashed() {
+            map_type map(allocator_);
+            map.reserve(size_);
+            low_ = std::numeric_limits<std::uint64_t>::max();
+            high_ = 0;
+
+            for (size_type i = next_direct(0); i != span_; i = next_direct(i + 1)) {
+                value_type& element = slots_[i];
+                low_ = std::min(low_, ordinal(element.first));
+                high_ = std::max(high_, ordinal(element.first));
+                map.try_emplace(element.first, std::move(element.second));
+            }
+
+            release_direct();
+            map_ = std::move(map);
+            hashed_ = true;
+        }
+
+        /// Moves the elements of map_ into an array over their exact key range.
+        void to_direct() {
+            std::uint64_t low = std::numeric_limits<std::uint64_t>::max();
+            std::uint64_t high = 0;
+            for (const value_type& element : map_) {
+                low = std::min(low, ordinal(element.first));
+                high = std::max(high, ordinal(element.first));
+            }
+
+            size_type span = std::max(static_cast<size_type>(high - low + 1), min_span);
+            if (low > std::numeric_limits<std::uint64_t>::max() - (span - 1)) {
+                low = std::numeric_limits<std::uint64_t>::max() - (span - 1);
+            }
+
+            direct_hash_map next(allocator_);
+            next.allocate_direct(low, span);
+            for (value_type& element : map_) {
+                next.construct_direct(ordinal(element.first) - low, element.first, std::move(element.second));
+            }
+
+            map_ = map_type(allocator_);
+            hashed_ = false;
+            swap_all(next);
+        }
+
+        /// Exchanges everything but the allocators.
+        void swap_all(direct_hash_map& x) noexcept {
+            std::swap(slots_, x.slots_);
+            occupied_.swap(x.occupied_);
+            std::swap(base_, x.base_);
+            std::swap(span_, x.span_);
+            std::swap(size_, x.size_);
+            std::swap(low_, x.low_);
+            std::swap(high_, x.high_);
+            std::swap(hashed_, x.hashed_);
+            map_.swap(x.map_);
+        }
+    };
+
+} // namespace fefu
@@ -0,0 +1,219 @@
+#include <cstdint>
+#include <limits>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "direct_hash_map.hpp"
+#include "hash_map.hpp"
+#include "../catch.hpp"
+
+TEST_CASE("direct_hash_map switches representation with key density", "[direct_hash_map]") {
+    using storage = fefu::direct_hash_map<int, std::string>::storage;
+    fefu::direct_hash_map<int, std::string> map;
+    REQUIRE(map.representation() == storage::direct);
+    REQUIRE(map.find(0) == map.end());
+
+    for (int i = -500; i < 500; i++) {
+        map[i] = std::to_string(i);
+    }
+    REQUIRE(map.representation() == storage::direct);
+    REQUIRE(map.size() == 1000);
+    REQUIRE(map.at(-500) == "-500");
+    REQUIRE(map.memory_usage().slots <= 4 * 1000 * sizeof(std::pair<const int, std::string>));
+
+    int previous = -501;
+    for (const auto& element : map) {
+        REQUIRE(element.first > previous);
+        previous = element.first;
+    }
+    REQUIRE(previous == 499);
+
+    SECTION("a far key switches to hashing and back") {
+        REQUIRE(map.try_emplace(1000000, "far").second);
+        REQUIRE(map.representation() == storage::hashed);
+        REQUIRE(map.size() == 1001);
+        REQUIRE(map.at(1000000) == "far");
+        REQUIRE(map.at(-1) == "-1");
+
+        REQUIRE(map.erase(1000000) == 1);
+        for (int i = 500; map.representation() == storage::hashed; i++) {
+            map[i] = std::to_string(i);
+        }
+        REQUIRE(map.size() > 1000);
+        REQUIRE(map.at(-500) == "-500");
+        REQUIRE_FALSE(map.contains(1000000));
+    }
+    SECTION("erasing most keys switches to hashing") {
+        for (int i = -500; i < 500; i++) {
+            if (i % 10 != 0) {
+                REQUIRE(map.erase(i) == 1);
+            }
+        }
+        REQUIRE(map.representation() == storage::hashed);
+        REQUIRE(map.size() == 100);
+        REQUIRE(map.at(-490) == "-490");
+        REQUIRE(map.erase(-491) == 0);
+    }
+    SECTION("copy, move and clear") {
+        auto copy = map;
+        REQUIRE(copy.at(7) == "7");
+        copy[7] = "seven";
+        REQUIRE(map.at(7) == "7");
+
+        fefu::direct_hash_map<int, std::string> moved(std::move(copy));
+        REQUIRE(copy.empty());
+        REQUIRE(moved.at(7) == "seven");
+
+        moved.clear();
+        REQUIRE(moved.empty());
+        REQUIRE(moved.begin() == moved.end());
+        moved[3] = "three";
+        REQUIRE(moved.size() == 1);
+        REQUIRE(moved.representation() == storage::direct);
+    }
+}
+
+namespace
+{
+    struct move_counter {
+        static int moves;
+        int value = 0;
+
+        move_counter() = default;
+        move_counter(const move_counter&) = default;
+        move_counter(move_counter&& other) noexcept : value(other.value) {
+            moves++;
+        }
+        move_counter& operator=(const move_counter&) = default;
+    };
+
+    int move_counter::moves = 0;
+}
+
+TEST_CASE("direct_hash_map measures density over the live keys", "[direct_hash_map]") {
+    fefu::direct_hash_map<int, move_counter> map;
+    for (int i = 0; i < 1000; i++) {
+        map[i].value = i;
+    }
+    for (int i = 0; i < 800; i++) {
+        map.erase(i);
+    }
+    REQUIRE(map.representation() == decltype(map)::storage::direct);
+
+    // The live keys 800..1023 are dense; the key past the array only
+    // relocates them once, not into a hash_map and straight back.
+    move_counter::moves = 0;
+    map[1024].value = 1024;
+    REQUIRE(map.representation() == decltype(map)::storage::direct);
+    REQUIRE(move_counter::moves <= 200);
+    REQUIRE(map.at(800).value == 800);
+    REQUIRE(map.at(1024).value == 1024);
+    REQUIRE_FALSE(map.contains(0));
+}
+
+TEST_CASE("direct_hash_map handles the ends of the key range", "[direct_hash_map]") {
+    fefu::direct_hash_map<std::int64_t, int> map;
+    const std::int64_t lowest = std::numeric_limits<std::int64_t>::min();
+    const std::int64_t highest = std::numeric_limits<std::int64_t>::max();
+
+    map[highest] = 1;
+    map[highest - 10] = 2;
+    REQUIRE(map.representation() == decltype(map)::storage::direct);
+    map[lowest] = 3;
+    REQUIRE(map.representation() == decltype(map)::storage::hashed);
+    REQUIRE(map.at(highest) == 1);
+    REQUIRE(map.at(lowest) == 3);
+
+    fefu::direct_hash_map<std::uint8_t, int> bytes;
+    for (int i = 255; i >= 0; i--) {
+        bytes[static_cast<std::uint8_t>(i)] = i;
+    }
+    REQUIRE(bytes.representation() == decltype(bytes)::storage::direct);
+    REQUIRE(bytes.size() == 256);
+    REQUIRE(bytes.at(0) == 0);
+}
+
+TEST_CASE("direct_hash_map agrees with std::unordered_map", "[direct_hash_map]") {
+    fefu::direct_hash_map<std::int32_t, std::uint32_t> map;
+    std::unordered_map<std::int32_t, std::uint32_t> reference;
+
+    // Dense phases alternate with sparse ones, so both switches are taken.
+    std::mt19937 generator(14);
+    for (int round = 0; round < 200000; round++) {
+        std::int32_t range = (round / 20000) % 2 == 0 ? 2000 : 1 << 30;
+        std::int32_t key = static_cast<std::int32_t>(generator() % range) - range / 2;
+        if (generator() % 3 == 0) {
+            REQUIRE(map.erase(key) == reference.erase(key));
+        }
+        else {
+            map[key] += round;
+            reference[key] += round;
+        }
+    }
+
+    REQUIRE(map.size() == reference.size());
+    std::size_t visited = 0;
+    for (const auto& element : map) {
+        REQUIRE(reference.at(element.first) == element.second);
+        visited++;
+    }
+    REQUIRE(visited == reference.size());
+}
+
+TEST_CASE("Dense integer keys: hash_map versus direct_hash_map", "[direct_hash_map][!benchmark]") {
+    // IDs 0..N with every 16th missing.
+    const std::uint32_t range = 1 << 22;
+    const std::uint32_t lookups = 1 << 22;
+
+    std::vector<std::uint32_t> ids;
+    for (std::uint32_t id = 0; id < range; id++) {
+        if (id % 16 != 5) {
+            ids.push_back(id);
+        }
+    }
+
+    std::mt19937 generator(15);
+    std::vector<std::uint32_t> probes(lookups);
+    for (auto& probe : probes) {
+        probe = generator() % range;
+    }
+
+    fefu::hash_map<std::uint32_t, std::uint32_t> hashed;
+    fefu::direct_hash_map<std::uint32_t, std::uint32_t> direct;
+
+    BENCHMARK("hash_map build") {
+        hashed = fefu::hash_map<std::uint32_t, std::uint32_t>();
+        for (std::uint32_t id : ids) {
+            hashed[id] = id;
+        }
+        return hashed.size();
+    };
+
+    BENCHMARK("direct_hash_map build") {
+        direct = fefu::direct_hash_map<std::uint32_t, std::uint32_t>();
+        for (std::uint32_t id : ids) {
+            direct[id] = id;
+        }
+        return direct.size();
+    };
+
+    WARN("hash_map: " << hashed.memory_usage().total() / (1 << 20) << " MiB, direct_hash_map: "
+        << direct.memory_usage().total() / (1 << 20) << " MiB");
+
+    BENCHMARK("hash_map find") {
+        std::uint64_t hits = 0;
+        for (std::uint32_t key : probes) {
+            hits += hashed.count(key);
+        }
+        return hits;
+    };
+
+    BENCHMARK("direct_hash_map find") {
+        std::uint64_t hits = 0;
+        for (std::uint32_t key : probes) {
+            hits += direct.count(key);
+        }
+        return hits;
+    };
+}
@@ -0,0 +1,194 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace fefu
+{
+    /**
+     *  @brief  Epoch-based reclamation domain.
+     *
+     *  Readers enter a critical section with pin(), which only writes the
+     *  calling thread's own cache line.  Writers hand unlinked objects to
+     *  retire(); an object is destroyed once every reader that could still
+     *  see it has left its critical section.
+     */
+    class epoch_domain {
+    public:
+        static constexpr std::size_t max_threads = 256;
+
+        /// RAII read-side critical section returned by pin().
+        class guard {
+        public:
+            guard() noexcept : domain_(nullptr) {}
+
+            explicit guard(epoch_domain& domain) : domain_(&domain) {
+                domain_->enter();
+            }
+
+            guard(const guard&) = delete;
+            guard& operator=(const guard&) = delete;
+
+            guard(guard&& other) noexcept : domain_(other.domain_) {
+                other.domain_ = nullptr;
+            }
+
+            guard& operator=(guard&& other) noexcept {
+                std::swap(domain_, other.domain_);
+                return *this;
+            }
+
+            ~guard() {
+                if (domain_ != nullptr) {
+                    domain_->leave();
+                }
+            }
+
+        private:
+            epoch_domain* domain_;
+        };
+
+        epoch_domain() : global_epoch_(1) {}
+
+        epoch_domain(const epoch_domain&) = delete;
+        epoch_domain& operator=(const epoch_domain&) = delete;
+
+        /// Frees everything still retired; no reader may be pinned.
+        ~epoch_domain() {
+            for (auto& retired : retired_) {
+                retired.deleter(retired.object);
+            }
+        }
+
+        /// Enters a read-side critical section for the calling thread.
+        guard pin() {
+            return guard(*this);
+        }
+
+        /**
+         *  @brief  Schedules @a object for deletion.
+         *  @param  object  An object already unreachable for new readers.
+         *
+         *  The object is deleted by a later collect() once all readers that
+         *  were pinned at the time of the call have unpinned.
+         */
+        template<typename T>
+        void retire(T* object) {
+            std::lock_guard<std::mutex> lock(retired_mutex_);
+            std::uint64_t epoch = global_epoch_.fetch_add(1, std::memory_order_seq_cst);
+            retired_.push_back({ epoch, object, [](void* p) { delete static_cast<T*>(p); } });
+        }
+
+        /// Deletes retired objects that no pinned reader can reach.
+        void collect() {
+            std::uint64_t oldest = global_epoch_.load(std::memory_order_seq_cst);
+
+            for (auto& slot : slots_) {
+                std::uint64_t epoch = slot.epoch.load(std::memory_order_seq_cst);
+
+                if (epoch != 0 && epoch < oldest) {
+                    oldest = epoch;
+                }
+            }
+
+            std::vector<retired_object> ready;
+            {
+                std::lock_guard<std::mutex> lock(retired_mutex_);
+                auto keep = retired_.begin();
+
+                for (auto& retired : retired_) {
+                    if (retired.epoch < oldest) {
+                        ready.push_back(retired);
+                    }
+                    else {
+                        *keep++ = retired;
+                    }
+                }
+
+                retired_.erase(keep, retired_.end());
+            }
+
+            for (auto& retired : ready) {
+                retired.deleter(retired.object);
+            }
+        }
+
+        /// Returns the number of objects waiting for reclamation.
+        std::size_t retired_count() {
+            std::lock_guard<std::mutex> lock(retired_mutex_);
+            return retired_.size();
+        }
+
+    private:
+        struct alignas(64) thread_slot {
+            std::atomic<std::uint64_t> epoch{ 0 };
+            std::size_t depth = 0;
+        };
+
+        struct retired_object {
+            std::uint64_t epoch;
+            void* object;
+            void (*deleter)(void*);
+        };
+
+        std::atomic<std::uint64_t> global_epoch_;
+        thread_slot slots_[max_threads];
+        std::mutex retired_mutex_;
+        std::vector<retired_object> retired_;
+
+        // Index of the calling thread, shared by all domains and released
+        // when the thread exits.
+        static std::size_t thread_index() {
+            struct registration {
+                std::size_t index;
+
+                registration() : index(acquire()) {}
+
+                ~registration() {
+                    owners()[index].store(false, std::memory_order_release);
+                }
+
+                static std::size_t acquire() {
+                    for (std::size_t i = 0; i != max_threads; i++) {
+                        bool expected = false;
+
+                        if (owners()[i].compare_exchange_strong(expected, true, std::memory_order_acq_rel)) {
+                            return i;
+                        }
+                    }
+
+                    throw std::length_error("epoch_domain: too many threads");
+                }
+            };
+
+            thread_local registration current;
+            return current.index;
+        }
+
+        static std::atomic<bool>* owners() {
+            static std::atomic<bool> owners[max_threads] = {};
+            return owners;
+        }
+
+        void enter() {
+            thread_slot& slot = slots_[thread_index()];
+
+            if (slot.depth++ == 0) {
+                slot.epoch.store(global_epoch_.load(std::memory_order_seq_cst), std::memory_order_seq_cst);
+            }
+        }
+
+        void leave() noexcept {
+            thread_slot& slot = slots_[thread_index()];
+
+            if (--slot.depth == 0) {
+                slot.epoch.store(0, std::memory_order_release);
+            }
+        }
+    };
+
+} // namespace fefu
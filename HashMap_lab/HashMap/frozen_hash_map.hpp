@@ -0,0 +1,420 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <istream>
+#include <memory>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "hash_map.hpp"
+#include "mapped_file.hpp"
+
+namespace fefu
+{
+    /**
+     *  @brief  An immutable map indexed by a minimal perfect hash.
+     *
+     *  Built once from a %hash_map (see freeze()), it keeps the elements
+     *  packed in an array of exactly size() entries, so there are no empty
+     *  buckets.  The position of a key is computed with the CHD scheme:
+     *  keys are split into about size()/4 groups by one hash, and every
+     *  group stores a 32-bit displacement choosing a second hash that sends
+     *  its keys to free positions.  Groups of one key store their position
+     *  directly.  A lookup reads one displacement and one entry.
+     *
+     *  The map is a flat image without pointers: save() writes it and
+     *  load() or map_file() read it back, the latter by mapping the file
+     *  read-only.  Keys and values must be trivially copyable, and Hash must
+     *  give the same values in the process that loads the image.  Copies
+     *  share the image.
+     */
+    template<typename K, typename T,
+        typename Hash = std::hash<K>,
+        typename Pred = std::equal_to<K>>
+        class frozen_hash_map
+    {
+        static_assert(std::is_trivially_copyable<K>::value, "frozen_hash_map keys must be trivially copyable");
+        static_assert(std::is_trivially_copyable<T>::value, "frozen_hash_map values must be trivially copyable");
+
+    public:
+        using key_type = K;
+        using mapped_type = T;
+        using hasher = Hash;
+        using key_equal = Pred;
+        using size_type = std::size_t;
+
+        /// A packed key and value.
+        struct entry {
+            key_type key;
+            mapped_type value;
+        };
+
+        static_assert(alignof(entry) <= alignof(std::max_align_t), "frozen_hash_map entries must not be over-aligned");
+
+        /// Image format version; images of another version are rejected.
+        static constexpr std::uint32_t format_version = 1;
+
+        /// Creates an empty map.
+        frozen_hash_map() : frozen_hash_map(std::vector<entry>()) {}
+
+        /**
+         *  @brief  Builds the map from @a entries.
+         *  @throw  std::invalid_argument  If a key occurs twice, two keys
+         *                                 have equal hashes, or no seed up
+         *                                 to max_seeds places every key.
+         */
+        explicit frozen_hash_map(const std::vector<entry>& entries, const hasher& hf = hasher(), const key_equal& eql = key_equal())
+            : hash_(hf), equal_(eql) {
+            build(entries);
+        }
+
+        size_type size() const noexcept {
+            return static_cast<size_type>(header_->size);
+        }
+
+        bool empty() const noexcept {
+            return size() == 0;
+        }
+
+        /// Returns a pointer to the value of @a k, or nullptr.
+        const mapped_type* find(const key_type& k) const {
+            if (header_->size == 0) {
+                return nullptr;
+            }
+
+            const entry& e = entries_[slot_of(k)];
+            return equal_(e.key, k) ? &e.value : nullptr;
+        }
+
+        bool contains(const key_type& k) const {
+            return find(k) != nullptr;
+        }
+
+        /// Returns the value of @a k, or throws std::out_of_range.
+        const mapped_type& at(const key_type& k) const {
+            const mapped_type* value = find(k);
+            if (value == nullptr) {
+                throw std::out_of_range("frozen_hash_map::at");
+            }
+            return *value;
+        }
+
+        //@{
+        /// Iterates the packed entries in storage order.
+        const entry* begin() const noexcept {
+            return entries_;
+        }
+
+        const entry* end() const noexcept {
+            return entries_ + header_->size;
+        }
+        //@}
+
+        /// Returns the bytes of the image: header, displacements and entries.
+        size_type memory_usage() const noexcept {
+            return static_cast<size_type>(header_->image_size);
+        }
+
+        /// Writes the image to @a out.
+        void save(std::ostream& out) const {
+            out.write(reinterpret_cast<const char*>(header_), static_cast<std::streamsize>(header_->image_size));
+
+            if (!out) {
+                throw std::runtime_error("frozen_hash_map: write failed");
+            }
+        }
+
+        /**
+         *  @brief  Reads an image written by save().
+         *  @throw  std::runtime_error  If the stream does not hold an image
+         *                              of this key and value layout.
+         */
+        static frozen_hash_map load(std::istream& in, const hasher& hf = hasher(), const key_equal& eql = key_equal()) {
+            image_header header;
+            if (!in.read(reinterpret_cast<char*>(&header), sizeof(header))) {
+                throw std::runtime_error("frozen_hash_map: truncated image");
+            }
+            check(header, header.image_size);
+
+            auto image = std::make_shared<std::vector<std::max_align_t>>(words(header.image_size));
+            char* data = reinterpret_cast<char*>(image->data());
+            std::memcpy(data, &header, sizeof(header));
+
+            if (!in.read(data + sizeof(header), static_cast<std::streamsize>(header.image_size - sizeof(header)))) {
+                throw std::runtime_error("frozen_hash_map: truncated image");
+            }
+
+            return frozen_hash_map(image, data, hf, eql);
+        }
+
+        /**
+         *  @brief  Maps an image file written by save() read-only.
+         *
+         *  Pages are read from the file as lookups touch them.
+         */
+        static frozen_hash_map map_file(const std::string& path, const hasher& hf = hasher(), const key_equal& eql = key_equal()) {
+            auto file = std::make_shared<detail::mapped_file>();
+            file->open_read_only(path);
+
+            if (file->size() < sizeof(image_header)) {
+                throw std::runtime_error("frozen_hash_map: " + path + " is not a frozen_hash_map image");
+            }
+            check(*reinterpret_cast<const image_header*>(file->data()), file->size());
+
+            return frozen_hash_map(file, file->data(), hf, eql);
+        }
+
+    private:
+        struct image_header {
+            char magic[8];
+            std::uint32_t version;
+            std::uint32_t header_size;
+            std::uint64_t key_size;
+            std::uint64_t value_size;
+            std::uint64_t entry_size;
+            std::uint64_t size;
+            std::uint64_t groups;
+            std::uint64_t seed;
+            std::uint64_t entries_offset;
+            std::uint64_t image_size;
+        };
+
+        static constexpr std::uint32_t direct = 0x80000000u;
+        static constexpr std::uint64_t max_displacement = std::uint64_t(1) << 24;
+        static constexpr std::uint64_t max_seeds = 64;
+
+        std::shared_ptr<const void> image_;
+        const image_header* header_;
+        const std::uint32_t* displacements_;
+        const entry* entries_;
+        hasher hash_;
+        key_equal equal_;
+
+        frozen_hash_map(std::shared_ptr<const void> image, const char* data, const hasher& hf, const key_equal& eql)
+            : image_(std::move(image)), hash_(hf), equal_(eql) {
+            attach(data);
+        }
+
+        static std::uint64_t displaced(std::uint64_t h, std::uint64_t d, std::uint64_t n) noexcept {
+            return detail::finalize(h + d * 0x9E3779B97F4A7C15ull) % n;
+        }
+
+        static std::size_t words(std::uint64_t bytes) noexcept {
+            return static_cast<std::size_t>((bytes + sizeof(std::max_align_t) - 1) / sizeof(std::max_align_t));
+        }
+
+        static const char* magic() noexcept {
+            return "FEFUMPHF";
+        }
+
+        static void check(const image_header& header, std::uint64_t available) {
+            if (std::memcmp(header.magic, magic(), sizeof(header.magic)) != 0) {
+                throw std::runtime_error("frozen_hash_map: not a frozen_hash_map image");
+            }
+            if (header.version != format_version || header.header_size != sizeof(image_header)) {
+                throw std::runtime_error("frozen_hash_map: unsupported image version");
+            }
+            if (header.key_size != sizeof(key_type) || header.value_size != sizeof(mapped_type) || header.entry_size != sizeof(entry)) {
+                throw std::runtime_error("frozen_hash_map: image holds a different key or value type");
+            }
+            if (header.entries_offset % alignof(entry) != 0 ||
+                header.entries_offset < sizeof(image_header) + header.groups * sizeof(std::uint32_t) ||
+                header.entries_offset + header.size * sizeof(entry) != header.image_size || header.image_size > available) {
+                throw std::runtime_error("frozen_hash_map: image is truncated or corrupt");
+            }
+        }
+
+        void attach(const char* data) noexcept {
+            header_ = reinterpret_cast<const image_header*>(data);
+            displacements_ = reinterpret_cast<const std::uint32_t*>(data + sizeof(image_header));
+            entries_ = reinterpret_cast<const entry*>(data + header_->entries_offset);
+        }
+
+        std::uint64_t slot_of(const key_type& k) const {
+            std::uint64_t h = detail::finalize(hash_(k) ^ header_->seed);
+            std::uint32_t d = displacements_[(h >> 32) % header_->groups];
+            return (d & direct) ? (d & ~direct) : displaced(h, d, header_->size);
+        }
+
+        void build(const std::vector<entry>& entries) {
+            const std::uint64_t n = entries.size();
+            const std::uint64_t groups = std::max<std::uint64_t>(1, n / 4);
+
+            if (n >= direct) {
+                throw std::length_error("frozen_hash_map: too many keys");
+            }
+
+            std::uint64_t entries_offset = sizeof(image_header) + groups * sizeof(std::uint32_t);
+            entries_offset = (entries_offset + alignof(entry) - 1) / alignof(entry) * alignof(entry);
+            std::uint64_t image_size = entries_offset + n * sizeof(entry);
+
+            auto image = std::make_shared<std::vector<std::max_align_t>>(words(image_size));
+            char* data = reinterpret_cast<char*>(image->data());
+            image_header* header = reinterpret_cast<image_header*>(data);
+            std::memcpy(header->magic, magic(), sizeof(header->magic));
+            header->version = format_version;
+            header->header_size = sizeof(image_header);
+            header->key_size = sizeof(key_type);
+            header->value_size = sizeof(mapped_type);
+            header->entry_size = sizeof(entry);
+            header->size = n;
+            header->groups = groups;
+            header->entries_offset = entries_offset;
+            header->image_size = image_size;
+
+            std::uint32_t* displacements = reinterpret_cast<std::uint32_t*>(data + sizeof(image_header));
+            entry* packed = reinterpret_cast<entry*>(data + entries_offset);
+
+            // The seed is mixed in after hashing, so keys with equal hashes
+            // would collide under every seed.
+            std::vector<std::pair<std::uint64_t, std::uint64_t>> by_hash(n);
+            for (std::uint64_t i = 0; i != n; i++) {
+                by_hash[i] = { hash_(entries[i].key), i };
+            }
+            std::sort(by_hash.begin(), by_hash.end());
+            for (std::uint64_t i = 1; i < n; i++) {
+                if (by_hash[i].first == by_hash[i - 1].first) {
+                    if (equal_(entries[by_hash[i].second].key, entries[by_hash[i - 1].second].key)) {
+                        throw std::invalid_argument("frozen_hash_map: duplicate key");
+                    }
+                    throw std::invalid_argument("frozen_hash_map: two keys have equal hashes");
+                }
+            }
+            by_hash = {};
+
+            std::uint64_t seed = 0;
+            for (; seed != max_seeds; seed++) {
+                header->seed = detail::finalize(seed + 1);
+                if (place(entries, header->seed, groups, displacements, packed)) {
+                    break;
+                }
+            }
+            if (seed == max_seeds) {
+                throw std::invalid_argument("frozen_hash_map: no seed places every key");
+            }
+
+            image_ = std::move(image);
+            attach(data);
+        }
+
+        // Finds displacements for seed @a seed; false if some group found none.
+        bool place(const std::vector<entry>& entries, std::uint64_t seed, std::uint64_t groups,
+            std::uint32_t* displacements, entry* packed) const {
+            const std::uint64_t n = entries.size();
+            std::vector<std::uint64_t> hashes(n);
+            std::vector<std::uint64_t> group_start(groups + 1, 0);
+
+            for (std::uint64_t i = 0; i != n; i++) {
+                hashes[i] = detail::finalize(hash_(entries[i].key) ^ seed);
+                group_start[(hashes[i] >> 32) % groups + 1]++;
+            }
+            for (std::uint64_t g = 0; g != groups; g++) {
+                group_start[g + 1] += group_start[g];
+            }
+
+            std::vector<std::uint64_t> members(n);
+            std::vector<std::uint64_t> fill(group_start.begin(), group_start.end() - 1);
+            for (std::uint64_t i = 0; i != n; i++) {
+                members[fill[(hashes[i] >> 32) % groups]++] = i;
+            }
+
+            // Largest groups first: they are the hardest to place.
+            std::vector<std::uint64_t> order(groups);
+            for (std::uint64_t g = 0; g != groups; g++) {
+                order[g] = g;
+            }
+            std::stable_sort(order.begin(), order.end(), [&](std::uint64_t a, std::uint64_t b) {
+                return group_start[a + 1] - group_start[a] > group_start[b + 1] - group_start[b];
+            });
+
+            std::vector<bool> taken(n, false);
+            std::vector<std::uint64_t> slots;
+            std::uint64_t next_free = 0;
+
+            for (std::uint64_t g : order) {
+                const std::uint64_t first = group_start[g];
+                const std::uint64_t count = group_start[g + 1] - first;
+
+                if (count == 0) {
+                    displacements[g] = 0;
+                    continue;
+                }
+
+                if (count == 1) {
+                    while (taken[next_free]) {
+                        next_free++;
+                    }
+                    taken[next_free] = true;
+                    displacements[g] = direct | static_cast<std::uint32_t>(next_free);
+                    packed[next_free] = entries[members[first]];
+                    continue;
+                }
+
+                // Keys with equal hashes collide for every displacement.
+                for (std::uint64_t i = first; i != first + count; i++) {
+                    for (std::uint64_t j = first; j != i; j++) {
+                        if (hashes[members[i]] == hashes[members[j]]) {
+                            if (equal_(entries[members[i]].key, entries[members[j]].key)) {
+                                throw std::invalid_argument("frozen_hash_map: duplicate key");
+                            }
+                            return false;
+                        }
+                    }
+                }
+
+                std::uint64_t d = 0;
+                for (; d != max_displacement; d++) {
+                    slots.clear();
+
+                    for (std::uint64_t i = first; i != first + count; i++) {
+                        std::uint64_t slot = displaced(hashes[members[i]], d, n);
+                        if (taken[slot] || std::find(slots.begin(), slots.end(), slot) != slots.end()) {
+                            break;
+                        }
+                        slots.push_back(slot);
+                    }
+
+                    if (slots.size() == count) {
+                        break;
+                    }
+                }
+
+                if (d == max_displacement) {
+                    return false;
+                }
+
+                for (std::uint64_t i = 0; i != count; i++) {
+                    taken[slots[i]] = true;
+                    packed[slots[i]] = entries[members[first + i]];
+                }
+                displacements[g] = static_cast<std::uint32_t>(d);
+            }
+
+            return true;
+        }
+    };
+
+    /**
+     *  @brief  Builds a %frozen_hash_map holding the elements of @a map.
+     *
+     *  The result does not depend on @a map afterwards.
+     */
+    template<typename K, typename T, typename Hash, typename Pred, typename Alloc>
+    frozen_hash_map<K, T, Hash, Pred> freeze(const hash_map<K, T, Hash, Pred, Alloc>& map) {
+        std::vector<typename frozen_hash_map<K, T, Hash, Pred>::entry> entries;
+        entries.reserve(map.size());
+
+        for (const auto& element : map) {
+            entries.push_back({ element.first, element.second });
+        }
+
+        return frozen_hash_map<K, T, Hash, Pred>(entries, map.hash_function(), map.key_eq());
+    }
+
+} // namespace fefu
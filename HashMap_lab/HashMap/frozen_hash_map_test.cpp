@@ -0,0 +1,123 @@
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+#include "frozen_hash_map.hpp"
+#include "hash_map.hpp"
+#include "../catch.hpp"
+
+TEST_CASE("freeze builds a minimal perfect hash table", "[frozen_hash_map]") {
+    fefu::hash_map<int, double> map;
+    for (int i = 0; i < 10000; i++) {
+        map[i * 31 - 5000] = i / 2.0;
+    }
+
+    auto frozen = fefu::freeze(map);
+    REQUIRE(frozen.size() == map.size());
+    REQUIRE(frozen.end() - frozen.begin() == 10000);
+
+    for (const auto& element : map) {
+        REQUIRE(frozen.at(element.first) == element.second);
+    }
+    REQUIRE_FALSE(frozen.contains(1));
+    REQUIRE(frozen.find(-4999) == nullptr);
+    REQUIRE_THROWS_AS(frozen.at(7), std::out_of_range);
+
+    SECTION("empty and tiny maps") {
+        fefu::frozen_hash_map<int, int> empty;
+        REQUIRE(empty.find(0) == nullptr);
+
+        fefu::hash_map<int, int> one;
+        one[42] = 1;
+        REQUIRE(fefu::freeze(one).at(42) == 1);
+        REQUIRE_FALSE(fefu::freeze(one).contains(41));
+    }
+    SECTION("duplicate keys are rejected") {
+        std::vector<fefu::frozen_hash_map<int, int>::entry> entries = { { 1, 1 }, { 2, 2 }, { 1, 3 } };
+        REQUIRE_THROWS_AS((fefu::frozen_hash_map<int, int>(entries)), std::invalid_argument);
+    }
+    SECTION("keys with equal hashes are rejected") {
+        struct half_hash {
+            std::size_t operator()(int k) const noexcept {
+                return static_cast<std::size_t>(k / 2);
+            }
+        };
+        fefu::hash_map<int, int, half_hash> colliding;
+        colliding[0] = 0;
+        colliding[1] = 1;
+        colliding[5] = 5;
+        REQUIRE_THROWS_AS(fefu::freeze(colliding), std::invalid_argument);
+    }
+    SECTION("stream round trip") {
+        std::stringstream stream;
+        frozen.save(stream);
+        REQUIRE(stream.str().size() == frozen.memory_usage());
+
+        auto loaded = fefu::frozen_hash_map<int, double>::load(stream);
+        REQUIRE(loaded.size() == 10000);
+        REQUIRE(loaded.at(-5000) == 0.0);
+
+        std::stringstream wrong(stream.str());
+        REQUIRE_THROWS_AS((fefu::frozen_hash_map<int, float>::load(wrong)), std::runtime_error);
+    }
+    SECTION("mapped file") {
+        std::string path = (std::filesystem::temp_directory_path() / "fefu_frozen_test.mph").string();
+        {
+            std::ofstream out(path, std::ios::binary);
+            frozen.save(out);
+        }
+
+        {
+            auto mapped = fefu::frozen_hash_map<int, double>::map_file(path);
+            REQUIRE(mapped.size() == 10000);
+            REQUIRE(mapped.at(9999 * 31 - 5000) == 9999 / 2.0);
+        }
+        std::filesystem::remove(path);
+    }
+}
+
+TEST_CASE("Lookups in a frozen map versus hash_map", "[frozen_hash_map][!benchmark]") {
+    const std::uint64_t elements = 1 << 22;
+    const std::uint64_t lookups = 1 << 22;
+
+    fefu::hash_map<std::uint64_t, std::uint64_t> map;
+    std::mt19937_64 generator(7);
+    std::vector<std::uint64_t> keys(elements);
+    for (std::uint64_t i = 0; i < elements; i++) {
+        keys[i] = generator();
+        map[keys[i]] = i;
+    }
+
+    std::vector<std::uint64_t> probes(lookups);
+    for (auto& probe : probes) {
+        probe = keys[generator() % elements];
+    }
+
+    fefu::frozen_hash_map<std::uint64_t, std::uint64_t> frozen;
+    BENCHMARK("freeze") {
+        frozen = fefu::freeze(map);
+        return frozen.size();
+    };
+
+    WARN("hash_map: " << static_cast<double>(map.memory_usage().total()) / elements << " bytes per element, frozen: "
+        << static_cast<double>(frozen.memory_usage()) / elements << " bytes per element");
+
+    BENCHMARK("hash_map lookups") {
+        std::uint64_t sum = 0;
+        for (std::uint64_t key : probes) {
+            sum += map.find(key)->second;
+        }
+        return sum;
+    };
+
+    BENCHMARK("frozen_hash_map lookups") {
+        std::uint64_t sum = 0;
+        for (std::uint64_t key : probes) {
+            sum += *frozen.find(key);
+        }
+        return sum;
+    };
+}
@@ -1,9 +1,17 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
 #include <functional>
+#include <iterator>
 #include <memory>
 #include <utility>
 #include <type_traits>
 #include <vector>
 #include <limits>
+#include <stdexcept>
+#include <tuple>
 
 namespace fefu
 {
@@ -17,6 +25,8 @@ namespace fefu
         using reference = typename std::add_lvalue_reference<T>::type;
         using const_reference = typename std::add_lvalue_reference<const T>::type;
         using value_type = T;
+        using propagate_on_container_move_assignment = std::true_type;
+        using is_always_equal = std::true_type;
 
         allocator() noexcept = default;
 
@@ -38,27 +48,123 @@ namespace fefu
         }
     };
 
-    template<typename ValueType>
+    template<typename T, typename U>
+    inline bool operator==(const allocator<T>&, const allocator<U>&) noexcept {
+        return true;
+    }
+
+    template<typename T, typename U>
+    inline bool operator!=(const allocator<T>&, const allocator<U>&) noexcept {
+        return false;
+    }
+
+    namespace detail
+    {
+        template<typename Key, typename Value, typename KeyOf, typename Hash, typename Pred, typename Alloc>
+        class hash_table;
+
+        /**
+         *  Spreads the bits of a hash over the low bits that pick a bucket of
+         *  a power-of-two table.  std::hash of an integer is the identity,
+         *  which linear probing over such a table cannot afford.
+         */
+        inline std::uint64_t mix(std::uint64_t h) noexcept {
+            h ^= h >> 33;
+            h *= 0xff51afd7ed558ccdULL;
+            h ^= h >> 33;
+            return h;
+        }
+
+        /**
+         *  MurmurHash3's 64-bit finalizer, a full avalanche of @a h.  The
+         *  file formats of persistent_hash_map and frozen_hash_map place
+         *  keys by it, so it must not change.
+         */
+        constexpr std::uint64_t finalize(std::uint64_t h) noexcept {
+            h ^= h >> 33;
+            h *= 0xff51afd7ed558ccdull;
+            h ^= h >> 33;
+            h *= 0xc4ceb9fe1a85ec53ull;
+            h ^= h >> 33;
+            return h;
+        }
+
+        /// Index of the lowest set bit of @a x, which must not be 0.
+        inline std::size_t lowest_bit(std::uint64_t x) noexcept {
+#if defined(__GNUC__)
+            return static_cast<std::size_t>(__builtin_ctzll(x));
+#else
+            std::size_t i = 0;
+            for (; (x & 1) == 0; x >>= 1) {
+                i++;
+            }
+            return i;
+#endif
+        }
+
+        /**
+         *  @brief  Backward-shift deletion for linear probing over a
+         *          power-of-two table.
+         *  @param  hole  The bucket being emptied.
+         *  @param  mask  The bucket count minus one.
+         *  @param  is_empty  is_empty(pos) tells whether bucket pos is free.
+         *  @param  home_of  home_of(pos) is the home bucket of the element in pos.
+         *  @param  move  move(from, to) moves the element of bucket from into to.
+         *  @return  The bucket left empty at the end; the caller clears it.
+         *
+         *  Pulls later members of the cluster into the hole unless that would
+         *  put them before their home bucket.
+         */
+        template<typename IsEmpty, typename HomeOf, typename Move>
+        std::size_t backward_shift(std::size_t hole, std::size_t mask, IsEmpty is_empty, HomeOf home_of, Move move) {
+            for (std::size_t pos = (hole + 1) & mask; !is_empty(pos); pos = (pos + 1) & mask) {
+                std::size_t home = home_of(pos);
+
+                if (((pos - home) & mask) >= ((pos - hole) & mask)) {
+                    move(pos, hole);
+                    hole = pos;
+                }
+            }
+            return hole;
+        }
+    }
+
+    template<typename ValueType, typename Bitmap>
+    class hash_map_const_iterator;
+
+    template<typename ValueType, typename Bitmap = std::vector<bool>>
     class hash_map_iterator {
     public:
+        template<typename, typename, typename, typename, typename>
+        friend class hash_map;
+
+        template<typename, typename, typename, typename, typename, typename>
+        friend class detail::hash_table;
+
+        friend class hash_map_const_iterator<ValueType, Bitmap>;
+
         using iterator_category = std::forward_iterator_tag;
         using value_type = ValueType;
         using difference_type = std::ptrdiff_t;
         using reference = ValueType&;
         using pointer = ValueType*;
 
-        hash_map_iterator() noexcept : ptr_value_(nullptr), used_(0) {}
+        hash_map_iterator() noexcept : ptr_value_(nullptr), ptr_begin_(nullptr), used_(nullptr) {}
 
-        hash_map_iterator(const pointer& ptr_value, const std::vector<bool>& used) {
+        hash_map_iterator(const pointer& ptr_value, const pointer& ptr_begin, const Bitmap& used) noexcept {
             ptr_value_ = ptr_value;
-            used_ = used;
+            ptr_begin_ = ptr_begin;
+            used_ = &used;
         }
 
         hash_map_iterator(const hash_map_iterator& other) noexcept {
             ptr_value_ = other.ptr_value_;
+            ptr_begin_ = other.ptr_begin_;
             used_ = other.used_;
         }
 
+        hash_map_iterator& operator=(const hash_map_iterator& other) noexcept = default;
+
         reference operator*() const {
             return *(ptr_value_);
         }
@@ -68,59 +174,78 @@ namespace fefu
         }
 
         // prefix ++
-        hash_map_iterator& operator++() { //TODO works not correct, make foreach to check where used[] is true
-            ptr_value_++;
+        hash_map_iterator& operator++() {
+            size_t end = used_->size();
+            size_t pos = ptr_value_ - ptr_begin_ + 1;
+
+            while (pos < end && !(*used_)[pos]) {
+                pos++;
+            }
+
+            ptr_value_ = ptr_begin_ + pos;
 
             return *this;
         }
         // postfix ++
         hash_map_iterator operator++(int) {
-            return (*this)++;
+            hash_map_iterator previous(*this);
+            ++(*this);
+
+            return previous;
         }
 
-        friend bool operator==(const hash_map_iterator<ValueType>& lhs, const hash_map_iterator<ValueType>& rhs) {
+        friend bool operator==(const hash_map_iterator& lhs, const hash_map_iterator& rhs) {
             return lhs.ptr_value_ == rhs.ptr_value_;
         }
 
-        friend bool operator!=(const hash_map_iterator<ValueType>& lhs, const hash_map_iterator<ValueType>& rhs) {
+        friend bool operator!=(const hash_map_iterator& lhs, const hash_map_iterator& rhs) {
             return lhs.ptr_value_ != rhs.ptr_value_;
         }
 
     private:
         pointer ptr_value_;
-        std::vector<bool> used_;
+        pointer ptr_begin_;
+        const Bitmap* used_;
     };
 
-    template<typename ValueType>
+    template<typename ValueType, typename Bitmap = std::vector<bool>>
     class hash_map_const_iterator {
         // Shouldn't give non const references on value
     public:
         template<typename, typename, typename, typename, typename>
         friend class hash_map;
 
+        template<typename, typename, typename, typename, typename, typename>
+        friend class detail::hash_table;
+
         using iterator_category = std::forward_iterator_tag;
         using value_type = ValueType;
         using difference_type = std::ptrdiff_t;
         using reference = const ValueType&;
         using pointer = const ValueType*;
 
-        hash_map_const_iterator() noexcept : ptr_value_(nullptr), used_(0) {}
+        hash_map_const_iterator() noexcept : ptr_value_(nullptr), ptr_begin_(nullptr), used_(nullptr) {}
 
-        hash_map_const_iterator(const pointer& ptr_value, const std::vector<bool>& used) {
+        hash_map_const_iterator(const pointer& ptr_value, const pointer& ptr_begin, const Bitmap& used) noexcept {
             ptr_value_ = ptr_value;
-            used_ = used;
+            ptr_begin_ = ptr_begin;
+            used_ = &used;
         }
 
         hash_map_const_iterator(const hash_map_const_iterator& other) noexcept {
             ptr_value_ = other.ptr_value_;
+            ptr_begin_ = other.ptr_begin_;
             used_ = other.used_;
         }
 
-        hash_map_const_iterator(const hash_map_iterator<ValueType>& other) noexcept {
+        hash_map_const_iterator(const hash_map_iterator<ValueType, Bitmap>& other) noexcept {
             ptr_value_ = other.ptr_value_;
+            ptr_begin_ = other.ptr_begin_;
             used_ = other.used_;
         }
 
+        hash_map_const_iterator& operator=(const hash_map_const_iterator& other) noexcept = default;
+
         reference operator*() const {
             return *ptr_value_;
         }
@@ -131,25 +256,48 @@ namespace fefu
 
         // prefix ++
         hash_map_const_iterator& operator++() {
-            ptr_value_++;
+            size_t end = used_->size();
+            size_t pos = ptr_value_ - ptr_begin_ + 1;
+
+            while (pos < end && !(*used_)[pos]) {
+                pos++;
+            }
+
+            ptr_value_ = ptr_begin_ + pos;
 
             return *this;
         }
         // postfix ++
         hash_map_const_iterator operator++(int) {
-            return (*this)++;
+            hash_map_const_iterator previous(*this);
+            ++(*this);
+
+            return previous;
         }
 
-        friend bool operator==(const hash_map_const_iterator<ValueType>& lhs, const hash_map_const_iterator<ValueType>& rhs) {
+        friend bool operator==(const hash_map_const_iterator& lhs, const hash_map_const_iterator& rhs) {
             return lhs.ptr_value_ == rhs.ptr_value_;
         }
-        friend bool operator!=(const hash_map_const_iterator<ValueType>& lhs, const hash_map_const_iterator<ValueType>& rhs) {
+        friend bool operator!=(const hash_map_const_iterator& lhs, const hash_map_const_iterator& rhs) {
             return lhs.ptr_value_ != rhs.ptr_value_;
         }
 
     private:
         pointer ptr_value_;
-        std::vector<bool> used_;
+        pointer ptr_begin_;
+        const Bitmap* used_;
+    };
+
+    /// Bytes used by a container, split by what they hold.
+    struct memory_footprint {
+        std::size_t object = 0;    ///< The container object itself.
+        std::size_t slots = 0;     ///< The bucket array, empty buckets included.
+        std::size_t metadata = 0;  ///< Occupancy and tombstone bitmaps.
+        std::size_t heap = 0;      ///< Out-of-line memory owned by the elements.
+
+        std::size_t total() const noexcept {
+            return object + slots + metadata + heap;
+        }
     };
 
     class PrimeNumberGenerator {
@@ -192,13 +340,799 @@ namespace fefu
         }
     };
 
+    namespace detail
+    {
+        template<typename Map>
+        struct table_access;
+
+        /// Returns the key of a %hash_map element.
+        struct select_first {
+            template<typename Pair>
+            const typename Pair::first_type& operator()(const Pair& x) const noexcept {
+                return x.first;
+            }
+        };
+
+        /// Returns a %hash_set element, which is its own key.
+        struct identity_key {
+            template<typename Key>
+            const Key& operator()(const Key& x) const noexcept {
+                return x;
+            }
+        };
+
+        /**
+         *  @brief  The open-addressing engine behind %hash_map, %hash_set
+         *          and %hash_multimap.
+         *
+         *  Stores Value elements in a prime-sized bucket array with an
+         *  occupancy and a tombstone bitmap, and probes by double hashing;
+         *  KeyOf returns the key of an element.  Everything that does not
+         *  depend on what an element holds besides its key lives here:
+         *  lookup, erasure, iteration, the bucket interface and the growth
+         *  policy.  Each container derives from it and adds the insertion
+         *  interface of its value type.
+         */
+        template<typename Key, typename Value, typename KeyOf, typename Hash, typename Pred, typename Alloc>
+        class hash_table
+        {
+        public:
+            using key_type = Key;
+            using hasher = Hash;
+            using key_equal = Pred;
+            using allocator_type = Alloc;
+            using value_type = Value;
+            using reference = value_type&;
+            using const_reference = const value_type&;
+            using size_type = std::size_t;
+
+        protected:
+            using alloc_traits = std::allocator_traits<Alloc>;
+            using bitmap_type = std::vector<bool, typename alloc_traits::template rebind_alloc<bool>>;
+
+        public:
+            using iterator = hash_map_iterator<value_type, bitmap_type>;
+            using const_iterator = hash_map_const_iterator<value_type, bitmap_type>;
+
+            ///  Returns the allocator object used by the %hash_table.
+            allocator_type get_allocator() const noexcept {
+                return allocator_;
+            }
+
+            // size and capacity:
+
+            ///  Returns true if the %hash_table is empty.
+            bool empty() const noexcept {
+                return size_ == 0;
+            }
+
+            ///  Returns the size of the %hash_table.
+            size_type size() const noexcept {
+                return size_;
+            }
+
+            ///  Returns the maximum size of the %hash_table.
+            size_type max_size() const noexcept {
+                return std::numeric_limits<size_type>::max();
+            }
+
+            //@{
+            /**
+             *  @brief  Returns the memory held by the %hash_table.
+             *  @param  heap_usage  Called for every element; returns the bytes
+             *                      the element owns outside its bucket, e.g.
+             *                      the buffer of a long std::string key.
+             *
+             *  Without @a heap_usage the element heap usage is reported as 0.
+             */
+            memory_footprint memory_usage() const noexcept {
+                memory_footprint footprint;
+                footprint.object = sizeof(*this);
+                footprint.slots = capacity_ * sizeof(value_type);
+                footprint.metadata = bitmap_bytes(used_) + bitmap_bytes(deleted_);
+                return footprint;
+            }
+
+            template<typename F>
+            memory_footprint memory_usage(F heap_usage) const {
+                memory_footprint footprint = memory_usage();
+
+                for (const value_type& element : *this) {
+                    footprint.heap += heap_usage(element);
+                }
+                return footprint;
+            }
+            //@}
+
+            // iterators.
+
+            /**
+             *  Returns a read/write iterator that points to the first element in the
+             *  %hash_table.
+             */
+            iterator begin() noexcept {
+                for (size_t i = 0; i != capacity_; i++) {
+                    if (used_[i]) {
+                        return make_iterator(i);
+                    }
+                }
+
+                return end();
+            }
+
+            //@{
+            /**
+             *  Returns a read-only (constant) iterator that points to the first
+             *  element in the %hash_table.
+             */
+            const_iterator begin() const noexcept {
+                return cbegin();
+            }
+
+            const_iterator cbegin() const noexcept {
+                for (size_t i = 0; i != capacity_; i++) {
+                    if (used_[i]) {
+                        return make_const_iterator(i);
+                    }
+                }
+
+                return cend();
+            }
+
+            /**
+             *  Returns a read/write iterator that points one past the last element in
+             *  the %hash_table.
+             */
+            iterator end() noexcept {
+                return make_iterator(capacity_);
+            }
+
+            //@{
+            /**
+             *  Returns a read-only (constant) iterator that points one past the last
+             *  element in the %hash_table.
+             */
+            const_iterator end() const noexcept {
+                return cend();
+            }
+
+            const_iterator cend() const noexcept {
+                return make_const_iterator(capacity_);
+            }
+            //@}
+
+            //@{
+            /**
+             *  @brief Erases an element from an %hash_table.
+             *  @param  position  An iterator pointing to the element to be erased.
+             *  @return An iterator pointing to the element immediately following
+             *          @a position prior to the element being erased. If no such
+             *          element exists, end() is returned.
+             *
+             *  This function erases an element, pointed to by the given iterator,
+             *  from an %hash_table.
+             *  Note that this function only erases the element, and that if the
+             *  element is itself a pointer, the pointed-to memory is not touched in
+             *  any way.  Managing the pointer is the user's responsibility.
+             */
+            iterator erase(const_iterator position) {
+                return erase_slot(position.ptr_value_ - ptr_begin_);
+            }
+
+            // LWG 2059.
+            iterator erase(iterator position) {
+                return erase_slot(position.ptr_value_ - ptr_begin_);
+            }
+            //@}
+
+            /**
+             *  @brief Erases elements according to the provided key.
+             *  @param  x  Key of element to be erased.
+             *  @return  The number of elements erased.
+             *
+             *  This function erases all the elements located by the given key from
+             *  an %hash_table. For an %hash_table the result of this function
+             *  can only be 0 (not present) or 1 (present).
+             *  Note that this function only erases the element, and that if the
+             *  element is itself a pointer, the pointed-to memory is not touched in
+             *  any way.  Managing the pointer is the user's responsibility.
+             */
+            size_type erase(const key_type& x) {
+                size_type pos = find_slot(x);
+
+                if (pos != capacity_) {
+                    erase_slot(pos);
+                    return 1;
+                }
+
+                return 0;
+            }
+
+            /**
+             *  @brief Erases a [first,last) range of elements from an
+             *  %hash_table.
+             *  @param  first  Iterator pointing to the start of the range to be
+             *                  erased.
+             *  @param last  Iterator pointing to the end of the range to
+             *                be erased.
+             *  @return The iterator @a last.
+             *
+             *  This function erases a sequence of elements from an %hash_table.
+             *  Note that this function only erases the elements, and that if
+             *  the element is itself a pointer, the pointed-to memory is not touched
+             *  in any way.  Managing the pointer is the user's responsibility.
+             */
+            iterator erase(const_iterator first, const_iterator last) {
+                size_type last_pos = last.ptr_value_ - ptr_begin_;
+
+                for (size_type pos = first.ptr_value_ - ptr_begin_; pos < last_pos; pos++) {
+                    if (used_[pos]) {
+                        erase_slot(pos);
+                    }
+                }
+
+                return make_iterator(last_pos);
+            }
+
+            /**
+             *  Erases all elements in an %hash_table.
+             *  Note that this function only erases the elements, and that if the
+             *  elements themselves are pointers, the pointed-to memory is not touched
+             *  in any way.  Managing the pointer is the user's responsibility.
+             *
+             *  The buckets are kept.  Trivially destructible elements are not
+             *  visited at all: only the bitmaps are reset, a word at a time.
+             */
+            void clear() noexcept {
+                destroy_elements();
+                std::fill(used_.begin(), used_.end(), false);
+                std::fill(deleted_.begin(), deleted_.end(), false);
+                size_ = 0;
+                max_probe_ = 0;
+            }
+
+            // observers.
+
+            ///  Returns the hash functor object with which the %hash_table was
+            ///  constructed.
+            Hash hash_function() const {
+                return hash_;
+            }
+
+            ///  Returns the key comparison object with which the %hash_table was
+            ///  constructed.
+            Pred key_eq() const {
+                return equal_;
+            }
+
+            // lookup.
+
+            //@{
+            /**
+             *  @brief Tries to locate an element in an %hash_table.
+             *  @param  x  Key to be located.
+             *  @return  Iterator pointing to sought-after element, or end() if not
+             *           found.
+             *
+             *  This function takes a key and tries to locate the element with which
+             *  the key matches.  If successful the function returns an iterator
+             *  pointing to the sought after element.  If unsuccessful it returns the
+             *  past-the-end ( @c end() ) iterator.
+             */
+            iterator find(const key_type& x) {
+                return make_iterator(find_slot(x));
+            }
+
+            const_iterator find(const key_type& x) const {
+                return make_const_iterator(find_slot(x));
+            }
+            //@}
+
+            /**
+             *  @brief  Finds the number of elements.
+             *  @param  x  Key to count.
+             *  @return  Number of elements with specified key.
+             *
+             *  This function only makes sense for %unordered_multimap; for
+             *  %hash_table the result will either be 0 (not present) or 1
+             *  (present).
+             */
+            size_type count(const key_type& x) const {
+                return contains(x);
+            }
+
+            /**
+             *  @brief  Finds whether an element with the given key exists.
+             *  @param  x  Key of elements to be located.
+             *  @return  True if there is any element with the specified key.
+             */
+            bool contains(const key_type& x) const {
+                return find_slot(x) != capacity_;
+            }
+
+            // bucket interface.
+
+            /// Returns the number of buckets of the %hash_table.
+            size_type bucket_count() const noexcept {
+                return capacity_;
+            }
+
+            //@{
+            /**
+             *  Returns an iterator to the first element stored in bucket @a n or
+             *  after it.  Iterating from slot_begin(a) to slot_begin(b) visits
+             *  exactly the elements of buckets [a, b).
+             */
+            iterator slot_begin(size_type n) noexcept {
+                while (n < capacity_ && !used_[n]) {
+                    n++;
+                }
+
+                return make_iterator(std::min(n, capacity_));
+            }
+
+            const_iterator slot_begin(size_type n) const noexcept {
+                while (n < capacity_ && !used_[n]) {
+                    n++;
+                }
+
+                return make_const_iterator(std::min(n, capacity_));
+            }
+            //@}
+
+            /*
+            * @brief  Returns the bucket index of a given element.
+            * @param  _K  A key instance.
+            * @return  The key bucket index.
+            */
+            size_type bucket(const key_type& _K) const {
+                size_type pos = find_slot(_K);
+
+                if (pos == capacity_) {
+                    throw std::invalid_argument("key is not in the hash map");
+                }
+
+                return pos;
+            }
+
+            // hash policy.
+
+            /// Returns the average number of elements per bucket.
+            float load_factor() const noexcept {
+                return size_ == 0 ? 0 : static_cast<float>(static_cast<float>(size_) / capacity_);
+            }
+
+            /// Returns a positive number that the %hash_table tries to keep the
+            /// load factor less than or equal to.  Above it, an insertion whose
+            /// probe sequence gets long grows the table.
+            float max_load_factor() const noexcept {
+                return max_load_factor_;
+            }
+
+            /**
+             *  @brief  Change the %hash_table maximum load factor.
+             *  @param  z The new maximum load factor.
+             */
+            void max_load_factor(float z) {  //TODO maybe it is needed to throw exception when max_load_factor > 100%
+                max_load_factor_ = z;
+            }
+
+            /**
+             *  @brief  May rehash the %hash_table.
+             *  @param  n The new number of buckets.
+             *
+             *  Rehash will occur only if the new number of buckets respect the
+             *  %hash_table maximum load factor.
+             */
+            void rehash(size_type n) {
+                if (n < size_) {
+                    n = size_;
+                }
+
+                size_type new_capacity = n == 0 ? 0 : PrimeNumberGenerator(n).GetNextPrime();
+                bitmap_type new_used = make_bitmap(new_capacity);
+                value_type* new_begin = new_capacity == 0 ? nullptr : alloc_traits::allocate(allocator_, new_capacity);
+                size_type new_max_probe = 0;
+
+                // The old elements stay in place, so if a copy throws only
+                // the new buckets have to go.
+                try {
+                    for (size_type i = 0; i != capacity_; i++) {
+                        if (used_[i]) {
+                            size_type probes = new_capacity;
+                            size_type pos = probe_free_slot(key_of(ptr_begin_[i]), new_capacity, new_used, probes);
+                            new(new_begin + pos) value_type(std::move_if_noexcept(ptr_begin_[i]));
+                            new_used[pos] = true;
+                            new_max_probe = std::max(new_max_probe, probes);
+                        }
+                    }
+                }
+                catch (...) {
+                    for (size_type i = 0; i != new_capacity; i++) {
+                        if (new_used[i]) {
+                            (new_begin + i)->~value_type();
+                        }
+                    }
+                    if (new_begin != nullptr) {
+                        alloc_traits::deallocate(allocator_, new_begin, new_capacity);
+                    }
+                    throw;
+                }
+
+                size_type size = size_;
+                destroy();
+
+                size_ = size;
+                capacity_ = new_capacity;
+                ptr_begin_ = new_begin;
+                used_ = std::move(new_used);
+                deleted_ = make_bitmap(new_capacity);
+                max_probe_ = new_max_probe;
+            }
+
+            /**
+             *  @brief  Prepare the %hash_table for a specified number of
+             *          elements.
+             *  @param  n Number of elements required.
+             *
+             *  Same as rehash(ceil(n / max_load_factor())).
+             */
+            void reserve(size_type n) {
+                rehash(static_cast<size_type>(std::ceil(n / max_load_factor())));
+            }
+
+        protected:
+            /// Default constructor.
+            hash_table() : size_(0), capacity_(0), max_load_factor_(0.5), ptr_begin_(nullptr), used_(), deleted_(), max_probe_(0) {}
+
+            /**
+             *  @brief Creates an %hash_table with no elements.
+             *  @param a An allocator object.
+             */
+            explicit hash_table(const allocator_type& a) : allocator_(a), size_(0),
+                capacity_(0), max_load_factor_(0.5), ptr_begin_(nullptr), used_(a), deleted_(a), max_probe_(0) {}
+
+            /// Copy constructor.
+            hash_table(const hash_table& other)
+                : hash_table(other, alloc_traits::select_on_container_copy_construction(other.allocator_)) {}
+
+            /// Move constructor.
+            hash_table(hash_table&& other) : hash_table(other.allocator_) {
+                swap_all(other);
+            }
+
+            /*
+            *  @brief Copy constructor with allocator argument.
+            * @param  uset  Input %hash_table to copy.
+            * @param  a  An allocator object.
+            */
+            hash_table(const hash_table& umap,
+                const allocator_type& a) : allocator_(a), used_(a), deleted_(a) {
+                size_ = 0;
+                capacity_ = umap.capacity_;
+                max_load_factor_ = umap.max_load_factor_;
+                ptr_begin_ = capacity_ == 0 ? nullptr : alloc_traits::allocate(allocator_, capacity_);
+                deleted_ = copy_bitmap(umap.deleted_);
+                max_probe_ = umap.max_probe_;
+                hash_ = umap.hash_;
+                equal_ = umap.equal_;
+
+                if constexpr (trivial_slots) {
+                    if (capacity_ != 0) {
+                        std::memcpy(static_cast<void*>(ptr_begin_), umap.ptr_begin_, capacity_ * sizeof(value_type));
+                    }
+                    used_ = copy_bitmap(umap.used_);
+                    size_ = umap.size_;
+                    return;
+                }
+
+                used_ = make_bitmap(capacity_);
+
+                try {
+                    for (size_type i = 0; i != capacity_; i++) {
+                        if (umap.used_[i]) {
+                            new(ptr_begin_ + i) value_type(umap.ptr_begin_[i]);
+                            used_[i] = true;
+                            size_++;
+                        }
+                    }
+                }
+                catch (...) {
+                    destroy();
+                    throw;
+                }
+            }
+
+            /*
+            *  @brief  Move constructor with allocator argument.
+            *  @param  uset Input %hash_table to move.
+            *  @param  a    An allocator object.
+            *
+            *  Steals the buckets of @a umap if its allocator equals @a a, and
+            *  moves the elements one by one into memory from @a a otherwise.
+            */
+            hash_table(hash_table&& umap,
+                const allocator_type& a) : hash_table(a) {
+                if (allocator_ == umap.allocator_) {
+                    swap_all(umap);
+                }
+                else {
+                    max_load_factor_ = umap.max_load_factor_;
+                    hash_ = umap.hash_;
+                    equal_ = umap.equal_;
+                    rehash(umap.capacity_);
+
+                    for (auto& element : umap) {
+                        insert_value(std::move(element));
+                    }
+                }
+            }
+
+            /// Destroys the elements and releases the bucket array.
+            ~hash_table() {
+                destroy();
+            }
+
+            /// Copy assignment operator.
+            hash_table& operator=(const hash_table& other) {
+                if (this != &other) {
+                    hash_table copy(other, alloc_traits::propagate_on_container_copy_assignment::value ? other.allocator_ : allocator_);
+                    swap_all(copy);
+                    swap_allocator(copy, typename alloc_traits::propagate_on_container_copy_assignment());
+                }
+                return *this;
+            }
+
+            /// Move assignment operator.
+            hash_table& operator=(hash_table&& other) {
+                if (alloc_traits::propagate_on_container_move_assignment::value || allocator_ == other.allocator_) {
+                    swap_all(other);
+                    swap_allocator(other, typename alloc_traits::propagate_on_container_move_assignment());
+                }
+                else {
+                    hash_table moved(std::move(other), allocator_);
+                    swap_all(moved);
+                }
+                return *this;
+            }
+
+            /// Returns the key of @a x, as given by KeyOf.
+            static const key_type& key_of(const value_type& x) noexcept {
+                return KeyOf()(x);
+            }
+
+            allocator_type allocator_;
+            size_type size_;
+            size_type capacity_;
+            float max_load_factor_;
+            value_type* ptr_begin_;
+            bitmap_type used_;
+            bitmap_type deleted_;
+            size_type max_probe_;
+            Hash hash_;
+            key_equal equal_;
+
+            // Longest probe sequence an insertion may use once the load factor
+            // exceeds max_load_factor_ before the table grows instead.
+            static constexpr size_type probe_limit = 32;
+
+            // Buckets of such elements are copied with memcpy and never need
+            // their destructors run.
+            static constexpr bool trivial_slots = std::is_trivially_copy_constructible<value_type>::value
+                && std::is_trivially_destructible<value_type>::value;
+
+            iterator make_iterator(size_type pos) noexcept {
+                return iterator(ptr_begin_ + pos, ptr_begin_, used_);
+            }
+
+            const_iterator make_const_iterator(size_type pos) const noexcept {
+                return const_iterator(ptr_begin_ + pos, ptr_begin_, used_);
+            }
+
+            size_t hash_first(size_t hash, size_type capacity) const {
+                return hash % capacity;
+            }
+
+            // Capacities are prime, so any step in [1, capacity) visits every bucket.
+            // The hash is mixed first: std::hash of small integers is the identity,
+            // which would make every step 1.
+            size_t hash_second(size_t hash, size_type capacity) const {
+                return capacity == 1 ? 1 : 1 + static_cast<size_t>(detail::mix(hash) % (capacity - 1));
+            }
+
+            /// Returns the bucket holding @a key, or capacity_ if there is none.
+            size_type find_slot(const key_type& key) const {
+                if (size_ == 0) {
+                    return capacity_;
+                }
+
+                size_t hash = hash_(key);
+                size_t pos = hash_first(hash, capacity_);
+                size_t step = hash_second(hash, capacity_);
+
+                for (size_t i = 0; i != max_probe_; i++) {
+                    if (used_[pos]) {
+                        if (equal_(key_of(ptr_begin_[pos]), key)) {
+                            return pos;
+                        }
+                    }
+                    else if (!deleted_[pos]) {
+                        break;
+                    }
+
+                    pos += step;
+                    if (pos >= capacity_) {
+                        pos -= capacity_;
+                    }
+                }
+
+                return capacity_;
+            }
+
+            /**
+             *  Returns the first free bucket among the first @a probes buckets of
+             *  the probe sequence of @a key, or @a capacity if there is none.  On
+             *  success @a probes is set to the number of buckets visited.
+             */
+            size_type probe_free_slot(const key_type& key, size_type capacity, const bitmap_type& used, size_type& probes) const {
+                size_t hash = hash_(key);
+                size_t pos = hash_first(hash, capacity);
+                size_t step = hash_second(hash, capacity);
+
+                for (size_t i = 0; i != probes; i++) {
+                    if (!used[pos]) {
+                        probes = i + 1;
+                        return pos;
+                    }
+
+                    pos += step;
+                    if (pos >= capacity) {
+                        pos -= capacity;
+                    }
+                }
+
+                return capacity;
+            }
+
+            template<typename V>
+            std::pair<iterator, bool> insert_value(V&& x) {
+                size_type pos = find_slot(key_of(x));
+
+                if (pos != capacity_) {
+                    return std::make_pair(make_iterator(pos), false);
+                }
+
+                return std::make_pair(insert_unique(key_of(x), std::forward<V>(x)), true);
+            }
+
+            /**
+             *  Builds an element from @a args for @a key, which must not be
+             *  present yet.  @a key is only read before the element is built,
+             *  so it may refer to the key the element is moved from.
+             */
+            template<typename... Args>
+            iterator insert_unique(const key_type& key, Args&&... args) {
+                size_type probes = capacity_;
+
+                if (size_ >= capacity_ * max_load_factor_) {
+                    probes = std::min(capacity_, probe_limit);
+                }
+
+                size_type pos = capacity_ == 0 ? 0 : probe_free_slot(key, capacity_, used_, probes);
+
+                if (pos == capacity_) {
+                    rehash(capacity_ == 0 ? 2 : capacity_ * 2);
+                    probes = capacity_;
+                    pos = probe_free_slot(key, capacity_, used_, probes);
+                }
+
+                new (ptr_begin_ + pos) value_type(std::forward<Args>(args)...);
+                used_[pos] = true;
+                deleted_[pos] = false;
+                max_probe_ = std::max(max_probe_, probes);
+                size_++;
+
+                return make_iterator(pos);
+            }
+
+            iterator erase_slot(size_type pos) {
+                if (pos < capacity_ && used_[pos]) {
+                    used_[pos] = false;
+                    deleted_[pos] = true;
+                    size_--;
+                    (ptr_begin_ + pos)->~value_type();
+
+                    return ++make_iterator(pos);
+                }
+
+                return end();
+            }
+
+            template<typename ForwardIterator>
+            void reserve_for_range(ForwardIterator first, ForwardIterator last, std::forward_iterator_tag) {
+                size_type n = static_cast<size_type>(std::distance(first, last));
+
+                if (n > capacity_ * max_load_factor_) {
+                    reserve(n);
+                }
+            }
+
+            template<typename InputIterator>
+            void reserve_for_range(InputIterator, InputIterator, std::input_iterator_tag) {}
+
+            void swap_allocator(hash_table& x, std::true_type) noexcept {
+                std::swap(allocator_, x.allocator_);
+            }
+
+            void swap_allocator(hash_table&, std::false_type) noexcept {}
+
+            /// Exchanges everything but the allocators.
+            void swap_all(hash_table& x) noexcept {
+                std::swap(size_, x.size_);
+                std::swap(capacity_, x.capacity_);
+                std::swap(max_load_factor_, x.max_load_factor_);
+                std::swap(ptr_begin_, x.ptr_begin_);
+                std::swap(used_, x.used_);
+                std::swap(deleted_, x.deleted_);
+                std::swap(max_probe_, x.max_probe_);
+                std::swap(hash_, x.hash_);
+                std::swap(equal_, x.equal_);
+            }
+
+            static size_type bitmap_bytes(const bitmap_type& bitmap) noexcept {
+                const size_type word_bits = sizeof(std::size_t) * 8;
+                return (bitmap.capacity() + word_bits - 1) / word_bits * sizeof(std::size_t);
+            }
+
+            bitmap_type make_bitmap(size_type n) const {
+                return bitmap_type(n, false, typename bitmap_type::allocator_type(allocator_));
+            }
+
+            /// Copies @a bitmap a word at a time, using the map's allocator.
+            bitmap_type copy_bitmap(const bitmap_type& bitmap) const {
+                return bitmap_type(bitmap, typename bitmap_type::allocator_type(allocator_));
+            }
+
+            /// Runs the element destructors, stopping after the last element.
+            void destroy_elements() noexcept {
+                if constexpr (!std::is_trivially_destructible<value_type>::value) {
+                    for (size_type i = 0, left = size_; left != 0; i++) {
+                        if (used_[i]) {
+                            (ptr_begin_ + i)->~value_type();
+                            left--;
+                        }
+                    }
+                }
+            }
+
+            /// Destroys the elements and releases the bucket array.
+            void destroy() noexcept {
+                destroy_elements();
+
+                if (ptr_begin_ != nullptr) {
+                    alloc_traits::deallocate(allocator_, ptr_begin_, capacity_);
+                }
+                ptr_begin_ = nullptr;
+                capacity_ = 0;
+                size_ = 0;
+                used_.clear();
+                deleted_.clear();
+                max_probe_ = 0;
+            }
+        };
+    }
+
     template<typename K, typename T,
         typename Hash = std::hash<K>,
         typename Pred = std::equal_to<K>,
         typename Alloc = allocator<std::pair<const K, T>>>
-        class hash_map
+        class hash_map : public detail::hash_table<K, std::pair<const K, T>, detail::select_first, Hash, Pred, Alloc>
     {
+        using base = detail::hash_table<K, std::pair<const K, T>, detail::select_first, Hash, Pred, Alloc>;
+
     public:
+        friend struct detail::table_access<hash_map>;
+
         using key_type = K;
         using mapped_type = T;
         using hasher = Hash;
@@ -207,22 +1141,123 @@ namespace fefu
         using value_type = std::pair<const key_type, mapped_type>;
         using reference = value_type&;
         using const_reference = const value_type&;
-        using iterator = hash_map_iterator<value_type>;
-        using const_iterator = hash_map_const_iterator<value_type>;
         using size_type = std::size_t;
+        using iterator = typename base::iterator;
+        using const_iterator = typename base::const_iterator;
+
+        // Lookup, erasure, iteration and the bucket interface come from
+        // the engine; these are named here because the members below use them.
+        using base::begin;
+        using base::end;
+        using base::find;
+        using base::contains;
+        using base::clear;
+        using base::rehash;
+        using base::reserve;
+        using base::max_load_factor;
+
+        /**
+         *  @brief  Owns an element taken out of a %hash_map by extract().
+         *
+         *  Buckets are stored inline, so the element cannot keep its address
+         *  the way a node of std::unordered_map does: extract() moves it,
+         *  key included, into the handle, and insert() moves it back into
+         *  a bucket.  Neither the key nor the mapped value is ever copied.
+         */
+        class node_type {
+        public:
+            using key_type = K;
+            using mapped_type = T;
+            using allocator_type = Alloc;
+
+            node_type() noexcept : empty_(true) {}
+
+            node_type(node_type&& other) : empty_(true) {
+                if (!other.empty_) {
+                    construct(other.value());
+                    other.reset();
+                }
+            }
+
+            node_type& operator=(node_type&& other) {
+                if (this != &other) {
+                    reset();
+                    if (!other.empty_) {
+                        construct(other.value());
+                        other.reset();
+                    }
+                }
+
+                return *this;
+            }
+
+            ~node_type() {
+                reset();
+            }
+
+            bool empty() const noexcept {
+                return empty_;
+            }
+
+            explicit operator bool() const noexcept {
+                return !empty_;
+            }
+
+            /// The key, which may be modified before the node is inserted.
+            key_type& key() const noexcept {
+                return const_cast<key_type&>(value().first);
+            }
+
+            mapped_type& mapped() const noexcept {
+                return value().second;
+            }
+
+        private:
+            friend class hash_map;
+
+            typename std::aligned_storage<sizeof(value_type), alignof(value_type)>::type storage_;
+            bool empty_;
+
+            value_type& value() const noexcept {
+                return *reinterpret_cast<value_type*>(const_cast<typename std::aligned_storage<sizeof(value_type), alignof(value_type)>::type*>(&storage_));
+            }
+
+            /// Moves @a x, key included; @a x is destroyed by the caller.
+            void construct(value_type& x) {
+                new (&storage_) value_type(std::piecewise_construct,
+                    std::forward_as_tuple(std::move(const_cast<key_type&>(x.first))),
+                    std::forward_as_tuple(std::move(x.second)));
+                empty_ = false;
+            }
+
+            void reset() noexcept {
+                if (!empty_) {
+                    value().~value_type();
+                    empty_ = true;
+                }
+            }
+        };
+
+        /// Result of inserting a node_type, as for std::unordered_map.
+        struct insert_return_type {
+            iterator position;
+            bool inserted;
+            node_type node;
+        };
 
         /// Default constructor.
-        hash_map() : max_load_factor_(0.5), size_(0), capacity_(0), ptr_begin_(nullptr), used_(0), prime_number_generator_(prime_num_) {};
+        hash_map() {}
 
         /**
          *  @brief  Default constructor creates no elements.
          *  @param n  Minimal initial number of buckets.
+         *
+         *  The number of buckets is rounded up to a prime, so that every
+         *  probe sequence visits all of them.
          */
-        explicit hash_map(size_type n) : max_load_factor_(0.5),
-            used_(n, false), size_(0),
-            capacity_(n),
-            ptr_begin_(allocator_.allocate(n)),
-            prime_number_generator_(prime_num_) {}
+        explicit hash_map(size_type n) : hash_map() {
+            rehash(n);
+        }
 
         /**
          *  @brief  Builds an %hash_map from a range.
@@ -232,78 +1267,43 @@ namespace fefu
          *
          *  Create an %hash_map consisting of copies of the elements from
          *  [first,last).  This is linear in N (where N is
-         *  distance(first,last)).
+         *  distance(first,last)).  For forward iterators the table is sized
+         *  for N elements up front, so it is never rehashed on the way.
          */
         template<typename InputIterator>
         hash_map(InputIterator first, InputIterator last, size_type n = 0) : hash_map(n) {
+            reserve_for_range(first, last, typename std::iterator_traits<InputIterator>::iterator_category());
             insert(first, last);
         }
 
         /// Copy constructor.
-        hash_map(const hash_map& other) {
-            allocator_ = other.allocator_;
-            size_ = other.size_;
-            capacity_ = other.capacity_;
-            max_load_factor_ = other.max_load_factor_;
-            ptr_begin_ = other.ptr_begin_;
-            used_ = other.used_;
-            hash_ = other.hash_;
-            equal_ = other.equal_;
-            prime_number_generator_ = other.prime_number_generator_;
-
-            for (size_type i = 0; i != capacity_; i++) {
-                if (used_[i]) {
-                    new(ptr_begin_ + i) value_type(other.ptr_begin_[i]);
-                }
-            }
-
-        }
+        hash_map(const hash_map& other) : base(other) {}
 
         /// Move constructor.
-        hash_map(hash_map&& other) : hash_map() {
-            swap(other);
-        }
+        hash_map(hash_map&& other) : base(std::move(other)) {}
 
         /**
          *  @brief Creates an %hash_map with no elements.
          *  @param a An allocator object.
          */
-        explicit hash_map(const allocator_type& a) : allocator_(a), max_load_factor_(0.5), size_(0),
-            capacity_(0), ptr_begin_(nullptr), used_(0),
-            prime_number_generator_(prime_num_) {}
+        explicit hash_map(const allocator_type& a) : base(a) {}
 
         /*
         *  @brief Copy constructor with allocator argument.
         * @param  uset  Input %hash_map to copy.
         * @param  a  An allocator object.
         */
-        hash_map(const hash_map& umap,
-            const allocator_type& a) : allocator_(a) {
-            size_ = umap.size_;
-            capacity_ = umap.capacity_;
-            max_load_factor_ = umap.max_load_factor_;
-            ptr_begin_ = allocator_.allocate(umap.capacity_);
-            used_ = umap.used_;
-            hash_ = umap.hash_;
-            equal_ = umap.equal_;
-            prime_number_generator_ = umap.prime_number_generator_;
-
-            for (size_type i = 0; i != capacity_; i++) {
-                if (used_[i]) {
-                    new(ptr_begin_ + i) value_type(umap.ptr_begin_[i]);
-                }
-            }
-        }
+        hash_map(const hash_map& umap, const allocator_type& a) : base(umap, a) {}
 
         /*
         *  @brief  Move constructor with allocator argument.
         *  @param  uset Input %hash_map to move.
         *  @param  a    An allocator object.
+        *
+        *  Steals the buckets of @a umap if its allocator equals @a a, and
+        *  moves the elements one by one into memory from @a a otherwise.
         */
-        hash_map(hash_map&& umap,
-            const allocator_type& a) : hash_map(allocator_) {
-            swap(umap);
-        }
+        hash_map(hash_map&& umap, const allocator_type& a) : base(std::move(umap), a) {}
 
         /**
          *  @brief  Builds an %hash_map from an initializer_list.
@@ -320,13 +1320,13 @@ namespace fefu
 
         /// Copy assignment operator.
         hash_map& operator=(const hash_map& other) {
-            *this = hash_map(other);
+            base::operator=(other);
             return *this;
         }
 
         /// Move assignment operator.
         hash_map& operator=(hash_map&& other) {
-            swap(other);
+            base::operator=(std::move(other));
             return *this;
         }
 
@@ -342,89 +1342,11 @@ namespace fefu
          *  of elements assigned.
          */
         hash_map& operator=(std::initializer_list<value_type> l) {
-            *this = hash_map(l);
+            clear();
+            insert(l);
             return *this;
         }
 
-        ///  Returns the allocator object used by the %hash_map.
-        allocator_type get_allocator() const noexcept {
-            return allocator_;
-        }
-
-        // size and capacity:
-
-        ///  Returns true if the %hash_map is empty.
-        bool empty() const noexcept {
-            return size_ == 0;
-        }
-
-        ///  Returns the size of the %hash_map.
-        size_type size() const noexcept {
-            return size_;
-        }
-
-        ///  Returns the maximum size of the %hash_map.
-        size_type max_size() const noexcept {
-            return std::numeric_limits<size_type>::max();
-        }
-
-        // iterators.
-
-        /**
-         *  Returns a read/write iterator that points to the first element in the
-         *  %hash_map.
-         */
-        iterator begin() noexcept {
-            for (size_t i = 0; i != capacity_; i++) {
-                if (used_[i]) {
-                    return iterator(ptr_begin_ + i, used_);
-                }
-            }
-
-            return iterator(ptr_begin_ + capacity_, used_);
-        }
-
-        //@{
-        /**
-         *  Returns a read-only (constant) iterator that points to the first
-         *  element in the %hash_map.
-         */
-        const_iterator begin() const noexcept {
-            return cbegin();
-        }
-
-        const_iterator cbegin() const noexcept {
-            for (size_t i = 0; i != capacity_; i++) {
-                if (used_[i]) {
-                    return const_iterator(ptr_begin_ + i, used_);
-                }
-            }
-
-            return cend();
-        }
-
-        /**
-         *  Returns a read/write iterator that points one past the last element in
-         *  the %hash_map.
-         */
-        iterator end() noexcept {
-            return iterator(ptr_begin_ + capacity_, used_);
-        }
-
-        //@{
-        /**
-         *  Returns a read-only (constant) iterator that points one past the last
-         *  element in the %hash_map.
-         */
-        const_iterator end() const noexcept {
-            return cend();
-        }
-
-        const_iterator cend() const noexcept {
-            return const_iterator(&ptr_begin_[capacity_], used_);
-        }
-        //@}
-
         // modifiers.
 
         /**
@@ -476,13 +1398,25 @@ namespace fefu
          */
         template <typename... _Args>
         std::pair<iterator, bool> try_emplace(const key_type& k, _Args&&... args) {
+            size_type pos = find_slot(k);
+
+            if (pos != capacity_) {
+                return std::make_pair(make_iterator(pos), false);
+            }
+
             return insert(value_type(std::piecewise_construct, std::forward_as_tuple(k), std::forward_as_tuple(std::forward<_Args>(args)...)));
         }
 
         // move-capable overload
         template <typename... _Args>
         std::pair<iterator, bool> try_emplace(key_type&& k, _Args&&... args) {
-            return insert(value_type(std::piecewise_construct, std::forward_as_tuple(k), std::forward_as_tuple(std::forward<_Args>(args)...)));
+            size_type pos = find_slot(k);
+
+            if (pos != capacity_) {
+                return std::make_pair(make_iterator(pos), false);
+            }
+
+            return insert(value_type(std::piecewise_construct, std::forward_as_tuple(std::move(k)), std::forward_as_tuple(std::forward<_Args>(args)...)));
         }
 
         //@{
@@ -503,51 +1437,52 @@ namespace fefu
         *  Insertion requires amortized constant time.
         */
         std::pair<iterator, bool> insert(const value_type& x) {
-            if (capacity_ == 0) {
-                rehash(capacity_ + 2);
-            }
+            return insert_value(x);
+        }
 
-            if (contains(x.first)) {
-                return make_pair(find(x.first), false);
-            }
+        std::pair<iterator, bool> insert(value_type&& x) {
+            return insert_value(std::move(x));
+        }
 
-            size_t hash_f = hash_first(x.first) % capacity_;
-            size_t hash_s = hash_second(x.first) % capacity_;
+        //@}
 
-            for (size_t i = 0; i != capacity_; i++) {
-                if (!used_[hash_f]) {
-                    used_[hash_f] = true;
-                    size_++;
-                    new (&ptr_begin_[hash_f]) value_type(x);
-                    return std::make_pair(iterator(ptr_begin_ + hash_f, used_), true);
-                }
+        //@{
+        /**
+         *  @brief Attempts to insert the element owned by a node handle.
+         *  @param  nh  A node handle returned by extract(), or an empty one.
+         *
+         *  @return  The position of the element with the key of @a nh, whether
+         *           it was inserted, and @a nh itself if it was not.
+         *
+         *  If the key is already present, @a nh keeps its element and is
+         *  handed back in the result.  Otherwise the element is moved into
+         *  a bucket and @a nh is left empty.
+         */
+        insert_return_type insert(node_type&& nh) {
+            insert_return_type result{ end(), false, node_type() };
 
-                hash_f = (hash_f + i * hash_s) % capacity_;
+            if (nh.empty()) {
+                return result;
             }
 
-            rehash(capacity_ * 2);
-            return std::make_pair(find(x.first), true);
-        }
-
-        std::pair<iterator, bool> insert(value_type&& x) {
-            size_t hash_f = hash_first(x.first) % capacity_;
-            size_t hash_s = hash_second(x.first) % capacity_;
+            size_type pos = find_slot(nh.key());
 
-            for (size_t i = 0; i != capacity_; i++) {
-                if (!used_[hash_f]) {
-                    used_[hash_f] = true;
-                    size_++;
-                    new (&ptr_begin_[hash_f]) value_type(x);
-                    return std::make_pair(iterator(ptr_begin_ + hash_f, used_), true);
-                }
-
-                hash_f = (hash_f + i * hash_s) % capacity_;
+            if (pos != capacity_) {
+                result.position = make_iterator(pos);
+                result.node = std::move(nh);
+                return result;
             }
 
-            rehash(capacity_ * 2);
-            return std::make_pair(find(x.first), true);
+            result.position = insert_moved(nh.value());
+            result.inserted = true;
+            nh.reset();
+            return result;
         }
 
+        /// The hint is ignored: a bucket is found from the key alone.
+        iterator insert(const_iterator, node_type&& nh) {
+            return insert(std::move(nh)).position;
+        }
         //@}
 
         /**
@@ -577,7 +1512,6 @@ namespace fefu
             insert(l.begin(), l.end());
         }
 
-
         /**
          *  @brief Attempts to insert a std::pair into the %hash_map.
          *  @param k    Key to use for finding a possibly existing pair in
@@ -600,123 +1534,27 @@ namespace fefu
          */
         template <typename _Obj>
         std::pair<iterator, bool> insert_or_assign(const key_type& k, _Obj&& obj) {
-            if (!contains((k))) {
-                return insert(std::make_pair(k, std::forward<_Obj>(obj)));
+            iterator position = find(k);
+
+            if (position == end()) {
+                return insert(value_type(k, std::forward<_Obj>(obj)));
             }
 
-            return std::make_pair(find(k), true);
+            position->second = std::forward<_Obj>(obj);
+            return std::make_pair(position, false);
         }
 
         // move-capable overload
         template <typename _Obj>
         std::pair<iterator, bool> insert_or_assign(key_type&& k, _Obj&& obj) {
-            if (!contains((k))) {
-                return insert(std::make_pair(k, std::forward<_Obj>(obj)));
-            }
-
-            return std::make_pair(find(k), true);
-        }
-
-        //@{
-        /**
-         *  @brief Erases an element from an %hash_map.
-         *  @param  position  An iterator pointing to the element to be erased.
-         *  @return An iterator pointing to the element immediately following
-         *          @a position prior to the element being erased. If no such
-         *          element exists, end() is returned.
-         *
-         *  This function erases an element, pointed to by the given iterator,
-         *  from an %hash_map.
-         *  Note that this function only erases the element, and that if the
-         *  element is itself a pointer, the pointed-to memory is not touched in
-         *  any way.  Managing the pointer is the user's responsibility.
-         */
-        iterator erase(const_iterator position) {
-            auto pos = position.ptr_value_ - ptr_begin_;
-
-            if (pos < capacity_ && used_[pos]) {
-                used_[pos] = false;
-                size_--;
-                (ptr_begin_ + pos++)->~value_type();
-
-                return iterator(ptr_begin_ + pos, pos);
-            }
+            iterator position = find(k);
 
-            return end();
-        }
-
-        // LWG 2059.
-        iterator erase(iterator position) {
-            auto pos = position.ptr_value_ - ptr_begin_;
-
-            if (pos < capacity_ && used_[pos]) {
-                used_[pos] = false;
-                size_--;
-                (ptr_begin_ + pos++)->~value_type();
-
-                return iterator(ptr_begin_ + pos, pos);
-            }
-
-            return end();
-        }
-        //@}
-
-        /**
-         *  @brief Erases elements according to the provided key.
-         *  @param  x  Key of element to be erased.
-         *  @return  The number of elements erased.
-         *
-         *  This function erases all the elements located by the given key from
-         *  an %hash_map. For an %hash_map the result of this function
-         *  can only be 0 (not present) or 1 (present).
-         *  Note that this function only erases the element, and that if the
-         *  element is itself a pointer, the pointed-to memory is not touched in
-         *  any way.  Managing the pointer is the user's responsibility.
-         */
-        size_type erase(const key_type& x) {
-            if (contains(x)) {
-                erase(find(x));
-                return 1;
-            }
-
-            return 0;
-        }
-
-        /**
-         *  @brief Erases a [first,last) range of elements from an
-         *  %hash_map.
-         *  @param  first  Iterator pointing to the start of the range to be
-         *                  erased.
-         *  @param last  Iterator pointing to the end of the range to
-         *                be erased.
-         *  @return The iterator @a last.
-         *
-         *  This function erases a sequence of elements from an %hash_map.
-         *  Note that this function only erases the elements, and that if
-         *  the element is itself a pointer, the pointed-to memory is not touched
-         *  in any way.  Managing the pointer is the user's responsibility.
-         */
-        iterator erase(const_iterator first, const_iterator last) {
-            for (const_iterator ptr_element = first; ptr_element != last; ptr_element++) {
-                erase(*ptr_element);
+            if (position == end()) {
+                return insert(value_type(std::move(k), std::forward<_Obj>(obj)));
             }
 
-            return iterator(last.ptr_value_ - ptr_begin_, used_);
-        }
-
-        /**
-         *  Erases all elements in an %hash_map.
-         *  Note that this function only erases the elements, and that if the
-         *  elements themselves are pointers, the pointed-to memory is not touched
-         *  in any way.  Managing the pointer is the user's responsibility.
-         */
-        void clear() noexcept {
-            if (size_ > 0) {
-                erase(begin(), end());
-                used_ = std::vector<bool>(capacity_, false);
-                size_ = 0;
-                prime_number_generator_ = PrimeNumberGenerator(2);
-            }
+            position->second = std::forward<_Obj>(obj);
+            return std::make_pair(position, false);
         }
 
         /**
@@ -725,116 +1563,84 @@ namespace fefu
          *  types.
          *
          *  This exchanges the elements between two %hash_map in constant
-         *  time.
+         *  time.  The allocators are exchanged only if the allocator type
+         *  propagates on swap; otherwise they must compare equal.
          *  Note that the global std::swap() function is specialized such that
          *  std::swap(m1,m2) will feed to this function.
          */
         void swap(hash_map& x) {
-            std::swap(size_, x.size_);
-            std::swap(capacity_, x.capacity_);
-            std::swap(max_load_factor_, x.max_load_factor_);
-            std::swap(ptr_begin_, x.ptr_begin_);
-            std::swap(used_, x.used_);
-            std::swap(hash_, x.hash_);
-            std::swap(equal_, x.equal_);
-            std::swap(allocator_, x.allocator_);
-            std::swap(prime_number_generator_, x.prime_number_generator_);
+            swap_all(x);
+            swap_allocator(x, typename alloc_traits::propagate_on_container_swap());
         }
 
-        template<typename _H2, typename _P2>
-        void merge(hash_map<K, T, _H2, _P2, Alloc>& source) {
-            for (auto i = source.begin(); i != source.end(); i++) {
-                insert(*i);
-            }
-        }
-
-        template<typename _H2, typename _P2>
-        void merge(hash_map<K, T, _H2, _P2, Alloc>&& source) {
-            for (auto i = source.begin(); i != source.end(); i++) {
-                insert(*i);
-            }
-        }
-
-        // observers.
-
-        ///  Returns the hash functor object with which the %hash_map was
-        ///  constructed.
-        Hash hash_function() const {
-            return hash_;
-        }
-
-        ///  Returns the key comparison object with which the %hash_map was
-        ///  constructed.
-        Pred key_eq() const {
-            return equal_;
-        }
-
-        // lookup.
-
         //@{
         /**
-         *  @brief Tries to locate an element in an %hash_map.
-         *  @param  x  Key to be located.
-         *  @return  Iterator pointing to sought-after element, or end() if not
-         *           found.
+         *  @brief Extracts an element from an %hash_map.
+         *  @param  position  An iterator pointing to the element, or the key
+         *                    of the element, to be extracted.
+         *  @return  A node handle owning the element, empty if there is none.
          *
-         *  This function takes a key and tries to locate the element with which
-         *  the key matches.  If successful the function returns an iterator
-         *  pointing to the sought after element.  If unsuccessful it returns the
-         *  past-the-end ( @c end() ) iterator.
+         *  The element is moved out of its bucket, which is then erased.
          */
-        iterator find(const key_type& x) {
-            size_t hash_f = hash_first(x) % capacity_;
-            size_t hash_s = hash_second(x) % capacity_;
+        node_type extract(const_iterator position) {
+            node_type nh;
+            size_type pos = position.ptr_value_ - ptr_begin_;
 
-            for (size_t i = 0; i != capacity_; i++) {
-                if (used_[hash_f] && ptr_begin_[hash_f].first == x) {
-                    return iterator(ptr_begin_ + hash_f, used_);
-                }
-
-                hash_f = (hash_f + i * hash_s) % capacity_;
+            if (pos < capacity_ && used_[pos]) {
+                nh.construct(ptr_begin_[pos]);
+                erase_slot(pos);
             }
 
-            return end(); //TODO
+            return nh;
         }
 
-        const_iterator find(const key_type& x) const {
-            /*size_t hash_f = hash_first(x);
-            size_t hash_s = hash_second(x);
+        node_type extract(const key_type& x) {
+            size_type pos = find_slot(x);
+            node_type nh;
 
-            for (size_t i = 0; i != capacity_; i++) {
-              if (used_[hash_f] && ptr_begin_[hash_f].first == x) {
-                return const_iterator(ptr_begin_ + hash_f, used_);
-              }
-
-              hash_f = (hash_f + i * hash_s) % capacity_;
-            }*/
+            if (pos != capacity_) {
+                nh.construct(ptr_begin_[pos]);
+                erase_slot(pos);
+            }
 
-            return cend();
+            return nh;
         }
         //@}
 
+        //@{
         /**
-         *  @brief  Finds the number of elements.
-         *  @param  x  Key to count.
-         *  @return  Number of elements with specified key.
+         *  @brief Moves the elements of @a source into the %hash_map.
+         *  @param  source  A %hash_map with the same key, mapped value and
+         *                  allocator types.
          *
-         *  This function only makes sense for %unordered_multimap; for
-         *  %hash_map the result will either be 0 (not present) or 1
-         *  (present).
+         *  Each element whose key is not already present is moved, key
+         *  included, out of @a source and erased there; only the elements
+         *  with duplicate keys are left behind.  The table is sized once for
+         *  both maps up front, so merging a large map rehashes at most once.
          */
-        size_type count(const key_type& x) const {
-            return contains(x);
+        template<typename _H2, typename _P2>
+        void merge(hash_map<K, T, _H2, _P2, Alloc>& source) {
+            if (static_cast<const void*>(&source) == this || source.size_ == 0) {
+                return;
+            }
+
+            if (size_ + source.size_ > capacity_ * max_load_factor_) {
+                reserve(size_ + source.size_);
+            }
+
+            for (size_type i = 0; i != source.capacity_; i++) {
+                if (source.used_[i] && find_slot(source.ptr_begin_[i].first) == capacity_) {
+                    insert_moved(source.ptr_begin_[i]);
+                    source.erase_slot(i);
+                }
+            }
         }
 
-        /**
-         *  @brief  Finds whether an element with the given key exists.
-         *  @param  x  Key of elements to be located.
-         *  @return  True if there is any element with the specified key.
-         */
-        bool contains(const key_type& x) const {
-            return find(x) != end();
+        template<typename _H2, typename _P2>
+        void merge(hash_map<K, T, _H2, _P2, Alloc>&& source) {
+            merge(source);
         }
+        //@}
 
         //@{
         /**
@@ -849,9 +1655,13 @@ namespace fefu
          *
          *  Lookup requires constant time.
          */
-        mapped_type& operator[](const key_type& k);
+        mapped_type& operator[](const key_type& k) {
+            return try_emplace(k).first->second;
+        }
 
-        mapped_type& operator[](key_type&& k);
+        mapped_type& operator[](key_type&& k) {
+            return try_emplace(std::move(k)).first->second;
+        }
         //@}
 
         //@{
@@ -863,120 +1673,152 @@ namespace fefu
          *  @throw  std::out_of_range  If no such data is present.
          */
         mapped_type& at(const key_type& k) {
-            if (!contains(k)) {
+            size_type pos = find_slot(k);
+
+            if (pos == capacity_) {
                 throw std::out_of_range("null reference exception: index is out of range");
             }
 
-            return find(k)->second;
+            return ptr_begin_[pos].second;
         }
 
         const mapped_type& at(const key_type& k) const {
-            (*this).at(k);
-        }
-        //@}
+            size_type pos = find_slot(k);
 
-        // bucket interface.
+            if (pos == capacity_) {
+                throw std::out_of_range("null reference exception: index is out of range");
+            }
 
-        /// Returns the number of buckets of the %hash_map.
-        size_type bucket_count() const noexcept {
-            return capacity_;
+            return ptr_begin_[pos].second;
         }
+        //@}
 
-        /*
-        * @brief  Returns the bucket index of a given element.
-        * @param  _K  A key instance.
-        * @return  The key bucket index.
-        */
-        size_type bucket(const key_type& _K) const {
-            if (!contains(_K)) {
-                throw std::invalid_argument("key is not in the hash map");
+        bool operator==(const hash_map& other) const {
+            if (size_ != other.size_) {
+                return false;
             }
 
-            return find(_K)->first;
-        }
-
-        // hash policy.
+            for (auto& element : other) {
+                if (!contains(element.first)) {
+                    return false;
+                }
+            }
 
-        /// Returns the average number of elements per bucket.
-        float load_factor() const noexcept {
-            return size_ == 0 ? 0 : static_cast<float>(static_cast<float>(size_) / capacity_);
+            return true;
         }
 
-        /// Returns a positive number that the %hash_map tries to keep the
-        /// load factor less than or equal to.
-        float max_load_factor() const noexcept {
-            return max_load_factor_;
-        }
+    private:
+        template<typename, typename, typename, typename, typename>
+        friend class hash_map;
 
-        /**
-         *  @brief  Change the %hash_map maximum load factor.
-         *  @param  z The new maximum load factor.
-         */
-        void max_load_factor(float z) {  //TODO maybe it is needed to throw exception when max_load_factor > 100%
-            max_load_factor_ = z;
+        using typename base::alloc_traits;
+        using typename base::bitmap_type;
+        using base::allocator_;
+        using base::size_;
+        using base::capacity_;
+        using base::max_load_factor_;
+        using base::ptr_begin_;
+        using base::used_;
+        using base::deleted_;
+        using base::max_probe_;
+        using base::hash_;
+        using base::equal_;
+        using base::make_iterator;
+        using base::hash_first;
+        using base::hash_second;
+        using base::find_slot;
+        using base::insert_value;
+        using base::insert_unique;
+        using base::erase_slot;
+        using base::reserve_for_range;
+        using base::swap_all;
+        using base::swap_allocator;
+        using base::make_bitmap;
+        using base::destroy;
+
+        /// Moves @a x, key included, into a new bucket; @a x is destroyed by the caller.
+        iterator insert_moved(value_type& x) {
+            return insert_unique(x.first, std::piecewise_construct,
+                std::forward_as_tuple(std::move(const_cast<key_type&>(x.first))),
+                std::forward_as_tuple(std::move(x.second)));
         }
+    };
 
+    namespace detail
+    {
         /**
-         *  @brief  May rehash the %hash_map.
-         *  @param  n The new number of buckets.
-         *
-         *  Rehash will occur only if the new number of buckets respect the
-         *  %hash_map maximum load factor.
+         *  Raw access to the bucket arrays of a %hash_map for the algorithms
+         *  that build or scan tables in bulk (parallel.hpp and friends).
+         *  The caller is responsible for keeping the table consistent.
          */
-        void rehash(size_type n) {
-            *this = hash_map(begin(), end(), n);
+        template<typename K, typename T, typename Hash, typename Pred, typename Alloc>
+        struct table_access<hash_map<K, T, Hash, Pred, Alloc>> {
+            using map_type = hash_map<K, T, Hash, Pred, Alloc>;
+            using key_type = K;
+            using value_type = typename map_type::value_type;
+            using size_type = typename map_type::size_type;
+            using bitmap_type = typename map_type::bitmap_type;
+
+            static value_type* slots(const map_type& map) noexcept {
+                return map.ptr_begin_;
+            }
 
-            auto next_prime = prime_number_generator_.GetNextPrime();
+            static bitmap_type& used(map_type& map) noexcept {
+                return map.used_;
+            }
 
-            if (next_prime < capacity_) {
-                prime_num_ = next_prime;
+            static bitmap_type& deleted(map_type& map) noexcept {
+                return map.deleted_;
             }
-        }
 
-        /**
-         *  @brief  Prepare the %hash_map for a specified number of
-         *          elements.
-         *  @param  n Number of elements required.
-         *
-         *  Same as rehash(ceil(n / max_load_factor())).
-         */
-        void reserve(size_type n) {
-            rehash(ceil(n / max_load_factor()));
-        }
+            static size_type& size(map_type& map) noexcept {
+                return map.size_;
+            }
 
-        bool operator==(const hash_map& other) const {
-            if (size_ != other.size_) {
-                return false;
+            static Alloc& allocator(map_type& map) noexcept {
+                return map.allocator_;
             }
 
-            for (auto& element : other) {
-                if (!contains(element.first)) {
-                    return false;
+            /// Returns the bucket count rehash(n) would pick.
+            static size_type capacity_for(const map_type& map, size_type n) {
+                if (n < map.size_) {
+                    n = map.size_;
                 }
+
+                return n == 0 ? 0 : PrimeNumberGenerator(n).GetNextPrime();
             }
 
-            return true;
-        }
+            /// Computes the start and step of the probe sequence of @a hash.
+            static void probe(const map_type& map, size_t hash, size_type capacity, size_t& pos, size_t& step) {
+                pos = map.hash_first(hash, capacity);
+                step = map.hash_second(hash, capacity);
+            }
 
-    private:
-        allocator_type allocator_;
-        size_type size_;
-        size_type capacity_;
-        float max_load_factor_;
-        value_type* ptr_begin_;
-        std::vector<bool> used_;
-        Hash hash_;
-        key_equal equal_;
-        size_t prime_num_ = 2;
-        PrimeNumberGenerator prime_number_generator_;
+            static size_t hash(const map_type& map, const key_type& key) {
+                return map.hash_(key);
+            }
 
-        size_t hash_first(const key_type& key) {
-            return hash_(key) % capacity_;
-        }
+            /// Returns an all-false bitmap using the map's allocator.
+            static bitmap_type make_bitmap(const map_type& map, size_type n) {
+                return map.make_bitmap(n);
+            }
 
-        size_t hash_second(const key_type& key) {
-            return prime_num_ - hash_(key) % prime_num_;
-        }
-    };
+            /**
+             *  Destroys the current elements and installs a bucket array
+             *  allocated with allocator(map), holding @a size elements.
+             */
+            static void adopt(map_type& map, value_type* slots, size_type capacity, bitmap_type&& used,
+                size_type size, size_type max_probe) {
+                map.destroy();
+
+                map.size_ = size;
+                map.capacity_ = capacity;
+                map.ptr_begin_ = slots;
+                map.used_ = std::move(used);
+                map.deleted_ = map.make_bitmap(capacity);
+                map.max_probe_ = max_probe;
+            }
+        };
+    }
 
 } // namespace fefu
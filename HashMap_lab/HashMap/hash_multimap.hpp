@@ -0,0 +1,520 @@
+#pragma once
+#include <cstddef>
+#include <functional>
+#include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include "hash_map.hpp"
+
+namespace fefu
+{
+    /**
+     *  @brief  A map with equal keys on the %hash_map probing engine.
+     *
+     *  Each distinct key takes one bucket, which holds the key and a run:
+     *  an array with every element of that key, in insertion order.  A
+     *  lookup probes once per key however many elements share it, count()
+     *  is constant time, and equal_range() walks one contiguous array
+     *  instead of chasing a node per element.
+     *
+     *  Elements of one key move together when their run grows, so
+     *  inserting invalidates iterators to elements of the same key, and
+     *  rehashing invalidates all iterators; references to elements of
+     *  other keys stay valid across rehashes.
+     */
+    template<typename K, typename T,
+        typename Hash = std::hash<K>,
+        typename Pred = std::equal_to<K>,
+        typename Alloc = allocator<std::pair<const K, T>>>
+        class hash_multimap;
+
+    namespace detail
+    {
+        /**
+         *  The elements of one %hash_multimap key, back to back.  Growing
+         *  doubles the array; erasing shifts the later elements down, so
+         *  insertion order is kept.
+         */
+        template<typename Value, typename Alloc>
+        class multimap_run {
+            using alloc_traits = std::allocator_traits<Alloc>;
+
+        public:
+            using size_type = std::size_t;
+
+            explicit multimap_run(const Alloc& a) noexcept : allocator_(a), data_(nullptr), size_(0), capacity_(0) {}
+
+            multimap_run(const multimap_run& other)
+                : multimap_run(alloc_traits::select_on_container_copy_construction(other.allocator_)) {
+                if (other.size_ == 0) {
+                    return;
+                }
+
+                data_ = alloc_traits::allocate(allocator_, other.size_);
+                capacity_ = other.size_;
+
+                try {
+                    for (; size_ != other.size_; size_++) {
+                        new (data_ + size_) Value(other.data_[size_]);
+                    }
+                }
+                catch (...) {
+                    destroy();
+                    throw;
+                }
+            }
+
+            multimap_run(multimap_run&& other) noexcept : allocator_(other.allocator_),
+                data_(other.data_), size_(other.size_), capacity_(other.capacity_) {
+                other.data_ = nullptr;
+                other.size_ = 0;
+                other.capacity_ = 0;
+            }
+
+            multimap_run& operator=(const multimap_run&) = delete;
+
+            multimap_run& operator=(multimap_run&&) = delete;
+
+            ~multimap_run() {
+                destroy();
+            }
+
+            Value* data() const noexcept {
+                return data_;
+            }
+
+            size_type size() const noexcept {
+                return size_;
+            }
+
+            size_type capacity() const noexcept {
+                return capacity_;
+            }
+
+            /**
+             *  Appends an element built from @a args.  On growth the new
+             *  element is built before the old ones move, so @a args may
+             *  refer to an element of this run.
+             */
+            template<typename... Args>
+            Value& emplace_back(Args&&... args) {
+                if (size_ != capacity_) {
+                    new (data_ + size_) Value(std::forward<Args>(args)...);
+                    return data_[size_++];
+                }
+
+                size_type new_capacity = capacity_ == 0 ? 1 : capacity_ * 2;
+                Value* new_data = alloc_traits::allocate(allocator_, new_capacity);
+
+                try {
+                    new (new_data + size_) Value(std::forward<Args>(args)...);
+                }
+                catch (...) {
+                    alloc_traits::deallocate(allocator_, new_data, new_capacity);
+                    throw;
+                }
+
+                for (size_type i = 0; i != size_; i++) {
+                    relocate(data_ + i, new_data + i);
+                }
+                if (data_ != nullptr) {
+                    alloc_traits::deallocate(allocator_, data_, capacity_);
+                }
+
+                data_ = new_data;
+                capacity_ = new_capacity;
+                return data_[size_++];
+            }
+
+            /// Removes the element at @a i, keeping the others in order.
+            void erase(size_type i) {
+                data_[i].~Value();
+                for (size_type j = i + 1; j != size_; j++) {
+                    relocate(data_ + j, data_ + j - 1);
+                }
+                size_--;
+            }
+
+        private:
+            Alloc allocator_;
+            Value* data_;
+            size_type size_;
+            size_type capacity_;
+
+            /// Moves *from, key included, into the raw memory at @a to.
+            static void relocate(Value* from, Value* to) {
+                using key_type = typename std::remove_const<typename Value::first_type>::type;
+
+                new (to) Value(std::piecewise_construct,
+                    std::forward_as_tuple(std::move(const_cast<key_type&>(from->first))),
+                    std::forward_as_tuple(std::move(from->second)));
+                from->~Value();
+            }
+
+            void destroy() noexcept {
+                for (size_type i = 0; i != size_; i++) {
+                    data_[i].~Value();
+                }
+                if (data_ != nullptr) {
+                    alloc_traits::deallocate(allocator_, data_, capacity_);
+                }
+                data_ = nullptr;
+                size_ = 0;
+                capacity_ = 0;
+            }
+        };
+
+        template<typename K, typename T, typename Hash, typename Pred, typename Alloc>
+        using multimap_table = hash_table<K,
+            std::pair<const K, multimap_run<std::pair<const K, T>, Alloc>>,
+            select_first, Hash, Pred,
+            typename std::allocator_traits<Alloc>::template rebind_alloc<std::pair<const K, multimap_run<std::pair<const K, T>, Alloc>>>>;
+    }
+
+    template<typename K, typename T, typename Hash, typename Pred, typename Alloc>
+    class hash_multimap : private detail::multimap_table<K, T, Hash, Pred, Alloc>
+    {
+        using base = detail::multimap_table<K, T, Hash, Pred, Alloc>;
+        using run_type = detail::multimap_run<std::pair<const K, T>, Alloc>;
+
+    public:
+        using key_type = K;
+        using mapped_type = T;
+        using hasher = Hash;
+        using key_equal = Pred;
+        using allocator_type = Alloc;
+        using value_type = std::pair<const key_type, mapped_type>;
+        using reference = value_type&;
+        using const_reference = const value_type&;
+        using size_type = std::size_t;
+
+    private:
+        /// Walks the runs bucket by bucket, and each run in order.
+        template<bool Const>
+        class basic_iterator {
+            using slot_iterator = typename std::conditional<Const,
+                typename base::const_iterator, typename base::iterator>::type;
+
+        public:
+            using iterator_category = std::forward_iterator_tag;
+            using value_type = typename hash_multimap::value_type;
+            using difference_type = std::ptrdiff_t;
+            using reference = typename std::conditional<Const, const value_type&, value_type&>::type;
+            using pointer = typename std::conditional<Const, const value_type*, value_type*>::type;
+
+            basic_iterator() noexcept : index_(0) {}
+
+            /// Converts an iterator to a const_iterator.
+            template<bool C = Const, typename = typename std::enable_if<C>::type>
+            basic_iterator(const basic_iterator<false>& other) noexcept : slot_(other.slot_), index_(other.index_) {}
+
+            reference operator*() const {
+                return slot_->second.data()[index_];
+            }
+
+            pointer operator->() const {
+                return slot_->second.data() + index_;
+            }
+
+            basic_iterator& operator++() {
+                if (++index_ == slot_->second.size()) {
+                    ++slot_;
+                    index_ = 0;
+                }
+                return *this;
+            }
+
+            basic_iterator operator++(int) {
+                basic_iterator previous(*this);
+                ++(*this);
+                return previous;
+            }
+
+            friend bool operator==(const basic_iterator& lhs, const basic_iterator& rhs) noexcept {
+                return lhs.slot_ == rhs.slot_ && lhs.index_ == rhs.index_;
+            }
+
+            friend bool operator!=(const basic_iterator& lhs, const basic_iterator& rhs) noexcept {
+                return !(lhs == rhs);
+            }
+
+        private:
+            friend class hash_multimap;
+            friend class basic_iterator<!Const>;
+
+            slot_iterator slot_;
+            size_type index_;
+
+            basic_iterator(slot_iterator slot, size_type index) noexcept : slot_(slot), index_(index) {}
+        };
+
+    public:
+        using iterator = basic_iterator<false>;
+        using const_iterator = basic_iterator<true>;
+
+        /// Default constructor.
+        hash_multimap() : size_(0) {}
+
+        /// Creates an empty map with at least @a n buckets, one per distinct key.
+        explicit hash_multimap(size_type n) : hash_multimap() {
+            base::rehash(n);
+        }
+
+        explicit hash_multimap(const allocator_type& a)
+            : base(typename base::allocator_type(a)), size_(0) {}
+
+        template<typename InputIterator>
+        hash_multimap(InputIterator first, InputIterator last, size_type n = 0) : hash_multimap(n) {
+            insert(first, last);
+        }
+
+        hash_multimap(std::initializer_list<value_type> l, size_type n = 0) : hash_multimap(l.begin(), l.end(), n) {}
+
+        hash_multimap(const hash_multimap& other) : base(other), size_(other.size_) {}
+
+        hash_multimap(hash_multimap&& other) : base(std::move(other)), size_(other.size_) {
+            other.size_ = 0;
+        }
+
+        hash_multimap& operator=(const hash_multimap& other) {
+            if (this != &other) {
+                base::operator=(other);
+                size_ = other.size_;
+            }
+            return *this;
+        }
+
+        hash_multimap& operator=(hash_multimap&& other) {
+            if (this != &other) {
+                base::operator=(std::move(other));
+                size_ = other.size_;
+                other.size_ = 0;
+            }
+            return *this;
+        }
+
+        allocator_type get_allocator() const noexcept {
+            return allocator_type(base::get_allocator());
+        }
+
+        bool empty() const noexcept {
+            return size_ == 0;
+        }
+
+        /// Returns the number of elements.
+        size_type size() const noexcept {
+            return size_;
+        }
+
+        /// Returns the number of distinct keys, each of which takes a bucket.
+        size_type key_count() const noexcept {
+            return base::size();
+        }
+
+        using base::hash_function;
+        using base::key_eq;
+        using base::bucket_count;
+        using base::load_factor;
+        using base::max_load_factor;
+        using base::rehash;
+        using base::reserve;
+        using base::contains;
+
+        /**
+         *  @brief  Reports the memory held by the map.
+         *
+         *  Buckets hold a key and the header of its run; the run arrays
+         *  are counted as heap, capacity included.
+         */
+        memory_footprint memory_usage() const noexcept {
+            memory_footprint footprint = base::memory_usage();
+            footprint.object = sizeof(*this);
+
+            for (const auto& slot : static_cast<const base&>(*this)) {
+                footprint.heap += slot.second.capacity() * sizeof(value_type);
+            }
+            return footprint;
+        }
+
+        //@{
+        iterator begin() noexcept {
+            return iterator(base::begin(), 0);
+        }
+
+        const_iterator begin() const noexcept {
+            return const_iterator(base::cbegin(), 0);
+        }
+
+        const_iterator cbegin() const noexcept {
+            return begin();
+        }
+
+        iterator end() noexcept {
+            return iterator(base::end(), 0);
+        }
+
+        const_iterator end() const noexcept {
+            return const_iterator(base::cend(), 0);
+        }
+
+        const_iterator cend() const noexcept {
+            return end();
+        }
+        //@}
+
+        //@{
+        /// Returns an iterator to the first element inserted with key @a k, or end().
+        iterator find(const key_type& k) {
+            return iterator(base::find(k), 0);
+        }
+
+        const_iterator find(const key_type& k) const {
+            return const_iterator(base::find(k), 0);
+        }
+        //@}
+
+        /// Returns the number of elements with key @a k, in constant time.
+        size_type count(const key_type& k) const {
+            auto slot = base::find(k);
+            return slot == base::cend() ? 0 : slot->second.size();
+        }
+
+        //@{
+        /**
+         *  @brief  Finds the elements with key @a k.
+         *
+         *  They are contiguous and in insertion order; the range ends at
+         *  the first element of the next bucket.
+         */
+        std::pair<iterator, iterator> equal_range(const key_type& k) {
+            auto slot = base::find(k);
+            if (slot == base::end()) {
+                return { end(), end() };
+            }
+            return { iterator(slot, 0), iterator(std::next(slot), 0) };
+        }
+
+        std::pair<const_iterator, const_iterator> equal_range(const key_type& k) const {
+            auto slot = base::find(k);
+            if (slot == base::cend()) {
+                return { end(), end() };
+            }
+            return { const_iterator(slot, 0), const_iterator(std::next(slot), 0) };
+        }
+        //@}
+
+        /**
+         *  @brief  Adds an element built from @a args after those with an equal key.
+         *  @return  An iterator to the new element.
+         */
+        template<typename... Args>
+        iterator emplace(Args&&... args) {
+            value_type x(std::forward<Args>(args)...);
+            auto slot = base::find(x.first);
+
+            bool fresh = slot == base::end();
+            if (fresh) {
+                slot = base::insert_unique(x.first, std::piecewise_construct,
+                    std::forward_as_tuple(x.first), std::forward_as_tuple(allocator_type(base::allocator_)));
+            }
+
+            run_type& run = slot->second;
+            try {
+                run.emplace_back(std::piecewise_construct,
+                    std::forward_as_tuple(std::move(const_cast<key_type&>(x.first))),
+                    std::forward_as_tuple(std::move(x.second)));
+            }
+            catch (...) {
+                // A bucket never holds an empty run.
+                if (fresh) {
+                    base::erase(slot);
+                }
+                throw;
+            }
+            size_++;
+
+            return iterator(slot, run.size() - 1);
+        }
+
+        //@{
+        iterator insert(const value_type& x) {
+            return emplace(x);
+        }
+
+        iterator insert(value_type&& x) {
+            return emplace(std::move(x));
+        }
+
+        template<typename InputIterator>
+        void insert(InputIterator first, InputIterator last) {
+            for (; first != last; ++first) {
+                emplace(*first);
+            }
+        }
+
+        void insert(std::initializer_list<value_type> l) {
+            insert(l.begin(), l.end());
+        }
+        //@}
+
+        //@{
+        /**
+         *  @brief  Erases the element at @a position.
+         *  @return  An iterator to the element after it.
+         *
+         *  Later elements of the same key shift down, so iterators to them
+         *  are invalidated; the returned iterator points at the first.
+         */
+        iterator erase(const_iterator position) {
+            size_type pos = &*position.slot_ - base::ptr_begin_;
+            auto slot = base::make_iterator(pos);
+            run_type& run = slot->second;
+            size_--;
+
+            if (run.size() == 1) {
+                return iterator(base::erase_slot(pos), 0);
+            }
+
+            run.erase(position.index_);
+            if (position.index_ == run.size()) {
+                return iterator(std::next(slot), 0);
+            }
+            return iterator(slot, position.index_);
+        }
+
+        iterator erase(iterator position) {
+            return erase(const_iterator(position));
+        }
+
+        /// Erases every element with key @a k; returns the number erased.
+        size_type erase(const key_type& k) {
+            auto slot = base::find(k);
+            if (slot == base::end()) {
+                return 0;
+            }
+
+            size_type erased = slot->second.size();
+            base::erase(slot);
+            size_ -= erased;
+            return erased;
+        }
+        //@}
+
+        void clear() {
+            base::clear();
+            size_ = 0;
+        }
+
+        void swap(hash_multimap& x) {
+            base::swap_all(x);
+            base::swap_allocator(x, typename base::alloc_traits::propagate_on_container_swap());
+            std::swap(size_, x.size_);
+        }
+
+    private:
+        size_type size_;
+    };
+
+} // namespace fefu
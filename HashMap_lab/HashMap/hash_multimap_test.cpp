@@ -0,0 +1,230 @@
+#include <algorithm>
+#include <cstdint>
+#include <map>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "hash_multimap.hpp"
+#include "../catch.hpp"
+
+TEST_CASE("hash_multimap keeps equal keys together in insertion order", "[hash_multimap]") {
+    fefu::hash_multimap<int, std::string> map;
+    REQUIRE(map.empty());
+    REQUIRE(map.equal_range(1).first == map.end());
+
+    for (int i = 0; i < 1000; i++) {
+        map.emplace(i % 10, std::to_string(i));
+    }
+    REQUIRE(map.size() == 1000);
+    REQUIRE(map.key_count() == 10);
+    REQUIRE(map.count(3) == 100);
+    REQUIRE(map.count(10) == 0);
+
+    auto range = map.equal_range(3);
+    int expected = 3;
+    for (auto it = range.first; it != range.second; ++it, expected += 10) {
+        REQUIRE(it->first == 3);
+        REQUIRE(it->second == std::to_string(expected));
+    }
+    REQUIRE(expected == 1003);
+    REQUIRE(map.find(3)->second == "3");
+
+    SECTION("erasing one element keeps the others in order") {
+        auto next = map.erase(std::next(map.find(3)));
+        REQUIRE(next->second == "23");
+        REQUIRE(map.count(3) == 99);
+        REQUIRE(map.size() == 999);
+
+        auto last = map.equal_range(7).first;
+        std::advance(last, 99);
+        REQUIRE(last->second == "997");
+        REQUIRE(map.erase(last) == map.equal_range(7).second);
+
+        fefu::hash_multimap<int, int> single{ { 1, 1 } };
+        REQUIRE(single.erase(single.begin()) == single.end());
+        REQUIRE(single.empty());
+        REQUIRE(!single.contains(1));
+    }
+    SECTION("erasing a key removes all its elements") {
+        REQUIRE(map.erase(5) == 100);
+        REQUIRE(map.erase(5) == 0);
+        REQUIRE(map.size() == 900);
+        REQUIRE(map.key_count() == 9);
+        REQUIRE(std::distance(map.begin(), map.end()) == 900);
+    }
+    SECTION("copy, move, clear and memory") {
+        auto copy = map;
+        REQUIRE(copy.size() == 1000);
+        REQUIRE(std::equal(copy.begin(), copy.end(), map.begin()));
+
+        fefu::hash_multimap<int, std::string> moved(std::move(copy));
+        REQUIRE(copy.empty());
+        REQUIRE(moved.count(9) == 100);
+        REQUIRE(moved.memory_usage().heap >= 1000 * sizeof(std::pair<const int, std::string>));
+
+        moved.clear();
+        REQUIRE(moved.size() == 0);
+        REQUIRE(moved.begin() == moved.end());
+    }
+}
+
+namespace {
+    struct fragile {
+        static bool throw_on_move;
+        int value;
+
+        fragile(int v) : value(v) {}
+        fragile(const fragile&) = default;
+        fragile(fragile&& other) : value(other.value) {
+            if (throw_on_move) {
+                throw std::runtime_error("fragile move");
+            }
+        }
+    };
+
+    bool fragile::throw_on_move = false;
+}
+
+TEST_CASE("hash_multimap drops a new key when its first element throws", "[hash_multimap]") {
+    fefu::hash_multimap<int, fragile> map;
+    map.emplace(1, 10);
+
+    fragile::throw_on_move = true;
+    REQUIRE_THROWS_AS(map.emplace(2, 20), std::runtime_error);
+    REQUIRE_THROWS_AS(map.emplace(1, 11), std::runtime_error);
+    fragile::throw_on_move = false;
+
+    REQUIRE(map.size() == 1);
+    REQUIRE(map.key_count() == 1);
+    REQUIRE(map.count(2) == 0);
+    REQUIRE(map.equal_range(2).first == map.end());
+    REQUIRE(map.count(1) == 1);
+
+    map.emplace(2, 20);
+    REQUIRE(map.count(2) == 1);
+    REQUIRE(map.equal_range(2).first->second.value == 20);
+}
+
+TEST_CASE("hash_multimap agrees with std::unordered_multimap", "[hash_multimap]") {
+    fefu::hash_multimap<std::uint32_t, std::uint32_t> map;
+    std::unordered_multimap<std::uint32_t, std::uint32_t> reference;
+
+    std::mt19937 generator(16);
+    for (std::uint32_t round = 0; round < 100000; round++) {
+        std::uint32_t key = generator() % 2000;
+        switch (generator() % 8) {
+        case 0:
+            REQUIRE(map.erase(key) == reference.erase(key));
+            break;
+        case 1: {
+            auto it = map.find(key);
+            auto expected = reference.find(key);
+            REQUIRE((it == map.end()) == (expected == reference.end()));
+            if (it != map.end()) {
+                auto range = reference.equal_range(key);
+                reference.erase(std::find(range.first, range.second, *it));
+                map.erase(it);
+            }
+            break;
+        }
+        default:
+            map.emplace(key, round);
+            reference.emplace(key, round);
+        }
+    }
+
+    REQUIRE(map.size() == reference.size());
+    REQUIRE(static_cast<std::size_t>(std::distance(map.begin(), map.end())) == reference.size());
+    for (std::uint32_t key = 0; key < 2000; key++) {
+        REQUIRE(map.count(key) == reference.count(key));
+
+        auto range = map.equal_range(key);
+        std::vector<std::uint32_t> values;
+        for (auto it = range.first; it != range.second; ++it) {
+            values.push_back(it->second);
+        }
+        REQUIRE(std::is_sorted(values.begin(), values.end()));
+
+        auto expected_range = reference.equal_range(key);
+        std::vector<std::uint32_t> expected;
+        for (auto it = expected_range.first; it != expected_range.second; ++it) {
+            expected.push_back(it->second);
+        }
+        std::sort(expected.begin(), expected.end());
+        REQUIRE(values == expected);
+    }
+}
+
+TEST_CASE("Iterating equal_range: std::unordered_multimap versus hash_multimap", "[hash_multimap][!benchmark]") {
+    const std::uint32_t keys = 1 << 15;
+    const std::uint32_t elements = keys * 16;
+
+    std::mt19937 generator(17);
+    std::vector<std::pair<std::uint32_t, std::uint32_t>> input(elements);
+    for (auto& element : input) {
+        element = { generator() % keys * 2654435761u, generator() };
+    }
+    std::vector<std::uint32_t> probes(keys);
+    for (auto& probe : probes) {
+        probe = input[generator() % elements].first;
+    }
+
+    BENCHMARK("std::unordered_multimap build") {
+        std::unordered_multimap<std::uint32_t, std::uint32_t> map;
+        for (const auto& element : input) {
+            map.insert(element);
+        }
+        return map.size();
+    };
+
+    BENCHMARK("hash_multimap build") {
+        fefu::hash_multimap<std::uint32_t, std::uint32_t> map;
+        for (const auto& element : input) {
+            map.insert(element);
+        }
+        return map.size();
+    };
+
+    std::unordered_multimap<std::uint32_t, std::uint32_t> standard(input.begin(), input.end());
+    fefu::hash_multimap<std::uint32_t, std::uint32_t> map(input.begin(), input.end());
+
+    BENCHMARK("std::unordered_multimap equal_range") {
+        std::uint64_t sum = 0;
+        for (std::uint32_t key : probes) {
+            auto range = standard.equal_range(key);
+            for (auto it = range.first; it != range.second; ++it) {
+                sum += it->second;
+            }
+        }
+        return sum;
+    };
+
+    BENCHMARK("hash_multimap equal_range") {
+        std::uint64_t sum = 0;
+        for (std::uint32_t key : probes) {
+            auto range = map.equal_range(key);
+            for (auto it = range.first; it != range.second; ++it) {
+                sum += it->second;
+            }
+        }
+        return sum;
+    };
+
+    BENCHMARK("std::unordered_multimap count") {
+        std::size_t total = 0;
+        for (std::uint32_t key : probes) {
+            total += standard.count(key);
+        }
+        return total;
+    };
+
+    BENCHMARK("hash_multimap count") {
+        std::size_t total = 0;
+        for (std::uint32_t key : probes) {
+            total += map.count(key);
+        }
+        return total;
+    };
+}
@@ -0,0 +1,180 @@
+#pragma once
+#include <cstddef>
+#include <functional>
+#include <initializer_list>
+#include <iterator>
+#include <utility>
+#include "hash_map.hpp"
+
+namespace fefu
+{
+    /**
+     *  @brief  A set of unique keys on the %hash_map probing engine.
+     *
+     *  Buckets hold the bare keys, with no mapped value beside them, and
+     *  are probed exactly as in a %hash_map: prime bucket counts, double
+     *  hashing, and the same growth policy.  Keys cannot be modified in
+     *  place, so iterator and const_iterator are the same type.
+     */
+    template<typename K,
+        typename Hash = std::hash<K>,
+        typename Pred = std::equal_to<K>,
+        typename Alloc = allocator<K>>
+        class hash_set : private detail::hash_table<K, K, detail::identity_key, Hash, Pred, Alloc>
+    {
+        using base = detail::hash_table<K, K, detail::identity_key, Hash, Pred, Alloc>;
+
+    public:
+        using key_type = K;
+        using value_type = K;
+        using hasher = Hash;
+        using key_equal = Pred;
+        using allocator_type = Alloc;
+        using reference = const value_type&;
+        using const_reference = const value_type&;
+        using size_type = std::size_t;
+        using iterator = typename base::const_iterator;
+        using const_iterator = typename base::const_iterator;
+
+        /// Default constructor.
+        hash_set() {}
+
+        /// Creates an empty set with at least @a n buckets.
+        explicit hash_set(size_type n) {
+            base::rehash(n);
+        }
+
+        explicit hash_set(const allocator_type& a) : base(a) {}
+
+        /// Builds a set from [first, last), sized once for forward iterators.
+        template<typename InputIterator>
+        hash_set(InputIterator first, InputIterator last, size_type n = 0) : hash_set(n) {
+            base::reserve_for_range(first, last, typename std::iterator_traits<InputIterator>::iterator_category());
+            insert(first, last);
+        }
+
+        hash_set(std::initializer_list<value_type> l, size_type n = 0) : hash_set(l.begin(), l.end(), n) {}
+
+        hash_set(const hash_set& other) : base(other) {}
+
+        hash_set(hash_set&& other) : base(std::move(other)) {}
+
+        hash_set& operator=(const hash_set& other) {
+            base::operator=(other);
+            return *this;
+        }
+
+        hash_set& operator=(hash_set&& other) {
+            base::operator=(std::move(other));
+            return *this;
+        }
+
+        using base::get_allocator;
+        using base::empty;
+        using base::size;
+        using base::max_size;
+        using base::memory_usage;
+        using base::count;
+        using base::contains;
+        using base::clear;
+        using base::hash_function;
+        using base::key_eq;
+        using base::bucket_count;
+        using base::load_factor;
+        using base::max_load_factor;
+        using base::rehash;
+        using base::reserve;
+
+        //@{
+        iterator begin() const noexcept {
+            return base::cbegin();
+        }
+
+        iterator cbegin() const noexcept {
+            return base::cbegin();
+        }
+
+        iterator end() const noexcept {
+            return base::cend();
+        }
+
+        iterator cend() const noexcept {
+            return base::cend();
+        }
+        //@}
+
+        /// Returns an iterator to @a k, or end().
+        iterator find(const key_type& k) const {
+            return base::find(k);
+        }
+
+        //@{
+        /**
+         *  @brief  Inserts @a k if it is absent.
+         *  @return  A pair of an iterator to the key equal to @a k and a
+         *           bool that is true if @a k was inserted.
+         */
+        std::pair<iterator, bool> insert(const value_type& k) {
+            auto result = base::insert_value(k);
+            return { result.first, result.second };
+        }
+
+        std::pair<iterator, bool> insert(value_type&& k) {
+            auto result = base::insert_value(std::move(k));
+            return { result.first, result.second };
+        }
+        //@}
+
+        /// Builds a key from @a args and inserts it if it is absent.
+        template<typename... Args>
+        std::pair<iterator, bool> emplace(Args&&... args) {
+            return insert(value_type(std::forward<Args>(args)...));
+        }
+
+        template<typename InputIterator>
+        void insert(InputIterator first, InputIterator last) {
+            for (; first != last; ++first) {
+                insert(*first);
+            }
+        }
+
+        void insert(std::initializer_list<value_type> l) {
+            insert(l.begin(), l.end());
+        }
+
+        //@{
+        /// Erases the key at @a position; returns an iterator to the next key.
+        iterator erase(const_iterator position) {
+            return base::erase(position);
+        }
+
+        /// Erases @a k; returns the number of keys erased.
+        size_type erase(const key_type& k) {
+            return base::erase(k);
+        }
+        //@}
+
+        void swap(hash_set& x) {
+            base::swap_all(x);
+            base::swap_allocator(x, typename base::alloc_traits::propagate_on_container_swap());
+        }
+
+        bool operator==(const hash_set& other) const {
+            if (size() != other.size()) {
+                return false;
+            }
+
+            for (const value_type& k : other) {
+                if (!contains(k)) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        bool operator!=(const hash_set& other) const {
+            return !(*this == other);
+        }
+    };
+
+} // namespace fefu
@@ -0,0 +1,153 @@
+#include <cstdint>
+#include <random>
+#include <string>
+#include <unordered_set>
+#include <vector>
+#include "hash_map.hpp"
+#include "hash_set.hpp"
+#include "../catch.hpp"
+
+TEST_CASE("hash_set stores bare keys", "[hash_set]") {
+    fefu::hash_set<std::string> set{ "a", "b", "c" };
+    REQUIRE(set.size() == 3);
+    REQUIRE(set.contains("b"));
+    REQUIRE(!set.contains("d"));
+
+    auto result = set.insert("b");
+    REQUIRE(!result.second);
+    REQUIRE(*result.first == "b");
+    result = set.emplace(3, 'd');
+    REQUIRE(result.second);
+    REQUIRE(*set.find("ddd") == "ddd");
+
+    REQUIRE(set.erase("a") == 1);
+    REQUIRE(set.erase("a") == 0);
+    REQUIRE(set.count("a") == 0);
+
+    fefu::hash_set<int> numbers;
+    fefu::hash_map<int, char> map;
+    for (int i = 0; i < 1000; i++) {
+        numbers.insert(i);
+        map[i] = 0;
+    }
+    REQUIRE(numbers.bucket_count() == map.bucket_count());
+    REQUIRE(numbers.memory_usage().slots == map.bucket_count() * sizeof(int));
+
+    SECTION("copy, move, swap and compare") {
+        auto copy = set;
+        REQUIRE(copy == set);
+        copy.insert("e");
+        REQUIRE(copy != set);
+
+        fefu::hash_set<std::string> moved(std::move(copy));
+        REQUIRE(copy.empty());
+        REQUIRE(moved.size() == 4);
+
+        moved.swap(set);
+        REQUIRE(set.size() == 4);
+        REQUIRE(moved.size() == 3);
+
+        set.clear();
+        REQUIRE(set.begin() == set.end());
+    }
+}
+
+TEST_CASE("hash_set agrees with std::unordered_set", "[hash_set]") {
+    fefu::hash_set<std::uint32_t> set;
+    std::unordered_set<std::uint32_t> reference;
+
+    std::mt19937 generator(14);
+    for (int round = 0; round < 100000; round++) {
+        std::uint32_t key = generator() % 3000;
+        if (generator() % 3 == 0) {
+            REQUIRE(set.erase(key) == reference.erase(key));
+        }
+        else {
+            REQUIRE(set.insert(key).second == reference.insert(key).second);
+        }
+    }
+
+    REQUIRE(set.size() == reference.size());
+    std::size_t visited = 0;
+    for (std::uint32_t key : set) {
+        REQUIRE(reference.count(key) == 1);
+        visited++;
+    }
+    REQUIRE(visited == reference.size());
+
+    for (auto it = set.begin(); it != set.end();) {
+        it = *it % 2 == 0 ? set.erase(it) : ++it;
+    }
+    for (std::uint32_t key : reference) {
+        REQUIRE(set.count(key) == key % 2);
+    }
+}
+
+TEST_CASE("Set membership: hash_map with a dummy value versus hash_set", "[hash_set][!benchmark]") {
+    const std::uint32_t elements = 1 << 20;
+
+    std::mt19937_64 generator(15);
+    std::vector<std::uint64_t> keys(elements);
+    std::vector<std::uint64_t> probes(elements);
+    for (std::uint32_t i = 0; i < elements; i++) {
+        keys[i] = generator();
+        probes[i] = i % 2 == 0 ? keys[generator() % elements] : generator();
+    }
+
+    BENCHMARK("std::unordered_set build") {
+        std::unordered_set<std::uint64_t> set;
+        for (std::uint64_t key : keys) {
+            set.insert(key);
+        }
+        return set.size();
+    };
+
+    BENCHMARK("hash_map<K, bool> build") {
+        fefu::hash_map<std::uint64_t, bool> map;
+        for (std::uint64_t key : keys) {
+            map.emplace(key, true);
+        }
+        return map.size();
+    };
+
+    BENCHMARK("hash_set build") {
+        fefu::hash_set<std::uint64_t> set;
+        for (std::uint64_t key : keys) {
+            set.insert(key);
+        }
+        return set.size();
+    };
+
+    std::unordered_set<std::uint64_t> standard(keys.begin(), keys.end());
+    fefu::hash_map<std::uint64_t, bool> map;
+    fefu::hash_set<std::uint64_t> set(keys.begin(), keys.end());
+    for (std::uint64_t key : keys) {
+        map.emplace(key, true);
+    }
+    WARN("hash_map<K, bool>: " << map.memory_usage().total() / (1 << 20) << " MiB, hash_set: "
+        << set.memory_usage().total() / (1 << 20) << " MiB");
+
+    BENCHMARK("std::unordered_set contains") {
+        std::size_t hits = 0;
+        for (std::uint64_t key : probes) {
+            hits += standard.count(key);
+        }
+        return hits;
+    };
+
+    BENCHMARK("hash_map<K, bool> contains") {
+        std::size_t hits = 0;
+        for (std::uint64_t key : probes) {
+            hits += map.contains(key);
+        }
+        return hits;
+    };
+
+    BENCHMARK("hash_set contains") {
+        std::size_t hits = 0;
+        for (std::uint64_t key : probes) {
+            hits += set.contains(key);
+        }
+        return hits;
+    };
+}
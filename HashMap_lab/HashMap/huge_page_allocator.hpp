@@ -0,0 +1,226 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+namespace fefu
+{
+    /**
+     *  @brief  Page-level allocation backed by 2 MiB pages where possible.
+     *
+     *  allocate() first asks for explicit huge pages (MAP_HUGETLB, or
+     *  MEM_LARGE_PAGES on Windows).  Those need a reserved pool (or the
+     *  SeLockMemoryPrivilege), so when that fails it maps ordinary pages
+     *  aligned to huge_page_size and advises the kernel to back them with
+     *  transparent huge pages (MADV_HUGEPAGE).  Sizes are rounded up to
+     *  whole huge pages.
+     */
+    class huge_pages {
+    public:
+        static constexpr std::size_t huge_page_size = std::size_t(2) << 20;
+
+        /// How a mapping ended up being backed.
+        enum class backing {
+            explicit_huge_pages,
+            transparent_huge_pages,
+            normal_pages
+        };
+
+        /**
+         *  @brief  Maps at least @a bytes of zeroed, huge_page_size-aligned memory.
+         *  @throw  std::bad_alloc  If the system is out of memory.
+         */
+        static void* allocate(std::size_t bytes) {
+            std::size_t size = round_up(bytes);
+            void* p = map_explicit(size);
+
+            if (p != nullptr) {
+                counter(backing::explicit_huge_pages).fetch_add(1, std::memory_order_relaxed);
+                return p;
+            }
+
+            bool advised = false;
+            p = map_aligned(size, advised);
+
+            if (p == nullptr) {
+                throw std::bad_alloc();
+            }
+
+            counter(advised ? backing::transparent_huge_pages : backing::normal_pages).fetch_add(1, std::memory_order_relaxed);
+            return p;
+        }
+
+        /// Unmaps memory from allocate(@a bytes).
+        static void deallocate(void* p, std::size_t bytes) noexcept {
+            if (p == nullptr) {
+                return;
+            }
+#if defined(_WIN32)
+            (void)bytes;
+            VirtualFree(p, 0, MEM_RELEASE);
+#else
+            munmap(p, round_up(bytes));
+#endif
+        }
+
+        /// Returns how many mappings so far were backed by @a b.
+        static std::size_t mappings(backing b) noexcept {
+            return counter(b).load(std::memory_order_relaxed);
+        }
+
+        static std::size_t round_up(std::size_t bytes) noexcept {
+            return (bytes + huge_page_size - 1) & ~(huge_page_size - 1);
+        }
+
+    private:
+        static std::atomic<std::size_t>& counter(backing b) noexcept {
+            static std::atomic<std::size_t> counters[3];
+            return counters[static_cast<int>(b)];
+        }
+
+#if defined(_WIN32)
+        static void* map_explicit(std::size_t size) noexcept {
+            SIZE_T large = GetLargePageMinimum();
+            if (large == 0 || size % large != 0) {
+                return nullptr;
+            }
+            return VirtualAlloc(nullptr, size, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+        }
+
+        // VirtualFree cannot trim part of a reservation, so this reserves a
+        // huge page more than needed, releases it, and maps again at the
+        // aligned address inside it.  Another thread may take that range in
+        // between, hence the retries.
+        static void* map_aligned(std::size_t size, bool& advised) noexcept {
+            advised = false;
+
+            for (int attempt = 0; attempt != 8; attempt++) {
+                void* raw = VirtualAlloc(nullptr, size + huge_page_size, MEM_RESERVE, PAGE_NOACCESS);
+                if (raw == nullptr) {
+                    return nullptr;
+                }
+
+                std::uintptr_t begin = reinterpret_cast<std::uintptr_t>(raw);
+                std::uintptr_t aligned = (begin + huge_page_size - 1) & ~(std::uintptr_t(huge_page_size) - 1);
+                VirtualFree(raw, 0, MEM_RELEASE);
+
+                void* p = VirtualAlloc(reinterpret_cast<void*>(aligned), size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+                if (p != nullptr) {
+                    return p;
+                }
+            }
+            return nullptr;
+        }
+#else
+        static void* map_explicit(std::size_t size) noexcept {
+#if defined(MAP_HUGETLB)
+            void* p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+            return p == MAP_FAILED ? nullptr : p;
+#else
+            (void)size;
+            return nullptr;
+#endif
+        }
+
+        // Over-maps by a huge page and trims both ends to get an aligned region.
+        static void* map_aligned(std::size_t size, bool& advised) noexcept {
+            void* raw = mmap(nullptr, size + huge_page_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (raw == MAP_FAILED) {
+                return nullptr;
+            }
+
+            std::uintptr_t begin = reinterpret_cast<std::uintptr_t>(raw);
+            std::uintptr_t aligned = (begin + huge_page_size - 1) & ~(std::uintptr_t(huge_page_size) - 1);
+
+            if (aligned != begin) {
+                munmap(raw, aligned - begin);
+            }
+            if (aligned + size != begin + size + huge_page_size) {
+                munmap(reinterpret_cast<void*>(aligned + size), begin + huge_page_size - aligned);
+            }
+
+            advised = false;
+#if defined(MADV_HUGEPAGE)
+            advised = madvise(reinterpret_cast<void*>(aligned), size, MADV_HUGEPAGE) == 0;
+#endif
+            return reinterpret_cast<void*>(aligned);
+        }
+#endif
+    };
+
+    /**
+     *  @brief  An allocator putting large arrays on huge pages.
+     *
+     *  Requests of at least Threshold bytes go to huge_pages; smaller ones
+     *  to ::operator new, where a huge page would mostly be wasted.  With
+     *  %hash_map this moves the bucket array of a large table onto 2 MiB
+     *  pages, so random probes miss the TLB far less often.
+     */
+    template<typename T, std::size_t Threshold = huge_pages::huge_page_size>
+    class huge_page_allocator {
+    public:
+        using size_type = std::size_t;
+        using difference_type = std::ptrdiff_t;
+        using pointer = T*;
+        using const_pointer = const T*;
+        using value_type = T;
+        using propagate_on_container_move_assignment = std::true_type;
+        using is_always_equal = std::true_type;
+
+        template<typename U>
+        struct rebind {
+            using other = huge_page_allocator<U, Threshold>;
+        };
+
+        static constexpr std::size_t threshold = Threshold;
+
+        huge_page_allocator() noexcept = default;
+
+        huge_page_allocator(const huge_page_allocator&) noexcept = default;
+
+        template <class U>
+        huge_page_allocator(const huge_page_allocator<U, Threshold>&) noexcept {};
+
+        pointer allocate(size_type n = 1) {
+            std::size_t bytes = n * sizeof(T);
+
+            if (bytes >= Threshold) {
+                return static_cast<pointer>(huge_pages::allocate(bytes));
+            }
+            return static_cast<pointer>(::operator new(bytes));
+        }
+
+        void deallocate(pointer p, size_type n) noexcept {
+            std::size_t bytes = n * sizeof(T);
+
+            if (bytes >= Threshold) {
+                huge_pages::deallocate(p, bytes);
+            }
+            else if (p != nullptr) {
+                ::operator delete(p, bytes);
+            }
+        }
+    };
+
+    template<typename T, typename U, std::size_t Threshold>
+    inline bool operator==(const huge_page_allocator<T, Threshold>&, const huge_page_allocator<U, Threshold>&) noexcept {
+        return true;
+    }
+
+    template<typename T, typename U, std::size_t Threshold>
+    inline bool operator!=(const huge_page_allocator<T, Threshold>&, const huge_page_allocator<U, Threshold>&) noexcept {
+        return false;
+    }
+
+} // namespace fefu
@@ -0,0 +1,161 @@
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+#include "hash_map.hpp"
+#include "huge_page_allocator.hpp"
+#include "../catch.hpp"
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+    // Counts dTLB load misses of the calling thread, where perf events are available.
+    class dtlb_miss_counter {
+    public:
+        dtlb_miss_counter() : fd_(-1) {
+#if defined(__linux__)
+            perf_event_attr attr;
+            std::memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = PERF_TYPE_HW_CACHE;
+            attr.config = PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+            attr.disabled = 1;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            fd_ = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+#endif
+        }
+
+        ~dtlb_miss_counter() {
+#if defined(__linux__)
+            if (fd_ >= 0) {
+                close(fd_);
+            }
+#endif
+        }
+
+        bool available() const noexcept {
+            return fd_ >= 0;
+        }
+
+        void start() {
+#if defined(__linux__)
+            ioctl(fd_, PERF_EVENT_IOC_RESET, 0);
+            ioctl(fd_, PERF_EVENT_IOC_ENABLE, 0);
+#endif
+        }
+
+        std::uint64_t stop() {
+            std::uint64_t count = 0;
+#if defined(__linux__)
+            ioctl(fd_, PERF_EVENT_IOC_DISABLE, 0);
+            if (read(fd_, &count, sizeof(count)) != sizeof(count)) {
+                count = 0;
+            }
+#endif
+            return count;
+        }
+
+    private:
+        int fd_;
+    };
+}
+
+TEST_CASE("huge_page_allocator", "[huge_pages]") {
+    using backing = fefu::huge_pages::backing;
+    std::size_t mappings_before = fefu::huge_pages::mappings(backing::explicit_huge_pages) +
+        fefu::huge_pages::mappings(backing::transparent_huge_pages) + fefu::huge_pages::mappings(backing::normal_pages);
+
+    fefu::huge_page_allocator<std::uint64_t> alloc;
+
+    SECTION("large requests are huge-page aligned") {
+        const std::size_t n = 3 << 17;
+        std::uint64_t* p = alloc.allocate(n);
+        REQUIRE(reinterpret_cast<std::uintptr_t>(p) % fefu::huge_pages::huge_page_size == 0);
+        p[0] = 1;
+        p[n - 1] = 2;
+        REQUIRE(p[n - 1] == 2);
+        alloc.deallocate(p, n);
+
+        std::size_t mappings_after = fefu::huge_pages::mappings(backing::explicit_huge_pages) +
+            fefu::huge_pages::mappings(backing::transparent_huge_pages) + fefu::huge_pages::mappings(backing::normal_pages);
+        REQUIRE(mappings_after == mappings_before + 1);
+    }
+    SECTION("small requests use operator new") {
+        std::uint64_t* p = alloc.allocate(16);
+        p[15] = 3;
+        alloc.deallocate(p, 16);
+
+        std::size_t mappings_after = fefu::huge_pages::mappings(backing::explicit_huge_pages) +
+            fefu::huge_pages::mappings(backing::transparent_huge_pages) + fefu::huge_pages::mappings(backing::normal_pages);
+        REQUIRE(mappings_after == mappings_before);
+    }
+    SECTION("hash_map bucket array") {
+        fefu::hash_map<std::uint64_t, std::uint64_t, std::hash<std::uint64_t>, std::equal_to<std::uint64_t>,
+            fefu::huge_page_allocator<std::pair<const std::uint64_t, std::uint64_t>>> map;
+
+        for (std::uint64_t i = 0; i < 200000; i++) {
+            map[i] = i;
+        }
+
+        REQUIRE(map.size() == 200000);
+        REQUIRE(map.at(123456) == 123456);
+    }
+}
+
+TEST_CASE("Random lookups in a large table with and without huge pages", "[huge_pages][!benchmark]") {
+    const std::size_t elements = std::size_t(1) << 24;
+    const std::size_t lookups = std::size_t(1) << 22;
+
+    std::vector<std::uint64_t> keys(lookups);
+    std::mt19937_64 generator(42);
+    for (auto& key : keys) {
+        key = generator() % elements;
+    }
+
+    auto run = [&](auto& map, const std::string& name) {
+        for (std::uint64_t i = 0; i < elements; i++) {
+            map[i * 0x9E3779B97F4A7C15ull] = i;
+        }
+
+        auto lookup = [&] {
+            std::uint64_t sum = 0;
+            for (std::uint64_t key : keys) {
+                sum += map.find(key * 0x9E3779B97F4A7C15ull)->second;
+            }
+            return sum;
+        };
+
+        dtlb_miss_counter counter;
+        if (counter.available()) {
+            counter.start();
+            lookup();
+            std::uint64_t misses = counter.stop();
+            WARN(name << ": " << static_cast<double>(misses) / lookups << " dTLB load misses per lookup");
+        }
+        else {
+            WARN(name << ": dTLB counters unavailable");
+        }
+
+        BENCHMARK(std::string(name)) {
+            return lookup();
+        };
+    };
+
+    {
+        fefu::hash_map<std::uint64_t, std::uint64_t> map(elements * 2);
+        run(map, "std pages");
+    }
+    {
+        fefu::hash_map<std::uint64_t, std::uint64_t, std::hash<std::uint64_t>, std::equal_to<std::uint64_t>,
+            fefu::huge_page_allocator<std::pair<const std::uint64_t, std::uint64_t>>> map(elements * 2);
+        run(map, "huge pages");
+    }
+}
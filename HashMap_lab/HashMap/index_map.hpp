@@ -0,0 +1,560 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "hash_map.hpp"
+
+namespace fefu
+{
+    /**
+     *  @brief  A %hash_map keeping its elements in insertion order in a
+     *          dense array.
+     *
+     *  The elements live in a vector in insertion order; the hash table
+     *  holds only a 32-bit index into it and 32 bits of the key's hash for
+     *  each bucket.  Iteration is a linear scan of size() elements, and
+     *  the table, at 8 bytes a bucket, is small enough to stay in cache
+     *  long after the elements would not.  Probing is linear over a
+     *  power-of-two table, and erasing shifts the cluster back, so there
+     *  are no tombstones.
+     *
+     *  erase() moves the last element into the hole, which is O(1) but
+     *  changes the order; ordered_erase() keeps the order at O(size()).
+     *  Iterators are random access and yield a pair of references.  Holds
+     *  at most 2^32 - 1 elements.
+     */
+    template<typename K, typename T,
+        typename Hash = std::hash<K>,
+        typename Pred = std::equal_to<K>,
+        typename Alloc = allocator<std::pair<const K, T>>>
+        class index_map
+    {
+    public:
+        using key_type = K;
+        using mapped_type = T;
+        using hasher = Hash;
+        using key_equal = Pred;
+        using allocator_type = Alloc;
+        using value_type = std::pair<const key_type, mapped_type>;
+        using reference = std::pair<const key_type&, mapped_type&>;
+        using const_reference = std::pair<const key_type&, const mapped_type&>;
+        using size_type = std::size_t;
+
+    private:
+        using alloc_traits = std::allocator_traits<Alloc>;
+        using entry = std::pair<K, T>;
+        using entry_vector = std::vector<entry, typename alloc_traits::template rebind_alloc<entry>>;
+
+        /// A bucket: an index into entries_ and the high half of the key's hash.
+        struct bucket {
+            std::uint32_t index;
+            std::uint32_t fingerprint;
+        };
+
+        using bucket_vector = std::vector<bucket, typename alloc_traits::template rebind_alloc<bucket>>;
+
+        static constexpr std::uint32_t empty_index = std::numeric_limits<std::uint32_t>::max();
+
+        template<bool Const>
+        class basic_iterator {
+            using entry_pointer = typename std::conditional<Const, const entry*, entry*>::type;
+
+        public:
+            using iterator_category = std::random_access_iterator_tag;
+            using value_type = index_map::value_type;
+            using difference_type = std::ptrdiff_t;
+            using reference = typename std::conditional<Const, index_map::const_reference, index_map::reference>::type;
+
+            /// Keeps the pair of references alive for operator->.
+            struct pointer {
+                reference ref;
+
+                const reference* operator->() const noexcept {
+                    return &ref;
+                }
+            };
+
+            basic_iterator() noexcept : entry_(nullptr) {}
+
+            template<bool C = Const, typename = typename std::enable_if<C>::type>
+            basic_iterator(const basic_iterator<false>& other) noexcept : entry_(other.entry_) {}
+
+            reference operator*() const {
+                return reference(entry_->first, entry_->second);
+            }
+
+            pointer operator->() const {
+                return pointer{ **this };
+            }
+
+            reference operator[](difference_type n) const {
+                return *(*this + n);
+            }
+
+            basic_iterator& operator++() {
+                ++entry_;
+                return *this;
+            }
+
+            basic_iterator operator++(int) {
+                basic_iterator previous(*this);
+                ++entry_;
+                return previous;
+            }
+
+            basic_iterator& operator--() {
+                --entry_;
+                return *this;
+            }
+
+            basic_iterator operator--(int) {
+                basic_iterator previous(*this);
+                --entry_;
+                return previous;
+            }
+
+            basic_iterator& operator+=(difference_type n) {
+                entry_ += n;
+                return *this;
+            }
+
+            basic_iterator& operator-=(difference_type n) {
+                entry_ -= n;
+                return *this;
+            }
+
+            friend basic_iterator operator+(basic_iterator it, difference_type n) {
+                return it += n;
+            }
+
+            friend basic_iterator operator+(difference_type n, basic_iterator it) {
+                return it += n;
+            }
+
+            friend basic_iterator operator-(basic_iterator it, difference_type n) {
+                return it -= n;
+            }
+
+            friend difference_type operator-(const basic_iterator& lhs, const basic_iterator& rhs) {
+                return lhs.entry_ - rhs.entry_;
+            }
+
+            friend bool operator==(const basic_iterator& lhs, const basic_iterator& rhs) {
+                return lhs.entry_ == rhs.entry_;
+            }
+
+            friend bool operator!=(const basic_iterator& lhs, const basic_iterator& rhs) {
+                return lhs.entry_ != rhs.entry_;
+            }
+
+            friend bool operator<(const basic_iterator& lhs, const basic_iterator& rhs) {
+                return lhs.entry_ < rhs.entry_;
+            }
+
+            friend bool operator>(const basic_iterator& lhs, const basic_iterator& rhs) {
+                return lhs.entry_ > rhs.entry_;
+            }
+
+            friend bool operator<=(const basic_iterator& lhs, const basic_iterator& rhs) {
+                return lhs.entry_ <= rhs.entry_;
+            }
+
+            friend bool operator>=(const basic_iterator& lhs, const basic_iterator& rhs) {
+                return lhs.entry_ >= rhs.entry_;
+            }
+
+        private:
+            friend class index_map;
+            friend class basic_iterator<true>;
+
+            entry_pointer entry_;
+
+            explicit basic_iterator(entry_pointer e) noexcept : entry_(e) {}
+        };
+
+    public:
+        using iterator = basic_iterator<false>;
+        using const_iterator = basic_iterator<true>;
+
+        /// Default constructor.
+        index_map() : index_map(Alloc()) {}
+
+        explicit index_map(const allocator_type& a)
+            : entries_(typename entry_vector::allocator_type(a)), buckets_(typename bucket_vector::allocator_type(a)),
+            mask_(0), hash_(), equal_() {}
+
+        index_map(std::initializer_list<value_type> l, const allocator_type& a = allocator_type()) : index_map(a) {
+            reserve(l.size());
+            for (const value_type& element : l) {
+                insert(element);
+            }
+        }
+
+        allocator_type get_allocator() const noexcept {
+            return allocator_type(entries_.get_allocator());
+        }
+
+        bool empty() const noexcept {
+            return entries_.empty();
+        }
+
+        size_type size() const noexcept {
+            return entries_.size();
+        }
+
+        /// Returns the bytes used by the map; the index table is metadata.
+        memory_footprint memory_usage() const noexcept {
+            memory_footprint footprint;
+            footprint.object = sizeof(*this);
+            footprint.slots = entries_.capacity() * sizeof(entry);
+            footprint.metadata = buckets_.capacity() * sizeof(bucket);
+            return footprint;
+        }
+
+        //@{
+        /// Iterators in insertion order.
+        iterator begin() noexcept {
+            return iterator(entries_.data());
+        }
+
+        const_iterator begin() const noexcept {
+            return const_iterator(entries_.data());
+        }
+
+        const_iterator cbegin() const noexcept {
+            return begin();
+        }
+
+        iterator end() noexcept {
+            return iterator(entries_.data() + entries_.size());
+        }
+
+        const_iterator end() const noexcept {
+            return const_iterator(entries_.data() + entries_.size());
+        }
+
+        const_iterator cend() const noexcept {
+            return end();
+        }
+        //@}
+
+        //@{
+        /// The element at position @a n in iteration order.
+        reference nth(size_type n) {
+            return reference(entries_[n].first, entries_[n].second);
+        }
+
+        const_reference nth(size_type n) const {
+            return const_reference(entries_[n].first, entries_[n].second);
+        }
+        //@}
+
+        /**
+         *  @brief  Appends an element with key @a k and a value constructed
+         *          from @a args if @a k is absent.
+         *  @return  A pair of an iterator to the element with key @a k and a
+         *           bool that is true if the element was inserted.
+         */
+        //@{
+        template<typename... Args>
+        std::pair<iterator, bool> try_emplace(const key_type& k, Args&&... args) {
+            return emplace_key(k, std::forward<Args>(args)...);
+        }
+
+        template<typename... Args>
+        std::pair<iterator, bool> try_emplace(key_type&& k, Args&&... args) {
+            return emplace_key(std::move(k), std::forward<Args>(args)...);
+        }
+        //@}
+
+        std::pair<iterator, bool> insert(const value_type& x) {
+            return emplace_key(x.first, x.second);
+        }
+
+        std::pair<iterator, bool> insert(value_type&& x) {
+            return emplace_key(x.first, std::move(x.second));
+        }
+
+        template<typename Obj>
+        std::pair<iterator, bool> insert_or_assign(const key_type& k, Obj&& obj) {
+            size_type pos = find_bucket(k);
+            if (pos != buckets_.size()) {
+                entry& e = entries_[buckets_[pos].index];
+                e.second = std::forward<Obj>(obj);
+                return { iterator(&e), false };
+            }
+            return emplace_key(k, std::forward<Obj>(obj));
+        }
+
+        mapped_type& operator[](const key_type& k) {
+            return emplace_key(k).first.entry_->second;
+        }
+
+        mapped_type& operator[](key_type&& k) {
+            return emplace_key(std::move(k)).first.entry_->second;
+        }
+
+        //@{
+        /// Returns the value of @a k, or throws std::out_of_range.
+        mapped_type& at(const key_type& k) {
+            size_type pos = find_bucket(k);
+            if (pos == buckets_.size()) {
+                throw std::out_of_range("index_map::at");
+            }
+            return entries_[buckets_[pos].index].second;
+        }
+
+        const mapped_type& at(const key_type& k) const {
+            size_type pos = find_bucket(k);
+            if (pos == buckets_.size()) {
+                throw std::out_of_range("index_map::at");
+            }
+            return entries_[buckets_[pos].index].second;
+        }
+        //@}
+
+        //@{
+        iterator find(const key_type& k) {
+            size_type pos = find_bucket(k);
+            return pos == buckets_.size() ? end() : begin() + buckets_[pos].index;
+        }
+
+        const_iterator find(const key_type& k) const {
+            size_type pos = find_bucket(k);
+            return pos == buckets_.size() ? end() : begin() + buckets_[pos].index;
+        }
+        //@}
+
+        bool contains(const key_type& k) const {
+            return find_bucket(k) != buckets_.size();
+        }
+
+        size_type count(const key_type& k) const {
+            return contains(k) ? 1 : 0;
+        }
+
+        /**
+         *  @brief  Erases the element with key @a k by moving the last
+         *          element into its place.
+         *  @return  The number of elements erased.
+         */
+        size_type erase(const key_type& k) {
+            size_type pos = find_bucket(k);
+            if (pos == buckets_.size()) {
+                return 0;
+            }
+            swap_erase(pos);
+            return 1;
+        }
+
+        /// Erases the element at @a position as erase(key) does; returns an
+        /// iterator to the element moved into its place.
+        iterator erase(const_iterator position) {
+            size_type index = static_cast<size_type>(position - cbegin());
+            swap_erase(find_index(index));
+            return begin() + index;
+        }
+
+        /**
+         *  @brief  Erases the element with key @a k keeping the order of the
+         *          rest; takes time linear in size().
+         *  @return  The number of elements erased.
+         */
+        size_type ordered_erase(const key_type& k) {
+            size_type pos = find_bucket(k);
+            if (pos == buckets_.size()) {
+                return 0;
+            }
+
+            std::uint32_t index = buckets_[pos].index;
+            remove_bucket(pos);
+            entries_.erase(entries_.begin() + index);
+
+            for (bucket& b : buckets_) {
+                if (b.index != empty_index && b.index > index) {
+                    b.index--;
+                }
+            }
+            return 1;
+        }
+
+        /// Erases every element; the capacity is kept.
+        void clear() noexcept {
+            entries_.clear();
+            for (bucket& b : buckets_) {
+                b.index = empty_index;
+            }
+        }
+
+        void swap(index_map& x) noexcept {
+            entries_.swap(x.entries_);
+            buckets_.swap(x.buckets_);
+            std::swap(mask_, x.mask_);
+            std::swap(hash_, x.hash_);
+            std::swap(equal_, x.equal_);
+        }
+
+        size_type bucket_count() const noexcept {
+            return buckets_.size();
+        }
+
+        float load_factor() const noexcept {
+            return buckets_.empty() ? 0 : static_cast<float>(size()) / buckets_.size();
+        }
+
+        /// Always 0.5: the table is only 8 bytes a bucket.
+        float max_load_factor() const noexcept {
+            return 0.5f;
+        }
+
+        /// Makes room for @a n elements without reallocation or rehashing.
+        void reserve(size_type n) {
+            entries_.reserve(n);
+            if (2 * n > buckets_.size()) {
+                rebuild(2 * n);
+            }
+        }
+
+        bool operator==(const index_map& other) const {
+            if (size() != other.size()) {
+                return false;
+            }
+            for (const entry& e : other.entries_) {
+                size_type pos = find_bucket(e.first);
+                if (pos == buckets_.size() || !(entries_[buckets_[pos].index].second == e.second)) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        bool operator!=(const index_map& other) const {
+            return !(*this == other);
+        }
+
+    private:
+        entry_vector entries_;
+        bucket_vector buckets_;
+        size_type mask_;
+        Hash hash_;
+        key_equal equal_;
+
+        static std::uint32_t fingerprint_of(std::uint64_t hash) noexcept {
+            return static_cast<std::uint32_t>(hash >> 32);
+        }
+
+        size_type home_of(std::uint64_t hash) const noexcept {
+            return static_cast<size_type>(hash) & mask_;
+        }
+
+        /// Returns the bucket holding @a k, or buckets_.size() if there is none.
+        size_type find_bucket(const key_type& k) const {
+            if (entries_.empty()) {
+                return buckets_.size();
+            }
+
+            std::uint64_t hash = detail::mix(hash_(k));
+            std::uint32_t fingerprint = fingerprint_of(hash);
+
+            for (size_type pos = home_of(hash);; pos = (pos + 1) & mask_) {
+                const bucket& b = buckets_[pos];
+
+                if (b.index == empty_index) {
+                    return buckets_.size();
+                }
+                if (b.fingerprint == fingerprint && equal_(entries_[b.index].first, k)) {
+                    return pos;
+                }
+            }
+        }
+
+        /// Returns the bucket pointing at entries_[index].
+        size_type find_index(size_type index) const {
+            std::uint64_t hash = detail::mix(hash_(entries_[index].first));
+
+            size_type pos = home_of(hash);
+            while (buckets_[pos].index != index) {
+                pos = (pos + 1) & mask_;
+            }
+            return pos;
+        }
+
+        template<typename KeyArg, typename... Args>
+        std::pair<iterator, bool> emplace_key(KeyArg&& k, Args&&... args) {
+            size_type pos = find_bucket(k);
+            if (pos != buckets_.size()) {
+                return { begin() + buckets_[pos].index, false };
+            }
+
+            if (entries_.size() == empty_index) {
+                throw std::length_error("index_map: too many elements");
+            }
+            if (2 * (entries_.size() + 1) > buckets_.size()) {
+                rebuild(buckets_.empty() ? 8 : 2 * buckets_.size());
+            }
+
+            std::uint64_t hash = detail::mix(hash_(k));
+            entries_.emplace_back(std::piecewise_construct, std::forward_as_tuple(std::forward<KeyArg>(k)),
+                std::forward_as_tuple(std::forward<Args>(args)...));
+
+            pos = home_of(hash);
+            while (buckets_[pos].index != empty_index) {
+                pos = (pos + 1) & mask_;
+            }
+            buckets_[pos] = bucket{ static_cast<std::uint32_t>(entries_.size() - 1), fingerprint_of(hash) };
+
+            return { end() - 1, true };
+        }
+
+        // Empties bucket @a hole, pulling later members of its cluster back.
+        void remove_bucket(size_type hole) {
+            hole = detail::backward_shift(hole, mask_,
+                [this](size_type pos) { return buckets_[pos].index == empty_index; },
+                [this](size_type pos) { return home_of(detail::mix(hash_(entries_[buckets_[pos].index].first))); },
+                [this](size_type from, size_type to) { buckets_[to] = buckets_[from]; });
+            buckets_[hole].index = empty_index;
+        }
+
+        void swap_erase(size_type pos) {
+            std::uint32_t index = buckets_[pos].index;
+            std::uint32_t last = static_cast<std::uint32_t>(entries_.size() - 1);
+
+            remove_bucket(pos);
+            if (index != last) {
+                buckets_[find_index(last)].index = index;
+                entries_[index] = std::move(entries_[last]);
+            }
+            entries_.pop_back();
+        }
+
+        // Rebuilds the table with at least @a n buckets.
+        void rebuild(size_type n) {
+            size_type count = 8;
+            while (count < n) {
+                count *= 2;
+            }
+
+            buckets_.assign(count, bucket{ empty_index, 0 });
+            mask_ = count - 1;
+
+            for (size_type i = 0; i != entries_.size(); i++) {
+                std::uint64_t hash = detail::mix(hash_(entries_[i].first));
+
+                size_type pos = home_of(hash);
+                while (buckets_[pos].index != empty_index) {
+                    pos = (pos + 1) & mask_;
+                }
+                buckets_[pos] = bucket{ static_cast<std::uint32_t>(i), fingerprint_of(hash) };
+            }
+        }
+    };
+
+} // namespace fefu
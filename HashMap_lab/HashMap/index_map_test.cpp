@@ -0,0 +1,143 @@
+#include <cstdint>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "hash_map.hpp"
+#include "index_map.hpp"
+#include "../catch.hpp"
+
+TEST_CASE("index_map keeps insertion order", "[index_map]") {
+    fefu::index_map<std::string, int> map;
+    REQUIRE(map.empty());
+    REQUIRE(map.find("a") == map.end());
+
+    for (int i = 0; i < 100; i++) {
+        REQUIRE(map.try_emplace(std::to_string(i * 7 % 100), i).second);
+    }
+    REQUIRE_FALSE(map.insert({ "0", 5 }).second);
+    REQUIRE(map.size() == 100);
+
+    int i = 0;
+    for (auto element : map) {
+        REQUIRE(element.first == std::to_string(i * 7 % 100));
+        REQUIRE(element.second == i++);
+    }
+    REQUIRE(map.find("49") - map.begin() == 7);
+    REQUIRE(map.nth(7).first == "49");
+    REQUIRE(map.at("49") == 7);
+    REQUIRE_THROWS_AS(map.at("100"), std::out_of_range);
+
+    SECTION("ordered_erase keeps the order") {
+        REQUIRE(map.ordered_erase("7") == 1);
+        REQUIRE(map.ordered_erase("7") == 0);
+        REQUIRE(map.size() == 99);
+        REQUIRE(map.nth(0).first == "0");
+        REQUIRE(map.nth(1).first == "14");
+        REQUIRE(map.at("14") == 2);
+        REQUIRE(map.find("14") - map.begin() == 1);
+    }
+    SECTION("erase moves the last element into the hole") {
+        REQUIRE(map.erase("7") == 1);
+        REQUIRE(map.nth(1).first == std::to_string(99 * 7 % 100));
+        REQUIRE(map.find(std::to_string(99 * 7 % 100)) - map.begin() == 1);
+
+        auto it = map.erase(map.find("0"));
+        REQUIRE(it == map.begin());
+        REQUIRE(map.size() == 98);
+        REQUIRE(map.nth(0).second == 98);
+    }
+    SECTION("copy, equality and clear") {
+        auto copy = map;
+        REQUIRE(copy == map);
+        copy["x"] = 1;
+        REQUIRE(copy != map);
+
+        map.clear();
+        REQUIRE(map.begin() == map.end());
+        REQUIRE_FALSE(map.contains("1"));
+        map["1"] = 1;
+        REQUIRE(map.size() == 1);
+    }
+}
+
+TEST_CASE("index_map agrees with std::unordered_map", "[index_map]") {
+    fefu::index_map<std::uint32_t, std::uint32_t> map;
+    std::unordered_map<std::uint32_t, std::uint32_t> reference;
+
+    std::mt19937 generator(6);
+    for (int round = 0; round < 100000; round++) {
+        std::uint32_t key = generator() % 3000;
+        switch (generator() % 4) {
+        case 0:
+            REQUIRE(map.erase(key) == reference.erase(key));
+            break;
+        case 1:
+            REQUIRE(map.ordered_erase(key) == reference.erase(key));
+            break;
+        default:
+            map[key] += round;
+            reference[key] += round;
+        }
+    }
+
+    REQUIRE(map.size() == reference.size());
+    for (auto element : map) {
+        REQUIRE(reference.at(element.first) == element.second);
+    }
+}
+
+TEST_CASE("Iteration and lookups: hash_map versus index_map", "[index_map][!benchmark]") {
+    const std::uint64_t elements = 1 << 20;
+    const std::uint64_t lookups = 1 << 22;
+
+    std::mt19937_64 generator(8);
+    std::vector<std::uint64_t> keys(elements);
+    fefu::hash_map<std::uint64_t, std::uint64_t> map;
+    fefu::index_map<std::uint64_t, std::uint64_t> index;
+    for (std::uint64_t i = 0; i < elements; i++) {
+        keys[i] = generator();
+        map[keys[i]] = i;
+        index[keys[i]] = i;
+    }
+
+    std::vector<std::uint64_t> probes(lookups);
+    for (auto& probe : probes) {
+        probe = keys[generator() % elements];
+    }
+
+    WARN("hash_map: " << map.memory_usage().total() / (1 << 20) << " MiB, index_map: "
+        << index.memory_usage().total() / (1 << 20) << " MiB");
+
+    BENCHMARK("hash_map iteration") {
+        std::uint64_t sum = 0;
+        for (const auto& element : map) {
+            sum += element.second;
+        }
+        return sum;
+    };
+
+    BENCHMARK("index_map iteration") {
+        std::uint64_t sum = 0;
+        for (auto element : index) {
+            sum += element.second;
+        }
+        return sum;
+    };
+
+    BENCHMARK("hash_map find") {
+        std::uint64_t sum = 0;
+        for (std::uint64_t key : probes) {
+            sum += map.find(key)->second;
+        }
+        return sum;
+    };
+
+    BENCHMARK("index_map find") {
+        std::uint64_t sum = 0;
+        for (std::uint64_t key : probes) {
+            sum += index.find(key)->second;
+        }
+        return sum;
+    };
+}
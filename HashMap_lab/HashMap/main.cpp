@@ -1,4 +1,8 @@
-﻿#include <iostream>
+﻿#include <cstdint>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
 #include "hash_map.hpp"
 #define CATCH_CONFIG_MAIN
 #include "../catch.hpp"
@@ -50,6 +54,17 @@ TEST_CASE("constructors", "[hash_map]") {
     }
 }
 
+TEST_CASE("range constructor sizes the table once", "[hash_map]") {
+    std::vector<std::pair<const int, int>> input;
+    for (int i = 0; i < 1000; i++) {
+        input.emplace_back(i, i);
+    }
+
+    fefu::hash_map<int, int> map(input.begin(), input.end());
+    REQUIRE(map.size() == 1000);
+    REQUIRE(map.bucket_count() >= 2000);
+}
+
 TEST_CASE("insert an element", "[hash_map]") {
     {
         fefu::hash_map<int, int> hm(13);
@@ -61,3 +76,269 @@ TEST_CASE("insert an element", "[hash_map]") {
         REQUIRE(hm.size() == 1);
     }
 }
+
+TEST_CASE("lookup after erase and rehash", "[hash_map]") {
+    fefu::hash_map<int, int> hm;
+    for (int i = 0; i < 1000; i++) {
+        hm[i] = i * 2;
+    }
+
+    REQUIRE(hm.size() == 1000);
+    REQUIRE(hm.at(999) == 1998);
+
+    for (int i = 0; i < 1000; i += 2) {
+        REQUIRE(hm.erase(i) == 1);
+    }
+
+    REQUIRE(hm.size() == 500);
+    REQUIRE(hm.contains(2) == false);
+    REQUIRE(hm.contains(3) == true);
+
+    hm.rehash(4000);
+    REQUIRE(hm.bucket_count() >= 4000);
+    REQUIRE(hm.at(501) == 1002);
+
+    size_t visited = 0;
+    for (auto& element : hm) {
+        REQUIRE(element.first % 2 == 1);
+        visited++;
+    }
+    REQUIRE(visited == 500);
+}
+
+TEST_CASE("copies are independent", "[hash_map]") {
+    fefu::hash_map<int, std::string> hm({ {1, "one"}, {2, "two"} });
+    fefu::hash_map<int, std::string> copy(hm);
+    const fefu::hash_map<int, std::string>& const_copy = copy;
+
+    copy[1] = "uno";
+    REQUIRE(hm.at(1) == "one");
+    REQUIRE(const_copy.at(1) == "uno");
+    REQUIRE(const_copy.find(2)->second == "two");
+    REQUIRE(const_copy.find(3) == const_copy.end());
+
+    hm = copy;
+    REQUIRE(hm == copy);
+}
+
+namespace
+{
+    // Copying throws once copies_left reaches zero; the move may throw, so rehash copies.
+    struct fragile {
+        static int copies_left;
+        int value;
+
+        explicit fragile(int v) : value(v) {}
+        fragile(const fragile& other) : value(other.value) {
+            if (copies_left-- == 0) {
+                throw std::runtime_error("copy failed");
+            }
+        }
+        fragile(fragile&& other) noexcept(false) : value(other.value) {}
+    };
+
+    int fragile::copies_left = 0;
+}
+
+TEST_CASE("rehash keeps the map when a copy throws", "[hash_map]") {
+    fefu::hash_map<int, fragile> hm;
+    fragile::copies_left = 1000;
+    for (int i = 0; i < 100; i++) {
+        hm.try_emplace(i, i);
+    }
+    std::size_t buckets = hm.bucket_count();
+
+    fragile::copies_left = 50;
+    REQUIRE_THROWS_AS(hm.rehash(4 * buckets), std::runtime_error);
+    REQUIRE(hm.bucket_count() == buckets);
+    REQUIRE(hm.size() == 100);
+    for (int i = 0; i < 100; i++) {
+        REQUIRE(hm.at(i).value == i);
+    }
+}
+
+namespace
+{
+    // Counts copies, so the tests can tell a move from a copy.
+    struct tracked {
+        static int copies;
+        std::string text;
+
+        tracked(const char* s = "") : text(s) {}
+        tracked(const tracked& other) : text(other.text) { copies++; }
+        tracked(tracked&&) = default;
+        tracked& operator=(const tracked& other) { text = other.text; copies++; return *this; }
+        tracked& operator=(tracked&&) = default;
+    };
+
+    int tracked::copies = 0;
+}
+
+TEST_CASE("extract and insert node handles", "[hash_map]") {
+    fefu::hash_map<std::string, tracked> hm;
+    hm.try_emplace("one", "1");
+    hm.try_emplace("two", "2");
+    tracked::copies = 0;
+
+    auto node = hm.extract("one");
+    REQUIRE_FALSE(node.empty());
+    REQUIRE(node.key() == "one");
+    REQUIRE(node.mapped().text == "1");
+    REQUIRE(hm.size() == 1);
+    REQUIRE_FALSE(hm.contains("one"));
+    REQUIRE(hm.extract("one").empty());
+
+    node.key() = "two";
+    auto result = hm.insert(std::move(node));
+    REQUIRE_FALSE(result.inserted);
+    REQUIRE(result.position->second.text == "2");
+    REQUIRE(result.node.mapped().text == "1");
+
+    result.node.key() = "three";
+    auto again = hm.insert(std::move(result.node));
+    REQUIRE(again.inserted);
+    REQUIRE(again.node.empty());
+    REQUIRE(hm.at("three").text == "1");
+
+    auto from_iterator = hm.extract(hm.find("two"));
+    REQUIRE(from_iterator.mapped().text == "2");
+    REQUIRE(hm.size() == 1);
+    REQUIRE(hm.insert(std::move(fefu::hash_map<std::string, tracked>::node_type())).position == hm.end());
+    REQUIRE(tracked::copies == 0);
+}
+
+TEST_CASE("merge moves elements and leaves duplicates", "[hash_map]") {
+    fefu::hash_map<int, tracked> target;
+    fefu::hash_map<int, tracked> source;
+    for (int i = 0; i < 1000; i++) {
+        target.try_emplace(i, "target");
+        source.try_emplace(i + 500, "source");
+    }
+    tracked::copies = 0;
+
+    target.merge(source);
+    REQUIRE(tracked::copies == 0);
+    REQUIRE(target.size() == 1500);
+    REQUIRE(source.size() == 500);
+    for (int i = 0; i < 1500; i++) {
+        REQUIRE(target.at(i).text == (i < 1000 ? "target" : "source"));
+    }
+    for (auto& element : source) {
+        REQUIRE(element.first >= 500);
+        REQUIRE(element.first < 1000);
+        REQUIRE(element.second.text == "source");
+    }
+
+    target.merge(target);
+    REQUIRE(target.size() == 1500);
+
+    fefu::hash_map<int, tracked> empty;
+    empty.merge(std::move(target));
+    REQUIRE(empty.size() == 1500);
+    REQUIRE(target.empty());
+}
+
+TEST_CASE("Merging maps with heavy values", "[hash_map][!benchmark]") {
+    // Two 10M-entry maps of vectors need more memory than a test run should
+    // take; the copy-versus-move gap per element does not depend on the size.
+    const int elements = 1 << 19;
+    using heavy = std::vector<int>;
+
+    auto make = [&](int first) {
+        fefu::hash_map<int, heavy> hm;
+        for (int i = first; i < first + elements; i++) {
+            hm.try_emplace(i, 256, i);
+        }
+        return hm;
+    };
+
+    BENCHMARK_ADVANCED("copy every element with insert")(Catch::Benchmark::Chronometer meter) {
+        auto target = make(0);
+        auto source = make(elements / 2);
+        meter.measure([&] {
+            for (auto& element : source) {
+                target.insert(element);
+            }
+            return target.size();
+        });
+    };
+
+    BENCHMARK_ADVANCED("merge")(Catch::Benchmark::Chronometer meter) {
+        auto target = make(0);
+        auto source = make(elements / 2);
+        meter.measure([&] {
+            target.merge(source);
+            return target.size();
+        });
+    };
+}
+
+TEST_CASE("clear keeps the buckets", "[hash_map]") {
+    fefu::hash_map<int, int> numbers;
+    fefu::hash_map<int, std::string> strings;
+    for (int i = 0; i < 1000; i++) {
+        numbers[i] = i;
+        strings[i] = std::string(40, 'x');
+    }
+    for (int i = 0; i < 1000; i += 3) {
+        numbers.erase(i);
+        strings.erase(i);
+    }
+    std::size_t buckets = numbers.bucket_count();
+
+    fefu::hash_map<int, int> numbers_copy(numbers);
+    fefu::hash_map<int, std::string> strings_copy(strings);
+    REQUIRE(numbers_copy == numbers);
+    REQUIRE(strings_copy == strings);
+    REQUIRE(numbers_copy.at(1) == 1);
+    REQUIRE_FALSE(numbers_copy.contains(3));
+
+    numbers.clear();
+    strings.clear();
+    REQUIRE(numbers.empty());
+    REQUIRE(strings.empty());
+    REQUIRE(numbers.bucket_count() == buckets);
+    REQUIRE(numbers.begin() == numbers.end());
+    REQUIRE(strings.begin() == strings.end());
+    REQUIRE_FALSE(numbers.contains(1));
+
+    numbers[7] = 7;
+    strings[7] = "seven";
+    REQUIRE(numbers.size() == 1);
+    REQUIRE(strings.at(7) == "seven");
+    REQUIRE(numbers_copy.size() == 666);
+    REQUIRE(strings_copy.at(2) == std::string(40, 'x'));
+}
+
+TEST_CASE("Per-request scratch maps", "[hash_map][!benchmark]") {
+    // Each request fills a scratch map with a few hundred entries and clears
+    // it; the table stays sized for the largest request seen so far.
+    const int requests = 1000;
+    const int largest = 1 << 16;
+    const int typical = 200;
+
+    fefu::hash_map<std::uint64_t, std::uint64_t> scratch;
+    scratch.reserve(largest);
+
+    BENCHMARK("fill and clear") {
+        std::uint64_t sum = 0;
+        for (int request = 0; request < requests; request++) {
+            for (int i = 0; i < typical; i++) {
+                scratch[static_cast<std::uint64_t>(request) * 7919 + i] = i;
+            }
+            sum += scratch.size();
+            scratch.clear();
+        }
+        return sum;
+    };
+
+    fefu::hash_map<std::uint64_t, std::uint64_t> table;
+    for (int i = 0; i < largest; i++) {
+        table[static_cast<std::uint64_t>(i) * 0x9E3779B97F4A7C15ULL] = i;
+    }
+
+    BENCHMARK("copy a 64K-entry table") {
+        fefu::hash_map<std::uint64_t, std::uint64_t> copy(table);
+        return copy.size();
+    };
+}
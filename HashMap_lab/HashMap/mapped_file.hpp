@@ -0,0 +1,208 @@
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace fefu
+{
+    namespace detail
+    {
+        /// A file mapped into memory in its entirety.
+        class mapped_file {
+        public:
+            mapped_file() noexcept = default;
+
+            mapped_file(const mapped_file&) = delete;
+            mapped_file& operator=(const mapped_file&) = delete;
+
+            ~mapped_file() {
+                close();
+            }
+
+            /**
+             *  @brief  Maps @a path, creating or extending it to @a min_size bytes.
+             *
+             *  An empty file is opened but not mapped.
+             *  @throw  std::runtime_error  If the file cannot be opened or mapped.
+             */
+            void open(const std::string& path, std::uint64_t min_size) {
+                map(path, min_size, false);
+            }
+
+            /**
+             *  @brief  Maps the existing file @a path read-only.
+             *  @throw  std::runtime_error  If the file cannot be opened or mapped.
+             */
+            void open_read_only(const std::string& path) {
+                map(path, 0, true);
+            }
+
+            /// Writes [offset, offset + length) back to the file and waits for the disk.
+            void sync(std::uint64_t offset, std::uint64_t length) {
+                if (data_ == nullptr || length == 0) {
+                    return;
+                }
+#if defined(_WIN32)
+                if (!FlushViewOfFile(data_ + offset, static_cast<SIZE_T>(length)) || !FlushFileBuffers(file_)) {
+                    throw std::runtime_error("mapped_file: flush failed");
+                }
+#else
+                std::uint64_t page = static_cast<std::uint64_t>(sysconf(_SC_PAGESIZE));
+                std::uint64_t first = offset / page * page;
+
+                if (msync(data_ + first, offset + length - first, MS_SYNC) != 0) {
+                    throw std::runtime_error("mapped_file: msync failed");
+                }
+#endif
+            }
+
+            /// Tells the kernel not to read ahead around faulting pages.
+            void advise_random(std::uint64_t offset, std::uint64_t length) noexcept {
+#if defined(POSIX_MADV_RANDOM)
+                std::uint64_t page = static_cast<std::uint64_t>(sysconf(_SC_PAGESIZE));
+                std::uint64_t first = offset / page * page;
+                posix_madvise(data_ + first, offset + length - first, POSIX_MADV_RANDOM);
+#else
+                (void)offset;
+                (void)length;
+#endif
+            }
+
+            void close() noexcept {
+#if defined(_WIN32)
+                if (data_ != nullptr) {
+                    UnmapViewOfFile(data_);
+                }
+                if (mapping_ != nullptr) {
+                    CloseHandle(mapping_);
+                }
+                if (file_ != INVALID_HANDLE_VALUE) {
+                    CloseHandle(file_);
+                }
+                mapping_ = nullptr;
+                file_ = INVALID_HANDLE_VALUE;
+#else
+                if (data_ != nullptr) {
+                    munmap(data_, size_);
+                }
+                if (fd_ >= 0) {
+                    ::close(fd_);
+                }
+                fd_ = -1;
+#endif
+                data_ = nullptr;
+                size_ = 0;
+            }
+
+            char* data() const noexcept {
+                return data_;
+            }
+
+            std::uint64_t size() const noexcept {
+                return size_;
+            }
+
+            /// Atomically replaces @a to with @a from.
+            static void replace(const std::string& from, const std::string& to) {
+#if defined(_WIN32)
+                bool done = MoveFileExA(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+                bool done = std::rename(from.c_str(), to.c_str()) == 0;
+#endif
+                if (!done) {
+                    throw std::runtime_error("mapped_file: cannot replace " + to);
+                }
+            }
+
+        private:
+#if defined(_WIN32)
+            HANDLE file_ = INVALID_HANDLE_VALUE;
+            HANDLE mapping_ = nullptr;
+#else
+            int fd_ = -1;
+#endif
+            char* data_ = nullptr;
+            std::uint64_t size_ = 0;
+
+            void map(const std::string& path, std::uint64_t min_size, bool read_only) {
+                close();
+#if defined(_WIN32)
+                file_ = CreateFileA(path.c_str(), read_only ? GENERIC_READ : GENERIC_READ | GENERIC_WRITE,
+                    read_only ? FILE_SHARE_READ : 0, nullptr, read_only ? OPEN_EXISTING : OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+                if (file_ == INVALID_HANDLE_VALUE) {
+                    fail("cannot open ", path);
+                }
+
+                LARGE_INTEGER size;
+                GetFileSizeEx(file_, &size);
+                size_ = static_cast<std::uint64_t>(size.QuadPart);
+
+                if (size_ < min_size) {
+                    size_ = min_size;
+                }
+                if (size_ == 0) {
+                    return;
+                }
+
+                mapping_ = CreateFileMappingA(file_, nullptr, read_only ? PAGE_READONLY : PAGE_READWRITE,
+                    static_cast<DWORD>(size_ >> 32), static_cast<DWORD>(size_), nullptr);
+                if (mapping_ == nullptr) {
+                    fail("cannot map ", path);
+                }
+
+                data_ = static_cast<char*>(MapViewOfFile(mapping_, read_only ? FILE_MAP_READ : FILE_MAP_ALL_ACCESS, 0, 0, 0));
+                if (data_ == nullptr) {
+                    fail("cannot map ", path);
+                }
+#else
+                fd_ = read_only ? ::open(path.c_str(), O_RDONLY) : ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+                if (fd_ < 0) {
+                    fail("cannot open ", path);
+                }
+
+                struct stat st;
+                if (fstat(fd_, &st) != 0) {
+                    fail("cannot stat ", path);
+                }
+                size_ = static_cast<std::uint64_t>(st.st_size);
+
+                if (size_ < min_size) {
+                    if (ftruncate(fd_, static_cast<off_t>(min_size)) != 0) {
+                        fail("cannot resize ", path);
+                    }
+                    size_ = min_size;
+                }
+
+                if (size_ == 0) {
+                    return;
+                }
+
+                void* p = mmap(nullptr, size_, read_only ? PROT_READ : PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+                if (p == MAP_FAILED) {
+                    fail("cannot map ", path);
+                }
+                data_ = static_cast<char*>(p);
+#endif
+            }
+
+            [[noreturn]] void fail(const char* what, const std::string& path) {
+                close();
+                throw std::runtime_error(std::string("mapped_file: ") + what + path);
+            }
+        };
+    } // namespace detail
+
+} // namespace fefu
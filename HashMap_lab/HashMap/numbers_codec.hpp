@@ -0,0 +1,36 @@
+#pragma once
+#include "../../ComplexNumbers_lab/Numbers/complex.h"
+#include "../../ComplexNumbers_lab/Numbers/rational.h"
+#include "serialization.hpp"
+
+namespace fefu
+{
+    /// Rationals as a zigzag numerator and a varint denominator.
+    template<>
+    struct codec<Rational> {
+        void write(byte_writer& out, const Rational& value) const {
+            out.varint(zigzag(value.Numerator()));
+            out.varint(static_cast<std::uint64_t>(value.Denominator()));
+        }
+
+        Rational read(byte_reader& in) const {
+            std::int64_t numerator = unzigzag(in.varint());
+            return Rational(numerator, static_cast<std::int64_t>(in.varint()));
+        }
+    };
+
+    /// Complex numbers as their real and imaginary rationals.
+    template<>
+    struct codec<Complex> {
+        void write(byte_writer& out, const Complex& value) const {
+            codec<Rational>().write(out, value.GetRealPart());
+            codec<Rational>().write(out, value.GetImaginaryPart());
+        }
+
+        Complex read(byte_reader& in) const {
+            Rational real = codec<Rational>().read(in);
+            return Complex(real, codec<Rational>().read(in));
+        }
+    };
+
+} // namespace fefu
@@ -0,0 +1,498 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+#include "hash_map.hpp"
+#include "thread_pool.hpp"
+
+namespace fefu
+{
+    /**
+     *  @brief  A cursor over the elements stored in a range of buckets.
+     *
+     *  Ranges handed out by the parallel algorithms start and end on
+     *  multiples of @a alignment, so two ranges never share a word of the
+     *  map's occupancy bitmaps and can be modified concurrently.
+     */
+    template<typename Map>
+    class slot_range {
+    public:
+        using size_type = typename Map::size_type;
+        using value_type = typename Map::value_type;
+        using iterator = decltype(std::declval<Map&>().begin());
+
+        static constexpr size_type alignment = 64;
+
+        slot_range(Map& map, size_type first, size_type last) noexcept
+            : map_(&map), first_(first), last_(std::min(last, map.bucket_count())) {}
+
+        size_type first() const noexcept {
+            return first_;
+        }
+
+        size_type last() const noexcept {
+            return last_;
+        }
+
+        iterator begin() const noexcept {
+            return map_->slot_begin(first_);
+        }
+
+        iterator end() const noexcept {
+            return map_->slot_begin(last_);
+        }
+
+        /**
+         *  @brief  Erases the elements of the range satisfying @a pred.
+         *  @return  The number of elements erased.
+         *
+         *  Does not update the map's size(); the caller accounts for the
+         *  returned count once all ranges are done.
+         */
+        template<typename Predicate>
+        size_type erase_unsized(Predicate& pred) {
+            using access = detail::table_access<Map>;
+            auto& used = access::used(*map_);
+            auto& deleted = access::deleted(*map_);
+            value_type* slots = access::slots(*map_);
+            size_type erased = 0;
+
+            for (size_type pos = first_; pos != last_; pos++) {
+                if (used[pos] && pred(slots[pos])) {
+                    used[pos] = false;
+                    deleted[pos] = true;
+                    (slots + pos)->~value_type();
+                    erased++;
+                }
+            }
+
+            return erased;
+        }
+
+    private:
+        Map* map_;
+        size_type first_;
+        size_type last_;
+    };
+
+    namespace detail
+    {
+        // About eight ranges per worker keeps stealing effective without
+        // paying for tiny tasks.
+        template<typename Map>
+        typename Map::size_type parallel_grain(const thread_pool& pool, const Map& map) {
+            return std::max<typename Map::size_type>(slot_range<const Map>::alignment,
+                map.bucket_count() / (pool.size() * 8));
+        }
+
+        template<typename Map, typename F>
+        void for_each_range(thread_pool& pool, Map& map, F f) {
+            pool.parallel_for(0, map.bucket_count(), parallel_grain(pool, map),
+                [&map, &f](std::size_t first, std::size_t last) { f(slot_range<Map>(map, first, last)); },
+                slot_range<Map>::alignment);
+        }
+    }
+
+    /**
+     *  @brief  Calls @a f on every element of @a map in parallel.
+     *
+     *  @a f may modify the mapped values but must not insert or erase.
+     */
+    template<typename Map, typename F>
+    void parallel_for_each(thread_pool& pool, Map& map, F f) {
+        detail::for_each_range(pool, map, [&f](const slot_range<Map>& range) {
+            for (auto& element : range) {
+                f(element);
+            }
+        });
+    }
+
+    /**
+     *  @brief  Reduces transform(element) over @a map in parallel.
+     *  @param  init  The initial value, included exactly once.
+     *
+     *  @a reduce must be associative and commutative: partial results are
+     *  combined in no particular order.
+     */
+    template<typename Map, typename T, typename Reduce, typename Transform>
+    T parallel_transform_reduce(thread_pool& pool, const Map& map, T init, Reduce reduce, Transform transform) {
+        std::mutex result_mutex;
+
+        detail::for_each_range(pool, map, [&](const slot_range<const Map>& range) {
+            auto element = range.begin();
+            auto last = range.end();
+
+            if (element == last) {
+                return;
+            }
+
+            T partial = transform(*element);
+
+            for (++element; element != last; ++element) {
+                partial = reduce(std::move(partial), transform(*element));
+            }
+
+            std::lock_guard<std::mutex> lock(result_mutex);
+            init = reduce(std::move(init), std::move(partial));
+        });
+
+        return init;
+    }
+
+    /// Counts the elements of @a map satisfying @a pred in parallel.
+    template<typename Map, typename Predicate>
+    typename Map::size_type parallel_count_if(thread_pool& pool, const Map& map, Predicate pred) {
+        std::atomic<typename Map::size_type> result(0);
+
+        detail::for_each_range(pool, map, [&](const slot_range<const Map>& range) {
+            typename Map::size_type count = 0;
+
+            for (auto& element : range) {
+                count += pred(element) ? 1 : 0;
+            }
+
+            result.fetch_add(count, std::memory_order_relaxed);
+        });
+
+        return result.load();
+    }
+
+    /**
+     *  @brief  Erases the elements of @a map satisfying @a pred in parallel.
+     *  @return  The number of elements erased.
+     */
+    template<typename Map, typename Predicate>
+    typename Map::size_type parallel_erase_if(thread_pool& pool, Map& map, Predicate pred) {
+        std::atomic<typename Map::size_type> erased(0);
+
+        detail::for_each_range(pool, map, [&](slot_range<Map> range) {
+            erased.fetch_add(range.erase_unsized(pred), std::memory_order_relaxed);
+        });
+
+        detail::table_access<Map>::size(map) -= erased.load();
+        return erased.load();
+    }
+
+    namespace detail
+    {
+        /**
+         *  A bucket array filled by several threads at once.  Each bucket
+         *  has a state byte; an element goes to the first bucket of its
+         *  probe sequence that it manages to claim with a compare-and-swap.
+         *  commit() hands the finished array to the map.  If it is never
+         *  called, the constructed elements are destroyed.
+         */
+        template<typename Map>
+        class concurrent_table {
+        public:
+            using access = table_access<Map>;
+            using size_type = typename Map::size_type;
+            using key_type = typename Map::key_type;
+            using value_type = typename Map::value_type;
+
+            concurrent_table(thread_pool& pool, Map& map, size_type capacity)
+                : map_(map), capacity_(capacity), max_probe_(0), size_(0),
+                grain_(std::max<size_type>(slot_range<Map>::alignment, capacity / (pool.size() * 8))),
+                slots_(capacity == 0 ? nullptr : std::allocator_traits<typename Map::allocator_type>::allocate(access::allocator(map), capacity)),
+                state_(new std::atomic<unsigned char>[capacity]), equal_(map.key_eq()) {
+                pool.parallel_for(0, capacity_, grain_, [this](std::size_t first, std::size_t last) {
+                    for (std::size_t i = first; i != last; i++) {
+                        state_[i].store(free_slot, std::memory_order_relaxed);
+                    }
+                });
+            }
+
+            concurrent_table(const concurrent_table&) = delete;
+            concurrent_table& operator=(const concurrent_table&) = delete;
+
+            ~concurrent_table() {
+                if (slots_ != nullptr) {
+                    for (size_type i = 0; i != capacity_; i++) {
+                        if (state_[i].load(std::memory_order_relaxed) == constructed) {
+                            (slots_ + i)->~value_type();
+                        }
+                    }
+
+                    std::allocator_traits<typename Map::allocator_type>::deallocate(access::allocator(map_), slots_, capacity_);
+                }
+            }
+
+            size_type capacity() const noexcept {
+                return capacity_;
+            }
+
+            /**
+             *  @brief  Constructs value_type(@a arg) in a free bucket.
+             *  @param  known_unique  If false, skips the insertion when an equal
+             *                        key is already on the probe sequence.
+             *                        That check is only exact if every element
+             *                        with this key is inserted by the calling
+             *                        thread.
+             *  @param  max_probe  Raised to the number of buckets visited.
+             *  @return  True if the element was inserted.
+             */
+            template<typename Arg>
+            bool insert(size_t hash, const key_type& key, Arg&& arg, bool known_unique, size_type& max_probe) {
+                size_t pos;
+                size_t step;
+                access::probe(map_, hash, capacity_, pos, step);
+
+                for (size_type probes = 1;; probes++) {
+                    unsigned char state = state_[pos].load(std::memory_order_acquire);
+
+                    if (state == free_slot && state_[pos].compare_exchange_strong(state, claimed, std::memory_order_relaxed)) {
+                        new (slots_ + pos) value_type(std::forward<Arg>(arg));
+                        state_[pos].store(constructed, std::memory_order_release);
+                        max_probe = std::max(max_probe, probes);
+                        return true;
+                    }
+
+                    if (!known_unique && state == constructed && equal_(slots_[pos].first, key)) {
+                        return false;
+                    }
+
+                    pos += step;
+                    if (pos >= capacity_) {
+                        pos -= capacity_;
+                    }
+                }
+            }
+
+            /// Records the results of one worker.
+            void merge_counts(size_type inserted, size_type max_probe) noexcept {
+                size_.fetch_add(inserted, std::memory_order_relaxed);
+
+                size_type current = max_probe_.load(std::memory_order_relaxed);
+                while (current < max_probe && !max_probe_.compare_exchange_weak(current, max_probe)) {
+                }
+            }
+
+            /// Replaces the contents of the map with the built table.
+            void commit(thread_pool& pool) {
+                // Ranges are 64-bucket aligned, so the bit writes never share a word.
+                auto used = access::make_bitmap(map_, capacity_);
+                pool.parallel_for(0, capacity_, grain_, [&](std::size_t first, std::size_t last) {
+                    for (std::size_t i = first; i != last; i++) {
+                        if (state_[i].load(std::memory_order_relaxed) == constructed) {
+                            used[i] = true;
+                        }
+                    }
+                }, slot_range<Map>::alignment);
+
+                access::adopt(map_, slots_, capacity_, std::move(used), size_.load(), max_probe_.load());
+                slots_ = nullptr;
+            }
+
+        private:
+            enum : unsigned char { free_slot, claimed, constructed };
+
+            Map& map_;
+            size_type capacity_;
+            std::atomic<size_type> max_probe_;
+            std::atomic<size_type> size_;
+            size_type grain_;
+            value_type* slots_;
+            std::unique_ptr<std::atomic<unsigned char>[]> state_;
+            typename Map::key_equal equal_;
+        };
+    }
+
+    /**
+     *  @brief  Rebuilds @a map with at least @a n buckets using @a pool.
+     *
+     *  Same result as map.rehash(n).  Old buckets are split into ranges,
+     *  and every element is moved to the first free bucket of its probe
+     *  sequence, which is claimed with a compare-and-swap on a per-bucket
+     *  flag.  An element may land in a different bucket than under a
+     *  sequential rehash, but every bucket before it on its probe
+     *  sequence is occupied, so lookups behave the same.
+     *
+     *  Elements whose move constructor may throw are copied.  If a copy
+     *  throws, the new table is discarded and @a map is left unchanged.
+     */
+    template<typename Map>
+    void parallel_rehash(thread_pool& pool, Map& map, typename Map::size_type n) {
+        using access = detail::table_access<Map>;
+        using size_type = typename Map::size_type;
+
+        detail::concurrent_table<Map> table(pool, map, access::capacity_for(map, n));
+
+        detail::for_each_range(pool, map, [&](const slot_range<Map>& range) {
+            size_type inserted = 0;
+            size_type max_probe = 0;
+
+            for (auto& element : range) {
+                table.insert(access::hash(map, element.first), element.first, std::move_if_noexcept(element), true, max_probe);
+                inserted++;
+            }
+
+            table.merge_counts(inserted, max_probe);
+        });
+
+        table.commit(pool);
+    }
+
+    /**
+     *  @brief  Builds a %hash_map from a range using @a pool.
+     *  @param  first  A random access iterator to the first element.
+     *  @param  last  A random access iterator past the last element.
+     *  @return  A map equal to Map(first, last).
+     *
+     *  The table is sized once.  The input is hashed and radix-partitioned
+     *  by home bucket, so each partition covers a contiguous, cache-sized
+     *  region of the table, and the partitions are inserted in parallel.
+     *  Equal keys always fall into the same partition; like insert(), the
+     *  first occurrence in the input wins.
+     */
+    template<typename Map, typename RandomAccessIterator>
+    Map parallel_build(thread_pool& pool, RandomAccessIterator first, RandomAccessIterator last) {
+        using access = detail::table_access<Map>;
+        using size_type = typename Map::size_type;
+        struct entry {
+            size_t hash;
+            size_type index;
+        };
+
+        // Bucket regions of about 256 KB per partition, and enough of them
+        // to keep every worker busy.
+        const size_type region_bytes = 256 * 1024;
+
+        Map map;
+        const size_type n = static_cast<size_type>(last - first);
+        const size_type capacity = access::capacity_for(map, static_cast<size_type>(std::ceil(n / map.max_load_factor())));
+        const size_type chunks = std::max<size_type>(1, std::min<size_type>(pool.size() * 4, n / 4096));
+        const size_type partitions = std::max<size_type>(pool.size() * 8,
+            capacity * sizeof(typename Map::value_type) / region_bytes + 1);
+
+        if (n == 0) {
+            return map;
+        }
+
+        // 1. Hash every element and count partition sizes per input chunk.
+        std::vector<size_t> hashes(n);
+        std::vector<size_type> counts(chunks * partitions, 0);
+        auto partition_of = [capacity, partitions, &map](size_t hash) {
+            size_t pos;
+            size_t step;
+            access::probe(map, hash, capacity, pos, step);
+            return static_cast<size_type>(static_cast<double>(pos) * partitions / capacity);
+        };
+        auto chunk_bounds = [n, chunks](size_type chunk) {
+            return std::make_pair(n * chunk / chunks, n * (chunk + 1) / chunks);
+        };
+
+        pool.parallel_for(0, chunks, 1, [&](std::size_t chunk_first, std::size_t chunk_last) {
+            for (size_type chunk = chunk_first; chunk != chunk_last; chunk++) {
+                auto bounds = chunk_bounds(chunk);
+                size_type* chunk_counts = counts.data() + chunk * partitions;
+
+                for (size_type i = bounds.first; i != bounds.second; i++) {
+                    hashes[i] = access::hash(map, first[i].first);
+                    chunk_counts[partition_of(hashes[i])]++;
+                }
+            }
+        });
+
+        // 2. Scatter (hash, index) pairs into their partitions, keeping input
+        //    order inside every partition.
+        std::vector<size_type> offsets(chunks * partitions);
+        std::vector<size_type> partition_begin(partitions + 1);
+        size_type offset = 0;
+
+        for (size_type partition = 0; partition != partitions; partition++) {
+            partition_begin[partition] = offset;
+
+            for (size_type chunk = 0; chunk != chunks; chunk++) {
+                offsets[chunk * partitions + partition] = offset;
+                offset += counts[chunk * partitions + partition];
+            }
+        }
+        partition_begin[partitions] = offset;
+
+        std::vector<entry> entries(n);
+        pool.parallel_for(0, chunks, 1, [&](std::size_t chunk_first, std::size_t chunk_last) {
+            for (size_type chunk = chunk_first; chunk != chunk_last; chunk++) {
+                auto bounds = chunk_bounds(chunk);
+                size_type* chunk_offsets = offsets.data() + chunk * partitions;
+
+                for (size_type i = bounds.first; i != bounds.second; i++) {
+                    entries[chunk_offsets[partition_of(hashes[i])]++] = entry{ hashes[i], i };
+                }
+            }
+        });
+
+        hashes = std::vector<size_t>();
+
+        // 3. Insert the partitions in parallel.
+        detail::concurrent_table<Map> table(pool, map, capacity);
+
+        pool.parallel_for(0, partitions, 1, [&](std::size_t partition_first, std::size_t partition_last) {
+            size_type inserted = 0;
+            size_type max_probe = 0;
+
+            for (size_type i = partition_begin[partition_first]; i != partition_begin[partition_last]; i++) {
+                const auto& element = first[entries[i].index];
+                inserted += table.insert(entries[i].hash, element.first, element, false, max_probe) ? 1 : 0;
+            }
+
+            table.merge_counts(inserted, max_probe);
+        });
+
+        table.commit(pool);
+        return map;
+    }
+
+    /// Builds a %hash_map from a range on thread_pool::default_pool().
+    template<typename Map, typename RandomAccessIterator>
+    Map parallel_build(RandomAccessIterator first, RandomAccessIterator last) {
+        return parallel_build<Map>(thread_pool::default_pool(), first, last);
+    }
+
+    /**
+     *  @brief  Prepares @a map for @a n elements using @a pool.
+     *
+     *  Same as parallel_rehash(pool, map, ceil(n / max_load_factor())).
+     */
+    template<typename Map>
+    void parallel_reserve(thread_pool& pool, Map& map, typename Map::size_type n) {
+        parallel_rehash(pool, map, static_cast<typename Map::size_type>(std::ceil(n / map.max_load_factor())));
+    }
+
+    //@{
+    /// Overloads running on thread_pool::default_pool().
+    template<typename Map, typename F>
+    void parallel_for_each(Map& map, F f) {
+        parallel_for_each(thread_pool::default_pool(), map, std::move(f));
+    }
+
+    template<typename Map, typename T, typename Reduce, typename Transform>
+    T parallel_transform_reduce(const Map& map, T init, Reduce reduce, Transform transform) {
+        return parallel_transform_reduce(thread_pool::default_pool(), map, std::move(init), std::move(reduce), std::move(transform));
+    }
+
+    template<typename Map, typename Predicate>
+    typename Map::size_type parallel_count_if(const Map& map, Predicate pred) {
+        return parallel_count_if(thread_pool::default_pool(), map, std::move(pred));
+    }
+
+    template<typename Map, typename Predicate>
+    typename Map::size_type parallel_erase_if(Map& map, Predicate pred) {
+        return parallel_erase_if(thread_pool::default_pool(), map, std::move(pred));
+    }
+
+    template<typename Map>
+    void parallel_rehash(Map& map, typename Map::size_type n) {
+        parallel_rehash(thread_pool::default_pool(), map, n);
+    }
+
+    template<typename Map>
+    void parallel_reserve(Map& map, typename Map::size_type n) {
+        parallel_reserve(thread_pool::default_pool(), map, n);
+    }
+    //@}
+
+} // namespace fefu
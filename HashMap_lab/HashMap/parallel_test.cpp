@@ -0,0 +1,205 @@
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include "parallel.hpp"
+#include "../catch.hpp"
+
+TEST_CASE("thread_pool parallel_for", "[thread_pool]") {
+    fefu::thread_pool pool(4);
+
+    SECTION("covers the range exactly once") {
+        std::vector<std::atomic<int>> hits(10000);
+        pool.parallel_for(0, hits.size(), 16, [&](std::size_t first, std::size_t last) {
+            for (std::size_t i = first; i != last; i++) {
+                hits[i]++;
+            }
+        });
+
+        for (auto& hit : hits) {
+            REQUIRE(hit == 1);
+        }
+    }
+    SECTION("split points respect the alignment") {
+        std::atomic<bool> misaligned(false);
+        pool.parallel_for(0, 1000, 1, [&](std::size_t first, std::size_t) {
+            if (first % 64 != 0) {
+                misaligned = true;
+            }
+        }, 64);
+
+        REQUIRE(misaligned == false);
+    }
+    SECTION("nested parallelism and exceptions") {
+        std::atomic<int> total(0);
+        pool.parallel_for(0, 8, 1, [&](std::size_t, std::size_t) {
+            pool.parallel_for(0, 8, 1, [&](std::size_t, std::size_t) { total++; });
+        });
+        REQUIRE(total == 64);
+
+        REQUIRE_THROWS_AS(pool.parallel_for(0, 100, 1, [](std::size_t first, std::size_t) {
+            if (first == 50) {
+                throw std::runtime_error("task failed");
+            }
+        }), std::runtime_error);
+    }
+}
+
+TEST_CASE("parallel algorithms over hash_map", "[parallel]") {
+    fefu::thread_pool pool(3);
+    fefu::hash_map<int, long long> map;
+    for (int i = 0; i < 100000; i++) {
+        map[i] = i;
+    }
+
+    fefu::parallel_for_each(pool, map, [](std::pair<const int, long long>& element) { element.second *= 2; });
+    REQUIRE(map.at(500) == 1000);
+
+    auto sum = fefu::parallel_transform_reduce(pool, map, 0LL, std::plus<long long>(),
+        [](const std::pair<const int, long long>& element) { return element.second; });
+    REQUIRE(sum == 99999LL * 100000LL);
+
+    auto odd = [](const std::pair<const int, long long>& element) { return element.first % 2 == 1; };
+    REQUIRE(fefu::parallel_count_if(pool, map, odd) == 50000);
+
+    REQUIRE(fefu::parallel_erase_if(pool, map, odd) == 50000);
+    REQUIRE(map.size() == 50000);
+    REQUIRE(map.contains(3) == false);
+    REQUIRE(map.at(4) == 8);
+
+    map[3] = 1;
+    REQUIRE(map.size() == 50001);
+    REQUIRE(fefu::parallel_count_if(map, odd) == 1);
+}
+
+TEST_CASE("parallel_rehash", "[parallel]") {
+    fefu::thread_pool pool(4);
+    fefu::hash_map<int, std::string> map;
+    for (int i = 0; i < 20000; i++) {
+        map[i] = std::to_string(i);
+    }
+    for (int i = 0; i < 20000; i += 3) {
+        map.erase(i);
+    }
+
+    fefu::hash_map<int, std::string> expected(map);
+    expected.rehash(100000);
+    fefu::parallel_rehash(pool, map, 100000);
+
+    REQUIRE(map.bucket_count() == expected.bucket_count());
+    REQUIRE(map.size() == expected.size());
+    REQUIRE(map == expected);
+    for (int i = 0; i < 20000; i++) {
+        REQUIRE(map.contains(i) == (i % 3 != 0));
+    }
+
+    map[0] = "0";
+    REQUIRE(map.erase(1) == 1);
+    REQUIRE(map.at(2) == "2");
+
+    fefu::parallel_reserve(pool, map, 10);
+    REQUIRE(map.bucket_count() >= map.size());
+    REQUIRE(map.at(0) == "0");
+}
+
+TEST_CASE("parallel_build", "[parallel]") {
+    fefu::thread_pool pool(4);
+    std::vector<std::pair<int, int>> input;
+    for (int i = 0; i < 50000; i++) {
+        input.emplace_back(i * 7 % 30011, i);
+    }
+
+    auto map = fefu::parallel_build<fefu::hash_map<int, int>>(pool, input.begin(), input.end());
+    fefu::hash_map<int, int> expected(input.begin(), input.end());
+
+    REQUIRE(map.size() == 30011);
+    REQUIRE(map.size() == expected.size());
+    for (auto& element : expected) {
+        REQUIRE(map.at(element.first) == element.second);
+    }
+
+    map[-1] = 1;
+    REQUIRE(map.size() == 30012);
+    REQUIRE(fefu::parallel_build<fefu::hash_map<int, int>>(pool, input.begin(), input.begin()).empty());
+}
+
+TEST_CASE("bulk build of a large map from a vector", "[parallel][!benchmark]") {
+    const int entries = 50000000;
+
+    std::vector<std::pair<std::uint32_t, std::uint32_t>> input(entries);
+    for (int i = 0; i < entries; i++) {
+        input[i] = std::make_pair(static_cast<std::uint32_t>(i) * 2654435761u, static_cast<std::uint32_t>(i));
+    }
+
+    BENCHMARK("range constructor") {
+        return fefu::hash_map<std::uint32_t, std::uint32_t>(input.begin(), input.end()).size();
+    };
+
+    for (std::size_t threads = 1; threads <= std::max(1u, std::thread::hardware_concurrency()); threads *= 2) {
+        fefu::thread_pool pool(threads);
+
+        BENCHMARK("parallel_build, " + std::to_string(threads) + " threads") {
+            return fefu::parallel_build<fefu::hash_map<std::uint32_t, std::uint32_t>>(pool, input.begin(), input.end()).size();
+        };
+    }
+}
+
+TEST_CASE("parallel_rehash wall time versus threads", "[parallel][!benchmark]") {
+    const int entries = 20000000;
+
+    fefu::hash_map<std::uint64_t, std::uint64_t> source;
+    source.reserve(entries);
+    for (int i = 0; i < entries; i++) {
+        source[static_cast<std::uint64_t>(i) * 0x9E3779B97F4A7C15ULL] = i;
+    }
+
+    BENCHMARK_ADVANCED("sequential rehash")(Catch::Benchmark::Chronometer meter) {
+        fefu::hash_map<std::uint64_t, std::uint64_t> map(source);
+        meter.measure([&] { map.rehash(map.bucket_count() * 2); });
+    };
+
+    for (std::size_t threads = 1; threads <= std::max(1u, std::thread::hardware_concurrency()); threads *= 2) {
+        fefu::thread_pool pool(threads);
+
+        BENCHMARK_ADVANCED("parallel_rehash, " + std::to_string(threads) + " threads")(Catch::Benchmark::Chronometer meter) {
+            fefu::hash_map<std::uint64_t, std::uint64_t> map(source);
+            meter.measure([&] { fefu::parallel_rehash(pool, map, map.bucket_count() * 2); });
+        };
+    }
+}
+
+TEST_CASE("parallel full-table scans scale with threads", "[parallel][!benchmark]") {
+    const int entries = 100000000;
+
+    fefu::hash_map<std::uint32_t, std::uint32_t> map;
+    map.reserve(entries);
+    for (int i = 0; i < entries; i++) {
+        map[static_cast<std::uint32_t>(i) * 2654435761u] = i;
+    }
+
+    auto is_even = [](const std::pair<const std::uint32_t, std::uint32_t>& element) { return element.second % 2 == 0; };
+
+    BENCHMARK("sequential count_if") {
+        std::size_t count = 0;
+        for (auto& element : map) {
+            count += is_even(element);
+        }
+        return count;
+    };
+
+    for (std::size_t threads = 1; threads <= std::max(1u, std::thread::hardware_concurrency()); threads *= 2) {
+        fefu::thread_pool pool(threads);
+
+        BENCHMARK("parallel_count_if, " + std::to_string(threads) + " threads") {
+            return fefu::parallel_count_if(pool, map, is_even);
+        };
+
+        BENCHMARK("parallel_transform_reduce, " + std::to_string(threads) + " threads") {
+            return fefu::parallel_transform_reduce(pool, map, std::uint64_t(0), std::plus<std::uint64_t>(),
+                [](const std::pair<const std::uint32_t, std::uint32_t>& element) { return std::uint64_t(element.second); });
+        };
+    }
+}
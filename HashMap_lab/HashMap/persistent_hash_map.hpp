@@ -0,0 +1,409 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include "hash_map.hpp"
+#include "mapped_file.hpp"
+
+namespace fefu
+{
+    /**
+     *  @brief  A hash map of trivially copyable keys and values living in a
+     *          memory-mapped file.
+     *
+     *  The file starts with a versioned header, followed by one state byte
+     *  per bucket and the bucket array.  Nothing in the file is a pointer:
+     *  sections are located by offsets from the header, so reopening the
+     *  file is a single mmap and lookups are served at once, pages being
+     *  faulted in as they are touched.
+     *
+     *  Buckets are probed linearly from a mixed hash over a power-of-two
+     *  capacity.  Hash must give the same value for a key in every process
+     *  that opens the file; std::hash of integers does.
+     *
+     *  Crash consistency:
+     *  - checkpoint() flushes the buckets, then writes and flushes a header
+     *    marked clean.  A file closed by the destructor is checkpointed.
+     *  - The first modification after a checkpoint marks the header dirty
+     *    on disk before touching any bucket.
+     *  - Opening a dirty file recounts the size from the state bytes and
+     *    sets recovered().  Any combination of state bytes is a valid
+     *    table, so the recovered map can be used, but changes made since
+     *    the last checkpoint may be lost or only partly written.
+     *  - Growing builds the new table in a side file, checkpoints it and
+     *    renames it over the old one, so a crash leaves either table.
+     */
+    template<typename K, typename T,
+        typename Hash = std::hash<K>,
+        typename Pred = std::equal_to<K>>
+        class persistent_hash_map
+    {
+        static_assert(std::is_trivially_copyable<K>::value, "persistent_hash_map keys must be trivially copyable");
+        static_assert(std::is_trivially_copyable<T>::value, "persistent_hash_map values must be trivially copyable");
+
+    public:
+        using key_type = K;
+        using mapped_type = T;
+        using hasher = Hash;
+        using key_equal = Pred;
+        using size_type = std::size_t;
+
+        /// On-disk format version; files of another version are rejected.
+        static constexpr std::uint32_t format_version = 1;
+
+        /**
+         *  @brief  Opens the map stored in @a path, creating it if needed.
+         *  @param  n  Number of elements a new file is sized for.
+         *  @throw  std::runtime_error  If the file is not a map of this
+         *                              key and value layout and version.
+         */
+        explicit persistent_hash_map(const std::string& path, size_type n = 0,
+            const hasher& hf = hasher(), const key_equal& eql = key_equal())
+            : path_(path), hash_(hf), equal_(eql), recovered_(false), dirty_(false) {
+            file_.open(path_, 0);
+
+            if (file_.size() == 0) {
+                file_.close();
+                create(path_, capacity_for(n));
+                file_.open(path_, 0);
+            }
+
+            attach();
+        }
+
+        persistent_hash_map(const persistent_hash_map&) = delete;
+        persistent_hash_map& operator=(const persistent_hash_map&) = delete;
+
+        /// Checkpoints and unmaps the file.
+        ~persistent_hash_map() {
+            try {
+                checkpoint();
+            }
+            catch (...) {
+            }
+        }
+
+        /// Returns true if the file was not checkpointed before it was last closed.
+        bool recovered() const noexcept {
+            return recovered_;
+        }
+
+        size_type size() const noexcept {
+            return static_cast<size_type>(header()->size);
+        }
+
+        bool empty() const noexcept {
+            return size() == 0;
+        }
+
+        size_type bucket_count() const noexcept {
+            return static_cast<size_type>(header()->capacity);
+        }
+
+        /// Returns a pointer to the value of @a k in the mapping, or nullptr.
+        const mapped_type* find(const key_type& k) const {
+            std::uint64_t pos = find_slot(k);
+            return pos == npos ? nullptr : &entries()[pos].value;
+        }
+
+        bool contains(const key_type& k) const {
+            return find_slot(k) != npos;
+        }
+
+        /// Returns the value of @a k, or throws std::out_of_range.
+        mapped_type at(const key_type& k) const {
+            const mapped_type* value = find(k);
+            if (value == nullptr) {
+                throw std::out_of_range("persistent_hash_map::at");
+            }
+            return *value;
+        }
+
+        /**
+         *  @brief  Stores @a obj under @a k.
+         *  @return  True if @a k was inserted, false if it was assigned.
+         */
+        bool insert_or_assign(const key_type& k, const mapped_type& obj) {
+            std::uint64_t pos = find_slot(k);
+            mark_dirty();
+
+            if (pos != npos) {
+                std::memcpy(&entries()[pos].value, &obj, sizeof(mapped_type));
+                return false;
+            }
+
+            if ((header()->size + header()->tombstones + 1) * 10 > header()->capacity * 7) {
+                grow(header()->size + 1);
+            }
+
+            std::uint64_t mask = header()->capacity - 1;
+            for (pos = detail::finalize(hash_(k)) & mask; states()[pos] == occupied; pos = (pos + 1) & mask) {
+            }
+
+            if (states()[pos] == erased) {
+                header()->tombstones--;
+            }
+
+            entry e;
+            std::memcpy(&e.key, &k, sizeof(key_type));
+            std::memcpy(&e.value, &obj, sizeof(mapped_type));
+            std::memcpy(&entries()[pos], &e, sizeof(entry));
+            states()[pos] = occupied;
+            header()->size++;
+            return true;
+        }
+
+        /// Erases @a k; returns the number of erased elements.
+        size_type erase(const key_type& k) {
+            std::uint64_t pos = find_slot(k);
+
+            if (pos == npos) {
+                return 0;
+            }
+
+            mark_dirty();
+            states()[pos] = erased;
+            header()->size--;
+            header()->tombstones++;
+            return 1;
+        }
+
+        /// Calls @a f(key, value) for every element.
+        template<typename F>
+        void for_each(F&& f) const {
+            const unsigned char* state = states();
+            const entry* e = entries();
+
+            for (std::uint64_t i = 0; i != header()->capacity; i++) {
+                if (state[i] == occupied) {
+                    f(e[i].key, e[i].value);
+                }
+            }
+        }
+
+        /// Makes the file able to hold @a n elements without growing.
+        void reserve(size_type n) {
+            if (capacity_for(n) > header()->capacity) {
+                grow(n);
+            }
+        }
+
+        /**
+         *  @brief  Makes every change so far durable.
+         *
+         *  Flushes the buckets and state bytes, then the header marked
+         *  clean.  Does nothing if nothing changed since the last call.
+         */
+        void checkpoint() {
+            if (!dirty_) {
+                return;
+            }
+
+            file_.sync(header()->states_offset, file_.size() - header()->states_offset);
+            header()->clean = 1;
+            header()->checkpoints++;
+            file_.sync(0, sizeof(file_header));
+            dirty_ = false;
+        }
+
+    private:
+        struct entry {
+            key_type key;
+            mapped_type value;
+        };
+
+        struct file_header {
+            char magic[8];
+            std::uint32_t version;
+            std::uint32_t header_size;
+            std::uint64_t key_size;
+            std::uint64_t value_size;
+            std::uint64_t entry_size;
+            std::uint64_t entry_align;
+            std::uint64_t capacity;
+            std::uint64_t size;
+            std::uint64_t tombstones;
+            std::uint64_t states_offset;
+            std::uint64_t entries_offset;
+            std::uint64_t checkpoints;
+            std::uint64_t clean;
+        };
+
+        static constexpr unsigned char empty_slot = 0;
+        static constexpr unsigned char occupied = 1;
+        static constexpr unsigned char erased = 2;
+        static constexpr std::uint64_t npos = ~std::uint64_t(0);
+        static constexpr std::uint64_t page_size = 4096;
+        static constexpr char magic[8] = { 'F', 'E', 'F', 'U', 'P', 'H', 'M', '\0' };
+
+        std::string path_;
+        detail::mapped_file file_;
+        hasher hash_;
+        key_equal equal_;
+        bool recovered_;
+        bool dirty_;
+
+        static std::uint64_t capacity_for(std::uint64_t n) noexcept {
+            std::uint64_t capacity = 16;
+            while (capacity * 7 < n * 10 + 10) {
+                capacity *= 2;
+            }
+            return capacity;
+        }
+
+        static std::uint64_t round_up(std::uint64_t n, std::uint64_t alignment) noexcept {
+            return (n + alignment - 1) / alignment * alignment;
+        }
+
+        file_header* header() const noexcept {
+            return reinterpret_cast<file_header*>(file_.data());
+        }
+
+        unsigned char* states() const noexcept {
+            return reinterpret_cast<unsigned char*>(file_.data() + header()->states_offset);
+        }
+
+        entry* entries() const noexcept {
+            return reinterpret_cast<entry*>(file_.data() + header()->entries_offset);
+        }
+
+        std::uint64_t find_slot(const key_type& k) const {
+            std::uint64_t mask = header()->capacity - 1;
+            const unsigned char* state = states();
+            const entry* e = entries();
+
+            for (std::uint64_t pos = detail::finalize(hash_(k)) & mask; state[pos] != empty_slot; pos = (pos + 1) & mask) {
+                if (state[pos] == occupied && equal_(e[pos].key, k)) {
+                    return pos;
+                }
+            }
+            return npos;
+        }
+
+        // Writes an empty, clean table of @a capacity buckets to @a path.
+        static void create(const std::string& path, std::uint64_t capacity) {
+            std::uint64_t states_offset = page_size;
+            std::uint64_t entries_offset = round_up(states_offset + capacity, page_size);
+            detail::mapped_file file;
+            file.open(path, entries_offset + capacity * sizeof(entry));
+
+            file_header* h = reinterpret_cast<file_header*>(file.data());
+            std::memcpy(h->magic, magic, sizeof(magic));
+            h->version = format_version;
+            h->header_size = sizeof(file_header);
+            h->key_size = sizeof(key_type);
+            h->value_size = sizeof(mapped_type);
+            h->entry_size = sizeof(entry);
+            h->entry_align = alignof(entry);
+            h->capacity = capacity;
+            h->size = 0;
+            h->tombstones = 0;
+            h->states_offset = states_offset;
+            h->entries_offset = entries_offset;
+            h->checkpoints = 0;
+            h->clean = 1;
+            file.sync(0, file.size());
+        }
+
+        // Validates the header of the mapped file and recovers a dirty one.
+        void attach() {
+            const file_header* h = header();
+
+            if (file_.size() < sizeof(file_header) || std::memcmp(h->magic, magic, sizeof(magic)) != 0) {
+                throw std::runtime_error("persistent_hash_map: " + path_ + " is not a persistent_hash_map file");
+            }
+            if (h->version != format_version || h->header_size != sizeof(file_header)) {
+                throw std::runtime_error("persistent_hash_map: " + path_ + " has an unsupported format version");
+            }
+            if (h->key_size != sizeof(key_type) || h->value_size != sizeof(mapped_type) ||
+                h->entry_size != sizeof(entry) || h->entry_align != alignof(entry)) {
+                throw std::runtime_error("persistent_hash_map: " + path_ + " holds a different key or value type");
+            }
+            if (h->capacity == 0 || (h->capacity & (h->capacity - 1)) != 0 ||
+                h->entries_offset % alignof(entry) != 0 || h->entries_offset + h->capacity * sizeof(entry) > file_.size()) {
+                throw std::runtime_error("persistent_hash_map: " + path_ + " is truncated or corrupt");
+            }
+
+            file_.advise_random(h->entries_offset, h->capacity * sizeof(entry));
+
+            if (!h->clean) {
+                recover();
+            }
+        }
+
+        void recover() {
+            std::uint64_t size = 0;
+            std::uint64_t tombstones = 0;
+            const unsigned char* state = states();
+
+            for (std::uint64_t i = 0; i != header()->capacity; i++) {
+                size += state[i] == occupied;
+                tombstones += state[i] == erased;
+            }
+
+            header()->size = size;
+            header()->tombstones = tombstones;
+            recovered_ = true;
+            dirty_ = true;
+            checkpoint();
+        }
+
+        void mark_dirty() {
+            if (!dirty_) {
+                header()->clean = 0;
+                file_.sync(0, sizeof(file_header));
+                dirty_ = true;
+            }
+        }
+
+        // Rebuilds the table for @a n elements in a side file and swaps it in.
+        void grow(std::uint64_t n) {
+            std::string side = path_ + ".grow";
+            std::uint64_t capacity = std::max(capacity_for(n), header()->capacity);
+            std::remove(side.c_str());
+            create(side, capacity);
+
+            {
+                detail::mapped_file target;
+                target.open(side, 0);
+                file_header* h = reinterpret_cast<file_header*>(target.data());
+                unsigned char* state = reinterpret_cast<unsigned char*>(target.data() + h->states_offset);
+                entry* e = reinterpret_cast<entry*>(target.data() + h->entries_offset);
+                std::uint64_t mask = capacity - 1;
+
+                for (std::uint64_t i = 0; i != header()->capacity; i++) {
+                    if (states()[i] != occupied) {
+                        continue;
+                    }
+
+                    std::uint64_t pos = detail::finalize(hash_(entries()[i].key)) & mask;
+                    while (state[pos] != empty_slot) {
+                        pos = (pos + 1) & mask;
+                    }
+                    std::memcpy(&e[pos], &entries()[i], sizeof(entry));
+                    state[pos] = occupied;
+                }
+
+                h->size = header()->size;
+                target.sync(0, target.size());
+            }
+
+            file_.close();
+            detail::mapped_file::replace(side, path_);
+            file_.open(path_, 0);
+            attach();
+            dirty_ = false;
+            mark_dirty();
+        }
+    };
+
+    template<typename K, typename T, typename Hash, typename Pred>
+    constexpr char persistent_hash_map<K, T, Hash, Pred>::magic[8];
+
+} // namespace fefu
@@ -0,0 +1,139 @@
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "hash_map.hpp"
+#include "persistent_hash_map.hpp"
+#include "../catch.hpp"
+
+namespace
+{
+    struct point {
+        double x;
+        double y;
+    };
+
+    // A file in the temp directory removed again at scope exit.
+    class temp_file {
+    public:
+        explicit temp_file(const std::string& name)
+            : path_((std::filesystem::temp_directory_path() / name).string()) {
+            std::filesystem::remove(path_);
+        }
+
+        ~temp_file() {
+            std::filesystem::remove(path_);
+        }
+
+        const std::string& path() const noexcept {
+            return path_;
+        }
+
+    private:
+        std::string path_;
+    };
+
+    // Overwrites the 8-byte header field at @a offset.
+    void patch_header(const std::string& path, std::streamoff offset, std::uint64_t value, std::size_t bytes = 8) {
+        std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+        file.seekp(offset);
+        file.write(reinterpret_cast<const char*>(&value), bytes);
+    }
+}
+
+TEST_CASE("persistent_hash_map survives reopening", "[persistent_hash_map]") {
+    temp_file file("fefu_persistent_test.map");
+
+    {
+        fefu::persistent_hash_map<int, point> map(file.path(), 4);
+        REQUIRE(map.empty());
+
+        for (int i = 0; i < 1000; i++) {
+            REQUIRE(map.insert_or_assign(i, { i * 1.0, i * 2.0 }));
+        }
+
+        REQUIRE_FALSE(map.insert_or_assign(7, { -1.0, -1.0 }));
+        REQUIRE(map.erase(8) == 1);
+        REQUIRE(map.erase(8) == 0);
+        REQUIRE(map.bucket_count() >= 1000);
+    }
+
+    fefu::persistent_hash_map<int, point> map(file.path());
+    REQUIRE_FALSE(map.recovered());
+    REQUIRE(map.size() == 999);
+    REQUIRE(map.at(7).x == -1.0);
+    REQUIRE(map.find(8) == nullptr);
+    REQUIRE(map.find(999)->y == 1998.0);
+    REQUIRE_THROWS_AS(map.at(1000), std::out_of_range);
+
+    std::size_t visited = 0;
+    map.for_each([&](int, const point&) { visited++; });
+    REQUIRE(visited == 999);
+}
+
+TEST_CASE("persistent_hash_map validates and recovers files", "[persistent_hash_map]") {
+    temp_file file("fefu_persistent_header_test.map");
+
+    {
+        fefu::persistent_hash_map<std::uint64_t, std::uint64_t> map(file.path());
+        map.insert_or_assign(1, 10);
+        map.insert_or_assign(2, 20);
+        map.checkpoint();
+    }
+
+    SECTION("other value type") {
+        REQUIRE_THROWS_AS((fefu::persistent_hash_map<std::uint64_t, std::uint32_t>(file.path())), std::runtime_error);
+    }
+    SECTION("other format version") {
+        patch_header(file.path(), 8, 99, 4);
+        REQUIRE_THROWS_AS((fefu::persistent_hash_map<std::uint64_t, std::uint64_t>(file.path())), std::runtime_error);
+    }
+    SECTION("dirty header") {
+        // Size field 0 and clean flag 0, as after a crash before the first checkpoint.
+        patch_header(file.path(), 56, 0);
+        patch_header(file.path(), 96, 0);
+
+        fefu::persistent_hash_map<std::uint64_t, std::uint64_t> map(file.path());
+        REQUIRE(map.recovered());
+        REQUIRE(map.size() == 2);
+        REQUIRE(map.at(2) == 20);
+    }
+}
+
+TEST_CASE("Startup: mapping a persistent table versus rebuilding", "[persistent_hash_map][!benchmark]") {
+    const std::uint64_t elements = 1 << 22;
+    const std::uint64_t lookups = 1000;
+    temp_file file("fefu_persistent_bench.map");
+
+    std::vector<std::pair<std::uint64_t, std::uint64_t>> source(elements);
+    for (std::uint64_t i = 0; i < elements; i++) {
+        source[i] = { i * 0x9E3779B97F4A7C15ull, i };
+    }
+
+    {
+        fefu::persistent_hash_map<std::uint64_t, std::uint64_t> map(file.path(), elements);
+        for (const auto& element : source) {
+            map.insert_or_assign(element.first, element.second);
+        }
+    }
+
+    BENCHMARK("rebuild hash_map from source, then look up") {
+        fefu::hash_map<std::uint64_t, std::uint64_t> map(source.begin(), source.end());
+        std::uint64_t sum = 0;
+        for (std::uint64_t i = 0; i < lookups; i++) {
+            sum += map.at(source[i * 4099 % elements].first);
+        }
+        return sum;
+    };
+
+    BENCHMARK("map persistent file, then look up") {
+        fefu::persistent_hash_map<std::uint64_t, std::uint64_t> map(file.path());
+        std::uint64_t sum = 0;
+        for (std::uint64_t i = 0; i < lookups; i++) {
+            sum += map.at(source[i * 4099 % elements].first);
+        }
+        return sum;
+    };
+}
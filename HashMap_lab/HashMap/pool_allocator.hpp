@@ -0,0 +1,370 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <new>
+#include <type_traits>
+
+namespace fefu
+{
+    /**
+     *  @brief  A thread-caching size-class memory pool.
+     *
+     *  Small requests are rounded up to one of class_count size classes.
+     *  Objects of a class are carved from spans, span_size-aligned blocks
+     *  holding objects of that class only, so the span of an object is
+     *  found by masking its address.
+     *
+     *  Every thread keeps a free list per class and serves allocations from
+     *  it without locking.  An empty thread list is refilled with a batch of
+     *  objects from the central list of the class, and a thread list grown
+     *  past two batches returns a batch; the central list is locked once per
+     *  batch.  A span all of whose objects have come back to the central
+     *  list is returned to the system, unless it is the last one of its
+     *  class.  A thread's cache goes back to the central lists when the
+     *  thread exits.
+     *
+     *  Requests larger than max_small_size, or aligned more strictly, are
+     *  passed to the aligned ::operator new.
+     */
+    class size_class_pool {
+    public:
+        static constexpr std::size_t span_size = std::size_t(1) << 16;
+        static constexpr std::size_t max_small_size = 8192;
+        static constexpr std::size_t min_alignment = 16;
+        static constexpr std::size_t class_count = 32;
+
+        size_class_pool(const size_class_pool&) = delete;
+        size_class_pool& operator=(const size_class_pool&) = delete;
+
+        /**
+         *  @brief  Returns the process-wide pool.
+         *
+         *  The pool is never destroyed, so containers with static storage
+         *  duration may still free memory into it at exit.
+         */
+        static size_class_pool& instance() {
+            static size_class_pool* pool = new size_class_pool();
+            return *pool;
+        }
+
+        /**
+         *  @brief  Allocates @a bytes aligned to @a alignment.
+         *  @throw  std::bad_alloc  If the system is out of memory.
+         */
+        void* allocate(std::size_t bytes, std::size_t alignment = alignof(std::max_align_t)) {
+            std::size_t k = class_of(bytes, alignment);
+
+            if (k == class_count) {
+                return ::operator new(bytes, std::align_val_t(std::max(alignment, min_alignment)));
+            }
+
+            thread_cache& cache = local_cache();
+
+            if (cache.head[k] == nullptr) {
+                fetch(cache, k, batch_[k]);
+            }
+
+            void* p = cache.head[k];
+            cache.head[k] = next_of(p);
+            cache.count[k]--;
+            return p;
+        }
+
+        /// Frees @a p, allocated with the same @a bytes and @a alignment.
+        void deallocate(void* p, std::size_t bytes, std::size_t alignment = alignof(std::max_align_t)) noexcept {
+            std::size_t k = class_of(bytes, alignment);
+
+            if (k == class_count) {
+                ::operator delete(p, std::align_val_t(std::max(alignment, min_alignment)));
+                return;
+            }
+
+            thread_cache& cache = local_cache();
+            next_of(p) = cache.head[k];
+            cache.head[k] = p;
+
+            if (++cache.count[k] >= 2 * batch_[k]) {
+                give_back(cache, k, batch_[k]);
+            }
+        }
+
+        /// Returns every object cached by the calling thread to the central lists.
+        void flush_thread_cache() noexcept {
+            thread_cache& cache = local_cache();
+
+            for (std::size_t k = 0; k != class_count; k++) {
+                give_back(cache, k, cache.count[k]);
+            }
+        }
+
+        /// Returns the number of spans currently obtained from the system.
+        std::size_t span_count() const noexcept {
+            return spans_.load(std::memory_order_relaxed);
+        }
+
+        /// Returns the object size of the class serving (@a bytes, @a alignment), 0 for large requests.
+        std::size_t class_size(std::size_t bytes, std::size_t alignment = alignof(std::max_align_t)) const noexcept {
+            std::size_t k = class_of(bytes, alignment);
+            return k == class_count ? 0 : sizes_[k];
+        }
+
+    private:
+        struct span {
+            span* prev;
+            span* next;
+            void* free;
+            char* bump;
+            char* end;
+            std::size_t live;
+            bool listed;
+        };
+
+        struct central_list {
+            std::mutex mutex;
+            span* partial = nullptr;
+            std::size_t spans = 0;
+        };
+
+        struct thread_cache {
+            void* head[class_count] = {};
+            std::size_t count[class_count] = {};
+
+            ~thread_cache() {
+                size_class_pool& pool = instance();
+
+                for (std::size_t k = 0; k != class_count; k++) {
+                    pool.give_back(*this, k, count[k]);
+                }
+            }
+        };
+
+        std::size_t sizes_[class_count];
+        std::size_t batch_[class_count];
+        unsigned char class_of_[max_small_size / min_alignment + 1];
+        central_list central_[class_count];
+        std::atomic<std::size_t> spans_;
+
+        // Classes step by 16 up to 128, then by a quarter of the power of two.
+        size_class_pool() : spans_(0) {
+            std::size_t k = 0;
+            for (std::size_t size = min_alignment; size <= max_small_size; k++) {
+                sizes_[k] = size;
+                batch_[k] = std::max<std::size_t>(2, std::min<std::size_t>(32, 8192 / size));
+                size += size < 128 ? min_alignment : ((std::size_t(1) << log2(size)) / 4);
+            }
+
+            std::size_t c = 0;
+            for (std::size_t i = 0; i <= max_small_size / min_alignment; i++) {
+                while (sizes_[c] < i * min_alignment) {
+                    c++;
+                }
+                class_of_[i] = static_cast<unsigned char>(c);
+            }
+        }
+
+        static unsigned log2(std::size_t x) noexcept {
+            unsigned result = 0;
+            while (x >>= 1) {
+                result++;
+            }
+            return result;
+        }
+
+        static void*& next_of(void* p) noexcept {
+            return *static_cast<void**>(p);
+        }
+
+        static span* span_of(void* p) noexcept {
+            return reinterpret_cast<span*>(reinterpret_cast<std::uintptr_t>(p) & ~(span_size - 1));
+        }
+
+        static thread_cache& local_cache() noexcept {
+            thread_local thread_cache cache;
+            return cache;
+        }
+
+        // Smallest class whose objects are aligned to @a alignment, or class_count.
+        std::size_t class_of(std::size_t bytes, std::size_t alignment) const noexcept {
+            alignment = std::max(alignment, min_alignment);
+            bytes = std::max(bytes, std::size_t(1));
+
+            if (bytes > max_small_size || alignment > max_small_size) {
+                return class_count;
+            }
+
+            bytes = (bytes + alignment - 1) & ~(alignment - 1);
+            std::size_t k = class_of_[(bytes + min_alignment - 1) / min_alignment];
+
+            while (k != class_count && sizes_[k] % alignment != 0) {
+                k++;
+            }
+            return k;
+        }
+
+        // The first object sits at a multiple of the largest power of two dividing the size.
+        std::size_t first_offset(std::size_t k) const noexcept {
+            std::size_t size = sizes_[k];
+            std::size_t align = size & (~size + 1);
+            return (sizeof(span) + align - 1) & ~(align - 1);
+        }
+
+        static void link(central_list& list, span* s) noexcept {
+            s->prev = nullptr;
+            s->next = list.partial;
+            if (list.partial != nullptr) {
+                list.partial->prev = s;
+            }
+            list.partial = s;
+            s->listed = true;
+        }
+
+        static void unlink(central_list& list, span* s) noexcept {
+            if (s->prev != nullptr) {
+                s->prev->next = s->next;
+            }
+            else {
+                list.partial = s->next;
+            }
+            if (s->next != nullptr) {
+                s->next->prev = s->prev;
+            }
+            s->listed = false;
+        }
+
+        span* new_span(std::size_t k) {
+            char* memory = static_cast<char*>(::operator new(span_size, std::align_val_t(span_size)));
+            span* s = reinterpret_cast<span*>(memory);
+            s->free = nullptr;
+            s->bump = memory + first_offset(k);
+            s->end = memory + span_size;
+            s->live = 0;
+            spans_.fetch_add(1, std::memory_order_relaxed);
+            return s;
+        }
+
+        /**
+         *  Moves @a want objects of class @a k into @a cache.  The cache's
+         *  count follows every object taken, so it stays exact if
+         *  new_span() throws part way.
+         */
+        void fetch(thread_cache& cache, std::size_t k, std::size_t want) {
+            central_list& list = central_[k];
+            std::size_t size = sizes_[k];
+            std::size_t taken = 0;
+            void*& head = cache.head[k];
+            std::lock_guard<std::mutex> lock(list.mutex);
+
+            while (taken != want) {
+                span* s = list.partial;
+
+                if (s == nullptr) {
+                    s = new_span(k);
+                    list.spans++;
+                    link(list, s);
+                }
+
+                for (; taken != want && s->free != nullptr; taken++) {
+                    void* p = s->free;
+                    s->free = next_of(p);
+                    next_of(p) = head;
+                    head = p;
+                    s->live++;
+                    cache.count[k]++;
+                }
+
+                for (; taken != want && s->bump + size <= s->end; taken++) {
+                    void* p = s->bump;
+                    s->bump += size;
+                    next_of(p) = head;
+                    head = p;
+                    s->live++;
+                    cache.count[k]++;
+                }
+
+                if (s->free == nullptr && s->bump + size > s->end) {
+                    unlink(list, s);
+                }
+            }
+        }
+
+        // Returns @a n objects of class @a k from @a cache to the central list.
+        void give_back(thread_cache& cache, std::size_t k, std::size_t n) noexcept {
+            if (n == 0) {
+                return;
+            }
+
+            central_list& list = central_[k];
+            std::lock_guard<std::mutex> lock(list.mutex);
+
+            for (std::size_t i = 0; i != n; i++) {
+                void* p = cache.head[k];
+                cache.head[k] = next_of(p);
+                span* s = span_of(p);
+
+                next_of(p) = s->free;
+                s->free = p;
+                s->live--;
+
+                if (!s->listed) {
+                    link(list, s);
+                }
+
+                if (s->live == 0 && list.spans > 1) {
+                    unlink(list, s);
+                    list.spans--;
+                    spans_.fetch_sub(1, std::memory_order_relaxed);
+                    ::operator delete(s, std::align_val_t(span_size));
+                }
+            }
+
+            cache.count[k] -= n;
+        }
+    };
+
+    /**
+     *  @brief  A stateless allocator drawing from size_class_pool::instance().
+     *
+     *  Usable as the Alloc parameter of %hash_map and the other fefu
+     *  containers; all instances compare equal.
+     */
+    template<typename T>
+    class pool_allocator {
+    public:
+        using size_type = std::size_t;
+        using difference_type = std::ptrdiff_t;
+        using pointer = T*;
+        using const_pointer = const T*;
+        using value_type = T;
+        using propagate_on_container_move_assignment = std::true_type;
+        using is_always_equal = std::true_type;
+
+        pool_allocator() noexcept = default;
+
+        pool_allocator(const pool_allocator&) noexcept = default;
+
+        template <class U>
+        pool_allocator(const pool_allocator<U>&) noexcept {};
+
+        pointer allocate(size_type n = 1) {
+            return static_cast<pointer>(size_class_pool::instance().allocate(n * sizeof(T), alignof(T)));
+        }
+
+        void deallocate(pointer p, size_type n) noexcept {
+            size_class_pool::instance().deallocate(p, n * sizeof(T), alignof(T));
+        }
+    };
+
+    template<typename T, typename U>
+    inline bool operator==(const pool_allocator<T>&, const pool_allocator<U>&) noexcept {
+        return true;
+    }
+
+    template<typename T, typename U>
+    inline bool operator!=(const pool_allocator<T>&, const pool_allocator<U>&) noexcept {
+        return false;
+    }
+
+} // namespace fefu
@@ -0,0 +1,120 @@
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <thread>
+#include <vector>
+#include "hash_map.hpp"
+#include "pool_allocator.hpp"
+#include "../catch.hpp"
+
+namespace
+{
+    struct alignas(64) cache_line {
+        char bytes[64];
+    };
+}
+
+TEST_CASE("size_class_pool classes and alignment", "[pool_allocator]") {
+    fefu::size_class_pool& pool = fefu::size_class_pool::instance();
+
+    REQUIRE(pool.class_size(1) == 16);
+    REQUIRE(pool.class_size(100) == 112);
+    REQUIRE(pool.class_size(129) == 160);
+    REQUIRE(pool.class_size(8192) == 8192);
+    REQUIRE(pool.class_size(8193) == 0);
+    REQUIRE(pool.class_size(80, 64) == 128);
+
+    fefu::pool_allocator<cache_line> alloc;
+    std::vector<cache_line*> lines;
+    for (int i = 0; i < 1000; i++) {
+        lines.push_back(alloc.allocate(1));
+        REQUIRE(reinterpret_cast<std::uintptr_t>(lines.back()) % 64 == 0);
+    }
+    for (cache_line* line : lines) {
+        alloc.deallocate(line, 1);
+    }
+
+    void* large = pool.allocate(100000, 4096);
+    REQUIRE(reinterpret_cast<std::uintptr_t>(large) % 4096 == 0);
+    pool.deallocate(large, 100000, 4096);
+}
+
+TEST_CASE("size_class_pool releases empty spans", "[pool_allocator]") {
+    fefu::size_class_pool& pool = fefu::size_class_pool::instance();
+    fefu::pool_allocator<std::uint64_t[12]> alloc;
+    std::size_t before = pool.span_count();
+
+    std::vector<std::uint64_t(*)[12]> blocks;
+    for (int i = 0; i < 20000; i++) {
+        blocks.push_back(alloc.allocate(1));
+    }
+    REQUIRE(pool.span_count() > before + 10);
+
+    std::thread freeing([&] {
+        for (auto block : blocks) {
+            alloc.deallocate(block, 1);
+        }
+    });
+    freeing.join();
+    pool.flush_thread_cache();
+
+    REQUIRE(pool.span_count() <= before + 1);
+}
+
+TEST_CASE("hash_map with pool_allocator", "[pool_allocator]") {
+    fefu::hash_map<int, int, std::hash<int>, std::equal_to<int>, fefu::pool_allocator<std::pair<const int, int>>> map;
+
+    for (int i = 0; i < 1000; i++) {
+        map[i] = -i;
+    }
+
+    auto copy = map;
+    map.clear();
+    REQUIRE(copy.size() == 1000);
+    REQUIRE(copy.at(500) == -500);
+}
+
+TEST_CASE("Allocation churn from many threads", "[pool_allocator][!benchmark]") {
+    const unsigned threads_count = std::max(2u, std::thread::hardware_concurrency());
+    const int operations = 1 << 20;
+    const std::size_t live = 1024;
+
+    auto run = [&](auto allocate, auto deallocate) {
+        std::vector<std::thread> threads;
+        for (unsigned t = 0; t < threads_count; t++) {
+            threads.emplace_back([&, t] {
+                std::mt19937 generator(t);
+                std::vector<std::pair<void*, std::size_t>> slots(live, { nullptr, 0 });
+                for (int i = 0; i < operations; i++) {
+                    auto& slot = slots[generator() % live];
+                    if (slot.first != nullptr) {
+                        deallocate(slot.first, slot.second);
+                    }
+                    slot.second = 16 + generator() % 240;
+                    slot.first = allocate(slot.second);
+                }
+                for (auto& slot : slots) {
+                    if (slot.first != nullptr) {
+                        deallocate(slot.first, slot.second);
+                    }
+                }
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+    };
+
+    BENCHMARK("std::allocator") {
+        std::allocator<char> alloc;
+        run([&](std::size_t n) -> void* { return alloc.allocate(n); },
+            [&](void* p, std::size_t n) { alloc.deallocate(static_cast<char*>(p), n); });
+    };
+
+    BENCHMARK("fefu::pool_allocator") {
+        fefu::pool_allocator<char> alloc;
+        run([&](std::size_t n) -> void* { return alloc.allocate(n); },
+            [&](void* p, std::size_t n) { alloc.deallocate(static_cast<char*>(p), n); });
+    };
+}
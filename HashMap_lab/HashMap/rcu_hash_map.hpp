@@ -0,0 +1,171 @@
+#pragma once
+#include <atomic>
+#include <mutex>
+#include <utility>
+#include "epoch.hpp"
+#include "hash_map.hpp"
+
+namespace fefu
+{
+    /**
+     *  @brief  A read-mostly map with wait-free lookups.
+     *
+     *  Readers look up keys in an immutable %hash_map snapshot without
+     *  taking locks.  Writers serialize among themselves, apply their changes
+     *  to a private copy of the current snapshot and publish it with an
+     *  atomic pointer swap; the previous snapshot is reclaimed through an
+     *  %epoch_domain once no reader can observe it.
+     *
+     *  Every update copies the table, so it suits maps that are read far
+     *  more often than they are written.  Group bursts of changes in a
+     *  single update() call.
+     */
+    template<typename K, typename T,
+        typename Hash = std::hash<K>,
+        typename Pred = std::equal_to<K>,
+        typename Alloc = allocator<std::pair<const K, T>>>
+        class rcu_hash_map
+    {
+    public:
+        using map_type = hash_map<K, T, Hash, Pred, Alloc>;
+        using key_type = typename map_type::key_type;
+        using mapped_type = typename map_type::mapped_type;
+        using value_type = typename map_type::value_type;
+        using size_type = typename map_type::size_type;
+
+        /// A pinned snapshot; the table it points to stays alive until destruction.
+        class read_view {
+        public:
+            const map_type& operator*() const noexcept {
+                return *map_;
+            }
+
+            const map_type* operator->() const noexcept {
+                return map_;
+            }
+
+        private:
+            friend class rcu_hash_map;
+
+            read_view(epoch_domain::guard&& guard, const map_type* map) noexcept
+                : guard_(std::move(guard)), map_(map) {}
+
+            epoch_domain::guard guard_;
+            const map_type* map_;
+        };
+
+        /// Default constructor.
+        rcu_hash_map() : current_(new map_type()) {}
+
+        /**
+         *  @brief  Publishes @a map as the initial snapshot.
+         *  @param  map  The initial contents.
+         */
+        explicit rcu_hash_map(map_type map) : current_(new map_type(std::move(map))) {}
+
+        rcu_hash_map(const rcu_hash_map&) = delete;
+        rcu_hash_map& operator=(const rcu_hash_map&) = delete;
+
+        ~rcu_hash_map() {
+            delete current_.load(std::memory_order_relaxed);
+        }
+
+        // lookup.
+
+        /**
+         *  @brief  Pins the current snapshot for a batch of lookups.
+         *
+         *  Updates published while the view is alive are not visible through
+         *  it.  Keep views short-lived: they delay reclamation.
+         */
+        read_view snapshot() const {
+            epoch_domain::guard guard = domain_.pin();
+            const map_type* map = current_.load(std::memory_order_seq_cst);
+
+            return read_view(std::move(guard), map);
+        }
+
+        /**
+         *  @brief  Calls @a f with the value mapped to @a k, if present.
+         *  @return  True if the key was found.
+         */
+        template<typename F>
+        bool read(const key_type& k, F&& f) const {
+            read_view view = snapshot();
+            auto position = view->find(k);
+
+            if (position == view->end()) {
+                return false;
+            }
+
+            std::forward<F>(f)(position->second);
+            return true;
+        }
+
+        /**
+         *  @brief  Copies the value mapped to @a k into @a result.
+         *  @return  True if the key was found.
+         */
+        bool find(const key_type& k, mapped_type& result) const {
+            return read(k, [&result](const mapped_type& value) { result = value; });
+        }
+
+        bool contains(const key_type& k) const {
+            return snapshot()->contains(k);
+        }
+
+        size_type size() const {
+            return snapshot()->size();
+        }
+
+        // modifiers.
+
+        /**
+         *  @brief  Applies @a f to a copy of the table and publishes it.
+         *  @param  f  A callable taking map_type&.
+         *
+         *  Concurrent writers are serialized.  If @a f throws, nothing is
+         *  published.
+         */
+        template<typename F>
+        void update(F&& f) {
+            std::lock_guard<std::mutex> lock(writer_mutex_);
+            map_type* next = new map_type(*current_.load(std::memory_order_relaxed));
+
+            try {
+                std::forward<F>(f)(*next);
+            }
+            catch (...) {
+                delete next;
+                throw;
+            }
+
+            map_type* previous = current_.exchange(next, std::memory_order_seq_cst);
+            domain_.retire(previous);
+            domain_.collect();
+        }
+
+        template<typename _Obj>
+        void insert_or_assign(const key_type& k, _Obj&& obj) {
+            update([&](map_type& map) { map.insert_or_assign(k, std::forward<_Obj>(obj)); });
+        }
+
+        size_type erase(const key_type& k) {
+            size_type erased = 0;
+            update([&](map_type& map) { erased = map.erase(k); });
+
+            return erased;
+        }
+
+        /// Reclaims snapshots that are no longer pinned by any reader.
+        void collect() {
+            domain_.collect();
+        }
+
+    private:
+        mutable epoch_domain domain_;
+        std::atomic<map_type*> current_;
+        std::mutex writer_mutex_;
+    };
+
+} // namespace fefu
@@ -0,0 +1,169 @@
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include "rcu_hash_map.hpp"
+#include "../catch.hpp"
+
+TEST_CASE("epoch_domain reclamation", "[epoch]") {
+    struct tracked {
+        std::atomic<int>* deleted;
+        ~tracked() { (*deleted)++; }
+    };
+
+    std::atomic<int> deleted(0);
+    fefu::epoch_domain domain;
+
+    SECTION("unpinned objects are reclaimed") {
+        domain.retire(new tracked{ &deleted });
+        domain.collect();
+        REQUIRE(deleted == 1);
+        REQUIRE(domain.retired_count() == 0);
+    }
+    SECTION("pinned readers delay reclamation") {
+        {
+            auto guard = domain.pin();
+            domain.retire(new tracked{ &deleted });
+            domain.collect();
+            REQUIRE(deleted == 0);
+            REQUIRE(domain.retired_count() == 1);
+        }
+        domain.collect();
+        REQUIRE(deleted == 1);
+    }
+}
+
+TEST_CASE("rcu_hash_map reads and updates", "[rcu_hash_map]") {
+    fefu::rcu_hash_map<int, int> map;
+    map.insert_or_assign(1, 10);
+    map.insert_or_assign(2, 20);
+
+    int value = 0;
+    REQUIRE(map.find(1, value));
+    REQUIRE(value == 10);
+    REQUIRE(map.size() == 2);
+
+    SECTION("snapshots are isolated from later updates") {
+        auto view = map.snapshot();
+        map.insert_or_assign(1, 11);
+        REQUIRE(view->at(1) == 10);
+        REQUIRE(map.find(1, value));
+        REQUIRE(value == 11);
+    }
+    SECTION("erase") {
+        REQUIRE(map.erase(2) == 1);
+        REQUIRE(map.erase(2) == 0);
+        REQUIRE(map.contains(2) == false);
+    }
+    SECTION("batched update") {
+        map.update([](fefu::hash_map<int, int>& m) {
+            for (int i = 0; i < 100; i++) {
+                m[i] = i;
+            }
+        });
+        REQUIRE(map.size() == 100);
+        REQUIRE(map.find(42, value));
+        REQUIRE(value == 42);
+    }
+}
+
+TEST_CASE("rcu_hash_map concurrent readers see whole updates", "[rcu_hash_map]") {
+    fefu::rcu_hash_map<int, int> map;
+    map.update([](fefu::hash_map<int, int>& m) { m[0] = 0; m[1] = 0; });
+
+    std::atomic<bool> stop(false);
+    std::atomic<bool> torn(false);
+    std::vector<std::thread> readers;
+
+    for (int t = 0; t < 4; t++) {
+        readers.emplace_back([&] {
+            while (!stop) {
+                auto view = map.snapshot();
+                if (view->at(0) != view->at(1)) {
+                    torn = true;
+                }
+            }
+        });
+    }
+
+    for (int i = 1; i <= 1000; i++) {
+        map.update([i](fefu::hash_map<int, int>& m) { m[0] = i; m[1] = i; });
+    }
+
+    stop = true;
+    for (auto& reader : readers) {
+        reader.join();
+    }
+
+    REQUIRE(torn == false);
+}
+
+TEST_CASE("rcu_hash_map reader throughput under a writer", "[rcu_hash_map][!benchmark]") {
+    const int keys = 1 << 16;
+    const int lookups_per_reader = 1 << 20;
+    const unsigned readers_count = std::max(2u, std::thread::hardware_concurrency()) - 1;
+
+    fefu::hash_map<int, int> initial;
+    initial.reserve(keys);
+    for (int i = 0; i < keys; i++) {
+        initial[i] = i;
+    }
+
+    fefu::rcu_hash_map<int, int> map(std::move(initial));
+    std::atomic<bool> stop(false);
+    std::thread writer([&] {
+        for (int i = 0; !stop; i++) {
+            map.insert_or_assign(i % keys, i);
+        }
+    });
+
+    BENCHMARK("readers, writer updating continuously") {
+        std::atomic<long long> found(0);
+        std::vector<std::thread> readers;
+
+        for (unsigned t = 0; t < readers_count; t++) {
+            readers.emplace_back([&, t] {
+                long long local = 0;
+                unsigned key = t;
+                for (int i = 0; i < lookups_per_reader; i++) {
+                    key = key * 1103515245u + 12345u;
+                    local += map.contains(static_cast<int>(key % keys));
+                }
+                found += local;
+            });
+        }
+
+        for (auto& reader : readers) {
+            reader.join();
+        }
+
+        return found.load();
+    };
+
+    BENCHMARK("readers, batched snapshot lookups") {
+        std::atomic<long long> found(0);
+        std::vector<std::thread> readers;
+
+        for (unsigned t = 0; t < readers_count; t++) {
+            readers.emplace_back([&, t] {
+                long long local = 0;
+                unsigned key = t;
+                auto view = map.snapshot();
+                for (int i = 0; i < lookups_per_reader; i++) {
+                    key = key * 1103515245u + 12345u;
+                    local += view->contains(static_cast<int>(key % keys));
+                }
+                found += local;
+            });
+        }
+
+        for (auto& reader : readers) {
+            reader.join();
+        }
+
+        return found.load();
+    };
+
+    stop = true;
+    writer.join();
+}
@@ -0,0 +1,639 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include "hash_map.hpp"
+
+namespace fefu
+{
+    /**
+     *  @brief  A %hash_map for keys with values reserved to mark free buckets.
+     *
+     *  The user gives up one key value, the empty key, and optionally a
+     *  second one, the deleted key.  A bucket is a plain {key, value} pair
+     *  whose key is the empty key while the bucket is free, so there is no
+     *  occupancy bitmap: a probe reads one array.  Probing is linear over a
+     *  power-of-two table, so a lookup usually stays within one cache line.
+     *
+     *  With a deleted key, erase() leaves it behind as a tombstone.  Without
+     *  one, erase() shifts the rest of the cluster back; this moves later
+     *  elements, so it invalidates iterators to them, and a cluster that
+     *  wraps past the end of the table can bring an element from its start
+     *  back in front of a loop erasing while it iterates.
+     *
+     *  Meant for integral keys; the key type must be trivially copyable.
+     *  Inserting a reserved key throws std::invalid_argument.  Iterators
+     *  yield a pair of references, as those of %split_hash_map do.
+     */
+    template<typename K, typename T,
+        typename Hash = std::hash<K>,
+        typename Pred = std::equal_to<K>,
+        typename Alloc = allocator<std::pair<const K, T>>>
+        class sentinel_hash_map
+    {
+        static_assert(std::is_trivially_copyable<K>::value, "sentinel_hash_map needs trivially copyable keys");
+
+    public:
+        using key_type = K;
+        using mapped_type = T;
+        using hasher = Hash;
+        using key_equal = Pred;
+        using allocator_type = Alloc;
+        using value_type = std::pair<const key_type, mapped_type>;
+        using reference = std::pair<const key_type&, mapped_type&>;
+        using const_reference = std::pair<const key_type&, const mapped_type&>;
+        using size_type = std::size_t;
+
+    private:
+        /// A bucket; value is alive only while key is not a reserved key.
+        struct slot {
+            K key;
+            union {
+                T value;
+            };
+
+            slot() noexcept {}
+            ~slot() {}
+        };
+
+        using alloc_traits = std::allocator_traits<Alloc>;
+        using slot_allocator = typename alloc_traits::template rebind_alloc<slot>;
+        using slot_traits = std::allocator_traits<slot_allocator>;
+
+        template<bool Const>
+        class basic_iterator {
+            using slot_pointer = typename std::conditional<Const, const slot*, slot*>::type;
+
+        public:
+            using iterator_category = std::forward_iterator_tag;
+            using value_type = sentinel_hash_map::value_type;
+            using difference_type = std::ptrdiff_t;
+            using reference = typename std::conditional<Const, sentinel_hash_map::const_reference, sentinel_hash_map::reference>::type;
+
+            /// Keeps the pair of references alive for operator->.
+            struct pointer {
+                reference ref;
+
+                const reference* operator->() const noexcept {
+                    return &ref;
+                }
+            };
+
+            basic_iterator() noexcept : map_(nullptr), slot_(nullptr) {}
+
+            template<bool C = Const, typename = typename std::enable_if<C>::type>
+            basic_iterator(const basic_iterator<false>& other) noexcept : map_(other.map_), slot_(other.slot_) {}
+
+            reference operator*() const {
+                return reference(slot_->key, slot_->value);
+            }
+
+            pointer operator->() const {
+                return pointer{ **this };
+            }
+
+            basic_iterator& operator++() {
+                slot_ = map_->next_live(slot_ + 1);
+                return *this;
+            }
+
+            basic_iterator operator++(int) {
+                basic_iterator previous(*this);
+                ++(*this);
+                return previous;
+            }
+
+            friend bool operator==(const basic_iterator& lhs, const basic_iterator& rhs) {
+                return lhs.slot_ == rhs.slot_;
+            }
+
+            friend bool operator!=(const basic_iterator& lhs, const basic_iterator& rhs) {
+                return lhs.slot_ != rhs.slot_;
+            }
+
+        private:
+            friend class sentinel_hash_map;
+            friend class basic_iterator<true>;
+
+            const sentinel_hash_map* map_;
+            slot_pointer slot_;
+
+            basic_iterator(const sentinel_hash_map* map, slot_pointer s) noexcept : map_(map), slot_(s) {}
+        };
+
+    public:
+        using iterator = basic_iterator<false>;
+        using const_iterator = basic_iterator<true>;
+
+        /// Creates an empty map whose free buckets hold @a empty_key; erase() shifts.
+        explicit sentinel_hash_map(const key_type& empty_key, const allocator_type& a = allocator_type())
+            : sentinel_hash_map(empty_key, empty_key, false, a) {}
+
+        /// Creates an empty map with @a empty_key and a @a deleted_key for tombstones.
+        sentinel_hash_map(const key_type& empty_key, const key_type& deleted_key, const allocator_type& a = allocator_type())
+            : sentinel_hash_map(empty_key, deleted_key, true, a) {
+            if (equal_(empty_key, deleted_key)) {
+                throw std::invalid_argument("sentinel_hash_map: the empty and deleted keys must differ");
+            }
+        }
+
+        sentinel_hash_map(const sentinel_hash_map& other)
+            : allocator_(alloc_traits::select_on_container_copy_construction(other.allocator_)), size_(0), tombstones_(0),
+            mask_(0), max_load_factor_(other.max_load_factor_), slots_(nullptr), empty_key_(other.empty_key_),
+            deleted_key_(other.deleted_key_), has_deleted_(other.has_deleted_), hash_(other.hash_), equal_(other.equal_) {
+            copy_table(other);
+        }
+
+        sentinel_hash_map(sentinel_hash_map&& other) noexcept
+            : allocator_(std::move(other.allocator_)), size_(0), tombstones_(0), mask_(0), max_load_factor_(other.max_load_factor_),
+            slots_(nullptr), empty_key_(other.empty_key_), deleted_key_(other.deleted_key_), has_deleted_(other.has_deleted_),
+            hash_(other.hash_), equal_(other.equal_) {
+            swap_table(other);
+        }
+
+        sentinel_hash_map& operator=(const sentinel_hash_map& other) {
+            if (this != &other) {
+                destroy();
+                if constexpr (alloc_traits::propagate_on_container_copy_assignment::value) {
+                    allocator_ = other.allocator_;
+                }
+                copy_settings(other);
+                copy_table(other);
+            }
+            return *this;
+        }
+
+        sentinel_hash_map& operator=(sentinel_hash_map&& other) {
+            if (this == &other) {
+                return *this;
+            }
+
+            destroy();
+            copy_settings(other);
+
+            if constexpr (alloc_traits::propagate_on_container_move_assignment::value) {
+                allocator_ = std::move(other.allocator_);
+                swap_table(other);
+            }
+            else if (allocator_ == other.allocator_) {
+                swap_table(other);
+            }
+            else {
+                copy_table(other);
+                other.clear();
+            }
+            return *this;
+        }
+
+        ~sentinel_hash_map() {
+            destroy();
+        }
+
+        allocator_type get_allocator() const noexcept {
+            return allocator_;
+        }
+
+        //@{
+        /// The reserved keys.
+        const key_type& empty_key() const noexcept {
+            return empty_key_;
+        }
+
+        /// Returns the deleted key, or throws std::logic_error if there is none.
+        const key_type& deleted_key() const {
+            if (!has_deleted_) {
+                throw std::logic_error("sentinel_hash_map: no deleted key");
+            }
+            return deleted_key_;
+        }
+        //@}
+
+        bool empty() const noexcept {
+            return size_ == 0;
+        }
+
+        size_type size() const noexcept {
+            return size_;
+        }
+
+        /// Returns the bytes used by the map; there is no metadata.
+        memory_footprint memory_usage() const noexcept {
+            memory_footprint footprint;
+            footprint.object = sizeof(*this);
+            footprint.slots = bucket_count() * sizeof(slot);
+            return footprint;
+        }
+
+        //@{
+        iterator begin() noexcept {
+            return iterator(this, next_live(slots_));
+        }
+
+        const_iterator begin() const noexcept {
+            return const_iterator(this, next_live(slots_));
+        }
+
+        const_iterator cbegin() const noexcept {
+            return begin();
+        }
+
+        iterator end() noexcept {
+            return iterator(this, slots_ + bucket_count());
+        }
+
+        const_iterator end() const noexcept {
+            return const_iterator(this, slots_ + bucket_count());
+        }
+
+        const_iterator cend() const noexcept {
+            return end();
+        }
+        //@}
+
+        /**
+         *  @brief  Inserts an element with key @a k and a value constructed
+         *          from @a args if @a k is absent.
+         *  @return  A pair of an iterator to the element with key @a k and a
+         *           bool that is true if the element was inserted.
+         *  @throw  std::invalid_argument if @a k is a reserved key.
+         */
+        template<typename... Args>
+        std::pair<iterator, bool> try_emplace(const key_type& k, Args&&... args) {
+            if (is_reserved(k)) {
+                throw std::invalid_argument("sentinel_hash_map: cannot insert a reserved key");
+            }
+
+            slot* found = find_slot(k);
+            if (found != nullptr) {
+                return { iterator(this, found), false };
+            }
+
+            // Only an actual insertion may rehash.
+            if (size_ + tombstones_ + 1 > bucket_count() * max_load_factor_) {
+                // Tombstones alone are cleared by a rehash at the same size.
+                rehash(size_ + 1 > bucket_count() * max_load_factor_ / 2 ? bucket_count() * 2 : bucket_count());
+            }
+
+            // The key is absent, so it goes into the first free bucket or tombstone.
+            size_type pos = home_of(k, mask_);
+            while (is_live(slots_[pos])) {
+                pos = (pos + 1) & mask_;
+            }
+            bool reuse = !equal_(slots_[pos].key, empty_key_);
+
+            new (&slots_[pos].value) T(std::forward<Args>(args)...);
+            slots_[pos].key = k;
+            tombstones_ -= reuse ? 1 : 0;
+            size_++;
+
+            return { iterator(this, slots_ + pos), true };
+        }
+
+        std::pair<iterator, bool> insert(const value_type& x) {
+            return try_emplace(x.first, x.second);
+        }
+
+        std::pair<iterator, bool> insert(value_type&& x) {
+            return try_emplace(x.first, std::move(x.second));
+        }
+
+        template<typename Obj>
+        std::pair<iterator, bool> insert_or_assign(const key_type& k, Obj&& obj) {
+            slot* s = find_slot(k);
+            if (s != nullptr) {
+                s->value = std::forward<Obj>(obj);
+                return { iterator(this, s), false };
+            }
+            return try_emplace(k, std::forward<Obj>(obj));
+        }
+
+        mapped_type& operator[](const key_type& k) {
+            return try_emplace(k).first.slot_->value;
+        }
+
+        //@{
+        /// Returns the value of @a k, or throws std::out_of_range.
+        mapped_type& at(const key_type& k) {
+            slot* s = find_slot(k);
+            if (s == nullptr) {
+                throw std::out_of_range("sentinel_hash_map::at");
+            }
+            return s->value;
+        }
+
+        const mapped_type& at(const key_type& k) const {
+            const slot* s = find_slot(k);
+            if (s == nullptr) {
+                throw std::out_of_range("sentinel_hash_map::at");
+            }
+            return s->value;
+        }
+        //@}
+
+        //@{
+        iterator find(const key_type& k) {
+            slot* s = find_slot(k);
+            return s == nullptr ? end() : iterator(this, s);
+        }
+
+        const_iterator find(const key_type& k) const {
+            const slot* s = find_slot(k);
+            return s == nullptr ? end() : const_iterator(this, s);
+        }
+        //@}
+
+        bool contains(const key_type& k) const {
+            return find_slot(k) != nullptr;
+        }
+
+        size_type count(const key_type& k) const {
+            return contains(k) ? 1 : 0;
+        }
+
+        /**
+         *  @brief  Erases the element at @a position.
+         *  @return  An iterator to the next element.  Without a deleted key
+         *           that may be an element shifted into @a position, and if
+         *           the cluster wraps, one from the start of the table that
+         *           an iteration has already visited.  Give the map a
+         *           deleted key when a loop must see every element once.
+         */
+        iterator erase(const_iterator position) {
+            slot* s = const_cast<slot*>(position.slot_);
+            erase_slot(s);
+            return iterator(this, next_live(s));
+        }
+
+        /// Erases the element with key @a k; returns the number erased.
+        size_type erase(const key_type& k) {
+            slot* s = find_slot(k);
+            if (s == nullptr) {
+                return 0;
+            }
+            erase_slot(s);
+            return 1;
+        }
+
+        /// Erases every element; the buckets are kept.
+        void clear() noexcept {
+            for (size_type i = 0; i != bucket_count(); i++) {
+                if (is_live(slots_[i])) {
+                    slots_[i].value.~T();
+                }
+                slots_[i].key = empty_key_;
+            }
+            size_ = 0;
+            tombstones_ = 0;
+        }
+
+        void swap(sentinel_hash_map& x) noexcept {
+            if constexpr (alloc_traits::propagate_on_container_swap::value) {
+                using std::swap;
+                swap(allocator_, x.allocator_);
+            }
+            std::swap(max_load_factor_, x.max_load_factor_);
+            std::swap(empty_key_, x.empty_key_);
+            std::swap(deleted_key_, x.deleted_key_);
+            std::swap(has_deleted_, x.has_deleted_);
+            std::swap(hash_, x.hash_);
+            std::swap(equal_, x.equal_);
+            swap_table(x);
+        }
+
+        size_type bucket_count() const noexcept {
+            return slots_ == nullptr ? 0 : mask_ + 1;
+        }
+
+        float load_factor() const noexcept {
+            return bucket_count() == 0 ? 0 : static_cast<float>(size_) / bucket_count();
+        }
+
+        float max_load_factor() const noexcept {
+            return max_load_factor_;
+        }
+
+        void max_load_factor(float z) {
+            max_load_factor_ = z;
+        }
+
+        /// Rebuilds the table with at least @a n buckets, rounded up to a
+        /// power of two, and drops the tombstones.
+        void rehash(size_type n) {
+            n = std::max({ n, static_cast<size_type>(std::ceil(size_ / max_load_factor_)) + 1, size_type(8) });
+
+            size_type new_count = 1;
+            while (new_count < n) {
+                new_count *= 2;
+            }
+
+            slot_allocator slot_alloc(allocator_);
+            slot* new_slots = slot_traits::allocate(slot_alloc, new_count);
+            for (size_type i = 0; i != new_count; i++) {
+                new (new_slots + i) slot();
+                new_slots[i].key = empty_key_;
+            }
+
+            // The old elements stay in place until every one has been moved,
+            // so a throwing copy leaves the map as it was.
+            size_type new_mask = new_count - 1;
+            try {
+                for (size_type i = 0; i != bucket_count(); i++) {
+                    slot& s = slots_[i];
+                    if (is_live(s)) {
+                        size_type pos = home_of(s.key, new_mask);
+                        while (!equal_(new_slots[pos].key, empty_key_)) {
+                            pos = (pos + 1) & new_mask;
+                        }
+
+                        new (&new_slots[pos].value) T(std::move_if_noexcept(s.value));
+                        new_slots[pos].key = s.key;
+                    }
+                }
+            }
+            catch (...) {
+                for (size_type i = 0; i != new_count; i++) {
+                    if (is_live(new_slots[i])) {
+                        new_slots[i].value.~T();
+                    }
+                    new_slots[i].~slot();
+                }
+                slot_traits::deallocate(slot_alloc, new_slots, new_count);
+                throw;
+            }
+
+            size_type size = size_;
+            destroy();
+
+            size_ = size;
+            mask_ = new_mask;
+            slots_ = new_slots;
+        }
+
+        /// Same as rehash(ceil(n / max_load_factor())).
+        void reserve(size_type n) {
+            rehash(static_cast<size_type>(std::ceil(n / max_load_factor_)));
+        }
+
+    private:
+        allocator_type allocator_;
+        size_type size_;
+        size_type tombstones_;
+        size_type mask_;
+        float max_load_factor_;
+        slot* slots_;
+        key_type empty_key_;
+        key_type deleted_key_;
+        bool has_deleted_;
+        Hash hash_;
+        key_equal equal_;
+
+        sentinel_hash_map(const key_type& empty_key, const key_type& deleted_key, bool has_deleted, const allocator_type& a)
+            : allocator_(a), size_(0), tombstones_(0), mask_(0), max_load_factor_(0.5), slots_(nullptr),
+            empty_key_(empty_key), deleted_key_(deleted_key), has_deleted_(has_deleted), hash_(), equal_() {}
+
+        size_type home_of(const key_type& k, size_type mask) const {
+            return static_cast<size_type>(detail::mix(hash_(k))) & mask;
+        }
+
+        bool is_reserved(const key_type& k) const {
+            return equal_(k, empty_key_) || (has_deleted_ && equal_(k, deleted_key_));
+        }
+
+        bool is_live(const slot& s) const {
+            return !is_reserved(s.key);
+        }
+
+        // First live bucket at or after @a s, or the end of the table.
+        template<typename SlotPointer>
+        SlotPointer next_live(SlotPointer s) const noexcept {
+            SlotPointer last = slots_ + bucket_count();
+            while (s != last && !is_live(*s)) {
+                ++s;
+            }
+            return s;
+        }
+
+        //@{
+        slot* find_slot(const key_type& k) {
+            return const_cast<slot*>(static_cast<const sentinel_hash_map*>(this)->find_slot(k));
+        }
+
+        const slot* find_slot(const key_type& k) const {
+            if (size_ == 0 || is_reserved(k)) {
+                return nullptr;
+            }
+
+            for (size_type pos = home_of(k, mask_);; pos = (pos + 1) & mask_) {
+                const slot& s = slots_[pos];
+
+                if (equal_(s.key, k)) {
+                    return &s;
+                }
+                if (equal_(s.key, empty_key_)) {
+                    return nullptr;
+                }
+            }
+        }
+        //@}
+
+        void erase_slot(slot* s) {
+            s->value.~T();
+            size_--;
+
+            if (has_deleted_) {
+                s->key = deleted_key_;
+                tombstones_++;
+                return;
+            }
+
+            size_type hole = detail::backward_shift(static_cast<size_type>(s - slots_), mask_,
+                [this](size_type pos) { return equal_(slots_[pos].key, empty_key_); },
+                [this](size_type pos) { return home_of(slots_[pos].key, mask_); },
+                [this](size_type from, size_type to) {
+                    new (&slots_[to].value) T(std::move(slots_[from].value));
+                    slots_[to].key = slots_[from].key;
+                    slots_[from].value.~T();
+                });
+            slots_[hole].key = empty_key_;
+        }
+
+        void copy_settings(const sentinel_hash_map& other) {
+            max_load_factor_ = other.max_load_factor_;
+            empty_key_ = other.empty_key_;
+            deleted_key_ = other.deleted_key_;
+            has_deleted_ = other.has_deleted_;
+            hash_ = other.hash_;
+            equal_ = other.equal_;
+        }
+
+        // Copies @a other into this empty map bucket by bucket.
+        void copy_table(const sentinel_hash_map& other) {
+            if (other.slots_ == nullptr) {
+                return;
+            }
+
+            slot_allocator slot_alloc(allocator_);
+            size_type count = other.bucket_count();
+            slots_ = slot_traits::allocate(slot_alloc, count);
+            mask_ = count - 1;
+
+            for (size_type i = 0; i != count; i++) {
+                new (slots_ + i) slot();
+                slots_[i].key = empty_key_;
+            }
+
+            try {
+                for (size_type i = 0; i != count; i++) {
+                    const slot& s = other.slots_[i];
+                    if (other.is_live(s)) {
+                        new (&slots_[i].value) T(s.value);
+                        size_++;
+                    }
+                    slots_[i].key = s.key;
+                }
+            }
+            catch (...) {
+                destroy();
+                throw;
+            }
+            tombstones_ = other.tombstones_;
+        }
+
+        void swap_table(sentinel_hash_map& x) noexcept {
+            std::swap(size_, x.size_);
+            std::swap(tombstones_, x.tombstones_);
+            std::swap(mask_, x.mask_);
+            std::swap(slots_, x.slots_);
+        }
+
+        /// Destroys the elements and releases the buckets.
+        void destroy() noexcept {
+            if (slots_ != nullptr) {
+                size_type count = bucket_count();
+                for (size_type i = 0; i != count; i++) {
+                    if (is_live(slots_[i])) {
+                        slots_[i].value.~T();
+                    }
+                    slots_[i].~slot();
+                }
+
+                slot_allocator slot_alloc(allocator_);
+                slot_traits::deallocate(slot_alloc, slots_, count);
+            }
+
+            size_ = 0;
+            tombstones_ = 0;
+            mask_ = 0;
+            slots_ = nullptr;
+        }
+    };
+
+} // namespace fefu
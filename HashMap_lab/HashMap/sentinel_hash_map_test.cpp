@@ -0,0 +1,204 @@
+#include <cstdint>
+#include <limits>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <unordered_set>
+#include <vector>
+#include "hash_map.hpp"
+#include "sentinel_hash_map.hpp"
+#include "../catch.hpp"
+
+namespace
+{
+    template<typename Key>
+    void benchmark_layouts(const char* name) {
+        const std::size_t elements = 1 << 20;
+        const std::size_t lookups = 1 << 22;
+        const Key empty = std::numeric_limits<Key>::max();
+
+        std::mt19937_64 generator(9);
+        std::vector<Key> keys(2 * elements);
+        for (auto& key : keys) {
+            key = static_cast<Key>(generator() % empty);
+        }
+
+        std::vector<Key> probes(lookups);
+        for (auto& probe : probes) {
+            probe = keys[generator() % keys.size()];
+        }
+
+        fefu::hash_map<Key, std::uint64_t> map;
+        fefu::sentinel_hash_map<Key, std::uint64_t> sentinel(empty);
+
+        BENCHMARK(std::string("hash_map insert, ") + name) {
+            map = fefu::hash_map<Key, std::uint64_t>();
+            for (std::size_t i = 0; i < elements; i++) {
+                map[keys[i]] = i;
+            }
+            return map.size();
+        };
+
+        BENCHMARK(std::string("sentinel_hash_map insert, ") + name) {
+            sentinel = fefu::sentinel_hash_map<Key, std::uint64_t>(empty);
+            for (std::size_t i = 0; i < elements; i++) {
+                sentinel[keys[i]] = i;
+            }
+            return sentinel.size();
+        };
+
+        WARN(name << " keys: hash_map " << map.memory_usage().total() / (1 << 20) << " MiB, sentinel_hash_map "
+            << sentinel.memory_usage().total() / (1 << 20) << " MiB");
+
+        BENCHMARK(std::string("hash_map find, ") + name) {
+            std::uint64_t hits = 0;
+            for (Key key : probes) {
+                hits += map.find(key) != map.end();
+            }
+            return hits;
+        };
+
+        BENCHMARK(std::string("sentinel_hash_map find, ") + name) {
+            std::uint64_t hits = 0;
+            for (Key key : probes) {
+                hits += sentinel.find(key) != sentinel.end();
+            }
+            return hits;
+        };
+    }
+}
+
+TEST_CASE("sentinel_hash_map basic operations", "[sentinel_hash_map]") {
+    fefu::sentinel_hash_map<std::uint64_t, std::string> map(0);
+    REQUIRE(map.empty());
+    REQUIRE(map.empty_key() == 0);
+    REQUIRE_THROWS_AS(map.deleted_key(), std::logic_error);
+    REQUIRE_THROWS_AS(map[0], std::invalid_argument);
+    REQUIRE_FALSE(map.contains(0));
+
+    for (std::uint64_t i = 1; i <= 1000; i++) {
+        REQUIRE(map.insert({ i, std::to_string(i) }).second);
+    }
+    REQUIRE_FALSE(map.try_emplace(7, "x").second);
+    REQUIRE(map.size() == 1000);
+    REQUIRE(map.at(1000) == "1000");
+    REQUIRE_THROWS_AS(map.at(1001), std::out_of_range);
+    REQUIRE(map.memory_usage().metadata == 0);
+
+    map.find(5)->second = "five";
+    REQUIRE(map[5] == "five");
+    REQUIRE_FALSE(map.insert_or_assign(6, "six").second);
+
+    SECTION("copy, move and swap") {
+        auto copy = map;
+        REQUIRE(copy.at(6) == "six");
+
+        fefu::sentinel_hash_map<std::uint64_t, std::string> moved(std::move(copy));
+        REQUIRE(copy.empty());
+        REQUIRE(moved.size() == 1000);
+
+        copy = std::move(moved);
+        copy.swap(moved);
+        REQUIRE(copy.empty());
+        REQUIRE(moved.at(1) == "1");
+    }
+    SECTION("clear") {
+        map.clear();
+        REQUIRE(map.begin() == map.end());
+        map[3] = "three";
+        REQUIRE(map.size() == 1);
+    }
+    SECTION("looking up a present key keeps iterators valid") {
+        map.max_load_factor(0.01f);
+        auto first = map.begin();
+        std::size_t buckets = map.bucket_count();
+        REQUIRE_FALSE(map.try_emplace((*first).first, "x").second);
+        map[(*first).first] += "!";
+        REQUIRE(map.bucket_count() == buckets);
+        REQUIRE(first == map.begin());
+    }
+}
+
+TEST_CASE("sentinel_hash_map erase with and without a deleted key", "[sentinel_hash_map]") {
+    fefu::sentinel_hash_map<std::uint32_t, std::uint32_t> shifting(~0u);
+    fefu::sentinel_hash_map<std::uint32_t, std::uint32_t> tombstones(~0u, ~0u - 1);
+    REQUIRE_THROWS_AS((fefu::sentinel_hash_map<int, int>(1, 1)), std::invalid_argument);
+    REQUIRE_THROWS_AS(tombstones[~0u - 1], std::invalid_argument);
+
+    std::mt19937 generator(1);
+    std::unordered_set<std::uint32_t> reference;
+
+    for (int round = 0; round < 100000; round++) {
+        std::uint32_t key = generator() % 2000;
+        if (generator() % 3 == 0) {
+            std::size_t erased = reference.erase(key);
+            REQUIRE(shifting.erase(key) == erased);
+            REQUIRE(tombstones.erase(key) == erased);
+        }
+        else {
+            bool inserted = reference.insert(key).second;
+            REQUIRE(shifting.try_emplace(key, key).second == inserted);
+            REQUIRE(tombstones.try_emplace(key, key).second == inserted);
+        }
+    }
+
+    REQUIRE(shifting.size() == reference.size());
+    REQUIRE(tombstones.size() == reference.size());
+    for (std::uint32_t key = 0; key < 2000; key++) {
+        REQUIRE(shifting.count(key) == reference.count(key));
+        REQUIRE(tombstones.count(key) == reference.count(key));
+    }
+
+    std::size_t visited = 0;
+    for (auto element : tombstones) {
+        REQUIRE(element.first == element.second);
+        visited++;
+    }
+    REQUIRE(visited == reference.size());
+
+    for (auto it = shifting.begin(); it != shifting.end();) {
+        it = shifting.erase(it);
+    }
+    REQUIRE(shifting.empty());
+}
+
+namespace
+{
+    // Copying throws once copies_left reaches zero; the move may throw, so rehash copies.
+    struct fragile {
+        static int copies_left;
+        int value;
+
+        explicit fragile(int v) : value(v) {}
+        fragile(const fragile& other) : value(other.value) {
+            if (copies_left-- == 0) {
+                throw std::runtime_error("copy failed");
+            }
+        }
+        fragile(fragile&& other) noexcept(false) : value(other.value) {}
+    };
+
+    int fragile::copies_left = 0;
+}
+
+TEST_CASE("sentinel_hash_map rehash keeps the map when a copy throws", "[sentinel_hash_map]") {
+    fefu::sentinel_hash_map<int, fragile> map(-1);
+    fragile::copies_left = 1000;
+    for (int i = 0; i < 100; i++) {
+        map.try_emplace(i, i);
+    }
+    std::size_t buckets = map.bucket_count();
+
+    fragile::copies_left = 50;
+    REQUIRE_THROWS_AS(map.rehash(4 * buckets), std::runtime_error);
+    REQUIRE(map.bucket_count() == buckets);
+    REQUIRE(map.size() == 100);
+    for (int i = 0; i < 100; i++) {
+        REQUIRE(map.at(i).value == i);
+    }
+}
+
+TEST_CASE("Sentinel keys versus the bitmap layout", "[sentinel_hash_map][!benchmark]") {
+    benchmark_layouts<std::uint32_t>("32-bit");
+    benchmark_layouts<std::uint64_t>("64-bit");
+}
@@ -0,0 +1,385 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <istream>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "thread_pool.hpp"
+
+namespace fefu
+{
+    /// Appends encoded data to a string.
+    class byte_writer {
+    public:
+        explicit byte_writer(std::string& out) noexcept : out_(&out) {}
+
+        void write(const void* data, std::size_t size) {
+            out_->append(static_cast<const char*>(data), size);
+        }
+
+        /// Writes @a value in LEB128: 7 bits per byte, low bits first.
+        void varint(std::uint64_t value) {
+            char buffer[10];
+            std::size_t size = 0;
+
+            while (value >= 0x80) {
+                buffer[size++] = static_cast<char>(value | 0x80);
+                value >>= 7;
+            }
+            buffer[size++] = static_cast<char>(value);
+            out_->append(buffer, size);
+        }
+
+    private:
+        std::string* out_;
+    };
+
+    /// Decodes data from a byte range.
+    class byte_reader {
+    public:
+        byte_reader(const char* data, std::size_t size) noexcept : ptr_(data), end_(data + size) {}
+
+        void read(void* data, std::size_t size) {
+            if (static_cast<std::size_t>(end_ - ptr_) < size) {
+                truncated();
+            }
+            std::memcpy(data, ptr_, size);
+            ptr_ += size;
+        }
+
+        std::uint64_t varint() {
+            std::uint64_t value = 0;
+
+            for (unsigned shift = 0; shift < 64; shift += 7) {
+                if (ptr_ == end_) {
+                    truncated();
+                }
+
+                std::uint64_t byte = static_cast<unsigned char>(*ptr_++);
+                value |= (byte & 0x7f) << shift;
+
+                if (byte < 0x80) {
+                    return value;
+                }
+            }
+
+            throw std::runtime_error("fefu::load: malformed varint");
+        }
+
+        bool done() const noexcept {
+            return ptr_ == end_;
+        }
+
+    private:
+        const char* ptr_;
+        const char* end_;
+
+        [[noreturn]] static void truncated() {
+            throw std::runtime_error("fefu::load: truncated data");
+        }
+    };
+
+    /// Maps signed integers to unsigned ones so that small magnitudes stay small.
+    inline std::uint64_t zigzag(std::int64_t value) noexcept {
+        return (static_cast<std::uint64_t>(value) << 1) ^ static_cast<std::uint64_t>(value >> 63);
+    }
+
+    inline std::int64_t unzigzag(std::uint64_t value) noexcept {
+        return static_cast<std::int64_t>(value >> 1) ^ -static_cast<std::int64_t>(value & 1);
+    }
+
+    /**
+     *  @brief  Encodes values of type T for save() and load().
+     *
+     *  A codec has
+     *      void write(byte_writer&, const T&) const;
+     *      T read(byte_reader&) const;
+     *  and, if keys of type T may be delta-encoded, also
+     *      void write_delta(byte_writer&, const T& previous, const T& value) const;
+     *      T read_delta(byte_reader&, const T& previous) const;
+     *  for keys written in ascending std::less order.  Specialize codec or
+     *  pass a codec object to save() and load() for other types.
+     */
+    template<typename T, typename = void>
+    struct codec;
+
+    /// Integers as varints, signed ones zigzag-encoded.
+    template<typename T>
+    struct codec<T, typename std::enable_if<std::is_integral<T>::value>::type> {
+        using unsigned_type = typename std::make_unsigned<T>::type;
+
+        void write(byte_writer& out, T value) const {
+            out.varint(std::is_signed<T>::value ? zigzag(static_cast<std::int64_t>(value)) : static_cast<std::uint64_t>(value));
+        }
+
+        T read(byte_reader& in) const {
+            std::uint64_t value = in.varint();
+            return std::is_signed<T>::value ? static_cast<T>(unzigzag(value)) : static_cast<T>(value);
+        }
+
+        void write_delta(byte_writer& out, T previous, T value) const {
+            out.varint(static_cast<unsigned_type>(static_cast<unsigned_type>(value) - static_cast<unsigned_type>(previous)));
+        }
+
+        T read_delta(byte_reader& in, T previous) const {
+            return static_cast<T>(static_cast<unsigned_type>(static_cast<unsigned_type>(previous) + in.varint()));
+        }
+    };
+
+    /// Floating-point numbers as their raw bytes; both ends must share the representation.
+    template<typename T>
+    struct codec<T, typename std::enable_if<std::is_floating_point<T>::value>::type> {
+        void write(byte_writer& out, T value) const {
+            out.write(&value, sizeof(value));
+        }
+
+        T read(byte_reader& in) const {
+            T value;
+            in.read(&value, sizeof(value));
+            return value;
+        }
+    };
+
+    /// Strings as a varint length followed by the characters.
+    template<>
+    struct codec<std::string> {
+        void write(byte_writer& out, const std::string& value) const {
+            out.varint(value.size());
+            out.write(value.data(), value.size());
+        }
+
+        std::string read(byte_reader& in) const {
+            std::string value(static_cast<std::size_t>(in.varint()), '\0');
+            in.read(&value[0], value.size());
+            return value;
+        }
+    };
+
+    template<typename A, typename B>
+    struct codec<std::pair<A, B>> {
+        void write(byte_writer& out, const std::pair<A, B>& value) const {
+            codec<A>().write(out, value.first);
+            codec<B>().write(out, value.second);
+        }
+
+        std::pair<A, B> read(byte_reader& in) const {
+            A first = codec<A>().read(in);
+            return std::pair<A, B>(std::move(first), codec<B>().read(in));
+        }
+    };
+
+    namespace detail
+    {
+        constexpr char snapshot_magic[8] = { 'F', 'E', 'F', 'U', 'S', 'N', 'A', 'P' };
+        constexpr std::uint64_t snapshot_version = 1;
+
+        template<typename Codec, typename = void>
+        struct has_delta : std::false_type {};
+
+        template<typename Codec>
+        struct has_delta<Codec, decltype(void(&Codec::write_delta))> : std::true_type {};
+
+        inline void write_varint(std::ostream& out, std::uint64_t value) {
+            std::string buffer;
+            byte_writer(buffer).varint(value);
+            out.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+        }
+
+        inline std::uint64_t read_varint(std::istream& in) {
+            std::uint64_t value = 0;
+
+            for (unsigned shift = 0; shift < 64; shift += 7) {
+                int byte = in.get();
+                if (byte == std::char_traits<char>::eof()) {
+                    throw std::runtime_error("fefu::load: truncated data");
+                }
+
+                value |= static_cast<std::uint64_t>(byte & 0x7f) << shift;
+                if (byte < 0x80) {
+                    return value;
+                }
+            }
+
+            throw std::runtime_error("fefu::load: malformed varint");
+        }
+
+        template<typename Element, typename KeyCodec, typename ValueCodec>
+        void encode_chunk(std::string& out, std::vector<const Element*>& chunk, const KeyCodec& keys, const ValueCodec& values) {
+            byte_writer writer(out);
+
+            if constexpr (has_delta<KeyCodec>::value) {
+                std::sort(chunk.begin(), chunk.end(), [](const Element* a, const Element* b) { return a->first < b->first; });
+            }
+
+            for (std::size_t i = 0; i != chunk.size(); i++) {
+                if constexpr (has_delta<KeyCodec>::value) {
+                    if (i != 0) {
+                        keys.write_delta(writer, chunk[i - 1]->first, chunk[i]->first);
+                    }
+                    else {
+                        keys.write(writer, chunk[i]->first);
+                    }
+                }
+                else {
+                    keys.write(writer, chunk[i]->first);
+                }
+
+                values.write(writer, chunk[i]->second);
+            }
+        }
+
+        template<typename KeyCodec, typename Decoded>
+        auto read_key(byte_reader& reader, const KeyCodec& keys, const Decoded& decoded) {
+            if constexpr (has_delta<KeyCodec>::value) {
+                if (!decoded.empty()) {
+                    return keys.read_delta(reader, decoded.back().first);
+                }
+            }
+            return keys.read(reader);
+        }
+
+        template<typename K, typename T, typename KeyCodec, typename ValueCodec>
+        void decode_chunk(const std::string& payload, std::size_t count, std::vector<std::pair<K, T>>& out,
+            const KeyCodec& keys, const ValueCodec& values) {
+            byte_reader reader(payload.data(), payload.size());
+            out.reserve(count);
+
+            for (std::size_t i = 0; i != count; i++) {
+                K key = read_key(reader, keys, out);
+                T value = values.read(reader);
+                out.emplace_back(std::move(key), std::move(value));
+            }
+
+            if (!reader.done()) {
+                throw std::runtime_error("fefu::load: chunk has trailing bytes");
+            }
+        }
+    } // namespace detail
+
+    /**
+     *  @brief  Writes the elements of @a map to @a out.
+     *  @param  chunk_entries  Elements per chunk.
+     *
+     *  The stream holds a magic string, a format version and the element
+     *  count, followed by chunks of at most @a chunk_entries elements.
+     *  Each chunk starts with its element count and byte length, so a
+     *  reader can hand whole chunks to other threads.  Within a chunk, keys
+     *  whose codec supports it are sorted and written as differences to
+     *  the previous key.  Only one chunk is buffered at a time.
+     */
+    template<typename Map,
+        typename KeyCodec = codec<typename Map::key_type>,
+        typename ValueCodec = codec<typename Map::mapped_type>>
+        void save(std::ostream& out, const Map& map, std::size_t chunk_entries = 4096,
+            const KeyCodec& keys = KeyCodec(), const ValueCodec& values = ValueCodec())
+    {
+        using element = typename Map::value_type;
+
+        chunk_entries = std::max<std::size_t>(chunk_entries, 1);
+        out.write(detail::snapshot_magic, sizeof(detail::snapshot_magic));
+        detail::write_varint(out, detail::snapshot_version);
+        detail::write_varint(out, map.size());
+
+        std::vector<const element*> chunk;
+        std::string payload;
+        auto flush = [&] {
+            payload.clear();
+            detail::encode_chunk(payload, chunk, keys, values);
+            detail::write_varint(out, chunk.size());
+            detail::write_varint(out, payload.size());
+            out.write(payload.data(), static_cast<std::streamsize>(payload.size()));
+            chunk.clear();
+        };
+
+        for (const element& e : map) {
+            chunk.push_back(&e);
+            if (chunk.size() == chunk_entries) {
+                flush();
+            }
+        }
+        if (!chunk.empty()) {
+            flush();
+        }
+
+        if (!out) {
+            throw std::runtime_error("fefu::save: write failed");
+        }
+    }
+
+    /**
+     *  @brief  Inserts the elements saved by save() into @a map.
+     *  @throw  std::runtime_error  If the stream is not a snapshot or is
+     *                              truncated.
+     *
+     *  Reserves room for every element up front, then reads a window of
+     *  a few chunks per pool thread at a time, decodes the window on
+     *  @a pool and inserts the result, so memory use is bounded by the
+     *  window rather than the stream.  Saved elements replace existing
+     *  ones with the same key.
+     */
+    template<typename Map,
+        typename KeyCodec = codec<typename Map::key_type>,
+        typename ValueCodec = codec<typename Map::mapped_type>>
+        void load(std::istream& in, Map& map, thread_pool& pool,
+            const KeyCodec& keys = KeyCodec(), const ValueCodec& values = ValueCodec())
+    {
+        using key_type = typename Map::key_type;
+        using mapped_type = typename Map::mapped_type;
+
+        char magic[sizeof(detail::snapshot_magic)];
+        if (!in.read(magic, sizeof(magic)) || std::memcmp(magic, detail::snapshot_magic, sizeof(magic)) != 0) {
+            throw std::runtime_error("fefu::load: not a hash_map snapshot");
+        }
+        if (detail::read_varint(in) != detail::snapshot_version) {
+            throw std::runtime_error("fefu::load: unsupported snapshot version");
+        }
+
+        std::uint64_t remaining = detail::read_varint(in);
+        map.reserve(map.size() + static_cast<std::size_t>(remaining));
+
+        const std::size_t window = 4 * pool.size();
+        std::vector<std::string> payloads(window);
+        std::vector<std::size_t> counts(window);
+        std::vector<std::vector<std::pair<key_type, mapped_type>>> decoded(window);
+
+        while (remaining != 0) {
+            std::size_t chunks = 0;
+
+            for (; chunks != window && remaining != 0; chunks++) {
+                counts[chunks] = static_cast<std::size_t>(detail::read_varint(in));
+                payloads[chunks].resize(static_cast<std::size_t>(detail::read_varint(in)));
+
+                if (counts[chunks] == 0 || counts[chunks] > remaining ||
+                    !in.read(&payloads[chunks][0], static_cast<std::streamsize>(payloads[chunks].size()))) {
+                    throw std::runtime_error("fefu::load: truncated data");
+                }
+                remaining -= counts[chunks];
+            }
+
+            pool.parallel_for(0, chunks, 1, [&](std::size_t first, std::size_t last) {
+                for (std::size_t i = first; i != last; i++) {
+                    decoded[i].clear();
+                    detail::decode_chunk(payloads[i], counts[i], decoded[i], keys, values);
+                }
+            });
+
+            for (std::size_t i = 0; i != chunks; i++) {
+                for (auto& element : decoded[i]) {
+                    map.insert_or_assign(std::move(element.first), std::move(element.second));
+                }
+            }
+        }
+    }
+
+    /// Loads on thread_pool::default_pool().
+    template<typename Map>
+    void load(std::istream& in, Map& map) {
+        load(in, map, thread_pool::default_pool());
+    }
+
+} // namespace fefu
@@ -0,0 +1,155 @@
+#include <cstdint>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include "hash_map.hpp"
+#include "numbers_codec.hpp"
+#include "serialization.hpp"
+#include "../catch.hpp"
+
+namespace
+{
+    // Stores doubles rounded to millionths as zigzag varints.
+    struct fixed_point_codec {
+        void write(fefu::byte_writer& out, double value) const {
+            out.varint(fefu::zigzag(static_cast<std::int64_t>(value * 1e6)));
+        }
+
+        double read(fefu::byte_reader& in) const {
+            return static_cast<double>(fefu::unzigzag(in.varint())) / 1e6;
+        }
+    };
+}
+
+TEST_CASE("varint and zigzag encoding", "[serialization]") {
+    std::string buffer;
+    fefu::byte_writer writer(buffer);
+    writer.varint(0);
+    writer.varint(127);
+    writer.varint(128);
+    writer.varint(~std::uint64_t(0));
+    REQUIRE(buffer.size() == 1 + 1 + 2 + 10);
+
+    fefu::byte_reader reader(buffer.data(), buffer.size());
+    REQUIRE(reader.varint() == 0);
+    REQUIRE(reader.varint() == 127);
+    REQUIRE(reader.varint() == 128);
+    REQUIRE(reader.varint() == ~std::uint64_t(0));
+    REQUIRE(reader.done());
+    REQUIRE_THROWS_AS(reader.varint(), std::runtime_error);
+
+    for (std::int64_t value : { std::int64_t(0), std::int64_t(-1), std::int64_t(1), INT64_MIN, INT64_MAX }) {
+        REQUIRE(fefu::unzigzag(fefu::zigzag(value)) == value);
+    }
+    REQUIRE(fefu::zigzag(-1) == 1);
+}
+
+TEST_CASE("save and load round trips", "[serialization]") {
+    std::stringstream stream;
+
+    SECTION("integer keys, string values, small chunks") {
+        fefu::hash_map<int, std::string> map;
+        for (int i = -500; i < 500; i++) {
+            map[i * 7] = std::to_string(i);
+        }
+
+        fefu::save(stream, map, 64);
+        fefu::hash_map<int, std::string> loaded;
+        fefu::load(stream, loaded);
+
+        REQUIRE(loaded == map);
+    }
+    SECTION("dense keys take about two bytes per entry") {
+        fefu::hash_map<std::uint64_t, std::uint8_t> map;
+        for (std::uint64_t i = 0; i < 10000; i++) {
+            map[1000000 + i] = static_cast<std::uint8_t>(i % 100);
+        }
+
+        fefu::save(stream, map);
+        REQUIRE(stream.str().size() < 2 * map.size() + 100);
+
+        fefu::hash_map<std::uint64_t, std::uint8_t> loaded;
+        fefu::load(stream, loaded);
+        REQUIRE(loaded == map);
+    }
+    SECTION("Rational and Complex values") {
+        fefu::hash_map<std::string, Complex> map;
+        map.insert({ "i", Complex(0, 1) });
+        map.insert({ "half", Complex(Rational(1, 2), Rational(-3, 4)) });
+
+        fefu::save(stream, map);
+        fefu::hash_map<std::string, Complex> loaded;
+        fefu::load(stream, loaded);
+
+        REQUIRE(loaded.size() == 2);
+        REQUIRE(loaded.at("half") == Complex(Rational(1, 2), Rational(-3, 4)));
+        REQUIRE(loaded.at("i") == Complex(0, 1));
+    }
+    SECTION("custom value codec") {
+        fefu::hash_map<int, double> map;
+        map[1] = 0.25;
+        map[2] = -3.5;
+
+        fefu::save(stream, map, 4096, fefu::codec<int>(), fixed_point_codec());
+        fefu::hash_map<int, double> loaded;
+        fefu::load(stream, loaded, fefu::thread_pool::default_pool(), fefu::codec<int>(), fixed_point_codec());
+
+        REQUIRE(loaded.at(2) == -3.5);
+    }
+}
+
+TEST_CASE("load rejects bad streams", "[serialization]") {
+    fefu::hash_map<int, int> map;
+    map[1] = 1;
+    map[2] = 2;
+
+    std::stringstream saved;
+    fefu::save(saved, map);
+    std::string bytes = saved.str();
+
+    fefu::hash_map<int, int> loaded;
+    std::stringstream wrong_magic("NOTASNAP");
+    REQUIRE_THROWS_AS(fefu::load(wrong_magic, loaded), std::runtime_error);
+
+    std::stringstream truncated(bytes.substr(0, bytes.size() - 1));
+    REQUIRE_THROWS_AS(fefu::load(truncated, loaded), std::runtime_error);
+}
+
+TEST_CASE("Snapshot size and load throughput versus text", "[serialization][!benchmark]") {
+    const std::uint64_t elements = 1 << 20;
+
+    fefu::hash_map<std::uint64_t, std::uint64_t> map;
+    for (std::uint64_t i = 0; i < elements; i++) {
+        map[i * 3] = i % 1000;
+    }
+
+    std::stringstream binary;
+    fefu::save(binary, map);
+    const std::string binary_bytes = binary.str();
+
+    std::stringstream text;
+    for (const auto& element : map) {
+        text << element.first << ' ' << element.second << '\n';
+    }
+    const std::string text_bytes = text.str();
+
+    WARN("binary: " << static_cast<double>(binary_bytes.size()) / elements << " bytes per entry, text: "
+        << static_cast<double>(text_bytes.size()) / elements << " bytes per entry");
+
+    BENCHMARK("load binary snapshot") {
+        std::istringstream in(binary_bytes);
+        fefu::hash_map<std::uint64_t, std::uint64_t> loaded;
+        fefu::load(in, loaded);
+        return loaded.size();
+    };
+
+    BENCHMARK("rebuild from text") {
+        std::istringstream in(text_bytes);
+        fefu::hash_map<std::uint64_t, std::uint64_t> loaded;
+        std::uint64_t key, value;
+        while (in >> key >> value) {
+            loaded[key] = value;
+        }
+        return loaded.size();
+    };
+}
@@ -0,0 +1,450 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include "hash_map.hpp"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define FEFU_SMALL_MAP_SSE2
+#endif
+
+namespace fefu
+{
+    /**
+     *  @brief  A %hash_map keeping up to N elements inside the object.
+     *
+     *  While it holds at most N elements, a %small_hash_map allocates
+     *  nothing: the elements live in an inline array and are found by a
+     *  linear scan.  For integral keys compared with std::equal_to a copy of
+     *  the keys is kept in a separate array and compared all at once, four
+     *  32-bit keys per SSE2 instruction where available.  Inserting
+     *  element N + 1 moves everything into a %hash_map, which serves all
+     *  later operations until clear() returns the map to inline mode.
+     *
+     *  Erasing an inline element moves the last one into its place, so
+     *  inline iterators to the last element are invalidated as well.
+     */
+    template<typename K, typename T, std::size_t N = 8,
+        typename Hash = std::hash<K>,
+        typename Pred = std::equal_to<K>,
+        typename Alloc = allocator<std::pair<const K, T>>>
+        class small_hash_map
+    {
+        static_assert(N > 0, "small_hash_map needs an inline capacity");
+
+    public:
+        using key_type = K;
+        using mapped_type = T;
+        using value_type = std::pair<const K, T>;
+        using hasher = Hash;
+        using key_equal = Pred;
+        using allocator_type = Alloc;
+        using size_type = std::size_t;
+        using map_type = hash_map<K, T, Hash, Pred, Alloc>;
+
+        static constexpr size_type inline_capacity = N;
+
+    private:
+        template<bool Const>
+        class basic_iterator {
+        public:
+            using iterator_category = std::forward_iterator_tag;
+            using value_type = small_hash_map::value_type;
+            using difference_type = std::ptrdiff_t;
+            using reference = typename std::conditional<Const, const value_type&, value_type&>::type;
+            using pointer = typename std::conditional<Const, const value_type*, value_type*>::type;
+
+            basic_iterator() noexcept : ptr_(nullptr), it_(), hashed_(false) {}
+
+            template<bool C = Const, typename = typename std::enable_if<C>::type>
+            basic_iterator(const basic_iterator<false>& other) noexcept
+                : ptr_(other.ptr_), it_(other.it_), hashed_(other.hashed_) {}
+
+            reference operator*() const {
+                return hashed_ ? *it_ : *ptr_;
+            }
+
+            pointer operator->() const {
+                return hashed_ ? &*it_ : ptr_;
+            }
+
+            basic_iterator& operator++() {
+                if (hashed_) {
+                    ++it_;
+                }
+                else {
+                    ++ptr_;
+                }
+                return *this;
+            }
+
+            basic_iterator operator++(int) {
+                basic_iterator previous(*this);
+                ++(*this);
+                return previous;
+            }
+
+            friend bool operator==(const basic_iterator& lhs, const basic_iterator& rhs) {
+                return lhs.hashed_ ? lhs.it_ == rhs.it_ : lhs.ptr_ == rhs.ptr_;
+            }
+
+            friend bool operator!=(const basic_iterator& lhs, const basic_iterator& rhs) {
+                return !(lhs == rhs);
+            }
+
+        private:
+            friend class small_hash_map;
+            friend class basic_iterator<true>;
+
+            using map_iterator = typename std::conditional<Const, typename map_type::const_iterator, typename map_type::iterator>::type;
+
+            pointer ptr_;
+            map_iterator it_;
+            bool hashed_;
+
+            explicit basic_iterator(pointer ptr) noexcept : ptr_(ptr), it_(), hashed_(false) {}
+            explicit basic_iterator(map_iterator it) noexcept : ptr_(nullptr), it_(it), hashed_(true) {}
+        };
+
+    public:
+        using iterator = basic_iterator<false>;
+        using const_iterator = basic_iterator<true>;
+
+        /// Creates an empty map in inline mode.
+        small_hash_map() noexcept(std::is_nothrow_default_constructible<map_type>::value) : size_(0), hashed_(false), keys_() {}
+
+        small_hash_map(std::initializer_list<value_type> l) : small_hash_map() {
+            for (const value_type& element : l) {
+                insert(element);
+            }
+        }
+
+        small_hash_map(const small_hash_map& other) : small_hash_map() {
+            if (other.hashed_) {
+                map_ = other.map_;
+                hashed_ = true;
+            }
+            else {
+                for (size_type i = 0; i != other.size_; i++) {
+                    construct(i, other.slot(i));
+                }
+            }
+        }
+
+        small_hash_map(small_hash_map&& other) : small_hash_map() {
+            take(other);
+        }
+
+        small_hash_map& operator=(const small_hash_map& other) {
+            if (this != &other) {
+                small_hash_map copy(other);
+                clear();
+                take(copy);
+            }
+            return *this;
+        }
+
+        small_hash_map& operator=(small_hash_map&& other) {
+            if (this != &other) {
+                clear();
+                take(other);
+            }
+            return *this;
+        }
+
+        ~small_hash_map() {
+            destroy_inline();
+        }
+
+        /// Returns true while the elements are stored inline.
+        bool is_inline() const noexcept {
+            return !hashed_;
+        }
+
+        bool empty() const noexcept {
+            return size() == 0;
+        }
+
+        size_type size() const noexcept {
+            return hashed_ ? map_.size() : size_;
+        }
+
+        //@{
+        iterator begin() noexcept {
+            return hashed_ ? iterator(map_.begin()) : iterator(data());
+        }
+
+        const_iterator begin() const noexcept {
+            return hashed_ ? const_iterator(map_.cbegin()) : const_iterator(data());
+        }
+
+        const_iterator cbegin() const noexcept {
+            return begin();
+        }
+
+        iterator end() noexcept {
+            return hashed_ ? iterator(map_.end()) : iterator(data() + size_);
+        }
+
+        const_iterator end() const noexcept {
+            return hashed_ ? const_iterator(map_.cend()) : const_iterator(data() + size_);
+        }
+
+        const_iterator cend() const noexcept {
+            return end();
+        }
+        //@}
+
+        //@{
+        /// Returns an iterator to the element with key @a k, or end().
+        iterator find(const key_type& k) {
+            if (hashed_) {
+                return iterator(map_.find(k));
+            }
+
+            size_type i = index_of(k);
+            return iterator(data() + i);
+        }
+
+        const_iterator find(const key_type& k) const {
+            if (hashed_) {
+                return const_iterator(map_.find(k));
+            }
+
+            size_type i = index_of(k);
+            return const_iterator(data() + i);
+        }
+        //@}
+
+        bool contains(const key_type& k) const {
+            return hashed_ ? map_.contains(k) : index_of(k) != size_;
+        }
+
+        size_type count(const key_type& k) const {
+            return contains(k) ? 1 : 0;
+        }
+
+        //@{
+        /// Returns the value of @a k, or throws std::out_of_range.
+        mapped_type& at(const key_type& k) {
+            iterator it = find(k);
+            if (it == end()) {
+                throw std::out_of_range("small_hash_map::at");
+            }
+            return it->second;
+        }
+
+        const mapped_type& at(const key_type& k) const {
+            const_iterator it = find(k);
+            if (it == end()) {
+                throw std::out_of_range("small_hash_map::at");
+            }
+            return it->second;
+        }
+        //@}
+
+        /**
+         *  @brief  Inserts an element with key @a k constructed from
+         *          @a args if @a k is absent.
+         *  @return  A pair of an iterator to the element with key @a k and
+         *           a bool that is true if the element was inserted.
+         */
+        template<typename... Args>
+        std::pair<iterator, bool> try_emplace(const key_type& k, Args&&... args) {
+            if (!hashed_) {
+                size_type i = index_of(k);
+
+                if (i != size_) {
+                    return { iterator(data() + i), false };
+                }
+                if (size_ != N) {
+                    construct(size_, std::piecewise_construct, std::forward_as_tuple(k), std::forward_as_tuple(std::forward<Args>(args)...));
+                    return { iterator(data() + size_ - 1), true };
+                }
+
+                promote();
+            }
+
+            auto result = map_.try_emplace(k, std::forward<Args>(args)...);
+            return { iterator(result.first), result.second };
+        }
+
+        std::pair<iterator, bool> insert(const value_type& x) {
+            return try_emplace(x.first, x.second);
+        }
+
+        std::pair<iterator, bool> insert(value_type&& x) {
+            return try_emplace(x.first, std::move(x.second));
+        }
+
+        template<typename Obj>
+        std::pair<iterator, bool> insert_or_assign(const key_type& k, Obj&& obj) {
+            auto result = try_emplace(k, std::forward<Obj>(obj));
+            if (!result.second) {
+                result.first->second = std::forward<Obj>(obj);
+            }
+            return result;
+        }
+
+        mapped_type& operator[](const key_type& k) {
+            return try_emplace(k).first->second;
+        }
+
+        /// Erases the element with key @a k; returns the number erased.
+        size_type erase(const key_type& k) {
+            if (hashed_) {
+                return map_.erase(k);
+            }
+
+            size_type i = index_of(k);
+            if (i == size_) {
+                return 0;
+            }
+
+            erase_inline(i);
+            return 1;
+        }
+
+        /// Erases every element and returns to inline mode.
+        void clear() noexcept {
+            destroy_inline();
+
+            if (hashed_) {
+                map_ = map_type();
+                hashed_ = false;
+            }
+        }
+
+    private:
+        static constexpr bool simd_keys = std::is_integral<K>::value && !std::is_same<K, bool>::value &&
+            std::is_same<Pred, std::equal_to<K>>::value && N <= 64;
+
+        size_type size_;
+        bool hashed_;
+        // Padded to whole SSE2 registers; lanes past size_ are masked out.
+        static constexpr size_type key_lanes = (N + 3) / 4 * 4;
+
+        typename std::conditional<simd_keys, K[key_lanes], char[1]>::type keys_;
+        typename std::aligned_storage<sizeof(value_type), alignof(value_type)>::type inline_[N];
+        map_type map_;
+        Pred equal_;
+
+        value_type* data() noexcept {
+            return reinterpret_cast<value_type*>(inline_);
+        }
+
+        const value_type* data() const noexcept {
+            return reinterpret_cast<const value_type*>(inline_);
+        }
+
+        const value_type& slot(size_type i) const noexcept {
+            return data()[i];
+        }
+
+        // Bit i is set if keys_[i] == k, for every lane including stale ones.
+        std::uint64_t match_mask(const key_type& k) const noexcept {
+            std::uint64_t hits = 0;
+#if defined(FEFU_SMALL_MAP_SSE2)
+            if constexpr (sizeof(K) == 4) {
+                __m128i key = _mm_set1_epi32(static_cast<int>(k));
+                for (size_type i = 0; i != key_lanes; i += 4) {
+                    __m128i lanes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(keys_ + i));
+                    int mask = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(lanes, key)));
+                    hits |= static_cast<std::uint64_t>(mask) << i;
+                }
+                return hits;
+            }
+#endif
+            for (size_type i = 0; i != N; i++) {
+                hits |= static_cast<std::uint64_t>(keys_[i] == k) << i;
+            }
+            return hits;
+        }
+
+        // Index of @a k among the inline elements, or size_.
+        size_type index_of(const key_type& k) const {
+            if constexpr (simd_keys) {
+                std::uint64_t hits = match_mask(k);
+                if (size_ != 64) {
+                    hits &= (std::uint64_t(1) << size_) - 1;
+                }
+                return hits == 0 ? size_ : detail::lowest_bit(hits);
+            }
+            else {
+                for (size_type i = 0; i != size_; i++) {
+                    if (equal_(slot(i).first, k)) {
+                        return i;
+                    }
+                }
+                return size_;
+            }
+        }
+
+        template<typename... Args>
+        void construct(size_type i, Args&&... args) {
+            value_type* p = ::new (static_cast<void*>(data() + i)) value_type(std::forward<Args>(args)...);
+
+            if constexpr (simd_keys) {
+                keys_[i] = p->first;
+            }
+            size_++;
+        }
+
+        void erase_inline(size_type i) {
+            size_type last = size_ - 1;
+            data()[i].~value_type();
+
+            if (i != last) {
+                ::new (static_cast<void*>(data() + i)) value_type(std::move(const_cast<K&>(data()[last].first)), std::move(data()[last].second));
+                data()[last].~value_type();
+
+                if constexpr (simd_keys) {
+                    keys_[i] = keys_[last];
+                }
+            }
+            size_--;
+        }
+
+        void destroy_inline() noexcept {
+            for (size_type i = 0; i != size_; i++) {
+                data()[i].~value_type();
+            }
+            size_ = 0;
+        }
+
+        // Moves the inline elements into map_.
+        void promote() {
+            map_.reserve(2 * N);
+
+            for (size_type i = 0; i != size_; i++) {
+                map_.insert(value_type(std::move(const_cast<K&>(data()[i].first)), std::move(data()[i].second)));
+            }
+
+            destroy_inline();
+            hashed_ = true;
+        }
+
+        // Takes the contents of @a other, which must be in inline mode or hashed; leaves it empty.
+        void take(small_hash_map& other) {
+            if (other.hashed_) {
+                map_ = std::move(other.map_);
+                hashed_ = true;
+                other.map_ = map_type();
+                other.hashed_ = false;
+            }
+            else {
+                for (size_type i = 0; i != other.size_; i++) {
+                    construct(i, std::move(const_cast<K&>(other.data()[i].first)), std::move(other.data()[i].second));
+                }
+                other.destroy_inline();
+            }
+        }
+    };
+
+} // namespace fefu
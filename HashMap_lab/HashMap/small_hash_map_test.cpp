@@ -0,0 +1,147 @@
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+#include "hash_map.hpp"
+#include "small_hash_map.hpp"
+#include "../catch.hpp"
+
+TEST_CASE("small_hash_map stays inline up to its capacity", "[small_hash_map]") {
+    fefu::small_hash_map<int, int, 4> map;
+    REQUIRE(map.is_inline());
+    REQUIRE(map.empty());
+    REQUIRE(map.find(1) == map.end());
+
+    for (int i = 0; i < 4; i++) {
+        REQUIRE(map.insert({ i, i * 10 }).second);
+    }
+    REQUIRE_FALSE(map.insert({ 2, 0 }).second);
+    REQUIRE(map.is_inline());
+    REQUIRE(map.size() == 4);
+    REQUIRE(map.at(3) == 30);
+    REQUIRE_THROWS_AS(map.at(4), std::out_of_range);
+
+    SECTION("erase moves the last element into the hole") {
+        REQUIRE(map.erase(0) == 1);
+        REQUIRE(map.erase(0) == 0);
+        REQUIRE(map.size() == 3);
+        for (int i = 1; i < 4; i++) {
+            REQUIRE(map[i] == i * 10);
+        }
+        REQUIRE_FALSE(map.contains(0));
+    }
+    SECTION("overflow promotes to a hash_map") {
+        map[4] = 40;
+        REQUIRE_FALSE(map.is_inline());
+        for (int i = 5; i < 100; i++) {
+            map.insert_or_assign(i, i * 10);
+        }
+        REQUIRE(map.size() == 100);
+
+        int sum = 0;
+        for (const auto& element : map) {
+            REQUIRE(element.second == element.first * 10);
+            sum += element.first;
+        }
+        REQUIRE(sum == 4950);
+
+        map.clear();
+        REQUIRE(map.is_inline());
+        REQUIRE(map.begin() == map.end());
+    }
+    SECTION("copy and move") {
+        fefu::small_hash_map<int, int, 4> copy(map);
+        REQUIRE(copy.size() == 4);
+        copy[9] = 90;
+
+        fefu::small_hash_map<int, int, 4> moved(std::move(copy));
+        REQUIRE_FALSE(moved.is_inline());
+        REQUIRE(moved.at(9) == 90);
+        REQUIRE(copy.empty());
+
+        map = moved;
+        REQUIRE(map.size() == 5);
+        moved = fefu::small_hash_map<int, int, 4>{ { 1, 1 } };
+        REQUIRE(moved.is_inline());
+        REQUIRE(moved.at(1) == 1);
+    }
+}
+
+TEST_CASE("small_hash_map with non-trivial elements", "[small_hash_map]") {
+    fefu::small_hash_map<std::string, std::string, 3> map;
+    map.try_emplace("a", 10, 'a');
+    map["b"] = "bb";
+    map.insert({ "c", "ccc" });
+    map.erase("a");
+    map["d"] = "dddd";
+    REQUIRE(map.is_inline());
+    map["e"] = "eeeee";
+    REQUIRE_FALSE(map.is_inline());
+
+    for (const auto& element : map) {
+        REQUIRE(element.second == std::string(element.second.size(), element.first[0]));
+    }
+    REQUIRE(map.size() == 4);
+}
+
+TEST_CASE("small_hash_map with 8- and 1-byte keys", "[small_hash_map]") {
+    fefu::small_hash_map<std::int64_t, int, 5> wide;
+    fefu::small_hash_map<char, int, 5> narrow;
+    for (int i = 0; i < 5; i++) {
+        wide[std::int64_t(1) << (40 + i)] = i;
+        narrow[static_cast<char>('a' + i)] = i;
+    }
+    wide.erase(std::int64_t(1) << 40);
+    narrow.erase('a');
+
+    REQUIRE(wide.is_inline());
+    REQUIRE(narrow.is_inline());
+    REQUIRE_FALSE(wide.contains(std::int64_t(1) << 40));
+    REQUIRE_FALSE(narrow.contains('a'));
+    for (int i = 1; i < 5; i++) {
+        REQUIRE(wide.at(std::int64_t(1) << (40 + i)) == i);
+        REQUIRE(narrow.at(static_cast<char>('a' + i)) == i);
+    }
+}
+
+TEST_CASE("Small maps: create, look up and destroy", "[small_hash_map][!benchmark]") {
+    const int rounds = 1 << 14;
+
+    std::mt19937 generator(11);
+    std::vector<std::uint32_t> keys(16 * rounds);
+    for (auto& key : keys) {
+        key = generator();
+    }
+
+    for (std::size_t n : { 0, 1, 2, 4, 8, 12, 16 }) {
+        BENCHMARK(std::string("hash_map, ") + std::to_string(n) + " entries") {
+            std::uint64_t sum = 0;
+            for (int r = 0; r < rounds; r++) {
+                const std::uint32_t* k = keys.data() + 16 * r;
+                fefu::hash_map<std::uint32_t, std::uint32_t> map;
+                for (std::size_t i = 0; i < n; i++) {
+                    map[k[i]] = static_cast<std::uint32_t>(i);
+                }
+                for (std::size_t i = 0; i < 16; i++) {
+                    sum += map.contains(k[i]);
+                }
+            }
+            return sum;
+        };
+
+        BENCHMARK(std::string("small_hash_map<16>, ") + std::to_string(n) + " entries") {
+            std::uint64_t sum = 0;
+            for (int r = 0; r < rounds; r++) {
+                const std::uint32_t* k = keys.data() + 16 * r;
+                fefu::small_hash_map<std::uint32_t, std::uint32_t, 16> map;
+                for (std::size_t i = 0; i < n; i++) {
+                    map[k[i]] = static_cast<std::uint32_t>(i);
+                }
+                for (std::size_t i = 0; i < 16; i++) {
+                    sum += map.contains(k[i]);
+                }
+            }
+            return sum;
+        };
+    }
+}
@@ -0,0 +1,741 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "hash_map.hpp"
+
+namespace fefu
+{
+    /**
+     *  @brief  A %hash_map storing keys and values in separate arrays.
+     *
+     *  Probing reads only the key array, so the cache lines it touches hold
+     *  nothing but keys no matter how large the mapped type is.  Values
+     *  larger than @a BoxAbove bytes are boxed: each lives in its own
+     *  allocation and the value array holds pointers, which keeps empty
+     *  buckets cheap and makes a rehash move pointers instead of values.
+     *
+     *  The probe sequence, growth and load factor are those of %hash_map.
+     *  Since a key and its value are not adjacent, dereferencing an
+     *  iterator yields a pair of references rather than a reference to a
+     *  pair.
+     */
+    template<typename K, typename T,
+        typename Hash = std::hash<K>,
+        typename Pred = std::equal_to<K>,
+        typename Alloc = allocator<std::pair<const K, T>>,
+        std::size_t BoxAbove = 128>
+        class split_hash_map
+    {
+    public:
+        using key_type = K;
+        using mapped_type = T;
+        using hasher = Hash;
+        using key_equal = Pred;
+        using allocator_type = Alloc;
+        using value_type = std::pair<const key_type, mapped_type>;
+        using reference = std::pair<const key_type&, mapped_type&>;
+        using const_reference = std::pair<const key_type&, const mapped_type&>;
+        using size_type = std::size_t;
+
+        /// True if values are stored out of line.
+        static constexpr bool boxed_values = sizeof(T) > BoxAbove;
+
+    private:
+        using alloc_traits = std::allocator_traits<Alloc>;
+        using slot_type = typename std::conditional<boxed_values, T*, T>::type;
+        using key_allocator = typename alloc_traits::template rebind_alloc<K>;
+        using slot_allocator = typename alloc_traits::template rebind_alloc<slot_type>;
+        using box_allocator = typename alloc_traits::template rebind_alloc<T>;
+        using bitmap_type = std::vector<bool, typename alloc_traits::template rebind_alloc<bool>>;
+
+        template<bool Const>
+        class basic_iterator {
+            using map_pointer = typename std::conditional<Const, const split_hash_map*, split_hash_map*>::type;
+
+        public:
+            using iterator_category = std::forward_iterator_tag;
+            using value_type = split_hash_map::value_type;
+            using difference_type = std::ptrdiff_t;
+            using reference = typename std::conditional<Const, split_hash_map::const_reference, split_hash_map::reference>::type;
+
+            /// Keeps the pair of references alive for operator->.
+            struct pointer {
+                reference ref;
+
+                const reference* operator->() const noexcept {
+                    return &ref;
+                }
+            };
+
+            basic_iterator() noexcept : map_(nullptr), pos_(0) {}
+
+            template<bool C = Const, typename = typename std::enable_if<C>::type>
+            basic_iterator(const basic_iterator<false>& other) noexcept : map_(other.map_), pos_(other.pos_) {}
+
+            reference operator*() const {
+                return reference(map_->keys_[pos_], map_->value_at(pos_));
+            }
+
+            pointer operator->() const {
+                return pointer{ **this };
+            }
+
+            basic_iterator& operator++() {
+                pos_ = map_->next_used(pos_ + 1);
+                return *this;
+            }
+
+            basic_iterator operator++(int) {
+                basic_iterator previous(*this);
+                ++(*this);
+                return previous;
+            }
+
+            friend bool operator==(const basic_iterator& lhs, const basic_iterator& rhs) {
+                return lhs.pos_ == rhs.pos_;
+            }
+
+            friend bool operator!=(const basic_iterator& lhs, const basic_iterator& rhs) {
+                return lhs.pos_ != rhs.pos_;
+            }
+
+        private:
+            friend class split_hash_map;
+            friend class basic_iterator<true>;
+
+            map_pointer map_;
+            size_type pos_;
+
+            basic_iterator(map_pointer map, size_type pos) noexcept : map_(map), pos_(pos) {}
+        };
+
+    public:
+        using iterator = basic_iterator<false>;
+        using const_iterator = basic_iterator<true>;
+
+        /// Default constructor.
+        split_hash_map() : split_hash_map(Alloc()) {}
+
+        explicit split_hash_map(const allocator_type& a) : allocator_(a), size_(0), capacity_(0), max_load_factor_(0.5),
+            keys_(nullptr), values_(nullptr), used_(make_bitmap(0)), deleted_(make_bitmap(0)), max_probe_(0), hash_(), equal_() {}
+
+        /// Creates an empty map with room for @a n elements.
+        explicit split_hash_map(size_type n, const allocator_type& a = allocator_type()) : split_hash_map(a) {
+            reserve(n);
+        }
+
+        split_hash_map(std::initializer_list<value_type> l, const allocator_type& a = allocator_type()) : split_hash_map(l.size(), a) {
+            for (const value_type& element : l) {
+                insert(element);
+            }
+        }
+
+        /// Copies the table bucket by bucket, so no key is rehashed.
+        split_hash_map(const split_hash_map& other)
+            : split_hash_map(alloc_traits::select_on_container_copy_construction(other.allocator_)) {
+            max_load_factor_ = other.max_load_factor_;
+            hash_ = other.hash_;
+            equal_ = other.equal_;
+            copy_table(other);
+        }
+
+        split_hash_map(split_hash_map&& other) noexcept
+            : allocator_(std::move(other.allocator_)), size_(0), capacity_(0), max_load_factor_(other.max_load_factor_),
+            keys_(nullptr), values_(nullptr), used_(make_bitmap(0)), deleted_(make_bitmap(0)), max_probe_(0),
+            hash_(other.hash_), equal_(other.equal_) {
+            swap_table(other);
+        }
+
+        split_hash_map& operator=(const split_hash_map& other) {
+            if (this != &other) {
+                destroy();
+                if constexpr (alloc_traits::propagate_on_container_copy_assignment::value) {
+                    allocator_ = other.allocator_;
+                }
+                max_load_factor_ = other.max_load_factor_;
+                hash_ = other.hash_;
+                equal_ = other.equal_;
+                copy_table(other);
+            }
+            return *this;
+        }
+
+        split_hash_map& operator=(split_hash_map&& other) {
+            if (this == &other) {
+                return *this;
+            }
+
+            destroy();
+            max_load_factor_ = other.max_load_factor_;
+            hash_ = other.hash_;
+            equal_ = other.equal_;
+
+            if constexpr (alloc_traits::propagate_on_container_move_assignment::value) {
+                allocator_ = std::move(other.allocator_);
+                swap_table(other);
+            }
+            else if (allocator_ == other.allocator_) {
+                swap_table(other);
+            }
+            else {
+                reserve(other.size_);
+                for (size_type i = 0; i != other.capacity_; i++) {
+                    if (other.used_[i]) {
+                        try_emplace(std::move(other.keys_[i]), std::move(other.value_at(i)));
+                    }
+                }
+                other.clear();
+            }
+            return *this;
+        }
+
+        ~split_hash_map() {
+            destroy();
+        }
+
+        allocator_type get_allocator() const noexcept {
+            return allocator_;
+        }
+
+        bool empty() const noexcept {
+            return size_ == 0;
+        }
+
+        size_type size() const noexcept {
+            return size_;
+        }
+
+        /**
+         *  Returns the bytes used by the map; boxed values are counted under
+         *  heap.
+         */
+        memory_footprint memory_usage() const noexcept {
+            memory_footprint footprint;
+            footprint.object = sizeof(*this);
+            footprint.slots = capacity_ * (sizeof(key_type) + sizeof(slot_type));
+            footprint.metadata = bitmap_bytes(used_) + bitmap_bytes(deleted_);
+            footprint.heap = boxed_values ? size_ * sizeof(T) : 0;
+            return footprint;
+        }
+
+        //@{
+        iterator begin() noexcept {
+            return iterator(this, next_used(0));
+        }
+
+        const_iterator begin() const noexcept {
+            return const_iterator(this, next_used(0));
+        }
+
+        const_iterator cbegin() const noexcept {
+            return begin();
+        }
+
+        iterator end() noexcept {
+            return iterator(this, capacity_);
+        }
+
+        const_iterator end() const noexcept {
+            return const_iterator(this, capacity_);
+        }
+
+        const_iterator cend() const noexcept {
+            return end();
+        }
+        //@}
+
+        /**
+         *  @brief  Inserts an element with key @a k and a value constructed
+         *          from @a args if @a k is absent.
+         *  @return  A pair of an iterator to the element with key @a k and a
+         *           bool that is true if the element was inserted.
+         */
+        //@{
+        template<typename... Args>
+        std::pair<iterator, bool> try_emplace(const key_type& k, Args&&... args) {
+            return emplace_key(k, std::forward<Args>(args)...);
+        }
+
+        template<typename... Args>
+        std::pair<iterator, bool> try_emplace(key_type&& k, Args&&... args) {
+            return emplace_key(std::move(k), std::forward<Args>(args)...);
+        }
+        //@}
+
+        std::pair<iterator, bool> insert(const value_type& x) {
+            return emplace_key(x.first, x.second);
+        }
+
+        std::pair<iterator, bool> insert(value_type&& x) {
+            return emplace_key(std::move(const_cast<key_type&>(x.first)), std::move(x.second));
+        }
+
+        template<typename Obj>
+        std::pair<iterator, bool> insert_or_assign(const key_type& k, Obj&& obj) {
+            size_type pos = find_slot(k);
+            if (pos != capacity_) {
+                value_at(pos) = std::forward<Obj>(obj);
+                return { iterator(this, pos), false };
+            }
+            return emplace_key(k, std::forward<Obj>(obj));
+        }
+
+        mapped_type& operator[](const key_type& k) {
+            return value_at(emplace_key(k).first.pos_);
+        }
+
+        mapped_type& operator[](key_type&& k) {
+            return value_at(emplace_key(std::move(k)).first.pos_);
+        }
+
+        //@{
+        /// Returns the value of @a k, or throws std::out_of_range.
+        mapped_type& at(const key_type& k) {
+            size_type pos = find_slot(k);
+            if (pos == capacity_) {
+                throw std::out_of_range("split_hash_map::at");
+            }
+            return value_at(pos);
+        }
+
+        const mapped_type& at(const key_type& k) const {
+            size_type pos = find_slot(k);
+            if (pos == capacity_) {
+                throw std::out_of_range("split_hash_map::at");
+            }
+            return value_at(pos);
+        }
+        //@}
+
+        //@{
+        iterator find(const key_type& k) {
+            return iterator(this, find_slot(k));
+        }
+
+        const_iterator find(const key_type& k) const {
+            return const_iterator(this, find_slot(k));
+        }
+        //@}
+
+        bool contains(const key_type& k) const {
+            return find_slot(k) != capacity_;
+        }
+
+        size_type count(const key_type& k) const {
+            return contains(k) ? 1 : 0;
+        }
+
+        /// Erases the element at @a position; returns an iterator to the next one.
+        iterator erase(const_iterator position) {
+            erase_slot(position.pos_);
+            return iterator(this, next_used(position.pos_ + 1));
+        }
+
+        /// Erases the element with key @a k; returns the number erased.
+        size_type erase(const key_type& k) {
+            size_type pos = find_slot(k);
+            if (pos == capacity_) {
+                return 0;
+            }
+            erase_slot(pos);
+            return 1;
+        }
+
+        /// Erases every element; the buckets are kept.
+        void clear() noexcept {
+            for (size_type i = 0; i != capacity_; i++) {
+                if (used_[i]) {
+                    destroy_slot(i);
+                }
+            }
+            std::fill(used_.begin(), used_.end(), false);
+            std::fill(deleted_.begin(), deleted_.end(), false);
+            size_ = 0;
+            max_probe_ = 0;
+        }
+
+        void swap(split_hash_map& x) noexcept {
+            if constexpr (alloc_traits::propagate_on_container_swap::value) {
+                using std::swap;
+                swap(allocator_, x.allocator_);
+            }
+            std::swap(max_load_factor_, x.max_load_factor_);
+            std::swap(hash_, x.hash_);
+            std::swap(equal_, x.equal_);
+            swap_table(x);
+        }
+
+        size_type bucket_count() const noexcept {
+            return capacity_;
+        }
+
+        float load_factor() const noexcept {
+            return capacity_ == 0 ? 0 : static_cast<float>(size_) / capacity_;
+        }
+
+        float max_load_factor() const noexcept {
+            return max_load_factor_;
+        }
+
+        void max_load_factor(float z) {
+            max_load_factor_ = z;
+        }
+
+        /// Rebuilds the table with at least @a n buckets, and no fewer than
+        /// size().
+        void rehash(size_type n) {
+            if (n < size_) {
+                n = size_;
+            }
+
+            size_type new_capacity = n == 0 ? 0 : PrimeNumberGenerator(n).GetNextPrime();
+            key_allocator key_alloc(allocator_);
+            slot_allocator slot_alloc(allocator_);
+            K* new_keys = nullptr;
+            slot_type* new_values = nullptr;
+            bitmap_type new_used = make_bitmap(new_capacity);
+            size_type new_max_probe = 0;
+
+            // The old elements stay in place until every one has been moved,
+            // so a throwing copy leaves the map as it was.  A boxed value is
+            // a pointer: both tables hold it until the swap below.
+            try {
+                if (new_capacity != 0) {
+                    new_keys = std::allocator_traits<key_allocator>::allocate(key_alloc, new_capacity);
+                    new_values = std::allocator_traits<slot_allocator>::allocate(slot_alloc, new_capacity);
+                }
+
+                for (size_type i = 0; i != capacity_; i++) {
+                    if (used_[i]) {
+                        size_type probes = new_capacity;
+                        size_type pos = probe_free_slot(keys_[i], new_capacity, new_used, probes);
+
+                        new (new_keys + pos) K(std::move_if_noexcept(keys_[i]));
+                        try {
+                            new (new_values + pos) slot_type(std::move_if_noexcept(values_[i]));
+                        }
+                        catch (...) {
+                            new_keys[pos].~K();
+                            throw;
+                        }
+                        new_used[pos] = true;
+                        new_max_probe = std::max(new_max_probe, probes);
+                    }
+                }
+            }
+            catch (...) {
+                for (size_type i = 0; i != new_capacity; i++) {
+                    if (new_used[i]) {
+                        new_keys[i].~K();
+                        if constexpr (!boxed_values) {
+                            new_values[i].~T();
+                        }
+                    }
+                }
+                if (new_keys != nullptr) {
+                    std::allocator_traits<key_allocator>::deallocate(key_alloc, new_keys, new_capacity);
+                }
+                if (new_values != nullptr) {
+                    std::allocator_traits<slot_allocator>::deallocate(slot_alloc, new_values, new_capacity);
+                }
+                throw;
+            }
+
+            // The boxes now belong to the new table.
+            if constexpr (boxed_values) {
+                for (size_type i = 0; i != capacity_; i++) {
+                    if (used_[i]) {
+                        values_[i] = nullptr;
+                    }
+                }
+            }
+
+            size_type size = size_;
+            destroy();
+
+            size_ = size;
+            capacity_ = new_capacity;
+            keys_ = new_keys;
+            values_ = new_values;
+            used_ = std::move(new_used);
+            deleted_ = make_bitmap(new_capacity);
+            max_probe_ = new_max_probe;
+        }
+
+        /// Same as rehash(ceil(n / max_load_factor())).
+        void reserve(size_type n) {
+            rehash(static_cast<size_type>(std::ceil(n / max_load_factor_)));
+        }
+
+    private:
+        allocator_type allocator_;
+        size_type size_;
+        size_type capacity_;
+        float max_load_factor_;
+        K* keys_;
+        slot_type* values_;
+        bitmap_type used_;
+        bitmap_type deleted_;
+        size_type max_probe_;
+        Hash hash_;
+        key_equal equal_;
+
+        // As in hash_map: past max_load_factor_, an insertion may still use
+        // this many probes before the table grows.
+        static constexpr size_type probe_limit = 32;
+
+        //@{
+        mapped_type& value_at(size_type pos) noexcept {
+            if constexpr (boxed_values) {
+                return *values_[pos];
+            }
+            else {
+                return values_[pos];
+            }
+        }
+
+        const mapped_type& value_at(size_type pos) const noexcept {
+            if constexpr (boxed_values) {
+                return *values_[pos];
+            }
+            else {
+                return values_[pos];
+            }
+        }
+        //@}
+
+        // First used bucket at or after @a pos, or capacity_.
+        size_type next_used(size_type pos) const noexcept {
+            while (pos < capacity_ && !used_[pos]) {
+                pos++;
+            }
+            return pos;
+        }
+
+        size_t hash_first(size_t hash, size_type capacity) const {
+            return hash % capacity;
+        }
+
+        // The same double hashing as hash_map::hash_second.
+        size_t hash_second(size_t hash, size_type capacity) const {
+            return capacity == 1 ? 1 : 1 + static_cast<size_t>(detail::mix(hash) % (capacity - 1));
+        }
+
+        /// Returns the bucket holding @a key, or capacity_ if there is none.
+        size_type find_slot(const key_type& key) const {
+            if (size_ == 0) {
+                return capacity_;
+            }
+
+            size_t hash = hash_(key);
+            size_t pos = hash_first(hash, capacity_);
+            size_t step = hash_second(hash, capacity_);
+
+            for (size_t i = 0; i != max_probe_; i++) {
+                if (used_[pos]) {
+                    if (equal_(keys_[pos], key)) {
+                        return pos;
+                    }
+                }
+                else if (!deleted_[pos]) {
+                    break;
+                }
+
+                pos += step;
+                if (pos >= capacity_) {
+                    pos -= capacity_;
+                }
+            }
+
+            return capacity_;
+        }
+
+        /// Returns the first free bucket of the probe sequence of @a key
+        /// and sets @a probes to the number of buckets visited.
+        size_type probe_free_slot(const key_type& key, size_type capacity, const bitmap_type& used, size_type& probes) const {
+            size_t hash = hash_(key);
+            size_t pos = hash_first(hash, capacity);
+            size_t step = hash_second(hash, capacity);
+
+            for (size_t i = 0; i != probes; i++) {
+                if (!used[pos]) {
+                    probes = i + 1;
+                    return pos;
+                }
+
+                pos += step;
+                if (pos >= capacity) {
+                    pos -= capacity;
+                }
+            }
+
+            return capacity;
+        }
+
+        template<typename KeyArg, typename... Args>
+        std::pair<iterator, bool> emplace_key(KeyArg&& k, Args&&... args) {
+            size_type pos = find_slot(k);
+            if (pos != capacity_) {
+                return { iterator(this, pos), false };
+            }
+
+            size_type probes = capacity_;
+
+            if (size_ >= capacity_ * max_load_factor_) {
+                probes = std::min(capacity_, probe_limit);
+            }
+
+            pos = capacity_ == 0 ? 0 : probe_free_slot(k, capacity_, used_, probes);
+
+            if (pos == capacity_) {
+                rehash(capacity_ == 0 ? 2 : capacity_ * 2);
+                probes = capacity_;
+                pos = probe_free_slot(k, capacity_, used_, probes);
+            }
+
+            new (keys_ + pos) K(std::forward<KeyArg>(k));
+            try {
+                construct_value(pos, std::forward<Args>(args)...);
+            }
+            catch (...) {
+                keys_[pos].~K();
+                throw;
+            }
+
+            used_[pos] = true;
+            deleted_[pos] = false;
+            max_probe_ = std::max(max_probe_, probes);
+            size_++;
+
+            return { iterator(this, pos), true };
+        }
+
+        template<typename... Args>
+        void construct_value(size_type pos, Args&&... args) {
+            if constexpr (boxed_values) {
+                box_allocator box_alloc(allocator_);
+                T* box = std::allocator_traits<box_allocator>::allocate(box_alloc, 1);
+                try {
+                    new (box) T(std::forward<Args>(args)...);
+                }
+                catch (...) {
+                    std::allocator_traits<box_allocator>::deallocate(box_alloc, box, 1);
+                    throw;
+                }
+                new (values_ + pos) slot_type(box);
+            }
+            else {
+                new (values_ + pos) T(std::forward<Args>(args)...);
+            }
+        }
+
+        // Destroys the key and value in bucket @a pos; leaves the bitmaps alone.
+        void destroy_slot(size_type pos) noexcept {
+            keys_[pos].~K();
+
+            if constexpr (boxed_values) {
+                T* box = values_[pos];
+                if (box != nullptr) {
+                    box_allocator box_alloc(allocator_);
+                    box->~T();
+                    std::allocator_traits<box_allocator>::deallocate(box_alloc, box, 1);
+                }
+            }
+            else {
+                values_[pos].~T();
+            }
+        }
+
+        void erase_slot(size_type pos) {
+            destroy_slot(pos);
+            used_[pos] = false;
+            deleted_[pos] = true;
+            size_--;
+        }
+
+        // Copies @a other into this empty map, keeping every element in its bucket.
+        void copy_table(const split_hash_map& other) {
+            if (other.capacity_ == 0) {
+                return;
+            }
+
+            key_allocator key_alloc(allocator_);
+            slot_allocator slot_alloc(allocator_);
+            keys_ = std::allocator_traits<key_allocator>::allocate(key_alloc, other.capacity_);
+            values_ = std::allocator_traits<slot_allocator>::allocate(slot_alloc, other.capacity_);
+            capacity_ = other.capacity_;
+            used_ = make_bitmap(capacity_);
+            deleted_ = other.deleted_;
+            max_probe_ = other.max_probe_;
+
+            for (size_type i = 0; i != capacity_; i++) {
+                if (other.used_[i]) {
+                    new (keys_ + i) K(other.keys_[i]);
+                    try {
+                        construct_value(i, other.value_at(i));
+                    }
+                    catch (...) {
+                        keys_[i].~K();
+                        destroy();
+                        throw;
+                    }
+                    used_[i] = true;
+                    size_++;
+                }
+            }
+        }
+
+        void swap_table(split_hash_map& x) noexcept {
+            std::swap(size_, x.size_);
+            std::swap(capacity_, x.capacity_);
+            std::swap(keys_, x.keys_);
+            std::swap(values_, x.values_);
+            used_.swap(x.used_);
+            deleted_.swap(x.deleted_);
+            std::swap(max_probe_, x.max_probe_);
+        }
+
+        static size_type bitmap_bytes(const bitmap_type& bitmap) noexcept {
+            const size_type word_bits = sizeof(std::size_t) * 8;
+            return (bitmap.capacity() + word_bits - 1) / word_bits * sizeof(std::size_t);
+        }
+
+        bitmap_type make_bitmap(size_type n) const {
+            return bitmap_type(n, false, typename bitmap_type::allocator_type(allocator_));
+        }
+
+        /// Destroys the elements and releases both arrays.
+        void destroy() noexcept {
+            for (size_type i = 0; i != capacity_; i++) {
+                if (used_[i]) {
+                    destroy_slot(i);
+                }
+            }
+
+            if (capacity_ != 0) {
+                key_allocator key_alloc(allocator_);
+                slot_allocator slot_alloc(allocator_);
+                std::allocator_traits<key_allocator>::deallocate(key_alloc, keys_, capacity_);
+                std::allocator_traits<slot_allocator>::deallocate(slot_alloc, values_, capacity_);
+            }
+
+            size_ = 0;
+            capacity_ = 0;
+            keys_ = nullptr;
+            values_ = nullptr;
+            used_ = make_bitmap(0);
+            deleted_ = make_bitmap(0);
+            max_probe_ = 0;
+        }
+    };
+
+} // namespace fefu
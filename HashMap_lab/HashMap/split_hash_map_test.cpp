@@ -0,0 +1,188 @@
+#include <array>
+#include <cstdint>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "hash_map.hpp"
+#include "split_hash_map.hpp"
+#include "../catch.hpp"
+
+namespace
+{
+    template<std::size_t Bytes>
+    struct payload {
+        std::array<std::uint64_t, Bytes / 8> words;
+
+        payload(std::uint64_t seed = 0) {
+            words.fill(seed);
+        }
+    };
+
+    template<std::size_t Bytes>
+    void benchmark_find(std::uint64_t elements, const std::vector<std::uint64_t>& keys, const std::vector<std::uint64_t>& probes) {
+        fefu::hash_map<std::uint64_t, payload<Bytes>> map;
+        fefu::split_hash_map<std::uint64_t, payload<Bytes>> split;
+        for (std::uint64_t i = 0; i < elements; i++) {
+            map.try_emplace(keys[i], i);
+            split.try_emplace(keys[i], i);
+        }
+
+        WARN(Bytes << "-byte values: hash_map " << map.memory_usage().total() / (1 << 20) << " MiB, split_hash_map "
+            << split.memory_usage().total() / (1 << 20) << " MiB" << (split.boxed_values ? " (boxed)" : ""));
+
+        BENCHMARK(std::string("hash_map find, ") + std::to_string(Bytes) + "-byte values") {
+            std::uint64_t hits = 0;
+            for (std::uint64_t key : probes) {
+                hits += map.find(key) != map.end();
+            }
+            return hits;
+        };
+
+        BENCHMARK(std::string("split_hash_map find, ") + std::to_string(Bytes) + "-byte values") {
+            std::uint64_t hits = 0;
+            for (std::uint64_t key : probes) {
+                hits += split.find(key) != split.end();
+            }
+            return hits;
+        };
+    }
+}
+
+TEST_CASE("split_hash_map basic operations", "[split_hash_map]") {
+    fefu::split_hash_map<int, std::string> map;
+    REQUIRE(map.empty());
+    REQUIRE(map.find(1) == map.end());
+
+    for (int i = 0; i < 1000; i++) {
+        REQUIRE(map.insert({ i, std::to_string(i) }).second);
+    }
+    REQUIRE_FALSE(map.try_emplace(7, "x").second);
+    REQUIRE(map.size() == 1000);
+    REQUIRE(map.at(999) == "999");
+    REQUIRE_THROWS_AS(map.at(1000), std::out_of_range);
+
+    map.find(5)->second = "five";
+    REQUIRE(map[5] == "five");
+    REQUIRE(map.insert_or_assign(6, "six").second == false);
+    REQUIRE(map.at(6) == "six");
+
+    for (int i = 0; i < 1000; i += 2) {
+        REQUIRE(map.erase(i) == 1);
+    }
+    REQUIRE(map.erase(0) == 0);
+    REQUIRE(map.size() == 500);
+
+    int count = 0;
+    for (auto element : map) {
+        REQUIRE(element.first % 2 == 1);
+        count++;
+    }
+    REQUIRE(count == 500);
+
+    SECTION("copy, move and swap") {
+        auto copy = map;
+        REQUIRE(copy.size() == 500);
+        REQUIRE(copy.at(999) == "999");
+
+        fefu::split_hash_map<int, std::string> moved(std::move(copy));
+        REQUIRE(copy.empty());
+        REQUIRE(moved.at(1) == "1");
+
+        copy = std::move(moved);
+        copy.swap(moved);
+        REQUIRE(copy.empty());
+        REQUIRE(moved.size() == 500);
+    }
+    SECTION("erase by iterator and clear") {
+        for (auto it = map.begin(); it != map.end();) {
+            it = it->first < 500 ? map.erase(it) : ++it;
+        }
+        REQUIRE(map.size() == 250);
+        REQUIRE_FALSE(map.contains(1));
+
+        map.clear();
+        REQUIRE(map.begin() == map.end());
+        map[3] = "three";
+        REQUIRE(map.size() == 1);
+    }
+}
+
+TEST_CASE("split_hash_map boxes large values", "[split_hash_map]") {
+    using map_type = fefu::split_hash_map<std::uint64_t, payload<256>>;
+    STATIC_REQUIRE(map_type::boxed_values);
+    STATIC_REQUIRE_FALSE(fefu::split_hash_map<std::uint64_t, payload<64>>::boxed_values);
+
+    map_type map;
+    for (std::uint64_t i = 0; i < 5000; i++) {
+        map.try_emplace(i * 7, i);
+    }
+    map.erase(7);
+    REQUIRE(map.memory_usage().heap == 4999 * sizeof(payload<256>));
+
+    map_type copy(map);
+    for (std::uint64_t i = 0; i < 5000; i++) {
+        REQUIRE(copy.count(i * 7) == (i != 1));
+        if (i != 1) {
+            REQUIRE(copy.at(i * 7).words[31] == i);
+        }
+    }
+}
+
+namespace
+{
+    // Copying throws once copies_left reaches zero; the move may throw, so rehash copies.
+    struct fragile {
+        static int copies_left;
+        int value;
+
+        explicit fragile(int v) : value(v) {}
+        fragile(const fragile& other) : value(other.value) {
+            if (copies_left-- == 0) {
+                throw std::runtime_error("copy failed");
+            }
+        }
+        fragile(fragile&& other) noexcept(false) : value(other.value) {}
+    };
+
+    int fragile::copies_left = 0;
+}
+
+TEST_CASE("split_hash_map rehash keeps the map when a copy throws", "[split_hash_map]") {
+    fefu::split_hash_map<int, fragile> map;
+    fragile::copies_left = 1000;
+    for (int i = 0; i < 100; i++) {
+        map.try_emplace(i, i);
+    }
+    std::size_t buckets = map.bucket_count();
+
+    fragile::copies_left = 50;
+    REQUIRE_THROWS_AS(map.rehash(4 * buckets), std::runtime_error);
+    REQUIRE(map.bucket_count() == buckets);
+    REQUIRE(map.size() == 100);
+    for (int i = 0; i < 100; i++) {
+        REQUIRE(map.at(i).value == i);
+    }
+}
+
+TEST_CASE("find with large values: hash_map versus split_hash_map", "[split_hash_map][!benchmark]") {
+    const std::uint64_t elements = 1 << 17;
+    const std::uint64_t lookups = 1 << 21;
+
+    std::mt19937_64 generator(5);
+    std::vector<std::uint64_t> keys(2 * elements);
+    for (auto& key : keys) {
+        key = generator();
+    }
+
+    // Half of the probes miss, which is where a long probe over wide buckets hurts.
+    std::vector<std::uint64_t> probes(lookups);
+    for (auto& probe : probes) {
+        probe = keys[generator() % keys.size()];
+    }
+
+    benchmark_find<64>(elements, keys, probes);
+    benchmark_find<128>(elements, keys, probes);
+    benchmark_find<256>(elements, keys, probes);
+    benchmark_find<512>(elements, keys, probes);
+}
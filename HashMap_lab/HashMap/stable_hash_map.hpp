@@ -0,0 +1,644 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "hash_map.hpp"
+
+namespace fefu
+{
+    /**
+     *  @brief  A %hash_map whose elements never move.
+     *
+     *  Elements are constructed in chunks of chunk_size slots that are
+     *  never reallocated, so pointers and references to an element stay
+     *  valid until that element is erased, across any number of inserts
+     *  and rehashes.  The hash table holds 8-byte buckets with a 32-bit
+     *  handle (chunk * chunk_size + slot) and 32 bits of the key's hash;
+     *  a rehash rebuilds only this table.  Probing is linear over a
+     *  power-of-two table, and erasing shifts the cluster back.
+     *
+     *  Slots freed by erase() are reused by later inserts.  Iteration
+     *  walks the chunks in order, skipping free slots by their bitmask.
+     *  Holds at most 2^32 - 1 elements.
+     */
+    template<typename K, typename T,
+        typename Hash = std::hash<K>,
+        typename Pred = std::equal_to<K>,
+        typename Alloc = allocator<std::pair<const K, T>>>
+        class stable_hash_map
+    {
+    public:
+        using key_type = K;
+        using mapped_type = T;
+        using hasher = Hash;
+        using key_equal = Pred;
+        using allocator_type = Alloc;
+        using value_type = std::pair<const key_type, mapped_type>;
+        using reference = value_type&;
+        using const_reference = const value_type&;
+        using size_type = std::size_t;
+
+        /// Slots per chunk; one bit of a chunk's live mask each.
+        static constexpr size_type chunk_size = 64;
+
+    private:
+        struct chunk {
+            std::uint64_t live = 0;
+            typename std::aligned_storage<sizeof(value_type), alignof(value_type)>::type slots[chunk_size];
+        };
+
+        struct bucket {
+            std::uint32_t handle;
+            std::uint32_t fingerprint;
+        };
+
+        using alloc_traits = std::allocator_traits<Alloc>;
+        using chunk_allocator = typename alloc_traits::template rebind_alloc<chunk>;
+        using chunk_traits = std::allocator_traits<chunk_allocator>;
+        using chunk_vector = std::vector<chunk*, typename alloc_traits::template rebind_alloc<chunk*>>;
+        using bucket_vector = std::vector<bucket, typename alloc_traits::template rebind_alloc<bucket>>;
+        using handle_vector = std::vector<std::uint32_t, typename alloc_traits::template rebind_alloc<std::uint32_t>>;
+
+        static constexpr std::uint32_t empty_handle = std::numeric_limits<std::uint32_t>::max();
+
+        template<bool Const>
+        class basic_iterator {
+            using map_pointer = typename std::conditional<Const, const stable_hash_map*, stable_hash_map*>::type;
+
+        public:
+            using iterator_category = std::forward_iterator_tag;
+            using value_type = stable_hash_map::value_type;
+            using difference_type = std::ptrdiff_t;
+            using reference = typename std::conditional<Const, const value_type&, value_type&>::type;
+            using pointer = typename std::conditional<Const, const value_type*, value_type*>::type;
+
+            basic_iterator() noexcept : map_(nullptr), handle_(0) {}
+
+            template<bool C = Const, typename = typename std::enable_if<C>::type>
+            basic_iterator(const basic_iterator<false>& other) noexcept : map_(other.map_), handle_(other.handle_) {}
+
+            reference operator*() const {
+                return map_->element(handle_);
+            }
+
+            pointer operator->() const {
+                return &map_->element(handle_);
+            }
+
+            basic_iterator& operator++() {
+                handle_ = map_->next_live(handle_ + 1);
+                return *this;
+            }
+
+            basic_iterator operator++(int) {
+                basic_iterator previous(*this);
+                ++(*this);
+                return previous;
+            }
+
+            friend bool operator==(const basic_iterator& lhs, const basic_iterator& rhs) {
+                return lhs.handle_ == rhs.handle_;
+            }
+
+            friend bool operator!=(const basic_iterator& lhs, const basic_iterator& rhs) {
+                return lhs.handle_ != rhs.handle_;
+            }
+
+        private:
+            friend class stable_hash_map;
+            friend class basic_iterator<true>;
+
+            map_pointer map_;
+            size_type handle_;
+
+            basic_iterator(map_pointer map, size_type handle) noexcept : map_(map), handle_(handle) {}
+        };
+
+    public:
+        using iterator = basic_iterator<false>;
+        using const_iterator = basic_iterator<true>;
+
+        /// Default constructor.
+        stable_hash_map() : stable_hash_map(Alloc()) {}
+
+        explicit stable_hash_map(const allocator_type& a)
+            : allocator_(a), chunks_(typename chunk_vector::allocator_type(a)), buckets_(typename bucket_vector::allocator_type(a)),
+            free_(typename handle_vector::allocator_type(a)), size_(0), next_handle_(0), mask_(0), hash_(), equal_() {}
+
+        stable_hash_map(std::initializer_list<value_type> l, const allocator_type& a = allocator_type()) : stable_hash_map(a) {
+            reserve(l.size());
+            for (const value_type& element : l) {
+                insert(element);
+            }
+        }
+
+        /// Copies every element into the same slot, so the table is copied as is.
+        stable_hash_map(const stable_hash_map& other)
+            : stable_hash_map(alloc_traits::select_on_container_copy_construction(other.allocator_)) {
+            hash_ = other.hash_;
+            equal_ = other.equal_;
+            copy_elements(other);
+        }
+
+        stable_hash_map(stable_hash_map&& other) noexcept
+            : allocator_(std::move(other.allocator_)), chunks_(std::move(other.chunks_)), buckets_(std::move(other.buckets_)),
+            free_(std::move(other.free_)), size_(other.size_), next_handle_(other.next_handle_), mask_(other.mask_),
+            hash_(other.hash_), equal_(other.equal_) {
+            other.forget();
+        }
+
+        stable_hash_map& operator=(const stable_hash_map& other) {
+            if (this != &other) {
+                destroy();
+                if constexpr (alloc_traits::propagate_on_container_copy_assignment::value) {
+                    allocator_ = other.allocator_;
+                }
+                hash_ = other.hash_;
+                equal_ = other.equal_;
+                copy_elements(other);
+            }
+            return *this;
+        }
+
+        stable_hash_map& operator=(stable_hash_map&& other) {
+            if (this == &other) {
+                return *this;
+            }
+
+            destroy();
+            hash_ = other.hash_;
+            equal_ = other.equal_;
+
+            if constexpr (alloc_traits::propagate_on_container_move_assignment::value) {
+                allocator_ = std::move(other.allocator_);
+                take(other);
+            }
+            else if (allocator_ == other.allocator_) {
+                take(other);
+            }
+            else {
+                copy_elements(other);
+                other.clear();
+            }
+            return *this;
+        }
+
+        ~stable_hash_map() {
+            destroy();
+        }
+
+        allocator_type get_allocator() const noexcept {
+            return allocator_;
+        }
+
+        bool empty() const noexcept {
+            return size_ == 0;
+        }
+
+        size_type size() const noexcept {
+            return size_;
+        }
+
+        /// Returns the bytes used by the map; the handle table and free list are metadata.
+        memory_footprint memory_usage() const noexcept {
+            memory_footprint footprint;
+            footprint.object = sizeof(*this);
+            footprint.slots = chunks_.size() * sizeof(chunk);
+            footprint.metadata = chunks_.capacity() * sizeof(chunk*) + buckets_.capacity() * sizeof(bucket)
+                + free_.capacity() * sizeof(std::uint32_t);
+            return footprint;
+        }
+
+        //@{
+        iterator begin() noexcept {
+            return iterator(this, next_live(0));
+        }
+
+        const_iterator begin() const noexcept {
+            return const_iterator(this, next_live(0));
+        }
+
+        const_iterator cbegin() const noexcept {
+            return begin();
+        }
+
+        iterator end() noexcept {
+            return iterator(this, end_handle());
+        }
+
+        const_iterator end() const noexcept {
+            return const_iterator(this, end_handle());
+        }
+
+        const_iterator cend() const noexcept {
+            return end();
+        }
+        //@}
+
+        /**
+         *  @brief  Inserts an element with key @a k and a value constructed
+         *          from @a args if @a k is absent.
+         *  @return  A pair of an iterator to the element with key @a k and a
+         *           bool that is true if the element was inserted.
+         */
+        //@{
+        template<typename... Args>
+        std::pair<iterator, bool> try_emplace(const key_type& k, Args&&... args) {
+            return emplace_key(k, std::forward<Args>(args)...);
+        }
+
+        template<typename... Args>
+        std::pair<iterator, bool> try_emplace(key_type&& k, Args&&... args) {
+            return emplace_key(std::move(k), std::forward<Args>(args)...);
+        }
+        //@}
+
+        std::pair<iterator, bool> insert(const value_type& x) {
+            return emplace_key(x.first, x.second);
+        }
+
+        std::pair<iterator, bool> insert(value_type&& x) {
+            return emplace_key(x.first, std::move(x.second));
+        }
+
+        template<typename Obj>
+        std::pair<iterator, bool> insert_or_assign(const key_type& k, Obj&& obj) {
+            size_type pos = find_bucket(k);
+            if (pos != buckets_.size()) {
+                element(buckets_[pos].handle).second = std::forward<Obj>(obj);
+                return { iterator(this, buckets_[pos].handle), false };
+            }
+            return emplace_key(k, std::forward<Obj>(obj));
+        }
+
+        mapped_type& operator[](const key_type& k) {
+            return element(emplace_key(k).first.handle_).second;
+        }
+
+        mapped_type& operator[](key_type&& k) {
+            return element(emplace_key(std::move(k)).first.handle_).second;
+        }
+
+        //@{
+        /// Returns the value of @a k, or throws std::out_of_range.
+        mapped_type& at(const key_type& k) {
+            size_type pos = find_bucket(k);
+            if (pos == buckets_.size()) {
+                throw std::out_of_range("stable_hash_map::at");
+            }
+            return element(buckets_[pos].handle).second;
+        }
+
+        const mapped_type& at(const key_type& k) const {
+            size_type pos = find_bucket(k);
+            if (pos == buckets_.size()) {
+                throw std::out_of_range("stable_hash_map::at");
+            }
+            return element(buckets_[pos].handle).second;
+        }
+        //@}
+
+        //@{
+        iterator find(const key_type& k) {
+            size_type pos = find_bucket(k);
+            return pos == buckets_.size() ? end() : iterator(this, buckets_[pos].handle);
+        }
+
+        const_iterator find(const key_type& k) const {
+            size_type pos = find_bucket(k);
+            return pos == buckets_.size() ? end() : const_iterator(this, buckets_[pos].handle);
+        }
+        //@}
+
+        bool contains(const key_type& k) const {
+            return find_bucket(k) != buckets_.size();
+        }
+
+        size_type count(const key_type& k) const {
+            return contains(k) ? 1 : 0;
+        }
+
+        /// Erases the element at @a position; returns an iterator to the next one.
+        iterator erase(const_iterator position) {
+            size_type handle = position.handle_;
+            erase_bucket(find_handle(handle));
+            return iterator(this, next_live(handle + 1));
+        }
+
+        /// Erases the element with key @a k; returns the number erased.
+        size_type erase(const key_type& k) {
+            size_type pos = find_bucket(k);
+            if (pos == buckets_.size()) {
+                return 0;
+            }
+            erase_bucket(pos);
+            return 1;
+        }
+
+        /// Erases every element; the chunks and the table are kept.
+        void clear() noexcept {
+            destroy_elements();
+            for (bucket& b : buckets_) {
+                b.handle = empty_handle;
+            }
+            free_.clear();
+            size_ = 0;
+            next_handle_ = 0;
+        }
+
+        void swap(stable_hash_map& x) noexcept {
+            if constexpr (alloc_traits::propagate_on_container_swap::value) {
+                using std::swap;
+                swap(allocator_, x.allocator_);
+            }
+            chunks_.swap(x.chunks_);
+            buckets_.swap(x.buckets_);
+            free_.swap(x.free_);
+            std::swap(size_, x.size_);
+            std::swap(next_handle_, x.next_handle_);
+            std::swap(mask_, x.mask_);
+            std::swap(hash_, x.hash_);
+            std::swap(equal_, x.equal_);
+        }
+
+        size_type bucket_count() const noexcept {
+            return buckets_.size();
+        }
+
+        float load_factor() const noexcept {
+            return buckets_.empty() ? 0 : static_cast<float>(size_) / buckets_.size();
+        }
+
+        /// Always 0.5: the table is only 8 bytes a bucket.
+        float max_load_factor() const noexcept {
+            return 0.5f;
+        }
+
+        /// Makes room for @a n elements; allocates the chunks up front.
+        void reserve(size_type n) {
+            while (chunks_.size() * chunk_size < n) {
+                add_chunk();
+            }
+            if (2 * n > buckets_.size()) {
+                rebuild(2 * n);
+            }
+        }
+
+    private:
+        allocator_type allocator_;
+        chunk_vector chunks_;
+        bucket_vector buckets_;
+        handle_vector free_;
+        size_type size_;
+        size_type next_handle_;
+        size_type mask_;
+        Hash hash_;
+        key_equal equal_;
+
+        //@{
+        value_type& element(size_type handle) noexcept {
+            return *reinterpret_cast<value_type*>(&chunks_[handle / chunk_size]->slots[handle % chunk_size]);
+        }
+
+        const value_type& element(size_type handle) const noexcept {
+            return *reinterpret_cast<const value_type*>(&chunks_[handle / chunk_size]->slots[handle % chunk_size]);
+        }
+        //@}
+
+        size_type end_handle() const noexcept {
+            return chunks_.size() * chunk_size;
+        }
+
+        // First live handle at or after @a handle, or end_handle().
+        size_type next_live(size_type handle) const noexcept {
+            size_type c = handle / chunk_size;
+            if (c >= chunks_.size()) {
+                return end_handle();
+            }
+
+            std::uint64_t live = chunks_[c]->live >> (handle % chunk_size);
+            if (live != 0) {
+                return handle + detail::lowest_bit(live);
+            }
+
+            for (c++; c != chunks_.size(); c++) {
+                if (chunks_[c]->live != 0) {
+                    return c * chunk_size + detail::lowest_bit(chunks_[c]->live);
+                }
+            }
+            return end_handle();
+        }
+
+        static std::uint32_t fingerprint_of(std::uint64_t hash) noexcept {
+            return static_cast<std::uint32_t>(hash >> 32);
+        }
+
+        size_type home_of(std::uint64_t hash) const noexcept {
+            return static_cast<size_type>(hash) & mask_;
+        }
+
+        /// Returns the bucket holding @a k, or buckets_.size() if there is none.
+        size_type find_bucket(const key_type& k) const {
+            if (size_ == 0) {
+                return buckets_.size();
+            }
+
+            std::uint64_t hash = detail::mix(hash_(k));
+            std::uint32_t fingerprint = fingerprint_of(hash);
+
+            for (size_type pos = home_of(hash);; pos = (pos + 1) & mask_) {
+                const bucket& b = buckets_[pos];
+
+                if (b.handle == empty_handle) {
+                    return buckets_.size();
+                }
+                if (b.fingerprint == fingerprint && equal_(element(b.handle).first, k)) {
+                    return pos;
+                }
+            }
+        }
+
+        /// Returns the bucket holding @a handle.
+        size_type find_handle(size_type handle) const {
+            size_type pos = home_of(detail::mix(hash_(element(handle).first)));
+            while (buckets_[pos].handle != handle) {
+                pos = (pos + 1) & mask_;
+            }
+            return pos;
+        }
+
+        void add_chunk() {
+            chunk_allocator chunk_alloc(allocator_);
+            chunk* c = chunk_traits::allocate(chunk_alloc, 1);
+            new (c) chunk();
+
+            try {
+                chunks_.push_back(c);
+            }
+            catch (...) {
+                chunk_traits::deallocate(chunk_alloc, c, 1);
+                throw;
+            }
+        }
+
+        template<typename KeyArg, typename... Args>
+        std::pair<iterator, bool> emplace_key(KeyArg&& k, Args&&... args) {
+            size_type pos = find_bucket(k);
+            if (pos != buckets_.size()) {
+                return { iterator(this, buckets_[pos].handle), false };
+            }
+
+            if (size_ == empty_handle) {
+                throw std::length_error("stable_hash_map: too many elements");
+            }
+            if (2 * (size_ + 1) > buckets_.size()) {
+                rebuild(buckets_.empty() ? 8 : 2 * buckets_.size());
+            }
+
+            size_type handle;
+            if (!free_.empty()) {
+                handle = free_.back();
+            }
+            else {
+                if (next_handle_ == end_handle()) {
+                    add_chunk();
+                }
+                handle = next_handle_;
+            }
+
+            std::uint64_t hash = detail::mix(hash_(k));
+            new (&chunks_[handle / chunk_size]->slots[handle % chunk_size])
+                value_type(std::piecewise_construct, std::forward_as_tuple(std::forward<KeyArg>(k)), std::forward_as_tuple(std::forward<Args>(args)...));
+
+            if (!free_.empty()) {
+                free_.pop_back();
+            }
+            else {
+                next_handle_++;
+            }
+            chunks_[handle / chunk_size]->live |= std::uint64_t(1) << (handle % chunk_size);
+            size_++;
+
+            pos = home_of(hash);
+            while (buckets_[pos].handle != empty_handle) {
+                pos = (pos + 1) & mask_;
+            }
+            buckets_[pos] = bucket{ static_cast<std::uint32_t>(handle), fingerprint_of(hash) };
+
+            return { iterator(this, handle), true };
+        }
+
+        void erase_bucket(size_type hole) {
+            size_type handle = buckets_[hole].handle;
+
+            // Only buckets move; the element is destroyed last.
+            hole = detail::backward_shift(hole, mask_,
+                [this](size_type pos) { return buckets_[pos].handle == empty_handle; },
+                [this](size_type pos) { return home_of(detail::mix(hash_(element(buckets_[pos].handle).first))); },
+                [this](size_type from, size_type to) { buckets_[to] = buckets_[from]; });
+            buckets_[hole].handle = empty_handle;
+
+            element(handle).~value_type();
+            chunks_[handle / chunk_size]->live &= ~(std::uint64_t(1) << (handle % chunk_size));
+            free_.push_back(static_cast<std::uint32_t>(handle));
+            size_--;
+        }
+
+        // Rebuilds the table with at least @a n buckets; no element moves.
+        void rebuild(size_type n) {
+            size_type count = 8;
+            while (count < n) {
+                count *= 2;
+            }
+
+            buckets_.assign(count, bucket{ empty_handle, 0 });
+            mask_ = count - 1;
+
+            for (size_type handle = next_live(0); handle != end_handle(); handle = next_live(handle + 1)) {
+                std::uint64_t hash = detail::mix(hash_(element(handle).first));
+
+                size_type pos = home_of(hash);
+                while (buckets_[pos].handle != empty_handle) {
+                    pos = (pos + 1) & mask_;
+                }
+                buckets_[pos] = bucket{ static_cast<std::uint32_t>(handle), fingerprint_of(hash) };
+            }
+        }
+
+        // Copies @a other into this empty map, each element into the same slot.
+        void copy_elements(const stable_hash_map& other) {
+            try {
+                while (chunks_.size() != other.chunks_.size()) {
+                    add_chunk();
+                }
+                for (size_type c = 0; c != chunks_.size(); c++) {
+                    for (std::uint64_t live = other.chunks_[c]->live; live != 0; live &= live - 1) {
+                        size_type handle = c * chunk_size + detail::lowest_bit(live);
+                        new (&chunks_[c]->slots[handle % chunk_size]) value_type(other.element(handle));
+                        chunks_[c]->live |= std::uint64_t(1) << (handle % chunk_size);
+                        size_++;
+                    }
+                }
+                buckets_ = other.buckets_;
+                free_ = other.free_;
+            }
+            catch (...) {
+                destroy();
+                throw;
+            }
+            next_handle_ = other.next_handle_;
+            mask_ = other.mask_;
+        }
+
+        void take(stable_hash_map& other) noexcept {
+            chunks_ = std::move(other.chunks_);
+            buckets_ = std::move(other.buckets_);
+            free_ = std::move(other.free_);
+            size_ = other.size_;
+            next_handle_ = other.next_handle_;
+            mask_ = other.mask_;
+            other.forget();
+        }
+
+        // Leaves a moved-from map empty without touching the storage it gave away.
+        void forget() noexcept {
+            chunks_.clear();
+            buckets_.clear();
+            free_.clear();
+            size_ = 0;
+            next_handle_ = 0;
+            mask_ = 0;
+        }
+
+        void destroy_elements() noexcept {
+            for (chunk* c : chunks_) {
+                for (std::uint64_t live = c->live; live != 0; live &= live - 1) {
+                    reinterpret_cast<value_type*>(&c->slots[detail::lowest_bit(live)])->~value_type();
+                }
+                c->live = 0;
+            }
+        }
+
+        /// Destroys the elements and releases the chunks and the table.
+        void destroy() noexcept {
+            destroy_elements();
+
+            chunk_allocator chunk_alloc(allocator_);
+            for (chunk* c : chunks_) {
+                c->~chunk();
+                chunk_traits::deallocate(chunk_alloc, c, 1);
+            }
+            forget();
+        }
+    };
+
+} // namespace fefu
@@ -0,0 +1,160 @@
+#include <cstdint>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "hash_map.hpp"
+#include "stable_hash_map.hpp"
+#include "../catch.hpp"
+
+TEST_CASE("stable_hash_map never moves its elements", "[stable_hash_map]") {
+    fefu::stable_hash_map<int, std::string> map;
+    std::string& first = map[0];
+    first = "value";
+    const std::string* address = &first;
+
+    for (int i = 1; i < 100000; i++) {
+        map.try_emplace(i, std::to_string(i));
+    }
+    REQUIRE(map.size() == 100000);
+    REQUIRE(&map.at(0) == address);
+    REQUIRE(*address == "value");
+
+    for (int i = 1; i < 100000; i += 2) {
+        REQUIRE(map.erase(i) == 1);
+    }
+    map.reserve(1000000);
+    REQUIRE(&map.find(0)->second == address);
+
+    SECTION("erased slots are reused") {
+        auto before = map.memory_usage().slots;
+        for (int i = 1; i < 100000; i += 2) {
+            map[-i] = "again";
+        }
+        REQUIRE(map.memory_usage().slots == before);
+        REQUIRE(map.size() == 100000);
+    }
+    SECTION("copy, move and clear") {
+        auto copy = map;
+        REQUIRE(copy.size() == map.size());
+        REQUIRE(copy.at(2) == "2");
+        REQUIRE(&copy.at(0) != address);
+
+        fefu::stable_hash_map<int, std::string> moved(std::move(map));
+        REQUIRE(map.empty());
+        REQUIRE(&moved.at(0) == address);
+
+        moved.clear();
+        REQUIRE(moved.begin() == moved.end());
+        moved[5] = "five";
+        REQUIRE(moved.size() == 1);
+    }
+}
+
+TEST_CASE("stable_hash_map agrees with std::unordered_map", "[stable_hash_map]") {
+    fefu::stable_hash_map<std::uint32_t, std::uint32_t> map;
+    std::unordered_map<std::uint32_t, std::uint32_t> reference;
+
+    std::mt19937 generator(12);
+    for (int round = 0; round < 100000; round++) {
+        std::uint32_t key = generator() % 3000;
+        if (generator() % 3 == 0) {
+            REQUIRE(map.erase(key) == reference.erase(key));
+        }
+        else {
+            map[key] += round;
+            reference[key] += round;
+        }
+    }
+
+    REQUIRE(map.size() == reference.size());
+    std::size_t visited = 0;
+    for (const auto& element : map) {
+        REQUIRE(reference.at(element.first) == element.second);
+        visited++;
+    }
+    REQUIRE(visited == reference.size());
+
+    for (auto it = map.begin(); it != map.end();) {
+        it = it->first % 2 == 0 ? map.erase(it) : ++it;
+    }
+    for (const auto& element : reference) {
+        REQUIRE(map.count(element.first) == element.first % 2);
+    }
+}
+
+TEST_CASE("Holding references across inserts: hash_map versus stable_hash_map", "[stable_hash_map][!benchmark]") {
+    using record = std::vector<std::uint32_t>;
+    const std::uint32_t elements = 1 << 19;
+
+    std::mt19937 generator(13);
+    std::vector<std::uint32_t> keys(elements);
+    for (auto& key : keys) {
+        key = generator();
+    }
+
+    BENCHMARK("hash_map build") {
+        fefu::hash_map<std::uint32_t, std::uint32_t> map;
+        for (std::uint32_t key : keys) {
+            map[key] = key;
+        }
+        return map.size();
+    };
+
+    BENCHMARK("stable_hash_map build") {
+        fefu::stable_hash_map<std::uint32_t, std::uint32_t> map;
+        for (std::uint32_t key : keys) {
+            map[key] = key;
+        }
+        return map.size();
+    };
+
+    // Each step reads a record, inserts a new one, then uses the first: a
+    // hash_map insert may rehash, so the record has to be copied out first.
+    BENCHMARK("hash_map, copying records out") {
+        fefu::hash_map<std::uint32_t, record> map;
+        map[keys[0]] = record(16, 1);
+        std::uint64_t sum = 0;
+        for (std::uint32_t i = 1; i < elements; i++) {
+            record parent = map.find(keys[i / 2])->second;
+            map.try_emplace(keys[i], 16, i);
+            sum += parent[i % 16];
+        }
+        return sum;
+    };
+
+    BENCHMARK("stable_hash_map, holding references") {
+        fefu::stable_hash_map<std::uint32_t, record> map;
+        map[keys[0]] = record(16, 1);
+        std::uint64_t sum = 0;
+        for (std::uint32_t i = 1; i < elements; i++) {
+            const record& parent = map.find(keys[i / 2])->second;
+            map.try_emplace(keys[i], 16, i);
+            sum += parent[i % 16];
+        }
+        return sum;
+    };
+
+    fefu::hash_map<std::uint32_t, std::uint32_t> flat;
+    fefu::stable_hash_map<std::uint32_t, std::uint32_t> stable;
+    for (std::uint32_t key : keys) {
+        flat[key] = key;
+        stable[key] = key;
+    }
+
+    BENCHMARK("hash_map find") {
+        std::uint64_t sum = 0;
+        for (std::uint32_t i = 0; i < elements; i++) {
+            sum += flat.find(keys[(i * 7919) % elements])->second;
+        }
+        return sum;
+    };
+
+    BENCHMARK("stable_hash_map find") {
+        std::uint64_t sum = 0;
+        for (std::uint32_t i = 0; i < elements; i++) {
+            sum += stable.find(keys[(i * 7919) % elements])->second;
+        }
+        return sum;
+    };
+}
@@ -0,0 +1,244 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <stdexcept>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include "hash_map.hpp"
+
+namespace fefu
+{
+    /**
+     *  @brief  Hash usable in constant expressions.
+     *
+     *  Defined for integral and enumeration types and std::string_view;
+     *  specialize it, or pass another Hash to %static_hash_map, for others.
+     */
+    template<typename K, typename = void>
+    struct static_hash;
+
+    template<typename K>
+    struct static_hash<K, typename std::enable_if<std::is_integral<K>::value || std::is_enum<K>::value>::type> {
+        constexpr std::uint64_t operator()(K key) const noexcept {
+            return static_cast<std::uint64_t>(key) * 0x9E3779B97F4A7C15ull;
+        }
+    };
+
+    /// FNV-1a.
+    template<>
+    struct static_hash<std::string_view> {
+        constexpr std::uint64_t operator()(std::string_view key) const noexcept {
+            std::uint64_t hash = 0xcbf29ce484222325ull;
+            for (char c : key) {
+                hash = (hash ^ static_cast<unsigned char>(c)) * 0x100000001b3ull;
+            }
+            return hash;
+        }
+    };
+
+    /**
+     *  @brief  A map over a fixed set of keys, built at compile time.
+     *
+     *  The constructor finds a perfect hash for its N keys: the keys are
+     *  split into groups by one hash, and every group gets a displacement
+     *  choosing a second hash that sends its keys to distinct free buckets
+     *  of a power-of-two table.  Declared constexpr, the whole search runs
+     *  in the compiler, the map lives in read-only data, and a lookup is
+     *  two array reads and one key comparison.  Lookups are constexpr as
+     *  well.
+     *
+     *  Keys and values must be literal types.  Duplicate keys, two keys
+     *  with equal hashes, or a group that no displacement up to
+     *  max_displacement can place make the construction throw
+     *  std::invalid_argument (a compile error for a constexpr map).
+     */
+    template<typename K, typename T, std::size_t N,
+        typename Hash = static_hash<K>,
+        typename Pred = std::equal_to<K>>
+        class static_hash_map
+    {
+    public:
+        using key_type = K;
+        using mapped_type = T;
+        using hasher = Hash;
+        using key_equal = Pred;
+        using size_type = std::size_t;
+
+        static constexpr size_type bucket_count() noexcept {
+            return table_size;
+        }
+
+        /// Builds the map from @a items.
+        constexpr explicit static_hash_map(const std::pair<K, T> (&items)[N]) : keys_(), values_(), displacements_(), slots_() {
+            std::uint64_t hashes[N == 0 ? 1 : N] = {};
+            size_type group_size[group_count] = {};
+            size_type order[group_count] = {};
+            bool taken[table_size] = {};
+
+            for (size_type i = 0; i != N; i++) {
+                keys_[i] = items[i].first;
+                values_[i] = items[i].second;
+                hashes[i] = detail::finalize(Hash()(items[i].first));
+                group_size[group_of(hashes[i])]++;
+
+                for (size_type j = 0; j != i; j++) {
+                    if (Pred()(keys_[j], keys_[i])) {
+                        throw std::invalid_argument("static_hash_map: duplicate key");
+                    }
+                    // Such keys share a group and collide for every displacement.
+                    if (hashes[j] == hashes[i]) {
+                        throw std::invalid_argument("static_hash_map: two keys have equal hashes");
+                    }
+                }
+            }
+
+            // Largest groups first; insertion sort is fine for constant tables.
+            for (size_type g = 0; g != group_count; g++) {
+                size_type j = g;
+                for (; j != 0 && group_size[order[j - 1]] < group_size[g]; j--) {
+                    order[j] = order[j - 1];
+                }
+                order[j] = g;
+            }
+
+            for (size_type o = 0; o != group_count && group_size[order[o]] != 0; o++) {
+                size_type g = order[o];
+
+                for (std::uint64_t d = 0;; d++) {
+                    if (d == max_displacement) {
+                        throw std::invalid_argument("static_hash_map: no displacement places a key group");
+                    }
+
+                    size_type placed[N == 0 ? 1 : N] = {};
+                    size_type count = 0;
+                    bool fits = true;
+
+                    for (size_type i = 0; i != N && fits; i++) {
+                        if (group_of(hashes[i]) != g) {
+                            continue;
+                        }
+
+                        size_type slot = slot_of(hashes[i], d);
+                        for (size_type p = 0; p != count; p++) {
+                            fits = fits && placed[p] != slot;
+                        }
+                        fits = fits && !taken[slot];
+
+                        if (fits) {
+                            placed[count++] = slot;
+                        }
+                    }
+
+                    if (fits) {
+                        size_type p = 0;
+                        for (size_type i = 0; i != N; i++) {
+                            if (group_of(hashes[i]) == g) {
+                                taken[placed[p]] = true;
+                                slots_[placed[p++]] = i;
+                            }
+                        }
+                        displacements_[g] = d;
+                        break;
+                    }
+                }
+            }
+        }
+
+        static constexpr size_type size() noexcept {
+            return N;
+        }
+
+        static constexpr bool empty() noexcept {
+            return N == 0;
+        }
+
+        /// Returns a pointer to the value of @a k, or nullptr.
+        constexpr const mapped_type* find(const key_type& k) const {
+            size_type i = index_of(k);
+            return i == N ? nullptr : &values_[i];
+        }
+
+        constexpr bool contains(const key_type& k) const {
+            return index_of(k) != N;
+        }
+
+        /// Returns the value of @a k, or throws std::out_of_range.
+        constexpr const mapped_type& at(const key_type& k) const {
+            size_type i = index_of(k);
+            if (i == N) {
+                throw std::out_of_range("static_hash_map::at");
+            }
+            return values_[i];
+        }
+
+        /// Returns the value of @a k, or @a fallback if it is absent.
+        constexpr mapped_type get(const key_type& k, const mapped_type& fallback) const {
+            size_type i = index_of(k);
+            return i == N ? fallback : values_[i];
+        }
+
+        //@{
+        /// Access to the keys and values in construction order.
+        constexpr const std::array<key_type, N>& keys() const noexcept {
+            return keys_;
+        }
+
+        constexpr const std::array<mapped_type, N>& values() const noexcept {
+            return values_;
+        }
+        //@}
+
+    private:
+        static constexpr size_type ceil_pow2(size_type n) noexcept {
+            size_type result = 1;
+            while (result < n) {
+                result *= 2;
+            }
+            return result;
+        }
+
+        static constexpr size_type table_size = ceil_pow2(N + N / 4 + 1);
+        static constexpr size_type group_count = ceil_pow2(N / 2 + 1);
+        static constexpr std::uint64_t max_displacement = std::uint64_t(1) << 16;
+
+        std::array<key_type, N> keys_;
+        std::array<mapped_type, N> values_;
+        std::array<std::uint64_t, group_count> displacements_;
+        std::array<size_type, table_size> slots_;
+
+        // Both take the mixed hash of a key.
+        static constexpr size_type group_of(std::uint64_t hash) noexcept {
+            return static_cast<size_type>(hash >> 40) & (group_count - 1);
+        }
+
+        static constexpr size_type slot_of(std::uint64_t hash, std::uint64_t d) noexcept {
+            return static_cast<size_type>(((hash ^ d) * 0x9E3779B97F4A7C15ull) >> 32) & (table_size - 1);
+        }
+
+        constexpr size_type index_of(const key_type& k) const {
+            std::uint64_t hash = detail::finalize(Hash()(k));
+            if constexpr (N == 0) {
+                return N;
+            }
+            else {
+                // Free buckets hold 0; no key other than keys_[0] compares equal there.
+                size_type i = slots_[slot_of(hash, displacements_[group_of(hash)])];
+                return Pred()(keys_[i], k) ? i : N;
+            }
+        }
+    };
+
+    /**
+     *  @brief  Creates a %static_hash_map from a braced list of pairs:
+     *
+     *      constexpr auto ops = make_static_hash_map<std::string_view, int>({ { "add", 1 }, { "sub", 2 } });
+     */
+    template<typename K, typename T, std::size_t N>
+    constexpr static_hash_map<K, T, N> make_static_hash_map(const std::pair<K, T> (&items)[N]) {
+        return static_hash_map<K, T, N>(items);
+    }
+
+} // namespace fefu
@@ -0,0 +1,109 @@
+#include <cstdint>
+#include <random>
+#include <stdexcept>
+#include <string_view>
+#include <vector>
+#include "hash_map.hpp"
+#include "static_hash_map.hpp"
+#include "../catch.hpp"
+
+namespace
+{
+    constexpr auto commands = fefu::make_static_hash_map<std::string_view, int>({
+        { "add", 1 }, { "sub", 2 }, { "mul", 3 }, { "div", 4 }, { "mod", 5 },
+        { "push", 6 }, { "pop", 7 }, { "jmp", 8 }, { "call", 9 }, { "ret", 10 },
+        { "load", 11 }, { "store", 12 }, { "cmp", 13 }, { "halt", 14 } });
+
+    static_assert(commands.size() == 14, "");
+    static_assert(commands.at("ret") == 10, "lookups are constant expressions");
+    static_assert(!commands.contains("nop"), "");
+    static_assert(commands.get("nop", -1) == -1, "");
+
+    constexpr std::pair<std::uint32_t, int> opcode_table[] = {
+        { 0x01, 1 }, { 0x03, 2 }, { 0x08, 3 }, { 0x0c, 4 }, { 0x11, 5 }, { 0x1f, 6 }, { 0x20, 7 }, { 0x2a, 8 },
+        { 0x37, 9 }, { 0x40, 10 }, { 0x55, 11 }, { 0x5b, 12 }, { 0x66, 13 }, { 0x7e, 14 }, { 0x80, 15 }, { 0x8f, 16 },
+        { 0x93, 17 }, { 0xa1, 18 }, { 0xa7, 19 }, { 0xb0, 20 }, { 0xbd, 21 }, { 0xc4, 22 }, { 0xcd, 23 }, { 0xd2, 24 },
+        { 0xdf, 25 }, { 0xe3, 26 }, { 0xe8, 27 }, { 0xee, 28 }, { 0xf1, 29 }, { 0xf4, 30 }, { 0xfa, 31 }, { 0xff, 32 } };
+
+    constexpr auto opcodes = fefu::make_static_hash_map(opcode_table);
+
+    int opcode_switch(std::uint32_t op) {
+        switch (op) {
+        case 0x01: return 1;  case 0x03: return 2;  case 0x08: return 3;  case 0x0c: return 4;
+        case 0x11: return 5;  case 0x1f: return 6;  case 0x20: return 7;  case 0x2a: return 8;
+        case 0x37: return 9;  case 0x40: return 10; case 0x55: return 11; case 0x5b: return 12;
+        case 0x66: return 13; case 0x7e: return 14; case 0x80: return 15; case 0x8f: return 16;
+        case 0x93: return 17; case 0xa1: return 18; case 0xa7: return 19; case 0xb0: return 20;
+        case 0xbd: return 21; case 0xc4: return 22; case 0xcd: return 23; case 0xd2: return 24;
+        case 0xdf: return 25; case 0xe3: return 26; case 0xe8: return 27; case 0xee: return 28;
+        case 0xf1: return 29; case 0xf4: return 30; case 0xfa: return 31; case 0xff: return 32;
+        default: return 0;
+        }
+    }
+}
+
+TEST_CASE("static_hash_map lookups", "[static_hash_map]") {
+    for (std::size_t i = 0; i != commands.size(); i++) {
+        REQUIRE(commands.at(commands.keys()[i]) == commands.values()[i]);
+    }
+    REQUIRE(commands.find("halt") != nullptr);
+    REQUIRE(commands.find("hal") == nullptr);
+    REQUIRE_THROWS_AS(commands.at(""), std::out_of_range);
+
+    for (std::uint32_t op = 0; op < 0x200; op++) {
+        REQUIRE(opcodes.get(op, 0) == opcode_switch(op));
+    }
+
+    SECTION("runtime construction") {
+        std::pair<int, int> items[] = { { 1, 1 }, { 2, 2 }, { 1, 3 } };
+        REQUIRE_THROWS_AS((fefu::static_hash_map<int, int, 3>(items)), std::invalid_argument);
+
+        struct constant_hash {
+            constexpr std::uint64_t operator()(int) const noexcept {
+                return 7;
+            }
+        };
+        std::pair<int, int> colliding[] = { { 1, 1 }, { 2, 2 } };
+        REQUIRE_THROWS_AS((fefu::static_hash_map<int, int, 2, constant_hash>(colliding)), std::invalid_argument);
+    }
+}
+
+TEST_CASE("Opcode lookups: static_hash_map, hash_map and switch", "[static_hash_map][!benchmark]") {
+    const int lookups = 1 << 22;
+
+    std::vector<std::uint32_t> stream(lookups);
+    std::mt19937 generator(3);
+    for (auto& op : stream) {
+        op = generator() % 4 == 0 ? generator() % 0x100 : opcode_table[generator() % 32].first;
+    }
+
+    fefu::hash_map<std::uint32_t, int> runtime_map;
+    for (const auto& item : opcode_table) {
+        runtime_map[item.first] = item.second;
+    }
+
+    BENCHMARK("static_hash_map") {
+        long long sum = 0;
+        for (std::uint32_t op : stream) {
+            sum += opcodes.get(op, 0);
+        }
+        return sum;
+    };
+
+    BENCHMARK("hash_map") {
+        long long sum = 0;
+        for (std::uint32_t op : stream) {
+            auto it = runtime_map.find(op);
+            sum += it == runtime_map.end() ? 0 : it->second;
+        }
+        return sum;
+    };
+
+    BENCHMARK("switch") {
+        long long sum = 0;
+        for (std::uint32_t op : stream) {
+            sum += opcode_switch(op);
+        }
+        return sum;
+    };
+}
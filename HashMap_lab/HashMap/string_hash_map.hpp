@@ -0,0 +1,710 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "hash_map.hpp"
+
+namespace fefu
+{
+    /**
+     *  @brief  A %hash_map from strings that does not allocate per key.
+     *
+     *  Keys of up to inline_capacity bytes are stored in the bucket itself.
+     *  Longer keys are appended to an arena owned by the map, and the
+     *  bucket records their offset and length.  Erasing a long key leaves
+     *  its bytes in the arena until the next rehash, which copies only the
+     *  live keys into a new one.
+     *
+     *  Each bucket also keeps one byte of the key's hash, so a probe rarely
+     *  compares strings, and almost never follows an offset into the
+     *  arena, for a key that does not match.  Probing is linear over a
+     *  power-of-two table; since the fingerprints keep longer probe runs
+     *  cheap, the default maximum load factor is 0.75 rather than 0.5.
+     *
+     *  Lookups take std::string_view.  Iterators yield a pair of a
+     *  std::string_view, valid until the next insertion or rehash, and a
+     *  reference to the value.
+     */
+    template<typename T,
+        typename Hash = std::hash<std::string_view>,
+        typename Alloc = allocator<std::pair<const std::string, T>>>
+        class string_hash_map
+    {
+    public:
+        using key_type = std::string;
+        using mapped_type = T;
+        using hasher = Hash;
+        using allocator_type = Alloc;
+        using value_type = std::pair<const key_type, mapped_type>;
+        using reference = std::pair<std::string_view, mapped_type&>;
+        using const_reference = std::pair<std::string_view, const mapped_type&>;
+        using size_type = std::size_t;
+
+        /// The longest key stored inside a bucket.
+        static constexpr size_type inline_capacity = 22;
+
+    private:
+        using alloc_traits = std::allocator_traits<Alloc>;
+        using arena_type = std::vector<char, typename alloc_traits::template rebind_alloc<char>>;
+
+        /// A key as stored in a bucket: 24 bytes, inline or in the arena.
+        class key_slot {
+        public:
+            key_slot() noexcept : fingerprint_(0), tag_(empty_tag) {}
+
+            bool is_empty() const noexcept {
+                return tag_ == empty_tag;
+            }
+
+            bool is_live() const noexcept {
+                return tag_ >= inline_tag;
+            }
+
+            bool is_far() const noexcept {
+                return tag_ == far_tag;
+            }
+
+            std::string_view view(const char* arena) const noexcept {
+                if (is_far()) {
+                    std::uint64_t offset, length;
+                    std::memcpy(&offset, bytes_, sizeof(offset));
+                    std::memcpy(&length, bytes_ + sizeof(offset), sizeof(length));
+                    return std::string_view(arena + offset, static_cast<size_type>(length));
+                }
+                return std::string_view(bytes_, tag_ - inline_tag);
+            }
+
+            bool matches(std::string_view key, unsigned char fingerprint, const char* arena) const noexcept {
+                return fingerprint_ == fingerprint && is_live() && view(arena) == key;
+            }
+
+            /// Stores @a key, appending it to @a arena if it is too long for the bucket.
+            void assign(std::string_view key, unsigned char fingerprint, arena_type& arena) {
+                if (key.size() <= inline_capacity) {
+                    std::memcpy(bytes_, key.data(), key.size());
+                    tag_ = static_cast<unsigned char>(inline_tag + key.size());
+                }
+                else {
+                    std::uint64_t offset = arena.size(), length = key.size();
+                    arena.insert(arena.end(), key.begin(), key.end());
+                    std::memcpy(bytes_, &offset, sizeof(offset));
+                    std::memcpy(bytes_ + sizeof(offset), &length, sizeof(length));
+                    tag_ = far_tag;
+                }
+                fingerprint_ = fingerprint;
+            }
+
+            void bury() noexcept {
+                tag_ = tombstone_tag;
+            }
+
+            void clear() noexcept {
+                tag_ = empty_tag;
+            }
+
+        private:
+            static constexpr unsigned char empty_tag = 0;
+            static constexpr unsigned char tombstone_tag = 1;
+            static constexpr unsigned char inline_tag = 2;
+            static constexpr unsigned char far_tag = 255;
+
+            char bytes_[inline_capacity];
+            unsigned char fingerprint_;
+            unsigned char tag_;
+        };
+
+        static_assert(sizeof(key_slot) == inline_capacity + 2, "key_slot must stay packed");
+
+        /// A bucket; value is alive only while key is live.
+        struct slot {
+            key_slot key;
+            union {
+                T value;
+            };
+
+            slot() noexcept {}
+            ~slot() {}
+        };
+
+        using slot_allocator = typename alloc_traits::template rebind_alloc<slot>;
+        using slot_traits = std::allocator_traits<slot_allocator>;
+
+        template<bool Const>
+        class basic_iterator {
+            using slot_pointer = typename std::conditional<Const, const slot*, slot*>::type;
+
+        public:
+            using iterator_category = std::forward_iterator_tag;
+            using value_type = string_hash_map::value_type;
+            using difference_type = std::ptrdiff_t;
+            using reference = typename std::conditional<Const, string_hash_map::const_reference, string_hash_map::reference>::type;
+
+            /// Keeps the pair alive for operator->.
+            struct pointer {
+                reference ref;
+
+                const reference* operator->() const noexcept {
+                    return &ref;
+                }
+            };
+
+            basic_iterator() noexcept : map_(nullptr), slot_(nullptr) {}
+
+            template<bool C = Const, typename = typename std::enable_if<C>::type>
+            basic_iterator(const basic_iterator<false>& other) noexcept : map_(other.map_), slot_(other.slot_) {}
+
+            reference operator*() const {
+                return reference(slot_->key.view(map_->arena_.data()), slot_->value);
+            }
+
+            pointer operator->() const {
+                return pointer{ **this };
+            }
+
+            basic_iterator& operator++() {
+                slot_ = map_->next_live(slot_ + 1);
+                return *this;
+            }
+
+            basic_iterator operator++(int) {
+                basic_iterator previous(*this);
+                ++(*this);
+                return previous;
+            }
+
+            friend bool operator==(const basic_iterator& lhs, const basic_iterator& rhs) {
+                return lhs.slot_ == rhs.slot_;
+            }
+
+            friend bool operator!=(const basic_iterator& lhs, const basic_iterator& rhs) {
+                return lhs.slot_ != rhs.slot_;
+            }
+
+        private:
+            friend class string_hash_map;
+            friend class basic_iterator<true>;
+
+            const string_hash_map* map_;
+            slot_pointer slot_;
+
+            basic_iterator(const string_hash_map* map, slot_pointer s) noexcept : map_(map), slot_(s) {}
+        };
+
+    public:
+        using iterator = basic_iterator<false>;
+        using const_iterator = basic_iterator<true>;
+
+        /// Default constructor.
+        string_hash_map() : string_hash_map(Alloc()) {}
+
+        explicit string_hash_map(const allocator_type& a) : allocator_(a), size_(0), tombstones_(0), mask_(0),
+            max_load_factor_(0.75), slots_(nullptr), arena_(typename arena_type::allocator_type(a)), garbage_(0), hash_() {}
+
+        string_hash_map(std::initializer_list<std::pair<std::string_view, T>> l, const allocator_type& a = allocator_type())
+            : string_hash_map(a) {
+            reserve(l.size());
+            for (const auto& element : l) {
+                try_emplace(element.first, element.second);
+            }
+        }
+
+        string_hash_map(const string_hash_map& other)
+            : allocator_(alloc_traits::select_on_container_copy_construction(other.allocator_)), size_(0), tombstones_(0),
+            mask_(0), max_load_factor_(other.max_load_factor_), slots_(nullptr),
+            arena_(typename arena_type::allocator_type(allocator_)), garbage_(0), hash_(other.hash_) {
+            copy_table(other);
+        }
+
+        string_hash_map(string_hash_map&& other) noexcept
+            : allocator_(std::move(other.allocator_)), size_(0), tombstones_(0), mask_(0), max_load_factor_(other.max_load_factor_),
+            slots_(nullptr), arena_(typename arena_type::allocator_type(allocator_)), garbage_(0), hash_(other.hash_) {
+            swap_table(other);
+        }
+
+        string_hash_map& operator=(const string_hash_map& other) {
+            if (this != &other) {
+                destroy();
+                if constexpr (alloc_traits::propagate_on_container_copy_assignment::value) {
+                    allocator_ = other.allocator_;
+                    arena_ = arena_type(typename arena_type::allocator_type(allocator_));
+                }
+                max_load_factor_ = other.max_load_factor_;
+                hash_ = other.hash_;
+                copy_table(other);
+            }
+            return *this;
+        }
+
+        string_hash_map& operator=(string_hash_map&& other) {
+            if (this == &other) {
+                return *this;
+            }
+
+            destroy();
+            max_load_factor_ = other.max_load_factor_;
+            hash_ = other.hash_;
+
+            if constexpr (alloc_traits::propagate_on_container_move_assignment::value) {
+                allocator_ = std::move(other.allocator_);
+                swap_table(other);
+            }
+            else if (allocator_ == other.allocator_) {
+                swap_table(other);
+            }
+            else {
+                copy_table(other);
+                other.clear();
+            }
+            return *this;
+        }
+
+        ~string_hash_map() {
+            destroy();
+        }
+
+        allocator_type get_allocator() const noexcept {
+            return allocator_;
+        }
+
+        bool empty() const noexcept {
+            return size_ == 0;
+        }
+
+        size_type size() const noexcept {
+            return size_;
+        }
+
+        /// Returns the bytes used by the map; the key arena is counted under heap.
+        memory_footprint memory_usage() const noexcept {
+            memory_footprint footprint;
+            footprint.object = sizeof(*this);
+            footprint.slots = bucket_count() * sizeof(slot);
+            footprint.heap = arena_.capacity();
+            return footprint;
+        }
+
+        /// Bytes of the arena held by keys that were erased.
+        size_type arena_garbage() const noexcept {
+            return garbage_;
+        }
+
+        //@{
+        iterator begin() noexcept {
+            return iterator(this, next_live(slots_));
+        }
+
+        const_iterator begin() const noexcept {
+            return const_iterator(this, next_live(slots_));
+        }
+
+        const_iterator cbegin() const noexcept {
+            return begin();
+        }
+
+        iterator end() noexcept {
+            return iterator(this, slots_ + bucket_count());
+        }
+
+        const_iterator end() const noexcept {
+            return const_iterator(this, slots_ + bucket_count());
+        }
+
+        const_iterator cend() const noexcept {
+            return end();
+        }
+        //@}
+
+        /**
+         *  @brief  Inserts an element with key @a k and a value constructed
+         *          from @a args if @a k is absent.
+         *  @return  A pair of an iterator to the element with key @a k and a
+         *           bool that is true if the element was inserted.
+         */
+        template<typename... Args>
+        std::pair<iterator, bool> try_emplace(std::string_view k, Args&&... args) {
+            std::uint64_t hash = detail::mix(hash_(k));
+            slot* s = find_slot(k, hash);
+            if (s != nullptr) {
+                return { iterator(this, s), false };
+            }
+
+            // A key read from this map, such as a part of it->first, would
+            // dangle once the insertion rehashes or grows the arena.
+            if (owns(k)) {
+                std::string key(k);
+                return { iterator(this, &insert_slot(key, hash, std::forward<Args>(args)...)), true };
+            }
+            return { iterator(this, &insert_slot(k, hash, std::forward<Args>(args)...)), true };
+        }
+
+        std::pair<iterator, bool> insert(const value_type& x) {
+            return try_emplace(x.first, x.second);
+        }
+
+        std::pair<iterator, bool> insert(value_type&& x) {
+            return try_emplace(x.first, std::move(x.second));
+        }
+
+        template<typename Obj>
+        std::pair<iterator, bool> insert_or_assign(std::string_view k, Obj&& obj) {
+            slot* s = find_slot(k);
+            if (s != nullptr) {
+                s->value = std::forward<Obj>(obj);
+                return { iterator(this, s), false };
+            }
+            return try_emplace(k, std::forward<Obj>(obj));
+        }
+
+        mapped_type& operator[](std::string_view k) {
+            return try_emplace(k).first.slot_->value;
+        }
+
+        //@{
+        /// Returns the value of @a k, or throws std::out_of_range.
+        mapped_type& at(std::string_view k) {
+            slot* s = find_slot(k);
+            if (s == nullptr) {
+                throw std::out_of_range("string_hash_map::at");
+            }
+            return s->value;
+        }
+
+        const mapped_type& at(std::string_view k) const {
+            const slot* s = find_slot(k);
+            if (s == nullptr) {
+                throw std::out_of_range("string_hash_map::at");
+            }
+            return s->value;
+        }
+        //@}
+
+        //@{
+        iterator find(std::string_view k) {
+            slot* s = find_slot(k);
+            return s == nullptr ? end() : iterator(this, s);
+        }
+
+        const_iterator find(std::string_view k) const {
+            const slot* s = find_slot(k);
+            return s == nullptr ? end() : const_iterator(this, s);
+        }
+        //@}
+
+        bool contains(std::string_view k) const {
+            return find_slot(k) != nullptr;
+        }
+
+        size_type count(std::string_view k) const {
+            return contains(k) ? 1 : 0;
+        }
+
+        /// Erases the element at @a position; returns an iterator to the next one.
+        iterator erase(const_iterator position) {
+            slot* s = const_cast<slot*>(position.slot_);
+            erase_slot(*s);
+            return iterator(this, next_live(s + 1));
+        }
+
+        /// Erases the element with key @a k; returns the number erased.
+        size_type erase(std::string_view k) {
+            slot* s = find_slot(k);
+            if (s == nullptr) {
+                return 0;
+            }
+            erase_slot(*s);
+            return 1;
+        }
+
+        /// Erases every element and empties the arena; the buckets are kept.
+        void clear() noexcept {
+            for (size_type i = 0; i != bucket_count(); i++) {
+                if (slots_[i].key.is_live()) {
+                    slots_[i].value.~T();
+                }
+                slots_[i].key.clear();
+            }
+            arena_.clear();
+            garbage_ = 0;
+            size_ = 0;
+            tombstones_ = 0;
+        }
+
+        void swap(string_hash_map& x) noexcept {
+            if constexpr (alloc_traits::propagate_on_container_swap::value) {
+                using std::swap;
+                swap(allocator_, x.allocator_);
+            }
+            std::swap(max_load_factor_, x.max_load_factor_);
+            std::swap(hash_, x.hash_);
+            swap_table(x);
+        }
+
+        size_type bucket_count() const noexcept {
+            return slots_ == nullptr ? 0 : mask_ + 1;
+        }
+
+        float load_factor() const noexcept {
+            return bucket_count() == 0 ? 0 : static_cast<float>(size_) / bucket_count();
+        }
+
+        float max_load_factor() const noexcept {
+            return max_load_factor_;
+        }
+
+        void max_load_factor(float z) {
+            max_load_factor_ = z;
+        }
+
+        /// Rebuilds the table with at least @a n buckets, rounded up to a
+        /// power of two, and copies the live long keys into a new arena.
+        void rehash(size_type n) {
+            n = std::max({ n, static_cast<size_type>(std::ceil(size_ / max_load_factor_)) + 1, size_type(8) });
+
+            size_type new_count = 1;
+            while (new_count < n) {
+                new_count *= 2;
+            }
+
+            arena_type new_arena{ typename arena_type::allocator_type(allocator_) };
+            new_arena.reserve(arena_.size() - garbage_);
+
+            slot_allocator slot_alloc(allocator_);
+            slot* new_slots = slot_traits::allocate(slot_alloc, new_count);
+            for (size_type i = 0; i != new_count; i++) {
+                new (new_slots + i) slot();
+            }
+
+            // The old elements stay in place until every one has been moved,
+            // so a throwing copy leaves the map as it was.  The new arena is
+            // reserved, so assign() does not throw.
+            size_type new_mask = new_count - 1;
+            try {
+                for (size_type i = 0; i != bucket_count(); i++) {
+                    slot& s = slots_[i];
+                    if (s.key.is_live()) {
+                        std::string_view key = s.key.view(arena_.data());
+                        std::uint64_t hash = detail::mix(hash_(key));
+
+                        size_type pos = static_cast<size_type>(hash) & new_mask;
+                        while (!new_slots[pos].key.is_empty()) {
+                            pos = (pos + 1) & new_mask;
+                        }
+
+                        new (&new_slots[pos].value) T(std::move_if_noexcept(s.value));
+                        new_slots[pos].key.assign(key, fingerprint_of(hash), new_arena);
+                    }
+                }
+            }
+            catch (...) {
+                for (size_type i = 0; i != new_count; i++) {
+                    if (new_slots[i].key.is_live()) {
+                        new_slots[i].value.~T();
+                    }
+                    new_slots[i].~slot();
+                }
+                slot_traits::deallocate(slot_alloc, new_slots, new_count);
+                throw;
+            }
+
+            size_type size = size_;
+            destroy();
+
+            size_ = size;
+            mask_ = new_mask;
+            slots_ = new_slots;
+            arena_ = std::move(new_arena);
+        }
+
+        /// Same as rehash(ceil(n / max_load_factor())).
+        void reserve(size_type n) {
+            rehash(static_cast<size_type>(std::ceil(n / max_load_factor_)));
+        }
+
+    private:
+        allocator_type allocator_;
+        size_type size_;
+        size_type tombstones_;
+        size_type mask_;
+        float max_load_factor_;
+        slot* slots_;
+        arena_type arena_;
+        size_type garbage_;
+        Hash hash_;
+
+        // The bucket comes from the low bits, so the fingerprint takes the high ones.
+        static unsigned char fingerprint_of(std::uint64_t hash) noexcept {
+            return static_cast<unsigned char>(hash >> 56);
+        }
+
+        // First live bucket at or after @a s, or the end of the table.
+        template<typename SlotPointer>
+        SlotPointer next_live(SlotPointer s) const noexcept {
+            SlotPointer last = slots_ + bucket_count();
+            while (s != last && !s->key.is_live()) {
+                ++s;
+            }
+            return s;
+        }
+
+        //@{
+        slot* find_slot(std::string_view k) {
+            return const_cast<slot*>(static_cast<const string_hash_map*>(this)->find_slot(k));
+        }
+
+        const slot* find_slot(std::string_view k) const {
+            return find_slot(k, detail::mix(hash_(k)));
+        }
+
+        slot* find_slot(std::string_view k, std::uint64_t hash) {
+            return const_cast<slot*>(static_cast<const string_hash_map*>(this)->find_slot(k, hash));
+        }
+
+        const slot* find_slot(std::string_view k, std::uint64_t hash) const {
+            if (size_ == 0) {
+                return nullptr;
+            }
+
+            unsigned char fingerprint = fingerprint_of(hash);
+
+            for (size_type pos = static_cast<size_type>(hash) & mask_;; pos = (pos + 1) & mask_) {
+                const slot& s = slots_[pos];
+
+                if (s.key.matches(k, fingerprint, arena_.data())) {
+                    return &s;
+                }
+                if (s.key.is_empty()) {
+                    return nullptr;
+                }
+            }
+        }
+        //@}
+
+        /// Whether @a k points into the buckets or the arena of this map.
+        bool owns(std::string_view k) const noexcept {
+            std::less<const char*> less;
+            const char* buckets = reinterpret_cast<const char*>(slots_);
+            const char* arena = arena_.data();
+
+            return (!less(k.data(), buckets) && less(k.data(), buckets + bucket_count() * sizeof(slot)))
+                || (!less(k.data(), arena) && less(k.data(), arena + arena_.size()));
+        }
+
+        // Places the absent key @a k, growing the table first if needed.
+        template<typename... Args>
+        slot& insert_slot(std::string_view k, std::uint64_t hash, Args&&... args) {
+            if (size_ + tombstones_ + 1 > bucket_count() * max_load_factor_) {
+                rehash(size_ + 1 > bucket_count() * max_load_factor_ / 2 ? bucket_count() * 2 : bucket_count());
+            }
+
+            size_type pos = static_cast<size_type>(hash) & mask_;
+            while (slots_[pos].key.is_live()) {
+                pos = (pos + 1) & mask_;
+            }
+            bool reuse = !slots_[pos].key.is_empty();
+
+            slot& s = slots_[pos];
+            new (&s.value) T(std::forward<Args>(args)...);
+            try {
+                s.key.assign(k, fingerprint_of(hash), arena_);
+            }
+            catch (...) {
+                s.value.~T();
+                throw;
+            }
+            tombstones_ -= reuse ? 1 : 0;
+            size_++;
+
+            return s;
+        }
+
+        void erase_slot(slot& s) {
+            if (s.key.is_far()) {
+                garbage_ += s.key.view(arena_.data()).size();
+            }
+            s.value.~T();
+            s.key.bury();
+            size_--;
+            tombstones_++;
+        }
+
+        // Copies @a other into this empty map bucket by bucket, arena included.
+        void copy_table(const string_hash_map& other) {
+            if (other.slots_ == nullptr) {
+                return;
+            }
+
+            slot_allocator slot_alloc(allocator_);
+            size_type count = other.bucket_count();
+            slots_ = slot_traits::allocate(slot_alloc, count);
+            mask_ = count - 1;
+
+            for (size_type i = 0; i != count; i++) {
+                new (slots_ + i) slot();
+            }
+
+            try {
+                arena_.assign(other.arena_.begin(), other.arena_.end());
+                for (size_type i = 0; i != count; i++) {
+                    const slot& s = other.slots_[i];
+                    if (s.key.is_live()) {
+                        new (&slots_[i].value) T(s.value);
+                        size_++;
+                    }
+                    slots_[i].key = s.key;
+                }
+            }
+            catch (...) {
+                destroy();
+                throw;
+            }
+            tombstones_ = other.tombstones_;
+            garbage_ = other.garbage_;
+        }
+
+        void swap_table(string_hash_map& x) noexcept {
+            std::swap(size_, x.size_);
+            std::swap(tombstones_, x.tombstones_);
+            std::swap(mask_, x.mask_);
+            std::swap(slots_, x.slots_);
+            arena_.swap(x.arena_);
+            std::swap(garbage_, x.garbage_);
+        }
+
+        /// Destroys the elements and releases the buckets and the arena.
+        void destroy() noexcept {
+            if (slots_ != nullptr) {
+                size_type count = bucket_count();
+                for (size_type i = 0; i != count; i++) {
+                    if (slots_[i].key.is_live()) {
+                        slots_[i].value.~T();
+                    }
+                    slots_[i].~slot();
+                }
+
+                slot_allocator slot_alloc(allocator_);
+                slot_traits::deallocate(slot_alloc, slots_, count);
+            }
+
+            size_ = 0;
+            tombstones_ = 0;
+            mask_ = 0;
+            slots_ = nullptr;
+            arena_.clear();
+            arena_.shrink_to_fit();
+            garbage_ = 0;
+        }
+    };
+
+} // namespace fefu
@@ -0,0 +1,222 @@
+#include <cstdint>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "hash_map.hpp"
+#include "string_hash_map.hpp"
+#include "../catch.hpp"
+
+namespace
+{
+    // Mostly short words with a tail of long compound tokens.
+    std::vector<std::string> make_vocabulary(std::size_t words, std::uint64_t seed) {
+        std::mt19937_64 generator(seed);
+        std::vector<std::string> vocabulary(words);
+
+        for (std::size_t i = 0; i < words; i++) {
+            std::size_t length = generator() % 5 == 0 ? 23 + generator() % 40 : 3 + generator() % 10;
+            std::string& word = vocabulary[i];
+            word = std::to_string(i);
+            while (word.size() < length) {
+                word += static_cast<char>('a' + generator() % 26);
+            }
+        }
+        return vocabulary;
+    }
+}
+
+TEST_CASE("string_hash_map stores short keys inline and long keys in the arena", "[string_hash_map]") {
+    fefu::string_hash_map<int> map;
+    std::string long_key(100, 'x');
+
+    REQUIRE(map.try_emplace("short", 1).second);
+    REQUIRE(map.try_emplace(std::string(22, 'y'), 2).second);
+    REQUIRE(map.try_emplace(long_key, 3).second);
+    REQUIRE(map.try_emplace("", 4).second);
+    REQUIRE_FALSE(map.try_emplace(long_key, 5).second);
+
+    REQUIRE(map.size() == 4);
+    REQUIRE(map.at("short") == 1);
+    REQUIRE(map.at(std::string(22, 'y')) == 2);
+    REQUIRE(map.at(long_key) == 3);
+    REQUIRE(map.at("") == 4);
+    REQUIRE_THROWS_AS(map.at(std::string(99, 'x')), std::out_of_range);
+    REQUIRE(map.memory_usage().heap >= 100);
+
+    map.erase(long_key);
+    REQUIRE(map.arena_garbage() == 100);
+    REQUIRE_FALSE(map.contains(long_key));
+
+    map.rehash(1000);
+    REQUIRE(map.arena_garbage() == 0);
+    REQUIRE(map.memory_usage().heap == 0);
+    REQUIRE(map.at("short") == 1);
+}
+
+TEST_CASE("string_hash_map inserts keys read from itself", "[string_hash_map]") {
+    fefu::string_hash_map<int> map;
+    map.try_emplace(std::string(60, 'a') + "tail", 0);
+    map.try_emplace("short key", 0);
+
+    // Each insertion may rehash and free the bytes its key was read from.
+    for (int i = 1; i < 200; i++) {
+        std::string_view long_key = map.find(std::string(60, 'a') + "tail")->first;
+        REQUIRE(map.try_emplace(long_key.substr(i % 60), i).second == (i < 60));
+        std::string_view short_key = map.find("short key")->first;
+        REQUIRE(map.try_emplace(short_key.substr(0, 1 + i % 8), i).second == (i <= 8));
+    }
+
+    REQUIRE(map.size() == 2 + 59 + 8);
+    REQUIRE(map.at(std::string(59, 'a') + "tail") == 1);
+    REQUIRE(map.at("short") == 4);
+
+    SECTION("looking up a present key keeps iterators valid") {
+        map.max_load_factor(0.01f);
+        auto first = map.begin();
+        std::size_t buckets = map.bucket_count();
+        REQUIRE_FALSE(map.try_emplace(first->first, -1).second);
+        REQUIRE(map.bucket_count() == buckets);
+        REQUIRE(first == map.begin());
+    }
+}
+
+TEST_CASE("string_hash_map agrees with std::unordered_map", "[string_hash_map]") {
+    auto words = make_vocabulary(5000, 1);
+    fefu::string_hash_map<std::size_t> map;
+    std::unordered_map<std::string, std::size_t> reference;
+
+    std::mt19937 generator(2);
+    for (int round = 0; round < 50000; round++) {
+        const std::string& word = words[generator() % words.size()];
+        if (generator() % 3 == 0) {
+            REQUIRE(map.erase(word) == reference.erase(word));
+        }
+        else {
+            map[word]++;
+            reference[word]++;
+        }
+    }
+
+    REQUIRE(map.size() == reference.size());
+    for (auto element : map) {
+        REQUIRE(reference.at(std::string(element.first)) == element.second);
+    }
+
+    SECTION("copy, move and clear") {
+        auto copy = map;
+        fefu::string_hash_map<std::size_t> moved(std::move(copy));
+        REQUIRE(copy.empty());
+        for (const auto& element : reference) {
+            REQUIRE(moved.at(element.first) == element.second);
+        }
+
+        moved.clear();
+        REQUIRE(moved.begin() == moved.end());
+        REQUIRE(moved.arena_garbage() == 0);
+    }
+}
+
+namespace
+{
+    // Copying throws once copies_left reaches zero; the move may throw, so rehash copies.
+    struct fragile {
+        static int copies_left;
+        int value;
+
+        explicit fragile(int v) : value(v) {}
+        fragile(const fragile& other) : value(other.value) {
+            if (copies_left-- == 0) {
+                throw std::runtime_error("copy failed");
+            }
+        }
+        fragile(fragile&& other) noexcept(false) : value(other.value) {}
+    };
+
+    int fragile::copies_left = 0;
+}
+
+TEST_CASE("string_hash_map rehash keeps the map when a copy throws", "[string_hash_map]") {
+    fefu::string_hash_map<fragile> map;
+    auto key_of = [](int i) { return i % 2 == 0 ? std::to_string(i) : std::string(40, 'k') + std::to_string(i); };
+
+    fragile::copies_left = 1000;
+    for (int i = 0; i < 100; i++) {
+        map.try_emplace(key_of(i), i);
+    }
+    std::size_t buckets = map.bucket_count();
+
+    fragile::copies_left = 50;
+    REQUIRE_THROWS_AS(map.rehash(4 * buckets), std::runtime_error);
+    REQUIRE(map.bucket_count() == buckets);
+    REQUIRE(map.size() == 100);
+    for (int i = 0; i < 100; i++) {
+        REQUIRE(map.at(key_of(i)).value == i);
+    }
+}
+
+TEST_CASE("Vocabulary: hash_map<std::string> versus string_hash_map", "[string_hash_map][!benchmark]") {
+    // 50M words needs more memory than a test run should take; the per-entry
+    // figures do not depend on the vocabulary size.
+    const std::size_t words = 3000000;
+    const std::size_t lookups = 1 << 22;
+
+    auto vocabulary = make_vocabulary(words, 3);
+
+    // The probe keys are read in order, so only the tables miss the cache.
+    std::mt19937_64 generator(4);
+    std::vector<std::string> string_probes(lookups);
+    std::string probe_text;
+    for (auto& probe : string_probes) {
+        probe = vocabulary[generator() % words];
+        probe_text += probe;
+    }
+
+    std::vector<std::string_view> probes(lookups);
+    for (std::size_t i = 0, offset = 0; i < lookups; offset += string_probes[i++].size()) {
+        probes[i] = std::string_view(probe_text).substr(offset, string_probes[i].size());
+    }
+
+    fefu::hash_map<std::string, std::uint32_t> map;
+    fefu::string_hash_map<std::uint32_t> strings;
+
+    BENCHMARK("hash_map<std::string> build") {
+        map = fefu::hash_map<std::string, std::uint32_t>();
+        for (std::size_t i = 0; i < words; i++) {
+            map[vocabulary[i]] = static_cast<std::uint32_t>(i);
+        }
+        return map.size();
+    };
+
+    BENCHMARK("string_hash_map build") {
+        strings = fefu::string_hash_map<std::uint32_t>();
+        for (std::size_t i = 0; i < words; i++) {
+            strings[vocabulary[i]] = static_cast<std::uint32_t>(i);
+        }
+        return strings.size();
+    };
+
+    auto string_heap = [](const std::pair<const std::string, std::uint32_t>& element) {
+        return element.first.capacity() > 15 ? element.first.capacity() + 1 : 0;
+    };
+    WARN("bytes per entry: hash_map<std::string> " << static_cast<double>(map.memory_usage(string_heap).total()) / words
+        << " (plus malloc headers), string_hash_map " << static_cast<double>(strings.memory_usage().total()) / words);
+
+    BENCHMARK("hash_map<std::string> find") {
+        std::uint64_t sum = 0;
+        for (const std::string& word : string_probes) {
+            sum += map.find(word)->second;
+        }
+        return sum;
+    };
+
+    BENCHMARK("string_hash_map find") {
+        std::uint64_t sum = 0;
+        for (std::string_view word : probes) {
+            sum += strings.find(word)->second;
+        }
+        return sum;
+    };
+}
@@ -0,0 +1,281 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace fefu
+{
+    /**
+     *  @brief  A fixed-size work-stealing thread pool.
+     *
+     *  Every worker owns a task deque.  It pushes and pops its own tasks at
+     *  the back (LIFO, cache friendly) and, when out of work, steals from
+     *  the front of another worker's deque (FIFO, takes the largest
+     *  pieces of a recursive split).  Threads waiting on a %task_group run
+     *  tasks themselves instead of blocking, so nested parallelism cannot
+     *  deadlock the pool.
+     */
+    class thread_pool {
+    public:
+        using task = std::function<void()>;
+
+        /// A set of tasks that can be waited for together.
+        class task_group {
+        public:
+            explicit task_group(thread_pool& pool) : pool_(pool), pending_(0) {}
+
+            task_group(const task_group&) = delete;
+            task_group& operator=(const task_group&) = delete;
+
+            ~task_group() {
+                wait_all();
+            }
+
+            /// Schedules @a f on the pool.
+            template<typename F>
+            void run(F&& f) {
+                pending_.fetch_add(1, std::memory_order_relaxed);
+                pool_.push([this, f = std::forward<F>(f)]() mutable {
+                    try {
+                        f();
+                    }
+                    catch (...) {
+                        std::lock_guard<std::mutex> lock(error_mutex_);
+                        if (!error_) {
+                            error_ = std::current_exception();
+                        }
+                    }
+                    pending_.fetch_sub(1, std::memory_order_release);
+                });
+            }
+
+            /**
+             *  @brief  Runs pool tasks until every task of the group is done.
+             *  @throw  The first exception thrown by a task of the group.
+             */
+            void wait() {
+                wait_all();
+
+                if (error_) {
+                    std::exception_ptr error = error_;
+                    error_ = nullptr;
+                    std::rethrow_exception(error);
+                }
+            }
+
+        private:
+            thread_pool& pool_;
+            std::atomic<std::size_t> pending_;
+            std::mutex error_mutex_;
+            std::exception_ptr error_;
+
+            void wait_all() {
+                while (pending_.load(std::memory_order_acquire) != 0) {
+                    if (!pool_.run_one()) {
+                        std::this_thread::yield();
+                    }
+                }
+            }
+        };
+
+        /**
+         *  @brief  Starts the workers.
+         *  @param  threads  Number of worker threads; the hardware
+         *                   concurrency by default.
+         */
+        explicit thread_pool(std::size_t threads = std::thread::hardware_concurrency())
+            : queues_(std::max<std::size_t>(threads, 1)), next_queue_(0), pushes_(0), stop_(false) {
+            for (std::size_t i = 0; i != queues_.size(); i++) {
+                queues_[i].reset(new work_queue());
+            }
+
+            for (std::size_t i = 0; i != queues_.size(); i++) {
+                workers_.emplace_back([this, i] { work(i); });
+            }
+        }
+
+        thread_pool(const thread_pool&) = delete;
+        thread_pool& operator=(const thread_pool&) = delete;
+
+        /// Finishes queued tasks and joins the workers.
+        ~thread_pool() {
+            {
+                std::lock_guard<std::mutex> lock(sleep_mutex_);
+                stop_ = true;
+            }
+            wake_.notify_all();
+
+            for (auto& worker : workers_) {
+                worker.join();
+            }
+        }
+
+        /// Returns the number of worker threads.
+        std::size_t size() const noexcept {
+            return workers_.size();
+        }
+
+        /// Returns a process-wide pool sized to the hardware.
+        static thread_pool& default_pool() {
+            static thread_pool pool;
+            return pool;
+        }
+
+        /**
+         *  @brief  Calls @a f on subranges of [first, last) in parallel.
+         *  @param  grain  Ranges no longer than this are not split further.
+         *  @param  align  Split points are multiples of this.
+         *
+         *  The range is split in halves recursively; the halves are stolen
+         *  by idle workers.  Blocks until every call returned.
+         */
+        template<typename F>
+        void parallel_for(std::size_t first, std::size_t last, std::size_t grain, F f, std::size_t align = 1) {
+            task_group group(*this);
+            grain = std::max(grain, align);
+            split(group, first, last, grain, align, f);
+            group.wait();
+        }
+
+    private:
+        struct work_queue {
+            std::mutex mutex;
+            std::deque<task> tasks;
+        };
+
+        std::vector<std::unique_ptr<work_queue>> queues_;
+        std::vector<std::thread> workers_;
+        std::atomic<std::size_t> next_queue_;
+        std::mutex sleep_mutex_;
+        std::condition_variable wake_;
+        std::atomic<std::size_t> pushes_;   ///< Tasks pushed so far; raised under sleep_mutex_.
+        bool stop_;
+
+        struct worker_identity {
+            const thread_pool* pool = nullptr;
+            std::size_t index = 0;
+        };
+
+        static worker_identity& identity() {
+            thread_local worker_identity id;
+            return id;
+        }
+
+        // Queue owned by the calling thread, or queues_.size() outside the pool.
+        std::size_t current_queue() const {
+            const worker_identity& id = identity();
+            return id.pool == this ? id.index : queues_.size();
+        }
+
+        void push(task t) {
+            std::size_t index = current_queue();
+
+            if (index >= queues_.size()) {
+                index = next_queue_.fetch_add(1, std::memory_order_relaxed) % queues_.size();
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(queues_[index]->mutex);
+                queues_[index]->tasks.push_back(std::move(t));
+            }
+
+            // Raised under the sleep mutex, so a worker cannot miss it between
+            // checking its wait predicate and going to sleep.
+            {
+                std::lock_guard<std::mutex> lock(sleep_mutex_);
+                pushes_.fetch_add(1, std::memory_order_release);
+            }
+            wake_.notify_one();
+        }
+
+        bool pop(std::size_t index, task& t) {
+            work_queue& queue = *queues_[index];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+
+            if (queue.tasks.empty()) {
+                return false;
+            }
+
+            t = std::move(queue.tasks.back());
+            queue.tasks.pop_back();
+            return true;
+        }
+
+        bool steal(std::size_t thief, task& t) {
+            for (std::size_t i = 1; i <= queues_.size(); i++) {
+                work_queue& queue = *queues_[(thief + i) % queues_.size()];
+                std::lock_guard<std::mutex> lock(queue.mutex);
+
+                if (!queue.tasks.empty()) {
+                    t = std::move(queue.tasks.front());
+                    queue.tasks.pop_front();
+                    return true;
+                }
+            }
+
+            return false;
+        }
+
+        // Runs one task from the caller's queue or a stolen one.
+        bool run_one() {
+            std::size_t index = current_queue();
+            task t;
+
+            if ((index < queues_.size() && pop(index, t)) || steal(index % queues_.size(), t)) {
+                t();
+                return true;
+            }
+
+            return false;
+        }
+
+        void work(std::size_t index) {
+            identity().pool = this;
+            identity().index = index;
+
+            while (true) {
+                // A task pushed after this read changes pushes_; one pushed
+                // before it is already queued and seen by run_one().
+                std::size_t seen = pushes_.load(std::memory_order_acquire);
+
+                if (run_one()) {
+                    continue;
+                }
+
+                std::unique_lock<std::mutex> lock(sleep_mutex_);
+                wake_.wait(lock, [this, seen] { return stop_ || pushes_.load(std::memory_order_relaxed) != seen; });
+
+                if (stop_) {
+                    break;
+                }
+            }
+
+            while (run_one()) {
+            }
+        }
+
+        template<typename F>
+        void split(task_group& group, std::size_t first, std::size_t last, std::size_t grain, std::size_t align, const F& f) {
+            while (last - first > grain) {
+                std::size_t middle = first + (last - first) / 2 / align * align;
+
+                if (middle == first) {
+                    break;
+                }
+
+                group.run([this, &group, middle, last, grain, align, &f] { split(group, middle, last, grain, align, f); });
+                last = middle;
+            }
+
+            f(first, last);
+        }
+    };
+
+} // namespace fefu